@@ -39,6 +39,9 @@ extern int isdigit_string(const char *str);
 #ifndef HAVE_MEMPCPY
 extern void *mempcpy(void *restrict dest, const void *restrict src, size_t n);
 #endif
+#ifndef HAVE_MEMRCHR
+extern void *memrchr(const void *s, int c, size_t n);
+#endif
 #ifndef HAVE_STRNLEN
 extern size_t strnlen(const char *s, size_t maxlen);
 #endif
@@ -16,6 +16,8 @@
 #include <inttypes.h>
 #include <dirent.h>
 
+struct sysfs_cache;
+
 struct sysfs_cxt {
 	dev_t	devno;
 	int	dir_fd;		/* /sys/block/<name> */
@@ -28,9 +30,11 @@ struct sysfs_cxt {
 			scsi_lun;
 
 	unsigned int	has_hctl : 1;
+
+	struct sysfs_cache *cache;	/* see sysfs_enable_cache() */
 };
 
-#define UL_SYSFSCXT_EMPTY { 0, -1, NULL, NULL, 0, 0, 0, 0, 0 }
+#define UL_SYSFSCXT_EMPTY { 0, -1, NULL, NULL, 0, 0, 0, 0, 0, NULL }
 
 extern char *sysfs_devno_attribute_path(dev_t devno, char *buf,
                                  size_t bufsiz, const char *attr);
@@ -43,6 +47,12 @@ extern int sysfs_init(struct sysfs_cxt *cxt, dev_t devno, struct sysfs_cxt *pare
 					__attribute__ ((warn_unused_result));
 extern void sysfs_deinit(struct sysfs_cxt *cxt);
 
+extern int sysfs_enable_cache(struct sysfs_cxt *cxt, int enable);
+extern const char *sysfs_next_dirent(struct sysfs_cxt *cxt, const char *attr,
+			const char *parent_name, size_t *idx);
+extern int sysfs_dirent_is_partition(struct sysfs_cxt *cxt, const char *attr,
+			const char *name);
+
 extern DIR *sysfs_opendir(struct sysfs_cxt *cxt, const char *attr);
 
 extern int sysfs_stat(struct sysfs_cxt *cxt, const char *attr, struct stat *st);
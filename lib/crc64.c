@@ -1,3 +1,7 @@
+#include <string.h>
+
+#include "c.h"
+#include "bitops.h"
 #include "crc64.h"
 
 static const uint64_t crc64_tab[256] = {
@@ -89,20 +93,722 @@ static const uint64_t crc64_tab[256] = {
 	0x9AFCE626CE85B507ULL
 };
 
+/*
+ * Slice-by-8 tables, crc64_slice[k - 1][i] is CRC of byte i followed by k zero
+ * bytes (crc64_tab is the table for k = 0).
+ */
+static const uint64_t crc64_slice[7][256] = {
+	{
+		0x0000000000000000ULL, 0xAF052A6B538EDF09ULL, 0x1CFAB53D0EF78881ULL,
+		0xB3FF9F565D795788ULL, 0x39F56A7A1DEF1102ULL, 0x96F040114E61CE0BULL,
+		0x250FDF4713189983ULL, 0x8A0AF52C4096468AULL, 0x73EAD4F43BDE2204ULL,
+		0xDCEFFE9F6850FD0DULL, 0x6F1061C93529AA85ULL, 0xC0154BA266A7758CULL,
+		0x4A1FBE8E26313306ULL, 0xE51A94E575BFEC0FULL, 0x56E50BB328C6BB87ULL,
+		0xF9E021D87B48648EULL, 0xE7D5A9E877BC4408ULL, 0x48D0838324329B01ULL,
+		0xFB2F1CD5794BCC89ULL, 0x542A36BE2AC51380ULL, 0xDE20C3926A53550AULL,
+		0x7125E9F939DD8A03ULL, 0xC2DA76AF64A4DD8BULL, 0x6DDF5CC4372A0282ULL,
+		0x943F7D1C4C62660CULL, 0x3B3A57771FECB905ULL, 0x88C5C8214295EE8DULL,
+		0x27C0E24A111B3184ULL, 0xADCA1766518D770EULL, 0x02CF3D0D0203A807ULL,
+		0xB130A25B5F7AFF8FULL, 0x1E3588300CF42086ULL, 0x8D5BB23B4692BE83ULL,
+		0x225E9850151C618AULL, 0x91A1070648653602ULL, 0x3EA42D6D1BEBE90BULL,
+		0xB4AED8415B7DAF81ULL, 0x1BABF22A08F37088ULL, 0xA8546D7C558A2700ULL,
+		0x075147170604F809ULL, 0xFEB166CF7D4C9C87ULL, 0x51B44CA42EC2438EULL,
+		0xE24BD3F273BB1406ULL, 0x4D4EF9992035CB0FULL, 0xC7440CB560A38D85ULL,
+		0x684126DE332D528CULL, 0xDBBEB9886E540504ULL, 0x74BB93E33DDADA0DULL,
+		0x6A8E1BD3312EFA8BULL, 0xC58B31B862A02582ULL, 0x7674AEEE3FD9720AULL,
+		0xD97184856C57AD03ULL, 0x537B71A92CC1EB89ULL, 0xFC7E5BC27F4F3480ULL,
+		0x4F81C49422366308ULL, 0xE084EEFF71B8BC01ULL, 0x1964CF270AF0D88FULL,
+		0xB661E54C597E0786ULL, 0x059E7A1A0407500EULL, 0xAA9B507157898F07ULL,
+		0x2091A55D171FC98DULL, 0x8F948F3644911684ULL, 0x3C6B106019E8410CULL,
+		0x936E3A0B4A669E05ULL, 0x5847859D24CF4B95ULL, 0xF742AFF67741949CULL,
+		0x44BD30A02A38C314ULL, 0xEBB81ACB79B61C1DULL, 0x61B2EFE739205A97ULL,
+		0xCEB7C58C6AAE859EULL, 0x7D485ADA37D7D216ULL, 0xD24D70B164590D1FULL,
+		0x2BAD51691F116991ULL, 0x84A87B024C9FB698ULL, 0x3757E45411E6E110ULL,
+		0x9852CE3F42683E19ULL, 0x12583B1302FE7893ULL, 0xBD5D11785170A79AULL,
+		0x0EA28E2E0C09F012ULL, 0xA1A7A4455F872F1BULL, 0xBF922C7553730F9DULL,
+		0x1097061E00FDD094ULL, 0xA36899485D84871CULL, 0x0C6DB3230E0A5815ULL,
+		0x8667460F4E9C1E9FULL, 0x29626C641D12C196ULL, 0x9A9DF332406B961EULL,
+		0x3598D95913E54917ULL, 0xCC78F88168AD2D99ULL, 0x637DD2EA3B23F290ULL,
+		0xD0824DBC665AA518ULL, 0x7F8767D735D47A11ULL, 0xF58D92FB75423C9BULL,
+		0x5A88B89026CCE392ULL, 0xE97727C67BB5B41AULL, 0x46720DAD283B6B13ULL,
+		0xD51C37A6625DF516ULL, 0x7A191DCD31D32A1FULL, 0xC9E6829B6CAA7D97ULL,
+		0x66E3A8F03F24A29EULL, 0xECE95DDC7FB2E414ULL, 0x43EC77B72C3C3B1DULL,
+		0xF013E8E171456C95ULL, 0x5F16C28A22CBB39CULL, 0xA6F6E3525983D712ULL,
+		0x09F3C9390A0D081BULL, 0xBA0C566F57745F93ULL, 0x15097C0404FA809AULL,
+		0x9F038928446CC610ULL, 0x3006A34317E21919ULL, 0x83F93C154A9B4E91ULL,
+		0x2CFC167E19159198ULL, 0x32C99E4E15E1B11EULL, 0x9DCCB425466F6E17ULL,
+		0x2E332B731B16399FULL, 0x813601184898E696ULL, 0x0B3CF434080EA01CULL,
+		0xA439DE5F5B807F15ULL, 0x17C6410906F9289DULL, 0xB8C36B625577F794ULL,
+		0x41234ABA2E3F931AULL, 0xEE2660D17DB14C13ULL, 0x5DD9FF8720C81B9BULL,
+		0xF2DCD5EC7346C492ULL, 0x78D620C033D08218ULL, 0xD7D30AAB605E5D11ULL,
+		0x642C95FD3D270A99ULL, 0xCB29BF966EA9D590ULL, 0xB08F0B3A499E972AULL,
+		0x1F8A21511A104823ULL, 0xAC75BE0747691FABULL, 0x0370946C14E7C0A2ULL,
+		0x897A614054718628ULL, 0x267F4B2B07FF5921ULL, 0x9580D47D5A860EA9ULL,
+		0x3A85FE160908D1A0ULL, 0xC365DFCE7240B52EULL, 0x6C60F5A521CE6A27ULL,
+		0xDF9F6AF37CB73DAFULL, 0x709A40982F39E2A6ULL, 0xFA90B5B46FAFA42CULL,
+		0x55959FDF3C217B25ULL, 0xE66A008961582CADULL, 0x496F2AE232D6F3A4ULL,
+		0x575AA2D23E22D322ULL, 0xF85F88B96DAC0C2BULL, 0x4BA017EF30D55BA3ULL,
+		0xE4A53D84635B84AAULL, 0x6EAFC8A823CDC220ULL, 0xC1AAE2C370431D29ULL,
+		0x72557D952D3A4AA1ULL, 0xDD5057FE7EB495A8ULL, 0x24B0762605FCF126ULL,
+		0x8BB55C4D56722E2FULL, 0x384AC31B0B0B79A7ULL, 0x974FE9705885A6AEULL,
+		0x1D451C5C1813E024ULL, 0xB24036374B9D3F2DULL, 0x01BFA96116E468A5ULL,
+		0xAEBA830A456AB7ACULL, 0x3DD4B9010F0C29A9ULL, 0x92D1936A5C82F6A0ULL,
+		0x212E0C3C01FBA128ULL, 0x8E2B265752757E21ULL, 0x0421D37B12E338ABULL,
+		0xAB24F910416DE7A2ULL, 0x18DB66461C14B02AULL, 0xB7DE4C2D4F9A6F23ULL,
+		0x4E3E6DF534D20BADULL, 0xE13B479E675CD4A4ULL, 0x52C4D8C83A25832CULL,
+		0xFDC1F2A369AB5C25ULL, 0x77CB078F293D1AAFULL, 0xD8CE2DE47AB3C5A6ULL,
+		0x6B31B2B227CA922EULL, 0xC43498D974444D27ULL, 0xDA0110E978B06DA1ULL,
+		0x75043A822B3EB2A8ULL, 0xC6FBA5D47647E520ULL, 0x69FE8FBF25C93A29ULL,
+		0xE3F47A93655F7CA3ULL, 0x4CF150F836D1A3AAULL, 0xFF0ECFAE6BA8F422ULL,
+		0x500BE5C538262B2BULL, 0xA9EBC41D436E4FA5ULL, 0x06EEEE7610E090ACULL,
+		0xB51171204D99C724ULL, 0x1A145B4B1E17182DULL, 0x901EAE675E815EA7ULL,
+		0x3F1B840C0D0F81AEULL, 0x8CE41B5A5076D626ULL, 0x23E1313103F8092FULL,
+		0xE8C88EA76D51DCBFULL, 0x47CDA4CC3EDF03B6ULL, 0xF4323B9A63A6543EULL,
+		0x5B3711F130288B37ULL, 0xD13DE4DD70BECDBDULL, 0x7E38CEB6233012B4ULL,
+		0xCDC751E07E49453CULL, 0x62C27B8B2DC79A35ULL, 0x9B225A53568FFEBBULL,
+		0x34277038050121B2ULL, 0x87D8EF6E5878763AULL, 0x28DDC5050BF6A933ULL,
+		0xA2D730294B60EFB9ULL, 0x0DD21A4218EE30B0ULL, 0xBE2D851445976738ULL,
+		0x1128AF7F1619B831ULL, 0x0F1D274F1AED98B7ULL, 0xA0180D24496347BEULL,
+		0x13E79272141A1036ULL, 0xBCE2B8194794CF3FULL, 0x36E84D35070289B5ULL,
+		0x99ED675E548C56BCULL, 0x2A12F80809F50134ULL, 0x8517D2635A7BDE3DULL,
+		0x7CF7F3BB2133BAB3ULL, 0xD3F2D9D072BD65BAULL, 0x600D46862FC43232ULL,
+		0xCF086CED7C4AED3BULL, 0x450299C13CDCABB1ULL, 0xEA07B3AA6F5274B8ULL,
+		0x59F82CFC322B2330ULL, 0xF6FD069761A5FC39ULL, 0x65933C9C2BC3623CULL,
+		0xCA9616F7784DBD35ULL, 0x796989A12534EABDULL, 0xD66CA3CA76BA35B4ULL,
+		0x5C6656E6362C733EULL, 0xF3637C8D65A2AC37ULL, 0x409CE3DB38DBFBBFULL,
+		0xEF99C9B06B5524B6ULL, 0x1679E868101D4038ULL, 0xB97CC20343939F31ULL,
+		0x0A835D551EEAC8B9ULL, 0xA586773E4D6417B0ULL, 0x2F8C82120DF2513AULL,
+		0x8089A8795E7C8E33ULL, 0x3376372F0305D9BBULL, 0x9C731D44508B06B2ULL,
+		0x824695745C7F2634ULL, 0x2D43BF1F0FF1F93DULL, 0x9EBC20495288AEB5ULL,
+		0x31B90A22010671BCULL, 0xBBB3FF0E41903736ULL, 0x14B6D565121EE83FULL,
+		0xA7494A334F67BFB7ULL, 0x084C60581CE960BEULL, 0xF1AC418067A10430ULL,
+		0x5EA96BEB342FDB39ULL, 0xED56F4BD69568CB1ULL, 0x4253DED63AD853B8ULL,
+		0xC8592BFA7A4E1532ULL, 0x675C019129C0CA3BULL, 0xD4A39EC774B99DB3ULL,
+		0x7BA6B4AC273742BAULL
+	},
+	{
+		0x0000000000000000ULL, 0x23EEF79F3AD718C7ULL, 0x47DDEF3E75AE318EULL,
+		0x643318A14F792949ULL, 0x8FBBDE7CEB5C631CULL, 0xAC5529E3D18B7BDBULL,
+		0xC86631429EF25292ULL, 0xEB88C6DDA4254A55ULL, 0x5D875D127F52F0ABULL,
+		0x7E69AA8D4585E86CULL, 0x1A5AB22C0AFCC125ULL, 0x39B445B3302BD9E2ULL,
+		0xD23C836E940E93B7ULL, 0xF1D274F1AED98B70ULL, 0x95E16C50E1A0A239ULL,
+		0xB60F9BCFDB77BAFEULL, 0xBB0EBA24FEA5E156ULL, 0x98E04DBBC472F991ULL,
+		0xFCD3551A8B0BD0D8ULL, 0xDF3DA285B1DCC81FULL, 0x34B5645815F9824AULL,
+		0x175B93C72F2E9A8DULL, 0x73688B666057B3C4ULL, 0x50867CF95A80AB03ULL,
+		0xE689E73681F711FDULL, 0xC56710A9BB20093AULL, 0xA1540808F4592073ULL,
+		0x82BAFF97CE8E38B4ULL, 0x6932394A6AAB72E1ULL, 0x4ADCCED5507C6A26ULL,
+		0x2EEFD6741F05436FULL, 0x0D0121EB25D25BA8ULL, 0x34ED95A254A1F43FULL,
+		0x1703623D6E76ECF8ULL, 0x73307A9C210FC5B1ULL, 0x50DE8D031BD8DD76ULL,
+		0xBB564BDEBFFD9723ULL, 0x98B8BC41852A8FE4ULL, 0xFC8BA4E0CA53A6ADULL,
+		0xDF65537FF084BE6AULL, 0x696AC8B02BF30494ULL, 0x4A843F2F11241C53ULL,
+		0x2EB7278E5E5D351AULL, 0x0D59D011648A2DDDULL, 0xE6D116CCC0AF6788ULL,
+		0xC53FE153FA787F4FULL, 0xA10CF9F2B5015606ULL, 0x82E20E6D8FD64EC1ULL,
+		0x8FE32F86AA041569ULL, 0xAC0DD81990D30DAEULL, 0xC83EC0B8DFAA24E7ULL,
+		0xEBD03727E57D3C20ULL, 0x0058F1FA41587675ULL, 0x23B606657B8F6EB2ULL,
+		0x47851EC434F647FBULL, 0x646BE95B0E215F3CULL, 0xD2647294D556E5C2ULL,
+		0xF18A850BEF81FD05ULL, 0x95B99DAAA0F8D44CULL, 0xB6576A359A2FCC8BULL,
+		0x5DDFACE83E0A86DEULL, 0x7E315B7704DD9E19ULL, 0x1A0243D64BA4B750ULL,
+		0x39ECB4497173AF97ULL, 0x69DB2B44A943E87EULL, 0x4A35DCDB9394F0B9ULL,
+		0x2E06C47ADCEDD9F0ULL, 0x0DE833E5E63AC137ULL, 0xE660F538421F8B62ULL,
+		0xC58E02A778C893A5ULL, 0xA1BD1A0637B1BAECULL, 0x8253ED990D66A22BULL,
+		0x345C7656D61118D5ULL, 0x17B281C9ECC60012ULL, 0x73819968A3BF295BULL,
+		0x506F6EF79968319CULL, 0xBBE7A82A3D4D7BC9ULL, 0x98095FB5079A630EULL,
+		0xFC3A471448E34A47ULL, 0xDFD4B08B72345280ULL, 0xD2D5916057E60928ULL,
+		0xF13B66FF6D3111EFULL, 0x95087E5E224838A6ULL, 0xB6E689C1189F2061ULL,
+		0x5D6E4F1CBCBA6A34ULL, 0x7E80B883866D72F3ULL, 0x1AB3A022C9145BBAULL,
+		0x395D57BDF3C3437DULL, 0x8F52CC7228B4F983ULL, 0xACBC3BED1263E144ULL,
+		0xC88F234C5D1AC80DULL, 0xEB61D4D367CDD0CAULL, 0x00E9120EC3E89A9FULL,
+		0x2307E591F93F8258ULL, 0x4734FD30B646AB11ULL, 0x64DA0AAF8C91B3D6ULL,
+		0x5D36BEE6FDE21C41ULL, 0x7ED84979C7350486ULL, 0x1AEB51D8884C2DCFULL,
+		0x3905A647B29B3508ULL, 0xD28D609A16BE7F5DULL, 0xF16397052C69679AULL,
+		0x95508FA463104ED3ULL, 0xB6BE783B59C75614ULL, 0x00B1E3F482B0ECEAULL,
+		0x235F146BB867F42DULL, 0x476C0CCAF71EDD64ULL, 0x6482FB55CDC9C5A3ULL,
+		0x8F0A3D8869EC8FF6ULL, 0xACE4CA17533B9731ULL, 0xC8D7D2B61C42BE78ULL,
+		0xEB3925292695A6BFULL, 0xE63804C20347FD17ULL, 0xC5D6F35D3990E5D0ULL,
+		0xA1E5EBFC76E9CC99ULL, 0x820B1C634C3ED45EULL, 0x6983DABEE81B9E0BULL,
+		0x4A6D2D21D2CC86CCULL, 0x2E5E35809DB5AF85ULL, 0x0DB0C21FA762B742ULL,
+		0xBBBF59D07C150DBCULL, 0x9851AE4F46C2157BULL, 0xFC62B6EE09BB3C32ULL,
+		0xDF8C4171336C24F5ULL, 0x340487AC97496EA0ULL, 0x17EA7033AD9E7667ULL,
+		0x73D96892E2E75F2EULL, 0x50379F0DD83047E9ULL, 0xD3B656895287D0FCULL,
+		0xF058A1166850C83BULL, 0x946BB9B72729E172ULL, 0xB7854E281DFEF9B5ULL,
+		0x5C0D88F5B9DBB3E0ULL, 0x7FE37F6A830CAB27ULL, 0x1BD067CBCC75826EULL,
+		0x383E9054F6A29AA9ULL, 0x8E310B9B2DD52057ULL, 0xADDFFC0417023890ULL,
+		0xC9ECE4A5587B11D9ULL, 0xEA02133A62AC091EULL, 0x018AD5E7C689434BULL,
+		0x22642278FC5E5B8CULL, 0x46573AD9B32772C5ULL, 0x65B9CD4689F06A02ULL,
+		0x68B8ECADAC2231AAULL, 0x4B561B3296F5296DULL, 0x2F650393D98C0024ULL,
+		0x0C8BF40CE35B18E3ULL, 0xE70332D1477E52B6ULL, 0xC4EDC54E7DA94A71ULL,
+		0xA0DEDDEF32D06338ULL, 0x83302A7008077BFFULL, 0x353FB1BFD370C101ULL,
+		0x16D14620E9A7D9C6ULL, 0x72E25E81A6DEF08FULL, 0x510CA91E9C09E848ULL,
+		0xBA846FC3382CA21DULL, 0x996A985C02FBBADAULL, 0xFD5980FD4D829393ULL,
+		0xDEB7776277558B54ULL, 0xE75BC32B062624C3ULL, 0xC4B534B43CF13C04ULL,
+		0xA0862C157388154DULL, 0x8368DB8A495F0D8AULL, 0x68E01D57ED7A47DFULL,
+		0x4B0EEAC8D7AD5F18ULL, 0x2F3DF26998D47651ULL, 0x0CD305F6A2036E96ULL,
+		0xBADC9E397974D468ULL, 0x993269A643A3CCAFULL, 0xFD0171070CDAE5E6ULL,
+		0xDEEF8698360DFD21ULL, 0x356740459228B774ULL, 0x1689B7DAA8FFAFB3ULL,
+		0x72BAAF7BE78686FAULL, 0x515458E4DD519E3DULL, 0x5C55790FF883C595ULL,
+		0x7FBB8E90C254DD52ULL, 0x1B8896318D2DF41BULL, 0x386661AEB7FAECDCULL,
+		0xD3EEA77313DFA689ULL, 0xF00050EC2908BE4EULL, 0x9433484D66719707ULL,
+		0xB7DDBFD25CA68FC0ULL, 0x01D2241D87D1353EULL, 0x223CD382BD062DF9ULL,
+		0x460FCB23F27F04B0ULL, 0x65E13CBCC8A81C77ULL, 0x8E69FA616C8D5622ULL,
+		0xAD870DFE565A4EE5ULL, 0xC9B4155F192367ACULL, 0xEA5AE2C023F47F6BULL,
+		0xBA6D7DCDFBC43882ULL, 0x99838A52C1132045ULL, 0xFDB092F38E6A090CULL,
+		0xDE5E656CB4BD11CBULL, 0x35D6A3B110985B9EULL, 0x1638542E2A4F4359ULL,
+		0x720B4C8F65366A10ULL, 0x51E5BB105FE172D7ULL, 0xE7EA20DF8496C829ULL,
+		0xC404D740BE41D0EEULL, 0xA037CFE1F138F9A7ULL, 0x83D9387ECBEFE160ULL,
+		0x6851FEA36FCAAB35ULL, 0x4BBF093C551DB3F2ULL, 0x2F8C119D1A649ABBULL,
+		0x0C62E60220B3827CULL, 0x0163C7E90561D9D4ULL, 0x228D30763FB6C113ULL,
+		0x46BE28D770CFE85AULL, 0x6550DF484A18F09DULL, 0x8ED81995EE3DBAC8ULL,
+		0xAD36EE0AD4EAA20FULL, 0xC905F6AB9B938B46ULL, 0xEAEB0134A1449381ULL,
+		0x5CE49AFB7A33297FULL, 0x7F0A6D6440E431B8ULL, 0x1B3975C50F9D18F1ULL,
+		0x38D7825A354A0036ULL, 0xD35F4487916F4A63ULL, 0xF0B1B318ABB852A4ULL,
+		0x9482ABB9E4C17BEDULL, 0xB76C5C26DE16632AULL, 0x8E80E86FAF65CCBDULL,
+		0xAD6E1FF095B2D47AULL, 0xC95D0751DACBFD33ULL, 0xEAB3F0CEE01CE5F4ULL,
+		0x013B36134439AFA1ULL, 0x22D5C18C7EEEB766ULL, 0x46E6D92D31979E2FULL,
+		0x65082EB20B4086E8ULL, 0xD307B57DD0373C16ULL, 0xF0E942E2EAE024D1ULL,
+		0x94DA5A43A5990D98ULL, 0xB734ADDC9F4E155FULL, 0x5CBC6B013B6B5F0AULL,
+		0x7F529C9E01BC47CDULL, 0x1B61843F4EC56E84ULL, 0x388F73A074127643ULL,
+		0x358E524B51C02DEBULL, 0x1660A5D46B17352CULL, 0x7253BD75246E1C65ULL,
+		0x51BD4AEA1EB904A2ULL, 0xBA358C37BA9C4EF7ULL, 0x99DB7BA8804B5630ULL,
+		0xFDE86309CF327F79ULL, 0xDE069496F5E567BEULL, 0x68090F592E92DD40ULL,
+		0x4BE7F8C61445C587ULL, 0x2FD4E0675B3CECCEULL, 0x0C3A17F861EBF409ULL,
+		0xE7B2D125C5CEBE5CULL, 0xC45C26BAFF19A69BULL, 0xA06F3E1BB0608FD2ULL,
+		0x8381C9848AB79715ULL
+	},
+	{
+		0x0000000000000000ULL, 0xE59C4CF90CE5976BULL, 0x89C87819B0211845ULL,
+		0x6C5434E0BCC48F2EULL, 0x516011D8C9A80619ULL, 0xB4FC5D21C54D9172ULL,
+		0xD8A869C179891E5CULL, 0x3D342538756C8937ULL, 0xA2C023B193500C32ULL,
+		0x475C6F489FB59B59ULL, 0x2B085BA823711477ULL, 0xCE9417512F94831CULL,
+		0xF3A032695AF80A2BULL, 0x163C7E90561D9D40ULL, 0x7A684A70EAD9126EULL,
+		0x9FF40689E63C8505ULL, 0x0770A6888F4A2EF7ULL, 0xE2ECEA7183AFB99CULL,
+		0x8EB8DE913F6B36B2ULL, 0x6B249268338EA1D9ULL, 0x5610B75046E228EEULL,
+		0xB38CFBA94A07BF85ULL, 0xDFD8CF49F6C330ABULL, 0x3A4483B0FA26A7C0ULL,
+		0xA5B085391C1A22C5ULL, 0x402CC9C010FFB5AEULL, 0x2C78FD20AC3B3A80ULL,
+		0xC9E4B1D9A0DEADEBULL, 0xF4D094E1D5B224DCULL, 0x114CD818D957B3B7ULL,
+		0x7D18ECF865933C99ULL, 0x9884A0016976ABF2ULL, 0x0EE14D111E945DEEULL,
+		0xEB7D01E81271CA85ULL, 0x87293508AEB545ABULL, 0x62B579F1A250D2C0ULL,
+		0x5F815CC9D73C5BF7ULL, 0xBA1D1030DBD9CC9CULL, 0xD64924D0671D43B2ULL,
+		0x33D568296BF8D4D9ULL, 0xAC216EA08DC451DCULL, 0x49BD22598121C6B7ULL,
+		0x25E916B93DE54999ULL, 0xC0755A403100DEF2ULL, 0xFD417F78446C57C5ULL,
+		0x18DD33814889C0AEULL, 0x74890761F44D4F80ULL, 0x91154B98F8A8D8EBULL,
+		0x0991EB9991DE7319ULL, 0xEC0DA7609D3BE472ULL, 0x8059938021FF6B5CULL,
+		0x65C5DF792D1AFC37ULL, 0x58F1FA4158767500ULL, 0xBD6DB6B85493E26BULL,
+		0xD1398258E8576D45ULL, 0x34A5CEA1E4B2FA2EULL, 0xAB51C828028E7F2BULL,
+		0x4ECD84D10E6BE840ULL, 0x2299B031B2AF676EULL, 0xC705FCC8BE4AF005ULL,
+		0xFA31D9F0CB267932ULL, 0x1FAD9509C7C3EE59ULL, 0x73F9A1E97B076177ULL,
+		0x9665ED1077E2F61CULL, 0x1DC29A223D28BBDCULL, 0xF85ED6DB31CD2CB7ULL,
+		0x940AE23B8D09A399ULL, 0x7196AEC281EC34F2ULL, 0x4CA28BFAF480BDC5ULL,
+		0xA93EC703F8652AAEULL, 0xC56AF3E344A1A580ULL, 0x20F6BF1A484432EBULL,
+		0xBF02B993AE78B7EEULL, 0x5A9EF56AA29D2085ULL, 0x36CAC18A1E59AFABULL,
+		0xD3568D7312BC38C0ULL, 0xEE62A84B67D0B1F7ULL, 0x0BFEE4B26B35269CULL,
+		0x67AAD052D7F1A9B2ULL, 0x82369CABDB143ED9ULL, 0x1AB23CAAB262952BULL,
+		0xFF2E7053BE870240ULL, 0x937A44B302438D6EULL, 0x76E6084A0EA61A05ULL,
+		0x4BD22D727BCA9332ULL, 0xAE4E618B772F0459ULL, 0xC21A556BCBEB8B77ULL,
+		0x27861992C70E1C1CULL, 0xB8721F1B21329919ULL, 0x5DEE53E22DD70E72ULL,
+		0x31BA67029113815CULL, 0xD4262BFB9DF61637ULL, 0xE9120EC3E89A9F00ULL,
+		0x0C8E423AE47F086BULL, 0x60DA76DA58BB8745ULL, 0x85463A23545E102EULL,
+		0x1323D73323BCE632ULL, 0xF6BF9BCA2F597159ULL, 0x9AEBAF2A939DFE77ULL,
+		0x7F77E3D39F78691CULL, 0x4243C6EBEA14E02BULL, 0xA7DF8A12E6F17740ULL,
+		0xCB8BBEF25A35F86EULL, 0x2E17F20B56D06F05ULL, 0xB1E3F482B0ECEA00ULL,
+		0x547FB87BBC097D6BULL, 0x382B8C9B00CDF245ULL, 0xDDB7C0620C28652EULL,
+		0xE083E55A7944EC19ULL, 0x051FA9A375A17B72ULL, 0x694B9D43C965F45CULL,
+		0x8CD7D1BAC5806337ULL, 0x145371BBACF6C8C5ULL, 0xF1CF3D42A0135FAEULL,
+		0x9D9B09A21CD7D080ULL, 0x7807455B103247EBULL, 0x45336063655ECEDCULL,
+		0xA0AF2C9A69BB59B7ULL, 0xCCFB187AD57FD699ULL, 0x29675483D99A41F2ULL,
+		0xB693520A3FA6C4F7ULL, 0x530F1EF33343539CULL, 0x3F5B2A138F87DCB2ULL,
+		0xDAC766EA83624BD9ULL, 0xE7F343D2F60EC2EEULL, 0x026F0F2BFAEB5585ULL,
+		0x6E3B3BCB462FDAABULL, 0x8BA777324ACA4DC0ULL, 0x3B8534447A5177B8ULL,
+		0xDE1978BD76B4E0D3ULL, 0xB24D4C5DCA706FFDULL, 0x57D100A4C695F896ULL,
+		0x6AE5259CB3F971A1ULL, 0x8F796965BF1CE6CAULL, 0xE32D5D8503D869E4ULL,
+		0x06B1117C0F3DFE8FULL, 0x994517F5E9017B8AULL, 0x7CD95B0CE5E4ECE1ULL,
+		0x108D6FEC592063CFULL, 0xF511231555C5F4A4ULL, 0xC825062D20A97D93ULL,
+		0x2DB94AD42C4CEAF8ULL, 0x41ED7E34908865D6ULL, 0xA47132CD9C6DF2BDULL,
+		0x3CF592CCF51B594FULL, 0xD969DE35F9FECE24ULL, 0xB53DEAD5453A410AULL,
+		0x50A1A62C49DFD661ULL, 0x6D9583143CB35F56ULL, 0x8809CFED3056C83DULL,
+		0xE45DFB0D8C924713ULL, 0x01C1B7F48077D078ULL, 0x9E35B17D664B557DULL,
+		0x7BA9FD846AAEC216ULL, 0x17FDC964D66A4D38ULL, 0xF261859DDA8FDA53ULL,
+		0xCF55A0A5AFE35364ULL, 0x2AC9EC5CA306C40FULL, 0x469DD8BC1FC24B21ULL,
+		0xA30194451327DC4AULL, 0x3564795564C52A56ULL, 0xD0F835AC6820BD3DULL,
+		0xBCAC014CD4E43213ULL, 0x59304DB5D801A578ULL, 0x6404688DAD6D2C4FULL,
+		0x81982474A188BB24ULL, 0xEDCC10941D4C340AULL, 0x08505C6D11A9A361ULL,
+		0x97A45AE4F7952664ULL, 0x7238161DFB70B10FULL, 0x1E6C22FD47B43E21ULL,
+		0xFBF06E044B51A94AULL, 0xC6C44B3C3E3D207DULL, 0x235807C532D8B716ULL,
+		0x4F0C33258E1C3838ULL, 0xAA907FDC82F9AF53ULL, 0x3214DFDDEB8F04A1ULL,
+		0xD7889324E76A93CAULL, 0xBBDCA7C45BAE1CE4ULL, 0x5E40EB3D574B8B8FULL,
+		0x6374CE05222702B8ULL, 0x86E882FC2EC295D3ULL, 0xEABCB61C92061AFDULL,
+		0x0F20FAE59EE38D96ULL, 0x90D4FC6C78DF0893ULL, 0x7548B095743A9FF8ULL,
+		0x191C8475C8FE10D6ULL, 0xFC80C88CC41B87BDULL, 0xC1B4EDB4B1770E8AULL,
+		0x2428A14DBD9299E1ULL, 0x487C95AD015616CFULL, 0xADE0D9540DB381A4ULL,
+		0x2647AE664779CC64ULL, 0xC3DBE29F4B9C5B0FULL, 0xAF8FD67FF758D421ULL,
+		0x4A139A86FBBD434AULL, 0x7727BFBE8ED1CA7DULL, 0x92BBF34782345D16ULL,
+		0xFEEFC7A73EF0D238ULL, 0x1B738B5E32154553ULL, 0x84878DD7D429C056ULL,
+		0x611BC12ED8CC573DULL, 0x0D4FF5CE6408D813ULL, 0xE8D3B93768ED4F78ULL,
+		0xD5E79C0F1D81C64FULL, 0x307BD0F611645124ULL, 0x5C2FE416ADA0DE0AULL,
+		0xB9B3A8EFA1454961ULL, 0x213708EEC833E293ULL, 0xC4AB4417C4D675F8ULL,
+		0xA8FF70F77812FAD6ULL, 0x4D633C0E74F76DBDULL, 0x70571936019BE48AULL,
+		0x95CB55CF0D7E73E1ULL, 0xF99F612FB1BAFCCFULL, 0x1C032DD6BD5F6BA4ULL,
+		0x83F72B5F5B63EEA1ULL, 0x666B67A6578679CAULL, 0x0A3F5346EB42F6E4ULL,
+		0xEFA31FBFE7A7618FULL, 0xD2973A8792CBE8B8ULL, 0x370B767E9E2E7FD3ULL,
+		0x5B5F429E22EAF0FDULL, 0xBEC30E672E0F6796ULL, 0x28A6E37759ED918AULL,
+		0xCD3AAF8E550806E1ULL, 0xA16E9B6EE9CC89CFULL, 0x44F2D797E5291EA4ULL,
+		0x79C6F2AF90459793ULL, 0x9C5ABE569CA000F8ULL, 0xF00E8AB620648FD6ULL,
+		0x1592C64F2C8118BDULL, 0x8A66C0C6CABD9DB8ULL, 0x6FFA8C3FC6580AD3ULL,
+		0x03AEB8DF7A9C85FDULL, 0xE632F42676791296ULL, 0xDB06D11E03159BA1ULL,
+		0x3E9A9DE70FF00CCAULL, 0x52CEA907B33483E4ULL, 0xB752E5FEBFD1148FULL,
+		0x2FD645FFD6A7BF7DULL, 0xCA4A0906DA422816ULL, 0xA61E3DE66686A738ULL,
+		0x4382711F6A633053ULL, 0x7EB654271F0FB964ULL, 0x9B2A18DE13EA2E0FULL,
+		0xF77E2C3EAF2EA121ULL, 0x12E260C7A3CB364AULL, 0x8D16664E45F7B34FULL,
+		0x688A2AB749122424ULL, 0x04DE1E57F5D6AB0AULL, 0xE14252AEF9333C61ULL,
+		0xDC7677968C5FB556ULL, 0x39EA3B6F80BA223DULL, 0x55BE0F8F3C7EAD13ULL,
+		0xB0224376309B3A78ULL
+	},
+	{
+		0x0000000000000000ULL, 0x770A6888F4A2EF70ULL, 0xEE14D111E945DEE0ULL,
+		0x991EB9991DE73190ULL, 0x9ED943C87B618B53ULL, 0xE9D32B408FC36423ULL,
+		0x70CD92D9922455B3ULL, 0x07C7FA516686BAC3ULL, 0x7F42667B5F292035ULL,
+		0x08480EF3AB8BCF45ULL, 0x9156B76AB66CFED5ULL, 0xE65CDFE242CE11A5ULL,
+		0xE19B25B32448AB66ULL, 0x96914D3BD0EA4416ULL, 0x0F8FF4A2CD0D7586ULL,
+		0x78859C2A39AF9AF6ULL, 0xFE84CCF6BE52406AULL, 0x898EA47E4AF0AF1AULL,
+		0x10901DE757179E8AULL, 0x679A756FA3B571FAULL, 0x605D8F3EC533CB39ULL,
+		0x1757E7B631912449ULL, 0x8E495E2F2C7615D9ULL, 0xF94336A7D8D4FAA9ULL,
+		0x81C6AA8DE17B605FULL, 0xF6CCC20515D98F2FULL, 0x6FD27B9C083EBEBFULL,
+		0x18D81314FC9C51CFULL, 0x1F1FE9459A1AEB0CULL, 0x681581CD6EB8047CULL,
+		0xF10B3854735F35ECULL, 0x860150DC87FDDA9CULL, 0xBFF97806D54EB647ULL,
+		0xC8F3108E21EC5937ULL, 0x51EDA9173C0B68A7ULL, 0x26E7C19FC8A987D7ULL,
+		0x21203BCEAE2F3D14ULL, 0x562A53465A8DD264ULL, 0xCF34EADF476AE3F4ULL,
+		0xB83E8257B3C80C84ULL, 0xC0BB1E7D8A679672ULL, 0xB7B176F57EC57902ULL,
+		0x2EAFCF6C63224892ULL, 0x59A5A7E49780A7E2ULL, 0x5E625DB5F1061D21ULL,
+		0x2968353D05A4F251ULL, 0xB0768CA41843C3C1ULL, 0xC77CE42CECE12CB1ULL,
+		0x417DB4F06B1CF62DULL, 0x3677DC789FBE195DULL, 0xAF6965E1825928CDULL,
+		0xD8630D6976FBC7BDULL, 0xDFA4F738107D7D7EULL, 0xA8AE9FB0E4DF920EULL,
+		0x31B02629F938A39EULL, 0x46BA4EA10D9A4CEEULL, 0x3E3FD28B3435D618ULL,
+		0x4935BA03C0973968ULL, 0xD02B039ADD7008F8ULL, 0xA7216B1229D2E788ULL,
+		0xA0E691434F545D4BULL, 0xD7ECF9CBBBF6B23BULL, 0x4EF24052A61183ABULL,
+		0x39F828DA52B36CDBULL, 0x3D0211E603775A1DULL, 0x4A08796EF7D5B56DULL,
+		0xD316C0F7EA3284FDULL, 0xA41CA87F1E906B8DULL, 0xA3DB522E7816D14EULL,
+		0xD4D13AA68CB43E3EULL, 0x4DCF833F91530FAEULL, 0x3AC5EBB765F1E0DEULL,
+		0x4240779D5C5E7A28ULL, 0x354A1F15A8FC9558ULL, 0xAC54A68CB51BA4C8ULL,
+		0xDB5ECE0441B94BB8ULL, 0xDC993455273FF17BULL, 0xAB935CDDD39D1E0BULL,
+		0x328DE544CE7A2F9BULL, 0x45878DCC3AD8C0EBULL, 0xC386DD10BD251A77ULL,
+		0xB48CB5984987F507ULL, 0x2D920C015460C497ULL, 0x5A986489A0C22BE7ULL,
+		0x5D5F9ED8C6449124ULL, 0x2A55F65032E67E54ULL, 0xB34B4FC92F014FC4ULL,
+		0xC4412741DBA3A0B4ULL, 0xBCC4BB6BE20C3A42ULL, 0xCBCED3E316AED532ULL,
+		0x52D06A7A0B49E4A2ULL, 0x25DA02F2FFEB0BD2ULL, 0x221DF8A3996DB111ULL,
+		0x5517902B6DCF5E61ULL, 0xCC0929B270286FF1ULL, 0xBB03413A848A8081ULL,
+		0x82FB69E0D639EC5AULL, 0xF5F10168229B032AULL, 0x6CEFB8F13F7C32BAULL,
+		0x1BE5D079CBDEDDCAULL, 0x1C222A28AD586709ULL, 0x6B2842A059FA8879ULL,
+		0xF236FB39441DB9E9ULL, 0x853C93B1B0BF5699ULL, 0xFDB90F9B8910CC6FULL,
+		0x8AB367137DB2231FULL, 0x13ADDE8A6055128FULL, 0x64A7B60294F7FDFFULL,
+		0x63604C53F271473CULL, 0x146A24DB06D3A84CULL, 0x8D749D421B3499DCULL,
+		0xFA7EF5CAEF9676ACULL, 0x7C7FA516686BAC30ULL, 0x0B75CD9E9CC94340ULL,
+		0x926B7407812E72D0ULL, 0xE5611C8F758C9DA0ULL, 0xE2A6E6DE130A2763ULL,
+		0x95AC8E56E7A8C813ULL, 0x0CB237CFFA4FF983ULL, 0x7BB85F470EED16F3ULL,
+		0x033DC36D37428C05ULL, 0x7437ABE5C3E06375ULL, 0xED29127CDE0752E5ULL,
+		0x9A237AF42AA5BD95ULL, 0x9DE480A54C230756ULL, 0xEAEEE82DB881E826ULL,
+		0x73F051B4A566D9B6ULL, 0x04FA393C51C436C6ULL, 0x7A0423CC06EEB43AULL,
+		0x0D0E4B44F24C5B4AULL, 0x9410F2DDEFAB6ADAULL, 0xE31A9A551B0985AAULL,
+		0xE4DD60047D8F3F69ULL, 0x93D7088C892DD019ULL, 0x0AC9B11594CAE189ULL,
+		0x7DC3D99D60680EF9ULL, 0x054645B759C7940FULL, 0x724C2D3FAD657B7FULL,
+		0xEB5294A6B0824AEFULL, 0x9C58FC2E4420A59FULL, 0x9B9F067F22A61F5CULL,
+		0xEC956EF7D604F02CULL, 0x758BD76ECBE3C1BCULL, 0x0281BFE63F412ECCULL,
+		0x8480EF3AB8BCF450ULL, 0xF38A87B24C1E1B20ULL, 0x6A943E2B51F92AB0ULL,
+		0x1D9E56A3A55BC5C0ULL, 0x1A59ACF2C3DD7F03ULL, 0x6D53C47A377F9073ULL,
+		0xF44D7DE32A98A1E3ULL, 0x8347156BDE3A4E93ULL, 0xFBC28941E795D465ULL,
+		0x8CC8E1C913373B15ULL, 0x15D658500ED00A85ULL, 0x62DC30D8FA72E5F5ULL,
+		0x651BCA899CF45F36ULL, 0x1211A2016856B046ULL, 0x8B0F1B9875B181D6ULL,
+		0xFC05731081136EA6ULL, 0xC5FD5BCAD3A0027DULL, 0xB2F733422702ED0DULL,
+		0x2BE98ADB3AE5DC9DULL, 0x5CE3E253CE4733EDULL, 0x5B241802A8C1892EULL,
+		0x2C2E708A5C63665EULL, 0xB530C913418457CEULL, 0xC23AA19BB526B8BEULL,
+		0xBABF3DB18C892248ULL, 0xCDB55539782BCD38ULL, 0x54ABECA065CCFCA8ULL,
+		0x23A18428916E13D8ULL, 0x24667E79F7E8A91BULL, 0x536C16F1034A466BULL,
+		0xCA72AF681EAD77FBULL, 0xBD78C7E0EA0F988BULL, 0x3B79973C6DF24217ULL,
+		0x4C73FFB49950AD67ULL, 0xD56D462D84B79CF7ULL, 0xA2672EA570157387ULL,
+		0xA5A0D4F41693C944ULL, 0xD2AABC7CE2312634ULL, 0x4BB405E5FFD617A4ULL,
+		0x3CBE6D6D0B74F8D4ULL, 0x443BF14732DB6222ULL, 0x333199CFC6798D52ULL,
+		0xAA2F2056DB9EBCC2ULL, 0xDD2548DE2F3C53B2ULL, 0xDAE2B28F49BAE971ULL,
+		0xADE8DA07BD180601ULL, 0x34F6639EA0FF3791ULL, 0x43FC0B16545DD8E1ULL,
+		0x4706322A0599EE27ULL, 0x300C5AA2F13B0157ULL, 0xA912E33BECDC30C7ULL,
+		0xDE188BB3187EDFB7ULL, 0xD9DF71E27EF86574ULL, 0xAED5196A8A5A8A04ULL,
+		0x37CBA0F397BDBB94ULL, 0x40C1C87B631F54E4ULL, 0x384454515AB0CE12ULL,
+		0x4F4E3CD9AE122162ULL, 0xD6508540B3F510F2ULL, 0xA15AEDC84757FF82ULL,
+		0xA69D179921D14541ULL, 0xD1977F11D573AA31ULL, 0x4889C688C8949BA1ULL,
+		0x3F83AE003C3674D1ULL, 0xB982FEDCBBCBAE4DULL, 0xCE8896544F69413DULL,
+		0x57962FCD528E70ADULL, 0x209C4745A62C9FDDULL, 0x275BBD14C0AA251EULL,
+		0x5051D59C3408CA6EULL, 0xC94F6C0529EFFBFEULL, 0xBE45048DDD4D148EULL,
+		0xC6C098A7E4E28E78ULL, 0xB1CAF02F10406108ULL, 0x28D449B60DA75098ULL,
+		0x5FDE213EF905BFE8ULL, 0x5819DB6F9F83052BULL, 0x2F13B3E76B21EA5BULL,
+		0xB60D0A7E76C6DBCBULL, 0xC10762F6826434BBULL, 0xF8FF4A2CD0D75860ULL,
+		0x8FF522A42475B710ULL, 0x16EB9B3D39928680ULL, 0x61E1F3B5CD3069F0ULL,
+		0x662609E4ABB6D333ULL, 0x112C616C5F143C43ULL, 0x8832D8F542F30DD3ULL,
+		0xFF38B07DB651E2A3ULL, 0x87BD2C578FFE7855ULL, 0xF0B744DF7B5C9725ULL,
+		0x69A9FD4666BBA6B5ULL, 0x1EA395CE921949C5ULL, 0x19646F9FF49FF306ULL,
+		0x6E6E0717003D1C76ULL, 0xF770BE8E1DDA2DE6ULL, 0x807AD606E978C296ULL,
+		0x067B86DA6E85180AULL, 0x7171EE529A27F77AULL, 0xE86F57CB87C0C6EAULL,
+		0x9F653F437362299AULL, 0x98A2C51215E49359ULL, 0xEFA8AD9AE1467C29ULL,
+		0x76B61403FCA14DB9ULL, 0x01BC7C8B0803A2C9ULL, 0x7939E0A131AC383FULL,
+		0x0E338829C50ED74FULL, 0x972D31B0D8E9E6DFULL, 0xE02759382C4B09AFULL,
+		0xE7E0A3694ACDB36CULL, 0x90EACBE1BE6F5C1CULL, 0x09F47278A3886D8CULL,
+		0x7EFE1AF0572A82FCULL
+	},
+	{
+		0x0000000000000000ULL, 0xF40847980DDD6874ULL, 0xAAE06EDBB250E67BULL,
+		0x5EE82943BF8D8E0FULL, 0x17303C5CCD4BFA65ULL, 0xE3387BC4C0969211ULL,
+		0xBDD052877F1B1C1EULL, 0x49D8151F72C6746AULL, 0x2E6078B99A97F4CAULL,
+		0xDA683F21974A9CBEULL, 0x8480166228C712B1ULL, 0x708851FA251A7AC5ULL,
+		0x395044E557DC0EAFULL, 0xCD58037D5A0166DBULL, 0x93B02A3EE58CE8D4ULL,
+		0x67B86DA6E85180A0ULL, 0x5CC0F173352FE994ULL, 0xA8C8B6EB38F281E0ULL,
+		0xF6209FA8877F0FEFULL, 0x0228D8308AA2679BULL, 0x4BF0CD2FF86413F1ULL,
+		0xBFF88AB7F5B97B85ULL, 0xE110A3F44A34F58AULL, 0x1518E46C47E99DFEULL,
+		0x72A089CAAFB81D5EULL, 0x86A8CE52A265752AULL, 0xD840E7111DE8FB25ULL,
+		0x2C48A08910359351ULL, 0x6590B59662F3E73BULL, 0x9198F20E6F2E8F4FULL,
+		0xCF70DB4DD0A30140ULL, 0x3B789CD5DD7E6934ULL, 0xB981E2E66A5FD328ULL,
+		0x4D89A57E6782BB5CULL, 0x13618C3DD80F3553ULL, 0xE769CBA5D5D25D27ULL,
+		0xAEB1DEBAA714294DULL, 0x5AB99922AAC94139ULL, 0x0451B0611544CF36ULL,
+		0xF059F7F91899A742ULL, 0x97E19A5FF0C827E2ULL, 0x63E9DDC7FD154F96ULL,
+		0x3D01F4844298C199ULL, 0xC909B31C4F45A9EDULL, 0x80D1A6033D83DD87ULL,
+		0x74D9E19B305EB5F3ULL, 0x2A31C8D88FD33BFCULL, 0xDE398F40820E5388ULL,
+		0xE54113955F703ABCULL, 0x1149540D52AD52C8ULL, 0x4FA17D4EED20DCC7ULL,
+		0xBBA93AD6E0FDB4B3ULL, 0xF2712FC9923BC0D9ULL, 0x067968519FE6A8ADULL,
+		0x58914112206B26A2ULL, 0xAC99068A2DB64ED6ULL, 0xCB216B2CC5E7CE76ULL,
+		0x3F292CB4C83AA602ULL, 0x61C105F777B7280DULL, 0x95C9426F7A6A4079ULL,
+		0xDC11577008AC3413ULL, 0x281910E805715C67ULL, 0x76F139ABBAFCD268ULL,
+		0x82F97E33B721BA1CULL, 0x31F324277D5590C3ULL, 0xC5FB63BF7088F8B7ULL,
+		0x9B134AFCCF0576B8ULL, 0x6F1B0D64C2D81ECCULL, 0x26C3187BB01E6AA6ULL,
+		0xD2CB5FE3BDC302D2ULL, 0x8C2376A0024E8CDDULL, 0x782B31380F93E4A9ULL,
+		0x1F935C9EE7C26409ULL, 0xEB9B1B06EA1F0C7DULL, 0xB573324555928272ULL,
+		0x417B75DD584FEA06ULL, 0x08A360C22A899E6CULL, 0xFCAB275A2754F618ULL,
+		0xA2430E1998D97817ULL, 0x564B498195041063ULL, 0x6D33D554487A7957ULL,
+		0x993B92CC45A71123ULL, 0xC7D3BB8FFA2A9F2CULL, 0x33DBFC17F7F7F758ULL,
+		0x7A03E90885318332ULL, 0x8E0BAE9088ECEB46ULL, 0xD0E387D337616549ULL,
+		0x24EBC04B3ABC0D3DULL, 0x4353ADEDD2ED8D9DULL, 0xB75BEA75DF30E5E9ULL,
+		0xE9B3C33660BD6BE6ULL, 0x1DBB84AE6D600392ULL, 0x546391B11FA677F8ULL,
+		0xA06BD629127B1F8CULL, 0xFE83FF6AADF69183ULL, 0x0A8BB8F2A02BF9F7ULL,
+		0x8872C6C1170A43EBULL, 0x7C7A81591AD72B9FULL, 0x2292A81AA55AA590ULL,
+		0xD69AEF82A887CDE4ULL, 0x9F42FA9DDA41B98EULL, 0x6B4ABD05D79CD1FAULL,
+		0x35A2944668115FF5ULL, 0xC1AAD3DE65CC3781ULL, 0xA612BE788D9DB721ULL,
+		0x521AF9E08040DF55ULL, 0x0CF2D0A33FCD515AULL, 0xF8FA973B3210392EULL,
+		0xB122822440D64D44ULL, 0x452AC5BC4D0B2530ULL, 0x1BC2ECFFF286AB3FULL,
+		0xEFCAAB67FF5BC34BULL, 0xD4B237B22225AA7FULL, 0x20BA702A2FF8C20BULL,
+		0x7E52596990754C04ULL, 0x8A5A1EF19DA82470ULL, 0xC3820BEEEF6E501AULL,
+		0x378A4C76E2B3386EULL, 0x696265355D3EB661ULL, 0x9D6A22AD50E3DE15ULL,
+		0xFAD24F0BB8B25EB5ULL, 0x0EDA0893B56F36C1ULL, 0x503221D00AE2B8CEULL,
+		0xA43A6648073FD0BAULL, 0xEDE2735775F9A4D0ULL, 0x19EA34CF7824CCA4ULL,
+		0x47021D8CC7A942ABULL, 0xB30A5A14CA742ADFULL, 0x63E6484EFAAB2186ULL,
+		0x97EE0FD6F77649F2ULL, 0xC906269548FBC7FDULL, 0x3D0E610D4526AF89ULL,
+		0x74D6741237E0DBE3ULL, 0x80DE338A3A3DB397ULL, 0xDE361AC985B03D98ULL,
+		0x2A3E5D51886D55ECULL, 0x4D8630F7603CD54CULL, 0xB98E776F6DE1BD38ULL,
+		0xE7665E2CD26C3337ULL, 0x136E19B4DFB15B43ULL, 0x5AB60CABAD772F29ULL,
+		0xAEBE4B33A0AA475DULL, 0xF05662701F27C952ULL, 0x045E25E812FAA126ULL,
+		0x3F26B93DCF84C812ULL, 0xCB2EFEA5C259A066ULL, 0x95C6D7E67DD42E69ULL,
+		0x61CE907E7009461DULL, 0x2816856102CF3277ULL, 0xDC1EC2F90F125A03ULL,
+		0x82F6EBBAB09FD40CULL, 0x76FEAC22BD42BC78ULL, 0x1146C18455133CD8ULL,
+		0xE54E861C58CE54ACULL, 0xBBA6AF5FE743DAA3ULL, 0x4FAEE8C7EA9EB2D7ULL,
+		0x0676FDD89858C6BDULL, 0xF27EBA409585AEC9ULL, 0xAC9693032A0820C6ULL,
+		0x589ED49B27D548B2ULL, 0xDA67AAA890F4F2AEULL, 0x2E6FED309D299ADAULL,
+		0x7087C47322A414D5ULL, 0x848F83EB2F797CA1ULL, 0xCD5796F45DBF08CBULL,
+		0x395FD16C506260BFULL, 0x67B7F82FEFEFEEB0ULL, 0x93BFBFB7E23286C4ULL,
+		0xF407D2110A630664ULL, 0x000F958907BE6E10ULL, 0x5EE7BCCAB833E01FULL,
+		0xAAEFFB52B5EE886BULL, 0xE337EE4DC728FC01ULL, 0x173FA9D5CAF59475ULL,
+		0x49D7809675781A7AULL, 0xBDDFC70E78A5720EULL, 0x86A75BDBA5DB1B3AULL,
+		0x72AF1C43A806734EULL, 0x2C473500178BFD41ULL, 0xD84F72981A569535ULL,
+		0x919767876890E15FULL, 0x659F201F654D892BULL, 0x3B77095CDAC00724ULL,
+		0xCF7F4EC4D71D6F50ULL, 0xA8C723623F4CEFF0ULL, 0x5CCF64FA32918784ULL,
+		0x02274DB98D1C098BULL, 0xF62F0A2180C161FFULL, 0xBFF71F3EF2071595ULL,
+		0x4BFF58A6FFDA7DE1ULL, 0x151771E54057F3EEULL, 0xE11F367D4D8A9B9AULL,
+		0x52156C6987FEB145ULL, 0xA61D2BF18A23D931ULL, 0xF8F502B235AE573EULL,
+		0x0CFD452A38733F4AULL, 0x452550354AB54B20ULL, 0xB12D17AD47682354ULL,
+		0xEFC53EEEF8E5AD5BULL, 0x1BCD7976F538C52FULL, 0x7C7514D01D69458FULL,
+		0x887D534810B42DFBULL, 0xD6957A0BAF39A3F4ULL, 0x229D3D93A2E4CB80ULL,
+		0x6B45288CD022BFEAULL, 0x9F4D6F14DDFFD79EULL, 0xC1A5465762725991ULL,
+		0x35AD01CF6FAF31E5ULL, 0x0ED59D1AB2D158D1ULL, 0xFADDDA82BF0C30A5ULL,
+		0xA435F3C10081BEAAULL, 0x503DB4590D5CD6DEULL, 0x19E5A1467F9AA2B4ULL,
+		0xEDEDE6DE7247CAC0ULL, 0xB305CF9DCDCA44CFULL, 0x470D8805C0172CBBULL,
+		0x20B5E5A32846AC1BULL, 0xD4BDA23B259BC46FULL, 0x8A558B789A164A60ULL,
+		0x7E5DCCE097CB2214ULL, 0x3785D9FFE50D567EULL, 0xC38D9E67E8D03E0AULL,
+		0x9D65B724575DB005ULL, 0x696DF0BC5A80D871ULL, 0xEB948E8FEDA1626DULL,
+		0x1F9CC917E07C0A19ULL, 0x4174E0545FF18416ULL, 0xB57CA7CC522CEC62ULL,
+		0xFCA4B2D320EA9808ULL, 0x08ACF54B2D37F07CULL, 0x5644DC0892BA7E73ULL,
+		0xA24C9B909F671607ULL, 0xC5F4F636773696A7ULL, 0x31FCB1AE7AEBFED3ULL,
+		0x6F1498EDC56670DCULL, 0x9B1CDF75C8BB18A8ULL, 0xD2C4CA6ABA7D6CC2ULL,
+		0x26CC8DF2B7A004B6ULL, 0x7824A4B1082D8AB9ULL, 0x8C2CE32905F0E2CDULL,
+		0xB7547FFCD88E8BF9ULL, 0x435C3864D553E38DULL, 0x1DB411276ADE6D82ULL,
+		0xE9BC56BF670305F6ULL, 0xA06443A015C5719CULL, 0x546C0438181819E8ULL,
+		0x0A842D7BA79597E7ULL, 0xFE8C6AE3AA48FF93ULL, 0x9934074542197F33ULL,
+		0x6D3C40DD4FC41747ULL, 0x33D4699EF0499948ULL, 0xC7DC2E06FD94F13CULL,
+		0x8E043B198F528556ULL, 0x7A0C7C81828FED22ULL, 0x24E455C23D02632DULL,
+		0xD0EC125A30DF0B59ULL
+	},
+	{
+		0x0000000000000000ULL, 0xC7CC909DF556430CULL, 0xCD69C0D04346B08BULL,
+		0x0AA5504DB610F387ULL, 0xD823604B2F675785ULL, 0x1FEFF0D6DA311489ULL,
+		0x154AA09B6C21E70EULL, 0xD28630069977A402ULL, 0xF2B6217DF7249999ULL,
+		0x357AB1E00272DA95ULL, 0x3FDFE1ADB4622912ULL, 0xF813713041346A1EULL,
+		0x2A954136D843CE1CULL, 0xED59D1AB2D158D10ULL, 0xE7FC81E69B057E97ULL,
+		0x2030117B6E533D9BULL, 0xA79CA31047A305A1ULL, 0x6050338DB2F546ADULL,
+		0x6AF563C004E5B52AULL, 0xAD39F35DF1B3F626ULL, 0x7FBFC35B68C45224ULL,
+		0xB87353C69D921128ULL, 0xB2D6038B2B82E2AFULL, 0x751A9316DED4A1A3ULL,
+		0x552A826DB0879C38ULL, 0x92E612F045D1DF34ULL, 0x984342BDF3C12CB3ULL,
+		0x5F8FD22006976FBFULL, 0x8D09E2269FE0CBBDULL, 0x4AC572BB6AB688B1ULL,
+		0x406022F6DCA67B36ULL, 0x87ACB26B29F0383AULL, 0x0DC9A7CB26AC3DD1ULL,
+		0xCA053756D3FA7EDDULL, 0xC0A0671B65EA8D5AULL, 0x076CF78690BCCE56ULL,
+		0xD5EAC78009CB6A54ULL, 0x1226571DFC9D2958ULL, 0x188307504A8DDADFULL,
+		0xDF4F97CDBFDB99D3ULL, 0xFF7F86B6D188A448ULL, 0x38B3162B24DEE744ULL,
+		0x3216466692CE14C3ULL, 0xF5DAD6FB679857CFULL, 0x275CE6FDFEEFF3CDULL,
+		0xE09076600BB9B0C1ULL, 0xEA35262DBDA94346ULL, 0x2DF9B6B048FF004AULL,
+		0xAA5504DB610F3870ULL, 0x6D99944694597B7CULL, 0x673CC40B224988FBULL,
+		0xA0F05496D71FCBF7ULL, 0x727664904E686FF5ULL, 0xB5BAF40DBB3E2CF9ULL,
+		0xBF1FA4400D2EDF7EULL, 0x78D334DDF8789C72ULL, 0x58E325A6962BA1E9ULL,
+		0x9F2FB53B637DE2E5ULL, 0x958AE576D56D1162ULL, 0x524675EB203B526EULL,
+		0x80C045EDB94CF66CULL, 0x470CD5704C1AB560ULL, 0x4DA9853DFA0A46E7ULL,
+		0x8A6515A00F5C05EBULL, 0x1B934F964D587BA2ULL, 0xDC5FDF0BB80E38AEULL,
+		0xD6FA8F460E1ECB29ULL, 0x11361FDBFB488825ULL, 0xC3B02FDD623F2C27ULL,
+		0x047CBF4097696F2BULL, 0x0ED9EF0D21799CACULL, 0xC9157F90D42FDFA0ULL,
+		0xE9256EEBBA7CE23BULL, 0x2EE9FE764F2AA137ULL, 0x244CAE3BF93A52B0ULL,
+		0xE3803EA60C6C11BCULL, 0x31060EA0951BB5BEULL, 0xF6CA9E3D604DF6B2ULL,
+		0xFC6FCE70D65D0535ULL, 0x3BA35EED230B4639ULL, 0xBC0FEC860AFB7E03ULL,
+		0x7BC37C1BFFAD3D0FULL, 0x71662C5649BDCE88ULL, 0xB6AABCCBBCEB8D84ULL,
+		0x642C8CCD259C2986ULL, 0xA3E01C50D0CA6A8AULL, 0xA9454C1D66DA990DULL,
+		0x6E89DC80938CDA01ULL, 0x4EB9CDFBFDDFE79AULL, 0x89755D660889A496ULL,
+		0x83D00D2BBE995711ULL, 0x441C9DB64BCF141DULL, 0x969AADB0D2B8B01FULL,
+		0x51563D2D27EEF313ULL, 0x5BF36D6091FE0094ULL, 0x9C3FFDFD64A84398ULL,
+		0x165AE85D6BF44673ULL, 0xD19678C09EA2057FULL, 0xDB33288D28B2F6F8ULL,
+		0x1CFFB810DDE4B5F4ULL, 0xCE798816449311F6ULL, 0x09B5188BB1C552FAULL,
+		0x031048C607D5A17DULL, 0xC4DCD85BF283E271ULL, 0xE4ECC9209CD0DFEAULL,
+		0x232059BD69869CE6ULL, 0x298509F0DF966F61ULL, 0xEE49996D2AC02C6DULL,
+		0x3CCFA96BB3B7886FULL, 0xFB0339F646E1CB63ULL, 0xF1A669BBF0F138E4ULL,
+		0x366AF92605A77BE8ULL, 0xB1C64B4D2C5743D2ULL, 0x760ADBD0D90100DEULL,
+		0x7CAF8B9D6F11F359ULL, 0xBB631B009A47B055ULL, 0x69E52B0603301457ULL,
+		0xAE29BB9BF666575BULL, 0xA48CEBD64076A4DCULL, 0x63407B4BB520E7D0ULL,
+		0x43706A30DB73DA4BULL, 0x84BCFAAD2E259947ULL, 0x8E19AAE098356AC0ULL,
+		0x49D53A7D6D6329CCULL, 0x9B530A7BF4148DCEULL, 0x5C9F9AE60142CEC2ULL,
+		0x563ACAABB7523D45ULL, 0x91F65A3642047E49ULL, 0x37269F2C9AB0F744ULL,
+		0xF0EA0FB16FE6B448ULL, 0xFA4F5FFCD9F647CFULL, 0x3D83CF612CA004C3ULL,
+		0xEF05FF67B5D7A0C1ULL, 0x28C96FFA4081E3CDULL, 0x226C3FB7F691104AULL,
+		0xE5A0AF2A03C75346ULL, 0xC590BE516D946EDDULL, 0x025C2ECC98C22DD1ULL,
+		0x08F97E812ED2DE56ULL, 0xCF35EE1CDB849D5AULL, 0x1DB3DE1A42F33958ULL,
+		0xDA7F4E87B7A57A54ULL, 0xD0DA1ECA01B589D3ULL, 0x17168E57F4E3CADFULL,
+		0x90BA3C3CDD13F2E5ULL, 0x5776ACA12845B1E9ULL, 0x5DD3FCEC9E55426EULL,
+		0x9A1F6C716B030162ULL, 0x48995C77F274A560ULL, 0x8F55CCEA0722E66CULL,
+		0x85F09CA7B13215EBULL, 0x423C0C3A446456E7ULL, 0x620C1D412A376B7CULL,
+		0xA5C08DDCDF612870ULL, 0xAF65DD916971DBF7ULL, 0x68A94D0C9C2798FBULL,
+		0xBA2F7D0A05503CF9ULL, 0x7DE3ED97F0067FF5ULL, 0x7746BDDA46168C72ULL,
+		0xB08A2D47B340CF7EULL, 0x3AEF38E7BC1CCA95ULL, 0xFD23A87A494A8999ULL,
+		0xF786F837FF5A7A1EULL, 0x304A68AA0A0C3912ULL, 0xE2CC58AC937B9D10ULL,
+		0x2500C831662DDE1CULL, 0x2FA5987CD03D2D9BULL, 0xE86908E1256B6E97ULL,
+		0xC859199A4B38530CULL, 0x0F958907BE6E1000ULL, 0x0530D94A087EE387ULL,
+		0xC2FC49D7FD28A08BULL, 0x107A79D1645F0489ULL, 0xD7B6E94C91094785ULL,
+		0xDD13B9012719B402ULL, 0x1ADF299CD24FF70EULL, 0x9D739BF7FBBFCF34ULL,
+		0x5ABF0B6A0EE98C38ULL, 0x501A5B27B8F97FBFULL, 0x97D6CBBA4DAF3CB3ULL,
+		0x4550FBBCD4D898B1ULL, 0x829C6B21218EDBBDULL, 0x88393B6C979E283AULL,
+		0x4FF5ABF162C86B36ULL, 0x6FC5BA8A0C9B56ADULL, 0xA8092A17F9CD15A1ULL,
+		0xA2AC7A5A4FDDE626ULL, 0x6560EAC7BA8BA52AULL, 0xB7E6DAC123FC0128ULL,
+		0x702A4A5CD6AA4224ULL, 0x7A8F1A1160BAB1A3ULL, 0xBD438A8C95ECF2AFULL,
+		0x2CB5D0BAD7E88CE6ULL, 0xEB79402722BECFEAULL, 0xE1DC106A94AE3C6DULL,
+		0x261080F761F87F61ULL, 0xF496B0F1F88FDB63ULL, 0x335A206C0DD9986FULL,
+		0x39FF7021BBC96BE8ULL, 0xFE33E0BC4E9F28E4ULL, 0xDE03F1C720CC157FULL,
+		0x19CF615AD59A5673ULL, 0x136A3117638AA5F4ULL, 0xD4A6A18A96DCE6F8ULL,
+		0x0620918C0FAB42FAULL, 0xC1EC0111FAFD01F6ULL, 0xCB49515C4CEDF271ULL,
+		0x0C85C1C1B9BBB17DULL, 0x8B2973AA904B8947ULL, 0x4CE5E337651DCA4BULL,
+		0x4640B37AD30D39CCULL, 0x818C23E7265B7AC0ULL, 0x530A13E1BF2CDEC2ULL,
+		0x94C6837C4A7A9DCEULL, 0x9E63D331FC6A6E49ULL, 0x59AF43AC093C2D45ULL,
+		0x799F52D7676F10DEULL, 0xBE53C24A923953D2ULL, 0xB4F692072429A055ULL,
+		0x733A029AD17FE359ULL, 0xA1BC329C4808475BULL, 0x6670A201BD5E0457ULL,
+		0x6CD5F24C0B4EF7D0ULL, 0xAB1962D1FE18B4DCULL, 0x217C7771F144B137ULL,
+		0xE6B0E7EC0412F23BULL, 0xEC15B7A1B20201BCULL, 0x2BD9273C475442B0ULL,
+		0xF95F173ADE23E6B2ULL, 0x3E9387A72B75A5BEULL, 0x3436D7EA9D655639ULL,
+		0xF3FA477768331535ULL, 0xD3CA560C066028AEULL, 0x1406C691F3366BA2ULL,
+		0x1EA396DC45269825ULL, 0xD96F0641B070DB29ULL, 0x0BE9364729077F2BULL,
+		0xCC25A6DADC513C27ULL, 0xC680F6976A41CFA0ULL, 0x014C660A9F178CACULL,
+		0x86E0D461B6E7B496ULL, 0x412C44FC43B1F79AULL, 0x4B8914B1F5A1041DULL,
+		0x8C45842C00F74711ULL, 0x5EC3B42A9980E313ULL, 0x990F24B76CD6A01FULL,
+		0x93AA74FADAC65398ULL, 0x5466E4672F901094ULL, 0x7456F51C41C32D0FULL,
+		0xB39A6581B4956E03ULL, 0xB93F35CC02859D84ULL, 0x7EF3A551F7D3DE88ULL,
+		0xAC7595576EA47A8AULL, 0x6BB905CA9BF23986ULL, 0x611C55872DE2CA01ULL,
+		0xA6D0C51AD8B4890DULL
+	},
+	{
+		0x0000000000000000ULL, 0x6E4D3E593561EE88ULL, 0xDC9A7CB26AC3DD10ULL,
+		0xB2D742EB5FA23398ULL, 0xFBC4188F7C6D8CB3ULL, 0x958926D6490C623BULL,
+		0x275E643D16AE51A3ULL, 0x49135A6423CFBF2BULL, 0xB578D0F551312FF5ULL,
+		0xDB35EEAC6450C17DULL, 0x69E2AC473BF2F2E5ULL, 0x07AF921E0E931C6DULL,
+		0x4EBCC87A2D5CA346ULL, 0x20F1F623183D4DCEULL, 0x9226B4C8479F7E56ULL,
+		0xFC6B8A9172FE90DEULL, 0x280140010B886979ULL, 0x464C7E583EE987F1ULL,
+		0xF49B3CB3614BB469ULL, 0x9AD602EA542A5AE1ULL, 0xD3C5588E77E5E5CAULL,
+		0xBD8866D742840B42ULL, 0x0F5F243C1D2638DAULL, 0x61121A652847D652ULL,
+		0x9D7990F45AB9468CULL, 0xF334AEAD6FD8A804ULL, 0x41E3EC46307A9B9CULL,
+		0x2FAED21F051B7514ULL, 0x66BD887B26D4CA3FULL, 0x08F0B62213B524B7ULL,
+		0xBA27F4C94C17172FULL, 0xD46ACA907976F9A7ULL, 0x500280021710D2F2ULL,
+		0x3E4FBE5B22713C7AULL, 0x8C98FCB07DD30FE2ULL, 0xE2D5C2E948B2E16AULL,
+		0xABC6988D6B7D5E41ULL, 0xC58BA6D45E1CB0C9ULL, 0x775CE43F01BE8351ULL,
+		0x1911DA6634DF6DD9ULL, 0xE57A50F74621FD07ULL, 0x8B376EAE7340138FULL,
+		0x39E02C452CE22017ULL, 0x57AD121C1983CE9FULL, 0x1EBE48783A4C71B4ULL,
+		0x70F376210F2D9F3CULL, 0xC22434CA508FACA4ULL, 0xAC690A9365EE422CULL,
+		0x7803C0031C98BB8BULL, 0x164EFE5A29F95503ULL, 0xA499BCB1765B669BULL,
+		0xCAD482E8433A8813ULL, 0x83C7D88C60F53738ULL, 0xED8AE6D55594D9B0ULL,
+		0x5F5DA43E0A36EA28ULL, 0x31109A673F5704A0ULL, 0xCD7B10F64DA9947EULL,
+		0xA3362EAF78C87AF6ULL, 0x11E16C44276A496EULL, 0x7FAC521D120BA7E6ULL,
+		0x36BF087931C418CDULL, 0x58F2362004A5F645ULL, 0xEA2574CB5B07C5DDULL,
+		0x84684A926E662B55ULL, 0xA00500042E21A5E4ULL, 0xCE483E5D1B404B6CULL,
+		0x7C9F7CB644E278F4ULL, 0x12D242EF7183967CULL, 0x5BC1188B524C2957ULL,
+		0x358C26D2672DC7DFULL, 0x875B6439388FF447ULL, 0xE9165A600DEE1ACFULL,
+		0x157DD0F17F108A11ULL, 0x7B30EEA84A716499ULL, 0xC9E7AC4315D35701ULL,
+		0xA7AA921A20B2B989ULL, 0xEEB9C87E037D06A2ULL, 0x80F4F627361CE82AULL,
+		0x3223B4CC69BEDBB2ULL, 0x5C6E8A955CDF353AULL, 0x8804400525A9CC9DULL,
+		0xE6497E5C10C82215ULL, 0x549E3CB74F6A118DULL, 0x3AD302EE7A0BFF05ULL,
+		0x73C0588A59C4402EULL, 0x1D8D66D36CA5AEA6ULL, 0xAF5A243833079D3EULL,
+		0xC1171A61066673B6ULL, 0x3D7C90F07498E368ULL, 0x5331AEA941F90DE0ULL,
+		0xE1E6EC421E5B3E78ULL, 0x8FABD21B2B3AD0F0ULL, 0xC6B8887F08F56FDBULL,
+		0xA8F5B6263D948153ULL, 0x1A22F4CD6236B2CBULL, 0x746FCA9457575C43ULL,
+		0xF007800639317716ULL, 0x9E4ABE5F0C50999EULL, 0x2C9DFCB453F2AA06ULL,
+		0x42D0C2ED6693448EULL, 0x0BC39889455CFBA5ULL, 0x658EA6D0703D152DULL,
+		0xD759E43B2F9F26B5ULL, 0xB914DA621AFEC83DULL, 0x457F50F3680058E3ULL,
+		0x2B326EAA5D61B66BULL, 0x99E52C4102C385F3ULL, 0xF7A8121837A26B7BULL,
+		0xBEBB487C146DD450ULL, 0xD0F67625210C3AD8ULL, 0x622134CE7EAE0940ULL,
+		0x0C6C0A974BCFE7C8ULL, 0xD806C00732B91E6FULL, 0xB64BFE5E07D8F0E7ULL,
+		0x049CBCB5587AC37FULL, 0x6AD182EC6D1B2DF7ULL, 0x23C2D8884ED492DCULL,
+		0x4D8FE6D17BB57C54ULL, 0xFF58A43A24174FCCULL, 0x91159A631176A144ULL,
+		0x6D7E10F26388319AULL, 0x03332EAB56E9DF12ULL, 0xB1E46C40094BEC8AULL,
+		0xDFA952193C2A0202ULL, 0x96BA087D1FE5BD29ULL, 0xF8F736242A8453A1ULL,
+		0x4A2074CF75266039ULL, 0x246D4A9640478EB1ULL, 0x02FAE1E3F5A97D5BULL,
+		0x6CB7DFBAC0C893D3ULL, 0xDE609D519F6AA04BULL, 0xB02DA308AA0B4EC3ULL,
+		0xF93EF96C89C4F1E8ULL, 0x9773C735BCA51F60ULL, 0x25A485DEE3072CF8ULL,
+		0x4BE9BB87D666C270ULL, 0xB7823116A49852AEULL, 0xD9CF0F4F91F9BC26ULL,
+		0x6B184DA4CE5B8FBEULL, 0x055573FDFB3A6136ULL, 0x4C462999D8F5DE1DULL,
+		0x220B17C0ED943095ULL, 0x90DC552BB236030DULL, 0xFE916B728757ED85ULL,
+		0x2AFBA1E2FE211422ULL, 0x44B69FBBCB40FAAAULL, 0xF661DD5094E2C932ULL,
+		0x982CE309A18327BAULL, 0xD13FB96D824C9891ULL, 0xBF728734B72D7619ULL,
+		0x0DA5C5DFE88F4581ULL, 0x63E8FB86DDEEAB09ULL, 0x9F837117AF103BD7ULL,
+		0xF1CE4F4E9A71D55FULL, 0x43190DA5C5D3E6C7ULL, 0x2D5433FCF0B2084FULL,
+		0x64476998D37DB764ULL, 0x0A0A57C1E61C59ECULL, 0xB8DD152AB9BE6A74ULL,
+		0xD6902B738CDF84FCULL, 0x52F861E1E2B9AFA9ULL, 0x3CB55FB8D7D84121ULL,
+		0x8E621D53887A72B9ULL, 0xE02F230ABD1B9C31ULL, 0xA93C796E9ED4231AULL,
+		0xC7714737ABB5CD92ULL, 0x75A605DCF417FE0AULL, 0x1BEB3B85C1761082ULL,
+		0xE780B114B388805CULL, 0x89CD8F4D86E96ED4ULL, 0x3B1ACDA6D94B5D4CULL,
+		0x5557F3FFEC2AB3C4ULL, 0x1C44A99BCFE50CEFULL, 0x720997C2FA84E267ULL,
+		0xC0DED529A526D1FFULL, 0xAE93EB7090473F77ULL, 0x7AF921E0E931C6D0ULL,
+		0x14B41FB9DC502858ULL, 0xA6635D5283F21BC0ULL, 0xC82E630BB693F548ULL,
+		0x813D396F955C4A63ULL, 0xEF700736A03DA4EBULL, 0x5DA745DDFF9F9773ULL,
+		0x33EA7B84CAFE79FBULL, 0xCF81F115B800E925ULL, 0xA1CCCF4C8D6107ADULL,
+		0x131B8DA7D2C33435ULL, 0x7D56B3FEE7A2DABDULL, 0x3445E99AC46D6596ULL,
+		0x5A08D7C3F10C8B1EULL, 0xE8DF9528AEAEB886ULL, 0x8692AB719BCF560EULL,
+		0xA2FFE1E7DB88D8BFULL, 0xCCB2DFBEEEE93637ULL, 0x7E659D55B14B05AFULL,
+		0x1028A30C842AEB27ULL, 0x593BF968A7E5540CULL, 0x3776C7319284BA84ULL,
+		0x85A185DACD26891CULL, 0xEBECBB83F8476794ULL, 0x178731128AB9F74AULL,
+		0x79CA0F4BBFD819C2ULL, 0xCB1D4DA0E07A2A5AULL, 0xA55073F9D51BC4D2ULL,
+		0xEC43299DF6D47BF9ULL, 0x820E17C4C3B59571ULL, 0x30D9552F9C17A6E9ULL,
+		0x5E946B76A9764861ULL, 0x8AFEA1E6D000B1C6ULL, 0xE4B39FBFE5615F4EULL,
+		0x5664DD54BAC36CD6ULL, 0x3829E30D8FA2825EULL, 0x713AB969AC6D3D75ULL,
+		0x1F778730990CD3FDULL, 0xADA0C5DBC6AEE065ULL, 0xC3EDFB82F3CF0EEDULL,
+		0x3F86711381319E33ULL, 0x51CB4F4AB45070BBULL, 0xE31C0DA1EBF24323ULL,
+		0x8D5133F8DE93ADABULL, 0xC442699CFD5C1280ULL, 0xAA0F57C5C83DFC08ULL,
+		0x18D8152E979FCF90ULL, 0x76952B77A2FE2118ULL, 0xF2FD61E5CC980A4DULL,
+		0x9CB05FBCF9F9E4C5ULL, 0x2E671D57A65BD75DULL, 0x402A230E933A39D5ULL,
+		0x0939796AB0F586FEULL, 0x6774473385946876ULL, 0xD5A305D8DA365BEEULL,
+		0xBBEE3B81EF57B566ULL, 0x4785B1109DA925B8ULL, 0x29C88F49A8C8CB30ULL,
+		0x9B1FCDA2F76AF8A8ULL, 0xF552F3FBC20B1620ULL, 0xBC41A99FE1C4A90BULL,
+		0xD20C97C6D4A54783ULL, 0x60DBD52D8B07741BULL, 0x0E96EB74BE669A93ULL,
+		0xDAFC21E4C7106334ULL, 0xB4B11FBDF2718DBCULL, 0x06665D56ADD3BE24ULL,
+		0x682B630F98B250ACULL, 0x2138396BBB7DEF87ULL, 0x4F7507328E1C010FULL,
+		0xFDA245D9D1BE3297ULL, 0x93EF7B80E4DFDC1FULL, 0x6F84F11196214CC1ULL,
+		0x01C9CF48A340A249ULL, 0xB31E8DA3FCE291D1ULL, 0xDD53B3FAC9837F59ULL,
+		0x9440E99EEA4CC072ULL, 0xFA0DD7C7DF2D2EFAULL, 0x48DA952C808F1D62ULL,
+		0x2697AB75B5EEF3EAULL
+	}
+};
+
+static uint64_t crc64_bytewise(uint64_t crc, const unsigned char *data, size_t len)
+{
+	while (len--) {
+		int i = ((int) (crc >> 56) ^ *data++) & 0xFF;
+		crc = crc64_tab[i] ^ (crc << 8);
+	}
+	return crc;
+}
+
 /*
  * This a generic crc64() function, it takes seed as an argument,
  * and does __not__ xor at the end. Then individual users can do
  * whatever they need.
+ *
+ * The buffer is processed by 8 bytes (slice-by-8), the rest byte by byte.
  */
 uint64_t crc64(uint64_t seed, const unsigned char *data, size_t len)
 {
 	uint64_t crc = seed;
 
-	while (len--) {
-		int i = ((int) (crc >> 56) ^ *data++) & 0xFF;
-		crc = crc64_tab[i] ^ (crc << 8);
+	if (len >= 16) {
+		for (; len >= 8; len -= 8, data += 8) {
+			uint64_t x;
+
+			memcpy(&x, data, 8);
+			x = crc ^ be64_to_cpu(x);
+
+			crc = crc64_slice[6][x >> 56] ^
+			      crc64_slice[5][(x >> 48) & 0xFF] ^
+			      crc64_slice[4][(x >> 40) & 0xFF] ^
+			      crc64_slice[3][(x >> 32) & 0xFF] ^
+			      crc64_slice[2][(x >> 24) & 0xFF] ^
+			      crc64_slice[1][(x >> 16) & 0xFF] ^
+			      crc64_slice[0][(x >> 8) & 0xFF] ^
+			      crc64_tab[x & 0xFF];
+		}
 	}
 
-	return crc;
+	return crc64_bytewise(crc, data, len);
 }
 
+#ifdef TEST_PROGRAM
+# include <stdio.h>
+# include <stdlib.h>
+# include <sys/time.h>
+
+static double crc64_bench(uint64_t (*fn)(uint64_t, const unsigned char *, size_t),
+			  const unsigned char *buf, size_t len, size_t loops)
+{
+	struct timeval start, end;
+	uint64_t crc = 0;
+	double sec;
+	size_t i;
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < loops; i++)
+		crc = fn(crc, buf, len);
+	gettimeofday(&end, NULL);
+
+	sec = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0;
+	return sec > 0 ? (double) len * loops / sec / (1024 * 1024) : 0.0;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned char buf[4096 + 16];
+	size_t i;
+
+	srandom(0);
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = random();
+
+	/* the CRC-64/ECMA-182 check value of the "123456789" string */
+	if (crc64(0, (unsigned char *) "123456789", 9) != 0x6C40DF5F0B497347ULL)
+		errx(EXIT_FAILURE, "check value mismatch");
+
+	for (i = 0; i < 20000; i++) {
+		size_t off = random() % 16, len = random() % 4096;
+		uint64_t seed = ((uint64_t) random() << 32) ^ random();
+
+		if (crc64(seed, buf + off, len) != crc64_bytewise(seed, buf + off, len))
+			errx(EXIT_FAILURE, "mismatch [offset=%zu, length=%zu, seed=0x%016jx]",
+					off, len, (uintmax_t) seed);
+	}
+
+	if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+		printf("bytewise:   %8.1f MiB/s\n",
+			crc64_bench(crc64_bytewise, buf, 4096, 50000));
+		printf("crc64():    %8.1f MiB/s\n",
+			crc64_bench(crc64, buf, 4096, 50000));
+	}
+
+	printf("ok\n");
+	return EXIT_SUCCESS;
+}
+#endif /* TEST_PROGRAM */
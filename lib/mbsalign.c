@@ -24,12 +24,75 @@
 #include <stdbool.h>
 #include <limits.h>
 #include <ctype.h>
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
 
 #include "c.h"
 #include "mbsalign.h"
 #include "widechar.h"
 
 #ifdef HAVE_WIDECHAR
+#ifdef TEST_PROGRAM
+static int ascii_fastpath = 1;
+#else
+# define ascii_fastpath 1
+#endif
+
+#define WORD_ONES	((unsigned long) -1 / 0xff)	/* 0x0101...01 */
+#define WORD_HIGHS	(WORD_ONES * 0x80)		/* 0x8080...80 */
+
+/*
+ * Returns non-zero if all bytes in @w are within 0x20..0x7e range.
+ */
+static inline int word_is_printable(unsigned long w)
+{
+	return !(((w - WORD_ONES * 0x20) & ~w & WORD_HIGHS) |	/* < 0x20 */
+		 (((w + WORD_ONES) | w) & WORD_HIGHS));		/* > 0x7e */
+}
+
+/*
+ * Returns number of leading printable ASCII chars (0x20..0x7e) in the
+ * first @len bytes of @s. These chars are one cell wide and printable in all
+ * locales, so the callers don't have to use mbrtowc() for them.
+ */
+static size_t ascii_printable_span(const char *s, size_t len)
+{
+	size_t i = 0;
+
+	if (!ascii_fastpath)
+		return 0;
+#ifdef __SSE2__
+	{
+		const __m128i lo = _mm_set1_epi8(0x1f);
+		const __m128i hi = _mm_set1_epi8(0x7f);
+
+		/* bytes >= 0x80 are negative, so signed compare is enough */
+		for (; i + 16 <= len; i += 16) {
+			__m128i v = _mm_loadu_si128((const __m128i *) (s + i));
+			unsigned int mask = _mm_movemask_epi8(
+					_mm_and_si128(_mm_cmpgt_epi8(v, lo),
+						      _mm_cmplt_epi8(v, hi)));
+			if (mask != 0xffff)
+				return i + __builtin_ctz(~mask);
+		}
+	}
+#endif
+	for (; i + sizeof(unsigned long) <= len; i += sizeof(unsigned long)) {
+		unsigned long w;
+
+		memcpy(&w, s + i, sizeof(w));
+		if (!word_is_printable(w))
+			break;
+	}
+	for (; i < len; i++) {
+		unsigned char c = (unsigned char) s[i];
+		if (c < 0x20 || c > 0x7e)
+			break;
+	}
+	return i;
+}
+
 /* Replace non printable chars.
    Note \t and \n etc. are non printable.
    Return 1 if replacement made, 0 otherwise.  */
@@ -53,6 +116,15 @@ size_t mbs_safe_nwidth(const char *buf, size_t bufsz, size_t *sz)
 		last = p + (bufsz - 1);
 
 	while (p && *p && p <= last) {
+		if (mbsinit(&st)) {
+			size_t n = ascii_printable_span(p, last - p + 1);
+
+			if (n) {
+				width += n, bytes += n;
+				p += n;
+				continue;
+			}
+		}
 		if (iscntrl((unsigned char) *p)) {
 			width += 4, bytes += 4;		/* *p encoded to \x?? */
 			p++;
@@ -127,6 +199,17 @@ char *mbs_safe_encode_to_buffer(const char *s, size_t *width, char *buf)
 	*width = 0;
 
 	while (p && *p) {
+		if (mbsinit(&st)) {
+			size_t n = ascii_printable_span(p, sz - (p - s));
+
+			if (n) {
+				memcpy(r, p, n);
+				r += n;
+				*width += n;
+				p += n;
+				continue;
+			}
+		}
 		if (iscntrl((unsigned char) *p)) {
 			sprintf(r, "\\x%02x", (unsigned char) *p);
 			r += 4;
@@ -152,7 +235,7 @@ char *mbs_safe_encode_to_buffer(const char *s, size_t *width, char *buf)
 					r += 4;
 					*width += 4;
 				} else {
-					width++;
+					(*width)++;
 					*r++ = *p;
 				}
 			} else if (!iswprint(wc)) {
@@ -177,7 +260,7 @@ char *mbs_safe_encode_to_buffer(const char *s, size_t *width, char *buf)
 			*width += 4;
 		} else {
 			*r++ = *p++;
-			*width++;
+			(*width)++;
 		}
 #endif
 	}
@@ -464,3 +547,122 @@ mbsalign_cleanup:
 
   return ret;
 }
+
+#if defined(TEST_PROGRAM) && defined(HAVE_WIDECHAR)
+#include <locale.h>
+#include <sys/time.h>
+
+static const char *samples[] = {
+	"sda1",
+	"/dev/disk/by-path/pci-0000:00:1f.2-ata-1.0-part1",
+	"rw,relatime,errors=remount-ro,data=ordered",
+	"\xc5\xbelu\xc5\xa5ou\xc4\x8dk\xc3\xbd k\xc5\xaf\xc5\x88",
+	"tab\there, newline\nthere",
+	"invalid \xff\xfe bytes \xc3 end",
+	"wide \xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e and ascii tail ................",
+};
+
+static int compare_paths(const char *s)
+{
+	size_t w[2], b[2], ew[2];
+	char *e[2];
+	int i, rc;
+
+	for (i = 0; i < 2; i++) {
+		ascii_fastpath = i;
+		w[i] = mbs_safe_nwidth(s, strlen(s), &b[i]);
+		e[i] = mbs_safe_encode(s, &ew[i]);
+	}
+	rc = w[0] != w[1] || b[0] != b[1] || ew[0] != ew[1]
+	     || strcmp(e[0], e[1]) != 0;
+	if (rc)
+		fprintf(stderr, "mismatch for '%s': %zu/%zu %zu/%zu '%s'/'%s'\n",
+				s, w[0], w[1], b[0], b[1], e[0], e[1]);
+	free(e[0]);
+	free(e[1]);
+	return rc;
+}
+
+/* random mix of ASCII, control chars, UTF-8 sequences and garbage */
+static void random_string(char *buf, size_t sz)
+{
+	static const char *pieces[] = {
+		"a", "Z", " ", "~", "\x7f", "\t", "\x01", "\xc3\xa1",
+		"\xe6\x97\xa5", "\xf0\x9f\x98\x80", "\xff", "\xc3", "\xe2\x80\x8b"
+	};
+	size_t len = 0;
+
+	while (len + 5 < sz) {
+		const char *p = pieces[rand() % ARRAY_SIZE(pieces)];
+		size_t n = rand() % 3 ? 1 + rand() % 40 : 1;
+
+		while (n-- && len + 5 < sz)
+			len += sprintf(buf + len, "%s", rand() % 2 ? "x" : p);
+	}
+	buf[len] = '\0';
+}
+
+static double bench(size_t loops)
+{
+	struct timeval start, end;
+	size_t i, k, sum = 0;
+	char buf[256];
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < loops; i++) {
+		for (k = 0; k < ARRAY_SIZE(samples); k++) {
+			size_t width;
+
+			sum += mbs_safe_width(samples[k]);
+			mbs_safe_encode_to_buffer(samples[k], &width, buf);
+			sum += width;
+		}
+	}
+	gettimeofday(&end, NULL);
+
+	if (!sum)
+		abort();
+	return (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0;
+}
+
+int main(int argc, char *argv[])
+{
+	size_t i, loops = 0;
+	int rc = 0;
+
+	setlocale(LC_ALL, "");
+
+	if (argc == 3 && strcmp(argv[1], "--bench") == 0)
+		loops = strtoul(argv[2], NULL, 10);
+	else if (argc != 1) {
+		fprintf(stderr, "usage: %s [--bench <loops>]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (loops) {
+		double old, new;
+
+		ascii_fastpath = 0;
+		old = bench(loops);
+		ascii_fastpath = 1;
+		new = bench(loops);
+
+		printf("per-char: %.3f s\n", old);
+		printf("fastpath: %.3f s\n", new);
+		printf("speedup:  %.2fx\n", new > 0 ? old / new : 0.0);
+		return EXIT_SUCCESS;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(samples); i++)
+		rc |= compare_paths(samples[i]);
+	for (i = 0; i < 100000; i++) {
+		char buf[128];
+
+		random_string(buf, 1 + rand() % sizeof(buf));
+		if (*buf)
+			rc |= compare_paths(buf);
+	}
+	printf("%s\n", rc ? "FAILED" : "ok");
+	return rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+#endif /* TEST_PROGRAM */
@@ -11,6 +11,7 @@
 #include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <sys/time.h>
 
 #include <sys/syscall.h>
@@ -30,20 +31,24 @@
 THREAD_LOCAL unsigned short ul_jrand_seed[3];
 #endif
 
-int random_get_fd(void)
+#if defined(__linux__) && defined(SYS_getrandom)
+# ifndef GRND_NONBLOCK
+#  define GRND_NONBLOCK	0x0001
+# endif
+/* glibc < 2.25 does not provide getrandom() wrapper */
+static int ul_getrandom(void *buf, size_t buflen, unsigned int flags)
 {
-	int i, fd;
+	return syscall(SYS_getrandom, buf, buflen, flags);
+}
+# define HAVE_UL_GETRANDOM
+#endif
+
+static void crank_random(void)
+{
+	int i;
 	struct timeval	tv;
 
 	gettimeofday(&tv, 0);
-	fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
-	if (fd == -1)
-		fd = open("/dev/random", O_RDONLY | O_NONBLOCK | O_CLOEXEC);
-	if (fd >= 0) {
-		i = fcntl(fd, F_GETFD);
-		if (i >= 0)
-			fcntl(fd, F_SETFD, i | FD_CLOEXEC);
-	}
 	srand((getpid() << 16) ^ getuid() ^ tv.tv_sec ^ tv.tv_usec);
 
 #ifdef DO_JRAND_MIX
@@ -55,22 +60,73 @@ int random_get_fd(void)
 	gettimeofday(&tv, 0);
 	for (i = (tv.tv_sec ^ tv.tv_usec) & 0x1F; i > 0; i--)
 		rand();
+}
+
+int random_get_fd(void)
+{
+	int i, fd;
+
+	fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+		fd = open("/dev/random", O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+	if (fd >= 0) {
+		i = fcntl(fd, F_GETFD);
+		if (i >= 0)
+			fcntl(fd, F_SETFD, i | FD_CLOEXEC);
+	}
+	crank_random();
 	return fd;
 }
 
+#ifdef HAVE_UL_GETRANDOM
+/*
+ * Reads up to @nbytes from the kernel by getrandom(2), the whole buffer is
+ * requested by one syscall (the kernel returns up to 32MiB at once). Returns
+ * number of the bytes not filled, the caller is expected to read the rest
+ * from /dev/urandom (e.g. old kernel or not yet initialized entropy pool).
+ */
+static size_t getrandom_bytes(unsigned char *cp, size_t n)
+{
+	while (n > 0) {
+		int x = ul_getrandom(cp, n, GRND_NONBLOCK);
+
+		if (x > 0) {
+			n -= x;
+			cp += x;
+		} else if (x < 0 && errno == EINTR)
+			continue;
+		else
+			break;	/* ENOSYS, EAGAIN, ... */
+	}
+	return n;
+}
+#endif
+
 
 /*
  * Generate a stream of random nbytes into buf.
- * Use /dev/urandom if possible, and if not,
+ * Use getrandom(2) or /dev/urandom if possible, and if not,
  * use glibc pseudo-random functions.
+ *
+ * Callers which need more random data should ask for a large buffer
+ * rather than call this function in a loop, the cost is mostly per call.
  */
 void random_get_bytes(void *buf, size_t nbytes)
 {
 	size_t i, n = nbytes;
-	int fd = random_get_fd();
+	int fd = -1;
 	int lose_counter = 0;
 	unsigned char *cp = (unsigned char *) buf;
 
+#ifdef HAVE_UL_GETRANDOM
+	n = getrandom_bytes(cp, n);
+	cp += nbytes - n;
+#endif
+	if (n > 0)
+		fd = random_get_fd();
+	else
+		crank_random();
+
 	if (fd >= 0) {
 		while (n > 0) {
 			ssize_t x = read(fd, cp, n);
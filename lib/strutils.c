@@ -189,6 +189,19 @@ void *mempcpy(void *restrict dest, const void *restrict src, size_t n)
 }
 #endif
 
+#ifndef HAVE_MEMRCHR
+void *memrchr(const void *s, int c, size_t n)
+{
+	const unsigned char *p = (const unsigned char *) s + n;
+
+	while (n--) {
+		if (*--p == (unsigned char) c)
+			return (void *) p;
+	}
+	return NULL;
+}
+#endif
+
 #ifndef HAVE_STRNLEN
 size_t strnlen(const char *s, size_t maxlen)
 {
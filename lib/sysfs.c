@@ -140,6 +140,10 @@ char *sysfs_devno_to_devpath(dev_t devno, char *buf, size_t bufsiz)
 	return NULL;
 }
 
+static void free_cache(struct sysfs_cache *ca);
+static const char *cache_get_attr(struct sysfs_cxt *cxt, const char *attr);
+static void cache_forget_attr(struct sysfs_cxt *cxt, const char *attr);
+
 int sysfs_init(struct sysfs_cxt *cxt, dev_t devno, struct sysfs_cxt *parent)
 {
 	char path[PATH_MAX];
@@ -176,6 +180,7 @@ void sysfs_deinit(struct sysfs_cxt *cxt)
 	if (cxt->dir_fd >= 0)
 	       close(cxt->dir_fd);
 	free(cxt->dir_path);
+	free_cache(cxt->cache);
 
 	memset(cxt, 0, sizeof(*cxt));
 
@@ -202,6 +207,13 @@ int sysfs_has_attribute(struct sysfs_cxt *cxt, const char *attr)
 {
 	struct stat st;
 
+	if (cxt->cache) {
+		if (cache_get_attr(cxt, attr))
+			return 1;
+		if (errno == ENOENT)
+			return 0;
+		/* e.g. a directory, use stat() */
+	}
 	return sysfs_stat(cxt, attr, &st) == 0;
 }
 
@@ -285,14 +297,16 @@ static struct dirent *xreaddir(DIR *dp)
 	return d;
 }
 
-int sysfs_is_partition_dirent(DIR *dir, struct dirent *d, const char *parent_name)
+static int is_partition_dirent(int dir_fd, const char *dirname,
+			       unsigned char type __attribute__((__unused__)),
+			       const char *name, const char *parent_name)
 {
 	char path[256];
 
 #ifdef _DIRENT_HAVE_D_TYPE
-	if (d->d_type != DT_DIR &&
-	    d->d_type != DT_LNK &&
-	    d->d_type != DT_UNKNOWN)
+	if (type != DT_DIR &&
+	    type != DT_LNK &&
+	    type != DT_UNKNOWN)
 		return 0;
 #endif
 	if (parent_name) {
@@ -308,21 +322,392 @@ int sysfs_is_partition_dirent(DIR *dir, struct dirent *d, const char *parent_nam
 		}
 
 		len = strlen(p);
-		if (strlen(d->d_name) <= len)
+		if (strlen(name) <= len)
 			return 0;
 
 		/* partitions subdir name is
 		 *	"<parent>[:digit:]" or "<parent>p[:digit:]"
 		 */
-		return strncmp(p, d->d_name, len) == 0 &&
-		       ((*(d->d_name + len) == 'p' && isdigit(*(d->d_name + len + 1)))
-			|| isdigit(*(d->d_name + len)));
+		return strncmp(p, name, len) == 0 &&
+		       ((*(name + len) == 'p' && isdigit(*(name + len + 1)))
+			|| isdigit(*(name + len)));
 	}
 
 	/* Cannot use /partition file, not supported on old sysfs */
-	snprintf(path, sizeof(path), "%s/start", d->d_name);
+	if (dirname)
+		snprintf(path, sizeof(path), "%s/%s/start", dirname, name);
+	else
+		snprintf(path, sizeof(path), "%s/start", name);
+
+	return faccessat(dir_fd, path, R_OK, 0) == 0;
+}
+
+int sysfs_is_partition_dirent(DIR *dir, struct dirent *d, const char *parent_name)
+{
+#ifdef _DIRENT_HAVE_D_TYPE
+	unsigned char type = d->d_type;
+#else
+	unsigned char type = 0;
+#endif
+	return is_partition_dirent(dirfd(dir), NULL, type, d->d_name, parent_name);
+}
+
+/*
+ * Cache mode
+ *
+ * sysfs_enable_cache() switches the context to a mode where attributes are
+ * read by one read() into a buffer reused for all reads rather than by stdio,
+ * and where attribute values and directory listings are kept in the context,
+ * so the same attribute or directory is never read twice. The context is
+ * expected to be short-living; the cache is invalidated by sysfs_write_*()
+ * only.
+ */
+struct sysfs_cache_attr {
+	char	*name;
+	char	*value;			/* NULL if the attribute does not exist */
+	struct sysfs_cache_attr *next;
+};
+
+struct sysfs_cache_dirent {
+	char		*name;
+	unsigned char	type;		/* DT_* */
+	signed char	is_part;	/* -1 if not checked yet */
+};
+
+struct sysfs_cache_dir {
+	char	*name;			/* NULL for the device directory */
+	struct sysfs_cache_dirent *ents;
+	size_t	nents;
+	struct sysfs_cache_dir *next;
+};
+
+struct sysfs_cache {
+	struct sysfs_cache_attr	*attrs;
+	struct sysfs_cache_dir	*dirs;
+
+	char	*buf;			/* reused for all reads */
+	size_t	bufsz;
+};
+
+/* sysfs attributes are not larger than a page */
+#define SYSFS_CACHE_BUFSZ	(4096 + 1)
+
+static void free_cache_dir(struct sysfs_cache_dir *cd)
+{
+	size_t i;
+
+	if (!cd)
+		return;
+	for (i = 0; i < cd->nents; i++)
+		free(cd->ents[i].name);
+	free(cd->ents);
+	free(cd->name);
+	free(cd);
+}
+
+static void free_cache(struct sysfs_cache *ca)
+{
+	if (!ca)
+		return;
+
+	while (ca->attrs) {
+		struct sysfs_cache_attr *a = ca->attrs;
+
+		ca->attrs = a->next;
+		free(a->name);
+		free(a->value);
+		free(a);
+	}
+	while (ca->dirs) {
+		struct sysfs_cache_dir *cd = ca->dirs;
+
+		ca->dirs = cd->next;
+		free_cache_dir(cd);
+	}
+	free(ca->buf);
+	free(ca);
+}
+
+/*
+ * Enables or disables (and deallocates) the cache mode. The cache is
+ * deallocated by sysfs_deinit() too.
+ */
+int sysfs_enable_cache(struct sysfs_cxt *cxt, int enable)
+{
+	if (enable && !cxt->cache) {
+		cxt->cache = calloc(1, sizeof(struct sysfs_cache));
+		if (!cxt->cache)
+			return -ENOMEM;
+	} else if (!enable && cxt->cache) {
+		free_cache(cxt->cache);
+		cxt->cache = NULL;
+	}
+	return 0;
+}
+
+/* reads @attr of @cxt into @ca buffer, returns allocated copy */
+static char *cache_read_attr(struct sysfs_cache *ca, struct sysfs_cxt *cxt,
+			     const char *attr)
+{
+	size_t len = 0;
+	int fd, errsv;
+
+	fd = open_at(cxt->dir_fd, cxt->dir_path, attr, O_RDONLY|O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+
+	for (;;) {
+		size_t want;
+		ssize_t ret;
+
+		if (len + 1 >= ca->bufsz) {
+			size_t sz = ca->bufsz ? ca->bufsz * 2 : SYSFS_CACHE_BUFSZ;
+			char *tmp = realloc(ca->buf, sz);
+
+			if (!tmp)
+				goto err;
+			ca->buf = tmp;
+			ca->bufsz = sz;
+		}
+
+		want = ca->bufsz - len - 1;
+		ret = read(fd, ca->buf + len, want);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			goto err;
+		}
+		len += ret;
+
+		/* sysfs returns the whole attribute by the first read(),
+		 * don't waste another syscall to get EOF */
+		if ((size_t) ret < want)
+			break;
+	}
+	close(fd);
+
+	ca->buf[len] = '\0';
+	return strdup(ca->buf);
+err:
+	errsv = errno;
+	close(fd);
+	errno = errsv;
+	return NULL;
+}
+
+/*
+ * Returns cached value of @attr, reads the attribute if not cached yet. If
+ * the attribute does not exist then returns NULL and sets errno to ENOENT.
+ */
+static const char *cache_get_attr(struct sysfs_cxt *cxt, const char *attr)
+{
+	struct sysfs_cache *ca = cxt->cache;
+	struct sysfs_cache_attr *a;
+	char *val;
+
+	for (a = ca->attrs; a; a = a->next) {
+		if (strcmp(a->name, attr) != 0)
+			continue;
+		if (!a->value)
+			errno = ENOENT;
+		return a->value;
+	}
+
+	val = cache_read_attr(ca, cxt, attr);
+	if (!val && errno == ENOENT && cxt->parent &&
+		 strncmp(attr, "queue/", 6) == 0) {
+		/* Exception for "queue/<attr>", see sysfs_open() */
+		if (cxt->parent->cache) {
+			const char *pval = cache_get_attr(cxt->parent, attr);
+
+			val = pval ? strdup(pval) : NULL;
+		} else
+			val = cache_read_attr(ca, cxt->parent, attr);
+	}
+	if (!val && errno != ENOENT)
+		return NULL;			/* don't cache errors */
+	if (!val && !cxt->parent && strncmp(attr, "queue/", 6) == 0)
+		return NULL;			/* parent may be set later */
+
+	a = calloc(1, sizeof(*a));
+	if (!a || !(a->name = strdup(attr))) {
+		free(a);
+		free(val);
+		return NULL;
+	}
+	a->value = val;
+	a->next = ca->attrs;
+	ca->attrs = a;
+
+	if (!val)
+		errno = ENOENT;
+	return val;
+}
+
+static void cache_forget_attr(struct sysfs_cxt *cxt, const char *attr)
+{
+	struct sysfs_cache_attr **pa;
+
+	if (!cxt->cache)
+		return;
+
+	for (pa = &cxt->cache->attrs; *pa; pa = &(*pa)->next) {
+		struct sysfs_cache_attr *a = *pa;
+
+		if (strcmp(a->name, attr) == 0) {
+			*pa = a->next;
+			free(a->name);
+			free(a->value);
+			free(a);
+			break;
+		}
+	}
+}
+
+static struct sysfs_cache_dir *cache_lookup_dir(struct sysfs_cxt *cxt,
+						const char *attr)
+{
+	struct sysfs_cache_dir *cd;
+
+	for (cd = cxt->cache->dirs; cd; cd = cd->next) {
+		if (attr ? cd->name && strcmp(cd->name, attr) == 0 : !cd->name)
+			return cd;
+	}
+	return NULL;
+}
+
+/* returns cached listing of @attr directory, NULL means device directory */
+static struct sysfs_cache_dir *cache_get_dir(struct sysfs_cxt *cxt,
+					     const char *attr)
+{
+	struct sysfs_cache_dir *cd;
+	struct dirent *d;
+	DIR *dir;
+
+	cd = cache_lookup_dir(cxt, attr);
+	if (cd)
+		return cd;
+
+	dir = sysfs_opendir(cxt, attr);
+	if (!dir)
+		return NULL;
+
+	cd = calloc(1, sizeof(*cd));
+	if (!cd)
+		goto err;
+	if (attr && !(cd->name = strdup(attr)))
+		goto err;
+
+	while ((d = xreaddir(dir))) {
+		struct sysfs_cache_dirent *e;
+
+		if (cd->nents % 16 == 0) {
+			void *tmp = realloc(cd->ents, (cd->nents + 16) * sizeof(*e));
+			if (!tmp)
+				goto err;
+			cd->ents = tmp;
+		}
+		e = &cd->ents[cd->nents];
+		e->name = strdup(d->d_name);
+		if (!e->name)
+			goto err;
+#ifdef _DIRENT_HAVE_D_TYPE
+		e->type = d->d_type;
+#else
+		e->type = 0;
+#endif
+		e->is_part = -1;
+		cd->nents++;
+	}
+	closedir(dir);
+
+	cd->next = cxt->cache->dirs;
+	cxt->cache->dirs = cd;
+	return cd;
+err:
+	closedir(dir);
+	free_cache_dir(cd);
+	return NULL;
+}
+
+static int cache_is_partition(struct sysfs_cxt *cxt, struct sysfs_cache_dir *cd,
+			      struct sysfs_cache_dirent *e, const char *parent_name)
+{
+	if (parent_name)
+		return is_partition_dirent(cxt->dir_fd, cd->name, e->type,
+					   e->name, parent_name);
+	if (e->is_part < 0)
+		e->is_part = is_partition_dirent(cxt->dir_fd, cd->name, e->type,
+						 e->name, NULL);
+	return e->is_part;
+}
+
+/*
+ * Returns the name of the next entry of the @attr directory (NULL means the
+ * device directory) or NULL at the end of the directory (errno is zero) or on
+ * error. The @idx is the iterator position and has to be zero for the first
+ * call. If @parent_name is not NULL then returns partitions of the
+ * @parent_name device only.
+ *
+ * The directory is listed only once, the context is switched to the cache
+ * mode.
+ */
+const char *sysfs_next_dirent(struct sysfs_cxt *cxt, const char *attr,
+			      const char *parent_name, size_t *idx)
+{
+	struct sysfs_cache_dir *cd;
+
+	if (sysfs_enable_cache(cxt, 1))
+		return NULL;
+
+	cd = *idx ? cache_lookup_dir(cxt, attr) : cache_get_dir(cxt, attr);
+	if (!cd)
+		return NULL;
+
+	while (*idx < cd->nents) {
+		struct sysfs_cache_dirent *e = &cd->ents[(*idx)++];
 
-	return faccessat(dirfd(dir), path, R_OK, 0) == 0;
+		if (!parent_name || cache_is_partition(cxt, cd, e, parent_name))
+			return e->name;
+	}
+	errno = 0;
+	return NULL;
+}
+
+/*
+ * Returns 1 if @name from the @attr directory (NULL means the device
+ * directory) is a partition. The same as sysfs_is_partition_dirent() without
+ * a parent name, but the result is cached if the directory has been listed by
+ * sysfs_next_dirent().
+ */
+int sysfs_dirent_is_partition(struct sysfs_cxt *cxt, const char *attr,
+			      const char *name)
+{
+	struct sysfs_cache_dir *cd = cxt->cache ? cache_lookup_dir(cxt, attr) : NULL;
+	size_t i;
+
+	for (i = 0; cd && i < cd->nents; i++) {
+		if (strcmp(cd->ents[i].name, name) == 0)
+			return cache_is_partition(cxt, cd, &cd->ents[i], NULL);
+	}
+	return is_partition_dirent(cxt->dir_fd, attr, 0, name, NULL);
+}
+
+/* returns 1 if @name partition has number @partno */
+static int is_partno(struct sysfs_cxt *cxt, const char *name, int partno,
+		     dev_t *devno)
+{
+	char path[256];
+	int n, maj, min;
+
+	snprintf(path, sizeof(path), "%s/partition", name);
+	if (sysfs_read_int(cxt, path, &n) || n != partno)
+		return 0;
+
+	snprintf(path, sizeof(path), "%s/dev", name);
+	if (sysfs_scanf(cxt, path, "%d:%d", &maj, &min) == 2)
+		*devno = makedev(maj, min);
+	return 1;
 }
 
 /*
@@ -336,29 +721,29 @@ dev_t sysfs_partno_to_devno(struct sysfs_cxt *cxt, int partno)
 {
 	DIR *dir;
 	struct dirent *d;
-	char path[256];
 	dev_t devno = 0;
 
+	if (cxt->cache) {
+		const char *name;
+		size_t i = 0;
+
+		while ((name = sysfs_next_dirent(cxt, NULL, NULL, &i))) {
+			if (sysfs_dirent_is_partition(cxt, NULL, name) &&
+			    is_partno(cxt, name, partno, &devno))
+				break;
+		}
+		return devno;
+	}
+
 	dir = sysfs_opendir(cxt, NULL);
 	if (!dir)
 		return 0;
 
 	while ((d = xreaddir(dir))) {
-		int n, maj, min;
-
 		if (!sysfs_is_partition_dirent(dir, d, NULL))
 			continue;
-
-		snprintf(path, sizeof(path), "%s/partition", d->d_name);
-		if (sysfs_read_int(cxt, path, &n))
-			continue;
-
-		if (n == partno) {
-			snprintf(path, sizeof(path), "%s/dev", d->d_name);
-			if (sysfs_scanf(cxt, path, "%d:%d", &maj, &min) == 2)
-				devno = makedev(maj, min);
+		if (is_partno(cxt, d->d_name, partno, &devno))
 			break;
-		}
 	}
 
 	closedir(dir);
@@ -368,10 +753,22 @@ dev_t sysfs_partno_to_devno(struct sysfs_cxt *cxt, int partno)
 
 int sysfs_scanf(struct sysfs_cxt *cxt,  const char *attr, const char *fmt, ...)
 {
-	FILE *f = sysfs_fopen(cxt, attr);
+	FILE *f;
 	va_list ap;
 	int rc;
 
+	if (cxt->cache) {
+		const char *val = cache_get_attr(cxt, attr);
+
+		if (!val)
+			return -EINVAL;
+		va_start(ap, fmt);
+		rc = vsscanf(val, fmt, ap);
+		va_end(ap);
+		return rc;
+	}
+
+	f = sysfs_fopen(cxt, attr);
 	if (!f)
 		return -EINVAL;
 	va_start(ap, fmt);
@@ -424,6 +821,7 @@ int sysfs_write_string(struct sysfs_cxt *cxt, const char *attr, const char *str)
 	int fd = sysfs_open(cxt, attr, O_WRONLY|O_CLOEXEC);
 	int rc, errsv;
 
+	cache_forget_attr(cxt, attr);
 	if (fd < 0)
 		return -errno;
 	rc = write_all(fd, str, strlen(str));
@@ -439,6 +837,7 @@ int sysfs_write_u64(struct sysfs_cxt *cxt, const char *attr, uint64_t num)
 	char buf[sizeof(stringify_value(ULLONG_MAX))];
 	int fd, rc = 0, len, errsv;
 
+	cache_forget_attr(cxt, attr);
 	fd = sysfs_open(cxt, attr, O_WRONLY|O_CLOEXEC);
 	if (fd < 0)
 		return -errno;
@@ -467,6 +866,11 @@ int sysfs_count_dirents(struct sysfs_cxt *cxt, const char *attr)
 	DIR *dir;
 	int r = 0;
 
+	if (cxt->cache) {
+		struct sysfs_cache_dir *cd = cache_get_dir(cxt, attr);
+
+		return cd ? (int) cd->nents : 0;
+	}
 	if (!(dir = sysfs_opendir(cxt, attr)))
 		return 0;
 
@@ -482,6 +886,13 @@ int sysfs_count_partitions(struct sysfs_cxt *cxt, const char *devname)
 	struct dirent *d;
 	int r = 0;
 
+	if (cxt->cache) {
+		size_t i = 0;
+
+		while (sysfs_next_dirent(cxt, NULL, devname, &i))
+			r++;
+		return r;
+	}
 	if (!(dir = sysfs_opendir(cxt, NULL)))
 		return 0;
 
@@ -504,6 +915,11 @@ char *sysfs_get_slave(struct sysfs_cxt *cxt)
 	struct dirent *d;
 	char *name = NULL;
 
+	if (cxt->cache) {
+		struct sysfs_cache_dir *cd = cache_get_dir(cxt, "slaves");
+
+		return cd && cd->nents == 1 ? strdup(cd->ents[0].name) : NULL;
+	}
 	if (!(dir = sysfs_opendir(cxt, "slaves")))
 		return NULL;
 
@@ -912,6 +1328,22 @@ int main(int argc, char *argv[])
 
 	printf("DEVNAME: %s\n", sysfs_get_devname(&cxt, path, sizeof(path)));
 
+	/* the same again in the cache mode */
+	if (sysfs_enable_cache(&cxt, 1))
+		errx(EXIT_FAILURE, "failed to enable cache");
+
+	for (i = 0; i < 2; i++) {
+		if (!is_part) {
+			dev_t dev = sysfs_partno_to_devno(&cxt, 1);
+
+			printf("PARTITIONS: %d\n", sysfs_count_partitions(&cxt, devname));
+			printf("\t#1 %d:%d\n", major(dev), minor(dev));
+		}
+		printf("SLAVES: %d\n", sysfs_count_dirents(&cxt, "slaves"));
+		if (sysfs_read_u64(&cxt, "size", &u64) == 0)
+			printf("SIZE: %jd\n", u64);
+	}
+
 	sysfs_deinit(&cxt);
 	return EXIT_SUCCESS;
 }
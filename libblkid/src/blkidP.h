@@ -179,9 +179,21 @@ struct blkid_bufinfo {
 	unsigned char		*data;
 	blkid_loff_t		off;
 	blkid_loff_t		len;
+	blkid_loff_t		size;	/* allocated space for data */
 	struct list_head	bufs;	/* list of buffers */
 };
 
+/* default size of the read-ahead blocks for probing buffers */
+#define BLKID_PROBE_READAHEAD	4096
+
+/*
+ * Area on the device (relative to the begin of the probing area)
+ */
+struct blkid_area {
+	blkid_loff_t		off;
+	blkid_loff_t		len;
+};
+
 /*
  * Low-level probing control struct
  */
@@ -203,7 +215,14 @@ struct blkid_struct_probe
 	blkid_loff_t		wipe_size;	/* size of the wiped area */
 	struct blkid_chain	*wipe_chain;	/* superblock, partition, ... */
 
-	struct list_head	buffers;	/* list of buffers */
+	struct list_head	buffers;	/* list of buffers sorted by offset */
+	struct list_head	merged;		/* buffers replaced by merged buffers */
+	struct blkid_bufinfo	*lastbuf;	/* the last used buffer */
+	blkid_loff_t		readahead;	/* read-ahead block size or 0 */
+
+	uint64_t		buf_hits;	/* requests satisfied from buffers */
+	uint64_t		buf_misses;	/* requests which required read() */
+	uint64_t		buf_bytes;	/* bytes read from the device */
 
 	struct blkid_chain	chains[BLKID_NCHAINS];	/* array of chains */
 	struct blkid_chain	*cur_chain;		/* current chain */
@@ -245,6 +264,7 @@ struct blkid_config {
 	int nevals;			/* number of elems in eval array */
 	int uevent;			/* SEND_UEVENT=<yes|not> option */
 	char *cachefile;		/* CACHE_FILE=<path> option */
+	int bincache;			/* CACHE_FORMAT=<text|binary> option */
 };
 
 extern struct blkid_config *blkid_read_config(const char *filename)
@@ -265,6 +285,19 @@ extern void blkid_free_config(struct blkid_config *conf);
  */
 #define BLKID_PROBE_INTERVAL	200
 
+/*
+ * Result of the low-level probing by blkid_probe_all_parallel(), used by
+ * blkid_verify() instead of reading the device.
+ */
+struct blkid_preprobe
+{
+	dev_t			devno;		/* device number */
+	int			done;		/* boolean, result is valid */
+	int			rc;		/* blkid_do_safeprobe() result */
+	int			nvals;		/* number of values */
+	struct blkid_prval	*vals;		/* probing result */
+};
+
 /* This describes an entire blkid cache file and probed devices.
  * We can traverse all of the found devices via bic_list.
  * We can traverse all of the tag types by bic_tags, which hold empty tags
@@ -280,10 +313,88 @@ struct blkid_struct_cache
 	unsigned int		bic_flags;	/* Status flags of the cache */
 	char			*bic_filename;	/* filename of cache */
 	blkid_probe		probe;		/* low-level probing stuff */
+
+	struct blkid_preprobe	*bic_preprobe;	/* parallel probing results */
+	size_t			bic_npreprobe;	/* sorted by devno */
+
+	void			*bic_map;	/* mmap()-ed binary cache file */
+	size_t			bic_mapsz;
+	unsigned char		*bic_maploaded;	/* map entries already in bic_devs */
 };
 
 #define BLKID_BIC_FL_PROBED	0x0002	/* We probed /proc/partition devices */
 #define BLKID_BIC_FL_CHANGED	0x0004	/* Cache has changed from disk */
+#define BLKID_BIC_FL_BINARY	0x0008	/* Write the cache in the binary format */
+
+/*
+ * Binary cache file format. The file is mmap()-ed read-only and devices are
+ * moved to the in-memory cache only when they are looked up (by name, devno or
+ * tag) or when all devices are necessary (probing, iteration, cache update).
+ *
+ *	header
+ *	struct blkid_bincache_dev  devs[ndevs]
+ *	struct blkid_bincache_tag  tags[ntags]
+ *	uint32_t                   devno_hash[nbuckets]
+ *	uint32_t                   name_hash[nbuckets]
+ *	uint32_t                   tag_hash[nbuckets]
+ *	char                       pool[poolsz]
+ *
+ * Strings are offsets to the pool, hash buckets and chains are indexes + 1 (so
+ * 0 is the end of the chain). All numbers are in the native byte order, the
+ * file is never shared between machines.
+ */
+#define BLKID_BINCACHE_MAGIC	"\0BLKIDC\n"
+#define BLKID_BINCACHE_MAGICSZ	8
+#define BLKID_BINCACHE_ENDIAN	0x01020304
+#define BLKID_BINCACHE_VERSION	1
+
+struct blkid_bincache_header {
+	char		magic[BLKID_BINCACHE_MAGICSZ];
+	uint32_t	endian;
+	uint32_t	version;
+	uint32_t	ndevs;
+	uint32_t	ntags;
+	uint32_t	nbuckets;	/* power of 2 */
+	uint32_t	poolsz;
+};
+
+struct blkid_bincache_dev {
+	uint64_t	devno;
+	int64_t		time;
+	int64_t		utime;
+	int32_t		pri;
+	uint32_t	name;
+	uint32_t	tags;		/* the first tag */
+	uint32_t	ntags;
+	uint32_t	next_devno;	/* devno_hash chain */
+	uint32_t	next_name;	/* name_hash chain */
+};
+
+struct blkid_bincache_tag {
+	uint32_t	name;
+	uint32_t	value;
+	uint32_t	dev;
+	uint32_t	next;		/* tag_hash chain */
+};
+
+static inline uint32_t blkid_bincache_strhash(uint32_t h, const char *str)
+{
+	/* FNV-1a */
+	for (; *str; str++)
+		h = (h ^ (unsigned char) *str) * 16777619U;
+	return h;
+}
+
+static inline uint32_t blkid_bincache_taghash(const char *name, const char *value)
+{
+	return blkid_bincache_strhash(
+			blkid_bincache_strhash(2166136261U, name) * 16777619U, value);
+}
+
+static inline uint32_t blkid_bincache_devnohash(uint64_t devno)
+{
+	return (uint32_t) ((devno ^ (devno >> 29)) * 0x9e3779b97f4a7c15ULL >> 32);
+}
 
 /* config file */
 #define BLKID_CONFIG_FILE	"/etc/blkid.conf"
@@ -349,12 +460,34 @@ extern void blkid__scan_dir(char *, dev_t, struct dir_list **, char **)
 extern int blkid_driver_has_major(const char *drvname, int major)
 			__attribute__((warn_unused_result));
 
+/* devname.c */
+extern struct blkid_preprobe *blkid_cache_get_preprobe(blkid_cache cache,
+							dev_t devno)
+			__attribute__((nonnull));
+
+/* verify.c */
+extern int blkid_verify_probe(blkid_probe pr, int fd)
+			__attribute__((nonnull));
+extern int blkid_dev_is_fresh(blkid_dev dev, struct stat *st, time_t now)
+			__attribute__((nonnull));
+
 /* lseek.c */
 extern blkid_loff_t blkid_llseek(int fd, blkid_loff_t offset, int whence);
 
 /* read.c */
 extern void blkid_read_cache(blkid_cache cache)
 			__attribute__((nonnull));
+extern void blkid_read_cache_all(blkid_cache cache)
+			__attribute__((nonnull));
+extern blkid_dev blkid_read_cache_devname(blkid_cache cache, const char *devname)
+			__attribute__((nonnull));
+extern void blkid_read_cache_devno(blkid_cache cache, dev_t devno)
+			__attribute__((nonnull));
+extern void blkid_read_cache_tag(blkid_cache cache, const char *type,
+			const char *value)
+			__attribute__((nonnull));
+extern void blkid_unmap_cache(blkid_cache cache)
+			__attribute__((nonnull));
 
 /* save.c */
 extern int blkid_flush_cache(blkid_cache cache)
@@ -403,6 +536,12 @@ extern unsigned char *blkid_probe_get_sector(blkid_probe pr, unsigned int sector
 			__attribute__((nonnull))
 			__attribute__((warn_unused_result));
 
+extern int blkid_probe_add_buffer(blkid_probe pr, blkid_loff_t off,
+				  blkid_loff_t len, const unsigned char *data)
+			__attribute__((nonnull));
+extern void blkid_probe_free_merged(blkid_probe pr)
+			__attribute__((nonnull));
+
 extern int blkid_probe_get_dimension(blkid_probe pr,
 	                blkid_loff_t *off, blkid_loff_t *size)
 			__attribute__((nonnull));
@@ -534,6 +673,11 @@ extern void blkid_probe_use_wiper(blkid_probe pr, blkid_loff_t off, blkid_loff_t
 #define blkid_bmp_nbytes(max_items) \
 		(blkid_bmp_nwords(max_items) * sizeof(unsigned long))
 
+/* superblocks/superblocks.c */
+extern int blkid_superblocks_get_magics_areas(blkid_probe pr,
+					      struct blkid_area **areas)
+			__attribute__((nonnull));
+
 /* encode.c */
 extern size_t blkid_encode_to_utf8(int enc, unsigned char *dest, size_t len,
 				const unsigned char *src, size_t count)
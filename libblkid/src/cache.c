@@ -92,6 +92,7 @@ char *blkid_get_cache_filename(struct blkid_config *conf)
  */
 int blkid_get_cache(blkid_cache *ret_cache, const char *filename)
 {
+	struct blkid_config *conf;
 	blkid_cache cache;
 
 	if (!ret_cache)
@@ -110,10 +111,15 @@ int blkid_get_cache(blkid_cache *ret_cache, const char *filename)
 
 	if (filename && !*filename)
 		filename = NULL;
+
+	conf = blkid_read_config(NULL);
 	if (filename)
 		cache->bic_filename = strdup(filename);
 	else
-		cache->bic_filename = blkid_get_cache_filename(NULL);
+		cache->bic_filename = blkid_get_cache_filename(conf);
+	if (conf && conf->bincache)
+		cache->bic_flags |= BLKID_BIC_FL_BINARY;
+	blkid_free_config(conf);
 
 	blkid_read_cache(cache);
 	*ret_cache = cache;
@@ -162,6 +168,7 @@ void blkid_put_cache(blkid_cache cache)
 	}
 
 	blkid_free_probe(cache->probe);
+	blkid_unmap_cache(cache);
 
 	free(cache->bic_filename);
 	free(cache);
@@ -181,6 +188,8 @@ void blkid_gc_cache(blkid_cache cache)
 	if (!cache)
 		return;
 
+	blkid_read_cache_all(cache);
+
 	list_for_each_safe(p, pnext, &cache->bic_devs) {
 		blkid_dev dev = list_entry(p, struct blkid_struct_dev, bid_devs);
 		if (stat(dev->bid_name, &st) < 0) {
@@ -97,6 +97,17 @@ static int parse_next(FILE *fd, struct blkid_config *conf)
 		s += 11;
 		if (*s)
 			conf->cachefile = strdup(s);
+	} else if (!strncmp(s, "CACHE_FORMAT=", 13)) {
+		s += 13;
+		if (!strcmp(s, "text"))
+			conf->bincache = FALSE;
+		else if (!strcmp(s, "binary"))
+			conf->bincache = TRUE;
+		else {
+			DBG(CONFIG, ul_debug(
+				"config file: unknown cache format '%s'.", s));
+			return -1;
+		}
 	} else if (!strncmp(s, "EVALUATE=", 9)) {
 		s += 9;
 		if (*s && parse_evaluate(conf, s) == -1)
@@ -191,6 +202,7 @@ int main(int argc, char *argv[])
 
 	printf("SEND UEVENT: %s\n", conf->uevent ? "TRUE" : "FALSE");
 	printf("CACHE_FILE:  %s\n", conf->cachefile);
+	printf("CACHE_FORMAT: %s\n", conf->bincache ? "binary" : "text");
 
 	blkid_free_config(conf);
 	return EXIT_SUCCESS;
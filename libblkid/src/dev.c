@@ -131,6 +131,9 @@ blkid_dev_iterate blkid_dev_iterate_begin(blkid_cache cache)
 		return NULL;
 	}
 
+	/* the iterator walks the in-memory list */
+	blkid_read_cache_all(cache);
+
 	iter = malloc(sizeof(struct blkid_struct_dev_iterate));
 	if (iter) {
 		iter->magic = DEV_ITERATE_MAGIC;
@@ -33,6 +33,9 @@
 #include <errno.h>
 #endif
 #include <time.h>
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
 
 #include "blkidP.h"
 
@@ -65,6 +68,9 @@ blkid_dev blkid_get_dev(blkid_cache cache, const char *devname, int flags)
 		break;
 	}
 
+	if (!dev)
+		dev = blkid_read_cache_devname(cache, devname);
+
 	if (!dev && (flags & BLKID_DEV_CREATE)) {
 		if (access(devname, F_OK) < 0)
 			return NULL;
@@ -89,6 +95,9 @@ blkid_dev blkid_get_dev(blkid_cache cache, const char *devname, int flags)
 		 * not be verified, then it's stale and so we remove
 		 * it.
 		 */
+		if (dev->bid_type)
+			blkid_read_cache_tag(cache, "TYPE", dev->bid_type);
+
 		list_for_each_safe(p, pnext, &cache->bic_devs) {
 			blkid_dev dev2 = list_entry(p, struct blkid_struct_dev, bid_devs);
 			if (dev2->bid_flags & BLKID_BID_FL_VERIFIED)
@@ -162,6 +171,7 @@ static void probe_one(blkid_cache cache, const char *ptname,
 	char *devname = NULL;
 
 	/* See if we already have this device number in the cache. */
+	blkid_read_cache_devno(cache, devno);
 	list_for_each_safe(p, pnext, &cache->bic_devs) {
 		blkid_dev tmp = list_entry(p, struct blkid_struct_dev,
 					   bid_devs);
@@ -412,10 +422,401 @@ ubi_probe_all(blkid_cache cache, int only_if_new)
 	}
 }
 
+/*
+ * Returns result of the parallel probing for @devno or NULL.
+ */
+struct blkid_preprobe *blkid_cache_get_preprobe(blkid_cache cache, dev_t devno)
+{
+	size_t lo = 0, hi = cache->bic_npreprobe;
+
+	while (lo < hi) {
+		size_t i = (lo + hi) / 2;
+		struct blkid_preprobe *pp = &cache->bic_preprobe[i];
+
+		if (pp->devno == devno)
+			return pp->done ? pp : NULL;
+		if (pp->devno < devno)
+			lo = i + 1;
+		else
+			hi = i;
+	}
+	return NULL;
+}
+
+static void free_preprobe(blkid_cache cache)
+{
+	size_t i;
+
+	for (i = 0; i < cache->bic_npreprobe; i++)
+		free(cache->bic_preprobe[i].vals);
+	free(cache->bic_preprobe);
+	cache->bic_preprobe = NULL;
+	cache->bic_npreprobe = 0;
+}
+
+#ifdef HAVE_LIBPTHREAD
+/*
+ * Parallel probing
+ *
+ * The devices from /proc/partitions are low-level probed by a pool of threads
+ * before the usual probe_all() loop. The results are stored in the cache and
+ * blkid_verify() uses them instead of reading the device, so the cache
+ * content is exactly the same as for the serial probing. All partitions on
+ * the same whole-disk are probed by one thread.
+ */
+struct preprobe_job {
+	dev_t			devno;
+	dev_t			disk;		/* whole-disk devno */
+	char			ptname[128 + 1];
+	struct blkid_preprobe	*res;
+};
+
+struct preprobe_pool {
+	pthread_mutex_t		lock;
+	struct preprobe_job	*jobs;		/* sorted by whole-disk */
+	size_t			njobs;
+	size_t			next;		/* the first unprocessed job */
+};
+
+/*
+ * The same as the device name lookup in probe_one(), but without cache.
+ */
+static char *preprobe_devname(const char *ptname, dev_t devno)
+{
+	struct stat st;
+	char device[256];
+
+	if (!strncmp(ptname, "dm-", 3) && isdigit(ptname[3])) {
+		char *devname = canonicalize_dm_name(ptname);
+		if (devname)
+			return devname;
+	}
+
+	snprintf(device, sizeof(device), "/dev/%s", ptname);
+	if (stat(device, &st) == 0 && S_ISBLK(st.st_mode) && st.st_rdev == devno)
+		return strdup(device);
+
+	return blkid_devno_to_devname(devno);
+}
+
+static void preprobe_device(blkid_probe pr, struct preprobe_job *job)
+{
+	struct blkid_preprobe *res = job->res;
+	char *devname;
+	int fd, n;
+
+	devname = preprobe_devname(job->ptname, res->devno);
+	if (!devname)
+		return;
+
+	fd = open(devname, O_RDONLY|O_CLOEXEC);
+	free(devname);
+	if (fd < 0)
+		return;
+
+	res->rc = blkid_verify_probe(pr, fd);
+	res->nvals = 0;
+
+	if (res->rc == 0 && (n = blkid_probe_numof_values(pr)) > 0) {
+		res->vals = calloc(n, sizeof(struct blkid_prval));
+		if (!res->vals)
+			goto done;
+		memcpy(res->vals, __blkid_probe_get_value(pr, 0),
+				n * sizeof(struct blkid_prval));
+		while (res->nvals < n)
+			res->vals[res->nvals++].chain = NULL;
+	}
+	res->done = 1;
+done:
+	blkid_reset_probe(pr);
+	blkid_probe_reset_superblocks_filter(pr);
+	close(fd);
+}
+
+static void *preprobe_worker(void *data)
+{
+	struct preprobe_pool *pool = (struct preprobe_pool *) data;
+	blkid_probe pr;
+
+	/* one probe for all devices probed by the thread */
+	pr = blkid_new_probe();
+	if (!pr)
+		return NULL;
+
+	while (1) {
+		size_t i, end;
+
+		/* get all jobs for the next whole-disk */
+		pthread_mutex_lock(&pool->lock);
+		i = end = pool->next;
+		while (end < pool->njobs &&
+		       pool->jobs[end].disk == pool->jobs[i].disk)
+			end++;
+		pool->next = end;
+		pthread_mutex_unlock(&pool->lock);
+
+		if (i == end)
+			break;
+		for ( ; i < end; i++)
+			preprobe_device(pr, &pool->jobs[i]);
+	}
+
+	blkid_free_probe(pr);
+	return NULL;
+}
+
+static int cmp_preprobe_jobs(const void *a, const void *b)
+{
+	const struct preprobe_job *x = (const struct preprobe_job *) a,
+				  *y = (const struct preprobe_job *) b;
+
+	if (x->disk != y->disk)
+		return x->disk < y->disk ? -1 : 1;
+	return x->res->devno < y->res->devno ? -1 : x->res->devno > y->res->devno;
+}
+
+static int cmp_preprobe_results(const void *a, const void *b)
+{
+	const struct blkid_preprobe *x = (const struct blkid_preprobe *) a,
+				    *y = (const struct blkid_preprobe *) b;
+
+	return x->devno < y->devno ? -1 : x->devno > y->devno;
+}
+
+static int cmp_devs_by_devno(const void *a, const void *b)
+{
+	const blkid_dev x = *(const blkid_dev *) a,
+			y = *(const blkid_dev *) b;
+
+	return x->bid_devno < y->bid_devno ? -1 : x->bid_devno > y->bid_devno;
+}
+
+/*
+ * Returns the cached devices sorted by devno.
+ */
+static blkid_dev *preprobe_sorted_devs(blkid_cache cache, size_t *ndevs)
+{
+	struct list_head *p;
+	blkid_dev *devs;
+	size_t n = 0;
+
+	list_for_each(p, &cache->bic_devs)
+		n++;
+
+	*ndevs = n;
+	devs = malloc((n ? n : 1) * sizeof(blkid_dev));
+	if (!devs)
+		return NULL;
+
+	n = 0;
+	list_for_each(p, &cache->bic_devs)
+		devs[n++] = list_entry(p, struct blkid_struct_dev, bid_devs);
+
+	qsort(devs, n, sizeof(blkid_dev), cmp_devs_by_devno);
+	return devs;
+}
+
+/*
+ * Returns 1 if probe_one() does not need to read the device, @devs is the
+ * cache sorted by preprobe_sorted_devs().
+ */
+static int preprobe_is_cached(blkid_dev *devs, size_t ndevs, dev_t devno,
+			      int only_if_new, time_t now)
+{
+	size_t lo = 0, hi = ndevs;
+
+	/* the first device with the devno */
+	while (lo < hi) {
+		size_t i = (lo + hi) / 2;
+
+		if (devs[i]->bid_devno < devno)
+			lo = i + 1;
+		else
+			hi = i;
+	}
+
+	for ( ; lo < ndevs && devs[lo]->bid_devno == devno; lo++) {
+		blkid_dev dev = devs[lo];
+		struct stat st;
+
+		if (only_if_new && !access(dev->bid_name, F_OK))
+			return 1;
+		if (stat(dev->bid_name, &st) == 0 &&
+		    blkid_dev_is_fresh(dev, &st, now))
+			return 1;
+	}
+	return 0;
+}
+
+static int preprobe_add_job(struct preprobe_job **jobs, size_t *njobs,
+			    const char *ptname, dev_t devno)
+{
+	struct preprobe_job *job;
+
+	if (*njobs % 64 == 0) {
+		struct preprobe_job *tmp = realloc(*jobs,
+				(*njobs + 64) * sizeof(struct preprobe_job));
+		if (!tmp)
+			return -BLKID_ERR_MEM;
+		*jobs = tmp;
+	}
+
+	job = &(*jobs)[(*njobs)++];
+	memset(job, 0, sizeof(*job));
+	strcpy(job->ptname, ptname);
+	job->devno = devno;
+	return 0;
+}
+
+/*
+ * Reads /proc/partitions and probes all the devices (with the same
+ * whole-disk vs. partitions heuristic as probe_all()) by @nthreads threads.
+ */
+static int preprobe_all(blkid_cache cache, int only_if_new, int nthreads)
+{
+	struct preprobe_pool pool;
+	struct preprobe_job *jobs = NULL, *job;
+	struct blkid_preprobe *res = NULL;
+	blkid_dev *devs = NULL;
+	pthread_t *threads = NULL;
+	size_t i, n, ndevs, njobs = 0, ndisks = 0;
+	char line[1024], ptname[128 + 1], disk[128 + 1] = "";
+	time_t now = time(0);
+	FILE *proc;
+	int ma, mi, rc = 0;
+	dev_t devno, diskno = 0;
+	unsigned long long sz;
+
+	proc = fopen(PROC_PARTITIONS, "r" UL_CLOEXECSTR);
+	if (!proc)
+		return -BLKID_ERR_PROC;
+
+	while (fgets(line, sizeof(line), proc)) {
+		size_t len;
+
+		if (sscanf(line, " %d %d %llu %128[^\n ]",
+			   &ma, &mi, &sz, ptname) != 4)
+			continue;
+		devno = makedev(ma, mi);
+		len = strlen(ptname);
+
+		/* the previous whole-disk is probed only if this device is not
+		 * its partition */
+		if (*disk && strncmp(disk, ptname, strlen(disk)) != 0)
+			rc = preprobe_add_job(&jobs, &njobs, disk, diskno);
+		*disk = '\0';
+
+		/* extended partitions (size is 1) are not probed */
+		if (!rc && isdigit(ptname[len - 1]) && sz > 1)
+			rc = preprobe_add_job(&jobs, &njobs, ptname, devno);
+		else if (!isdigit(ptname[len - 1])) {
+			memcpy(disk, ptname, len + 1);
+			diskno = devno;
+		}
+		if (rc)
+			goto done;
+	}
+	if (*disk && (rc = preprobe_add_job(&jobs, &njobs, disk, diskno)))
+		goto done;
+
+	if (!njobs)
+		goto done;
+
+	for (i = 0; i < njobs; i++)
+		blkid_read_cache_devno(cache, jobs[i].devno);
+
+	devs = preprobe_sorted_devs(cache, &ndevs);
+	if (!devs) {
+		rc = -BLKID_ERR_MEM;
+		goto done;
+	}
+
+	res = calloc(njobs, sizeof(struct blkid_preprobe));
+	if (!res) {
+		rc = -BLKID_ERR_MEM;
+		goto done;
+	}
+
+	/* remove already cached devices, assign whole-disks */
+	for (n = 0, i = 0; i < njobs; i++) {
+		dev_t whole = 0;
+
+		devno = jobs[i].devno;
+		if (preprobe_is_cached(devs, ndevs, devno, only_if_new, now))
+			continue;
+		if (sysfs_devno_to_wholedisk(devno, NULL, 0, &whole) || !whole)
+			whole = devno;
+
+		job = &jobs[n];
+		if (n != i)
+			memcpy(job, &jobs[i], sizeof(*job));
+		job->disk = whole;
+		job->res = &res[n];
+		job->res->devno = devno;
+		n++;
+	}
+	njobs = n;
+
+	if (!njobs)
+		goto done;
+
+	qsort(jobs, njobs, sizeof(struct preprobe_job), cmp_preprobe_jobs);
+
+	for (i = 0; i < njobs; i++) {
+		if (i == 0 || jobs[i].disk != jobs[i - 1].disk)
+			ndisks++;
+	}
+	if ((size_t) nthreads > ndisks)
+		nthreads = ndisks;
+
+	DBG(PROBE, ul_debug("parallel probing: %zu devices, %zu whole-disks, "
+				"%d threads", njobs, ndisks, nthreads));
+
+	threads = calloc(nthreads, sizeof(pthread_t));
+	if (!threads) {
+		rc = -BLKID_ERR_MEM;
+		goto done;
+	}
+
+	/* initialize global stuff before threads */
+	blkid_init_debug(0);
+
+	memset(&pool, 0, sizeof(pool));
+	pthread_mutex_init(&pool.lock, NULL);
+	pool.jobs = jobs;
+	pool.njobs = njobs;
+
+	for (i = 0; i < (size_t) nthreads; i++) {
+		if (pthread_create(&threads[i], NULL, preprobe_worker, &pool))
+			break;
+	}
+	if (i == 0)
+		preprobe_worker(&pool);	/* no thread, do it ourself */
+	nthreads = i;
+	for (i = 0; i < (size_t) nthreads; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_mutex_destroy(&pool.lock);
+
+	/* results are stored to the cache, sorted by devno */
+	qsort(res, njobs, sizeof(struct blkid_preprobe), cmp_preprobe_results);
+	cache->bic_preprobe = res;
+	cache->bic_npreprobe = njobs;
+	res = NULL;
+done:
+	fclose(proc);
+	free(threads);
+	free(devs);
+	free(jobs);
+	free(res);
+	return rc;
+}
+#endif /* HAVE_LIBPTHREAD */
+
 /*
  * Read the device data for all available block devices in the system.
  */
-static int probe_all(blkid_cache cache, int only_if_new)
+static int probe_all(blkid_cache cache, int only_if_new, int nthreads)
 {
 	FILE *proc;
 	char line[1024];
@@ -439,6 +840,12 @@ static int probe_all(blkid_cache cache, int only_if_new)
 		return 0;
 
 	blkid_read_cache(cache);
+#ifdef HAVE_LIBPTHREAD
+	if (nthreads > 1)
+		preprobe_all(cache, only_if_new, nthreads);
+#else
+	(void) nthreads;
+#endif
 	evms_probe_all(cache, only_if_new);
 #ifdef VG_DIR
 	lvm_probe_all(cache, only_if_new);
@@ -446,8 +853,10 @@ static int probe_all(blkid_cache cache, int only_if_new)
 	ubi_probe_all(cache, only_if_new);
 
 	proc = fopen(PROC_PARTITIONS, "r" UL_CLOEXECSTR);
-	if (!proc)
+	if (!proc) {
+		free_preprobe(cache);
 		return -BLKID_ERR_PROC;
+	}
 
 	while (fgets(line, sizeof(line), proc)) {
 		last = which;
@@ -492,6 +901,7 @@ static int probe_all(blkid_cache cache, int only_if_new)
 		 * it exists.
 		 */
 		if (lens[last] && !strncmp(ptnames[last], ptname, lens[last])) {
+			blkid_read_cache_devno(cache, devs[last]);
 			list_for_each_safe(p, pnext, &cache->bic_devs) {
 				blkid_dev tmp;
 
@@ -527,6 +937,7 @@ static int probe_all(blkid_cache cache, int only_if_new)
 		probe_one(cache, ptname, devs[which], 0, only_if_new, 0);
 
 	fclose(proc);
+	free_preprobe(cache);
 	blkid_flush_cache(cache);
 	return 0;
 }
@@ -591,7 +1002,7 @@ int blkid_probe_all(blkid_cache cache)
 	int ret;
 
 	DBG(PROBE, ul_debug("Begin blkid_probe_all()"));
-	ret = probe_all(cache, 0);
+	ret = probe_all(cache, 0, 1);
 	if (ret == 0) {
 		cache->bic_time = time(0);
 		cache->bic_flags |= BLKID_BIC_FL_PROBED;
@@ -600,6 +1011,35 @@ int blkid_probe_all(blkid_cache cache)
 	return ret;
 }
 
+/**
+ * blkid_probe_all_parallel:
+ * @cache: cache handler
+ * @njobs: maximal number of parallel probing threads
+ *
+ * Probes all block devices like blkid_probe_all(), but the devices are read
+ * by a pool of @njobs threads. Partitions on the same whole-disk are never
+ * read in parallel. The content of the @cache is the same as after
+ * blkid_probe_all().
+ *
+ * If the library has been compiled without threads support or @njobs is
+ * less than 2 then this function is the same as blkid_probe_all().
+ *
+ * Returns: 0 on success, or number less than zero in case of error.
+ */
+int blkid_probe_all_parallel(blkid_cache cache, int njobs)
+{
+	int ret;
+
+	DBG(PROBE, ul_debug("Begin blkid_probe_all_parallel() [jobs=%d]", njobs));
+	ret = probe_all(cache, 0, njobs);
+	if (ret == 0) {
+		cache->bic_time = time(0);
+		cache->bic_flags |= BLKID_BIC_FL_PROBED;
+	}
+	DBG(PROBE, ul_debug("End blkid_probe_all_parallel() [rc=%d]", ret));
+	return ret;
+}
+
 /**
  * blkid_probe_all_new:
  * @cache: cache handler
@@ -613,7 +1053,7 @@ int blkid_probe_all_new(blkid_cache cache)
 	int ret;
 
 	DBG(PROBE, ul_debug("Begin blkid_probe_all_new()"));
-	ret = probe_all(cache, 1);
+	ret = probe_all(cache, 1, 1);
 	DBG(PROBE, ul_debug("End blkid_probe_all_new() [rc=%d]", ret));
 	return ret;
 }
@@ -611,6 +611,7 @@ static int partitions_probe(blkid_probe pr, struct blkid_chain *chn)
 
 		/* apply checks from idinfo */
 		rc = idinfo_probe(pr, idinfos[i], chn);
+		blkid_probe_free_merged(pr);
 		if (rc < 0)
 			break;
 		if (rc != BLKID_PROBE_OK)
@@ -0,0 +1,560 @@
+/*
+ * prefetch.c - read areas with magic strings for more devices at once
+ *
+ * The probing functions read the device by synchronous read() calls, so the
+ * time necessary to probe more devices is the sum of the devices latencies.
+ * The blkid_probe_prefetch() submits all reads for all the devices at once
+ * by asynchronous I/O and the probing functions then use the data from the
+ * probing buffers.
+ *
+ * The I/O backends (in order of preference):
+ *
+ *	io_uring	- Linux >= 5.6 (IORING_OP_READ)
+ *	aio		- Linux AIO, the devices are reopened with O_DIRECT
+ *	threads		- pread() from a few threads
+ *	sync		- pread() only
+ *
+ * The requests which are not possible to read by the backend (for example
+ * misaligned O_DIRECT requests or unsupported io_uring operation) are passed
+ * to the next backend. The backend is possible to select by
+ * LIBBLKID_PREFETCH=<name> environment variable ("none" disables the
+ * prefetching at all).
+ *
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdint.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#ifdef HAVE_LINUX_IO_URING_H
+# include <linux/io_uring.h>
+#endif
+#ifdef HAVE_LINUX_AIO_ABI_H
+# include <linux/aio_abi.h>
+#endif
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
+
+#include "blkidP.h"
+#include "env.h"
+
+#if defined(HAVE_LINUX_IO_URING_H) && defined(SYS_io_uring_setup) && \
+    defined(SYS_io_uring_enter) && defined(IORING_FEAT_SINGLE_MMAP)
+# define PREFETCH_URING 1
+#endif
+
+#if defined(HAVE_LINUX_AIO_ABI_H) && defined(SYS_io_setup) && \
+    defined(SYS_io_submit) && defined(SYS_io_getevents) && defined(O_DIRECT)
+# define PREFETCH_AIO 1
+#endif
+
+/* max number of requests in the kernel at the same time */
+#define PREFETCH_MAXQUEUE	256
+
+/* max number of the threads for "threads" backend */
+#define PREFETCH_MAXTHREADS	16
+
+/* alignment of the buffers (O_DIRECT) */
+#define PREFETCH_ALIGN		4096
+
+/* request not read yet, or not possible to read by the backend */
+#define PREFETCH_PENDING	(-EAGAIN)
+
+struct prefetch_req {
+	blkid_probe	pr;
+	blkid_loff_t	off;		/* relative to the probing area */
+	blkid_loff_t	len;
+	unsigned char	*buf;
+	ssize_t		res;		/* number of bytes or -errno */
+};
+
+struct prefetch_backend {
+	const char	*name;
+	int		(*read)(struct prefetch_req *reqs, size_t nreqs);
+};
+
+static void prefetch_pread(struct prefetch_req *req)
+{
+	ssize_t ret;
+
+	if (req->res != PREFETCH_PENDING)
+		return;
+
+	ret = pread(req->pr->fd, req->buf, req->len, req->pr->off + req->off);
+	req->res = ret < 0 ? -errno : ret;
+}
+
+#ifdef PREFETCH_URING
+/*
+ * io_uring by raw syscalls, we don't want to depend on liburing.
+ */
+static int prefetch_read_uring(struct prefetch_req *reqs, size_t nreqs)
+{
+	struct io_uring_params p;
+	struct io_uring_sqe *sqes = MAP_FAILED;
+	struct io_uring_cqe *cqes;
+	unsigned char *sq = MAP_FAILED, *cq = MAP_FAILED;
+	unsigned *sq_tail, *sq_mask, *sq_array, *cq_head, *cq_tail, *cq_mask;
+	size_t sq_sz, cq_sz, i = 0, inflight = 0, queued = 0;
+	int fd, rc = -1, failed = 0;
+
+	memset(&p, 0, sizeof(p));
+	fd = syscall(SYS_io_uring_setup,
+			nreqs < PREFETCH_MAXQUEUE ? nreqs : PREFETCH_MAXQUEUE, &p);
+	if (fd < 0) {
+		DBG(LOWPROBE, ul_debug("prefetch: io_uring setup failed: %m"));
+		return -1;
+	}
+
+	sq_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	cq_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+
+	if (!(p.features & IORING_FEAT_SINGLE_MMAP))
+		goto done;			/* Linux < 5.4, ignore */
+	sq_sz = cq_sz = max(sq_sz, cq_sz);
+
+	sq = mmap(NULL, sq_sz, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (sq == MAP_FAILED)
+		goto done;
+	cq = sq;
+	sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe),
+			PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			fd, IORING_OFF_SQES);
+	if (sqes == MAP_FAILED)
+		goto done;
+
+	sq_tail  = (unsigned *) (sq + p.sq_off.tail);
+	sq_mask  = (unsigned *) (sq + p.sq_off.ring_mask);
+	sq_array = (unsigned *) (sq + p.sq_off.array);
+	cq_head  = (unsigned *) (cq + p.cq_off.head);
+	cq_tail  = (unsigned *) (cq + p.cq_off.tail);
+	cq_mask  = (unsigned *) (cq + p.cq_off.ring_mask);
+	cqes     = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+
+	rc = 0;
+	while (inflight || (!failed && (i < nreqs || queued))) {
+		unsigned tail = *sq_tail, head;
+		int ret;
+
+		/* fill submission queue */
+		while (!failed && i < nreqs && inflight + queued < p.sq_entries) {
+			struct prefetch_req *req = &reqs[i++];
+			struct io_uring_sqe *sqe;
+
+			if (req->res != PREFETCH_PENDING)
+				continue;
+
+			sqe = &sqes[tail & *sq_mask];
+			memset(sqe, 0, sizeof(*sqe));
+			sqe->opcode = IORING_OP_READ;
+			sqe->fd = req->pr->fd;
+			sqe->off = req->pr->off + req->off;
+			sqe->addr = (uintptr_t) req->buf;
+			sqe->len = req->len;
+			sqe->user_data = (uintptr_t) req;
+
+			sq_array[tail & *sq_mask] = tail & *sq_mask;
+			tail++;
+			queued++;
+		}
+		__atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+		if (!queued && !inflight)
+			break;
+
+		ret = syscall(SYS_io_uring_enter, fd, failed ? 0 : queued, 1,
+				IORING_ENTER_GETEVENTS, NULL, 0);
+		if (ret < 0) {
+			if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+				continue;
+			if (!failed)
+				DBG(LOWPROBE, ul_debug("prefetch: io_uring enter failed: %m"));
+
+			/* The not submitted requests stay pending for the next
+			 * backend. The kernel still reads to the buffers of the
+			 * submitted requests, so wait for them, the completions
+			 * are posted to the ring anyway. */
+			failed = 1;
+			if (!inflight)
+				break;
+			xusleep(1000);
+		} else if (!failed) {
+			queued -= ret;
+			inflight += ret;
+		}
+
+		/* reap completions */
+		head = *cq_head;
+		while (head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+			struct io_uring_cqe *cqe = &cqes[head & *cq_mask];
+			struct prefetch_req *req =
+				(struct prefetch_req *) (uintptr_t) cqe->user_data;
+
+			/* unsupported operation, try the next backend */
+			req->res = cqe->res == -EINVAL ? PREFETCH_PENDING : cqe->res;
+			head++;
+			inflight--;
+		}
+		__atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+	}
+done:
+	if (sqes != MAP_FAILED)
+		munmap(sqes, p.sq_entries * sizeof(struct io_uring_sqe));
+	if (sq != MAP_FAILED)
+		munmap(sq, sq_sz);
+	close(fd);
+	return rc;
+}
+#endif /* PREFETCH_URING */
+
+#ifdef PREFETCH_AIO
+/*
+ * Reopens the device with O_DIRECT, the Linux AIO is synchronous for
+ * buffered I/O. Returns the original descriptor on error.
+ */
+static int reopen_direct(blkid_probe pr)
+{
+	char path[sizeof("/proc/self/fd/") + sizeof(stringify_value(INT_MAX))];
+	int fd;
+
+	snprintf(path, sizeof(path), "/proc/self/fd/%d", pr->fd);
+	fd = open(path, O_RDONLY | O_DIRECT | O_CLOEXEC);
+
+	return fd < 0 ? pr->fd : fd;
+}
+
+static int prefetch_read_aio(struct prefetch_req *reqs, size_t nreqs)
+{
+	aio_context_t ctx = 0;
+	struct iocb *iocbs = NULL, **ptrs = NULL;
+	struct io_event *events = NULL;
+	blkid_probe last = NULL;
+	size_t i, n = 0, done = 0;
+	unsigned nr = nreqs < PREFETCH_MAXQUEUE ? nreqs : PREFETCH_MAXQUEUE;
+	int fd = -1, rc = -1;
+
+	if (syscall(SYS_io_setup, nr, &ctx) < 0) {
+		DBG(LOWPROBE, ul_debug("prefetch: aio setup failed: %m"));
+		return -1;
+	}
+
+	iocbs = calloc(nreqs, sizeof(struct iocb));
+	ptrs = calloc(nreqs, sizeof(struct iocb *));
+	events = calloc(nr, sizeof(struct io_event));
+	if (!iocbs || !ptrs || !events)
+		goto done;
+
+	/* the requests are sorted by probers, the descriptors are shared */
+	for (i = 0; i < nreqs; i++) {
+		struct prefetch_req *req = &reqs[i];
+		struct iocb *cb;
+
+		if (req->res != PREFETCH_PENDING)
+			continue;
+		if (req->pr != last) {
+			last = req->pr;
+			fd = reopen_direct(last);
+		}
+		cb = &iocbs[n];
+		cb->aio_data = (uintptr_t) req;
+		cb->aio_lio_opcode = IOCB_CMD_PREAD;
+		cb->aio_fildes = fd;
+		cb->aio_buf = (uintptr_t) req->buf;
+		cb->aio_nbytes = req->len;
+		cb->aio_offset = req->pr->off + req->off;
+		ptrs[n++] = cb;
+	}
+
+	rc = 0;
+	for (i = 0; done < n; ) {
+		long ret, k;
+
+		if (i < n && i - done < nr) {
+			ret = syscall(SYS_io_submit, ctx,
+					(long) min(n - i, (size_t) nr - (i - done)), &ptrs[i]);
+			if (ret <= 0) {
+				DBG(LOWPROBE, ul_debug("prefetch: aio submit failed: %m"));
+				if (i == done) {
+					/* the first request is not possible
+					 * to submit, keep it pending */
+					i++;
+					done++;
+					continue;
+				}
+			} else
+				i += ret;
+		}
+		if (i == done)
+			continue;
+
+		ret = syscall(SYS_io_getevents, ctx, 1, nr, events, NULL);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		for (k = 0; k < ret; k++) {
+			struct prefetch_req *req =
+				(struct prefetch_req *) (uintptr_t) events[k].data;
+
+			/* misaligned O_DIRECT, try the next backend */
+			req->res = events[k].res == -EINVAL ?
+					PREFETCH_PENDING : events[k].res;
+		}
+		done += ret;
+	}
+done:
+	syscall(SYS_io_destroy, ctx);
+
+	/* close the O_DIRECT descriptors */
+	for (i = 0, last = NULL; i < n; i++) {
+		struct prefetch_req *req =
+			(struct prefetch_req *) (uintptr_t) iocbs[i].aio_data;
+
+		if (req->pr != last && (int) iocbs[i].aio_fildes != req->pr->fd)
+			close(iocbs[i].aio_fildes);
+		last = req->pr;
+	}
+	free(iocbs);
+	free(ptrs);
+	free(events);
+	return rc;
+}
+#endif /* PREFETCH_AIO */
+
+#ifdef HAVE_LIBPTHREAD
+struct prefetch_threads {
+	struct prefetch_req	*reqs;
+	size_t			nreqs;
+	size_t			next;	/* next not-read request */
+};
+
+static void *prefetch_worker(void *data)
+{
+	struct prefetch_threads *th = (struct prefetch_threads *) data;
+	size_t i;
+
+	while ((i = __sync_fetch_and_add(&th->next, 1)) < th->nreqs)
+		prefetch_pread(&th->reqs[i]);
+	return NULL;
+}
+
+static int prefetch_read_threads(struct prefetch_req *reqs, size_t nreqs)
+{
+	struct prefetch_threads th = { .reqs = reqs, .nreqs = nreqs };
+	pthread_t tids[PREFETCH_MAXTHREADS];
+	size_t i, n = min(nreqs, (size_t) PREFETCH_MAXTHREADS);
+
+	for (i = 0; i < n; i++) {
+		if (pthread_create(&tids[i], NULL, prefetch_worker, &th))
+			break;
+	}
+	n = i;
+	if (!n)
+		return -1;
+
+	for (i = 0; i < n; i++)
+		pthread_join(tids[i], NULL);
+	return 0;
+}
+#endif /* HAVE_LIBPTHREAD */
+
+static int prefetch_read_sync(struct prefetch_req *reqs, size_t nreqs)
+{
+	size_t i;
+
+	for (i = 0; i < nreqs; i++)
+		prefetch_pread(&reqs[i]);
+	return 0;
+}
+
+static const struct prefetch_backend prefetch_backends[] =
+{
+#ifdef PREFETCH_URING
+	{ "io_uring",	prefetch_read_uring },
+#endif
+#ifdef PREFETCH_AIO
+	{ "aio",	prefetch_read_aio },
+#endif
+#ifdef HAVE_LIBPTHREAD
+	{ "threads",	prefetch_read_threads },
+#endif
+	{ "sync",	prefetch_read_sync }
+};
+
+/*
+ * Returns index of the first backend or -1 if the prefetching is disabled.
+ */
+static int prefetch_first_backend(void)
+{
+	char *name = safe_getenv("LIBBLKID_PREFETCH");
+	size_t i;
+
+	if (!name || !*name)
+		return 0;
+	if (strcmp(name, "none") == 0)
+		return -1;
+
+	for (i = 0; i < ARRAY_SIZE(prefetch_backends); i++) {
+		if (strcmp(name, prefetch_backends[i].name) == 0)
+			return i;
+	}
+	DBG(LOWPROBE, ul_debug("prefetch: unsupported backend '%s'", name));
+	return 0;
+}
+
+/*
+ * Adds requests for all areas with magic strings for @pr.
+ */
+static int prefetch_add_probe(blkid_probe pr, struct prefetch_req **reqs,
+			      size_t *nreqs, size_t *bufsz)
+{
+	struct blkid_area *areas = NULL;
+	struct prefetch_req *tmp;
+	int i, n;
+
+	if (!pr || pr->fd < 0 || pr->size <= 0 || pr->parent ||
+	    (pr->flags & BLKID_FL_NOSCAN_DEV))
+		return 0;
+
+	n = blkid_superblocks_get_magics_areas(pr, &areas);
+	if (n <= 0)
+		return n;
+
+	tmp = realloc(*reqs, (*nreqs + n) * sizeof(struct prefetch_req));
+	if (!tmp) {
+		free(areas);
+		return -1;
+	}
+	*reqs = tmp;
+
+	for (i = 0; i < n; i++) {
+		struct prefetch_req *req = &tmp[(*nreqs)++];
+		blkid_loff_t start = areas[i].off,
+			     end = areas[i].off + areas[i].len;
+
+		/* the same alignment as blkid_probe_get_buffer() uses */
+		if (pr->readahead > 0) {
+			start -= start % pr->readahead;
+			end += pr->readahead - 1;
+			end -= end % pr->readahead;
+			if (end > pr->size)
+				end = max(areas[i].off + areas[i].len, pr->size);
+		}
+
+		req->pr = pr;
+		req->off = start;
+		req->len = end - start;
+		req->res = PREFETCH_PENDING;
+		req->buf = NULL;
+
+		*bufsz += (req->len + PREFETCH_ALIGN - 1) & ~(PREFETCH_ALIGN - 1);
+	}
+
+	free(areas);
+	return n;
+}
+
+/**
+ * blkid_probe_prefetch:
+ * @prs: array of probes with assigned devices
+ * @nprs: number of the probes
+ *
+ * Reads all areas with superblock magic strings for all @prs at once. The
+ * reads are submitted by asynchronous I/O (io_uring, Linux AIO, or by
+ * threads if AIO is not supported) and the data are stored to the probing
+ * buffers, so the next blkid_do_probe() or blkid_do_safeprobe() calls don't
+ * have to wait for the devices. This is useful for a large number of devices
+ * with high I/O latency. The time necessary to read all the devices is the
+ * maximal rather than the sum of the devices latencies.
+ *
+ * The probes have to be already set by blkid_probe_set_device() and the
+ * superblocks chain has to be already set up (filters, etc.). The data are
+ * forgotten by the next blkid_probe_set_device() call. The probes cloned by
+ * blkid_probe_get_wholedisk_probe() are ignored.
+ *
+ * The backend is possible to select by the LIBBLKID_PREFETCH=<name>
+ * environment variable, where the name is "io_uring", "aio", "threads",
+ * "sync" or "none".
+ *
+ * Returns: number of successfully read areas, or -1 in case of error.
+ */
+int blkid_probe_prefetch(blkid_probe *prs, size_t nprs)
+{
+	struct prefetch_req *reqs = NULL;
+	unsigned char *data = NULL;
+	size_t i, nreqs = 0, bufsz = 0;
+	int b, count = 0;
+
+	if (!prs)
+		return -1;
+
+	b = prefetch_first_backend();
+	if (b < 0)
+		return 0;
+
+	for (i = 0; i < nprs; i++) {
+		if (prefetch_add_probe(prs[i], &reqs, &nreqs, &bufsz) < 0)
+			goto err;
+	}
+	if (!nreqs)
+		goto done;
+
+	if (posix_memalign((void **) &data, PREFETCH_ALIGN, bufsz))
+		goto err;
+
+	for (i = 0, bufsz = 0; i < nreqs; i++) {
+		reqs[i].buf = data + bufsz;
+		bufsz += (reqs[i].len + PREFETCH_ALIGN - 1) & ~(PREFETCH_ALIGN - 1);
+	}
+
+	for (; b < (int) ARRAY_SIZE(prefetch_backends); b++) {
+		size_t pending = 0;
+
+		DBG(LOWPROBE, ul_debug("prefetch: reading %zu area(s) by %s",
+					nreqs, prefetch_backends[b].name));
+
+		if (prefetch_backends[b].read(reqs, nreqs) != 0)
+			continue;
+		for (i = 0; i < nreqs; i++) {
+			if (reqs[i].res == PREFETCH_PENDING)
+				pending++;
+		}
+		if (!pending)
+			break;
+	}
+
+	for (i = 0; i < nreqs; i++) {
+		struct prefetch_req *req = &reqs[i];
+
+		if (req->res != req->len) {
+			DBG(LOWPROBE, ul_debug("prefetch: off=%jd len=%jd pr=%p "
+					"failed: %zd", req->off, req->len,
+					req->pr, req->res));
+			continue;
+		}
+		if (blkid_probe_add_buffer(req->pr, req->off, req->len, req->buf) == 0) {
+			req->pr->buf_bytes += req->len;
+			count++;
+		}
+	}
+done:
+	DBG(LOWPROBE, ul_debug("prefetch: %d of %zu area(s) for %zu device(s) read",
+				count, nreqs, nprs));
+	free(data);
+	free(reqs);
+	return count;
+err:
+	free(data);
+	free(reqs);
+	return -1;
+}
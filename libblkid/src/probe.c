@@ -154,6 +154,8 @@ blkid_probe blkid_new_probe(void)
 		pr->chains[i].enabled = chains_drvs[i]->dflt_enabled;
 	}
 	INIT_LIST_HEAD(&pr->buffers);
+	INIT_LIST_HEAD(&pr->merged);
+	pr->readahead = BLKID_PROBE_READAHEAD;
 	return pr;
 }
 
@@ -183,6 +185,7 @@ blkid_probe blkid_clone_probe(blkid_probe parent)
 	pr->disk_devno = parent->disk_devno;
 	pr->blkssz = parent->blkssz;
 	pr->flags = parent->flags;
+	pr->readahead = parent->readahead;
 	pr->parent = parent;
 
 	pr->flags &= ~BLKID_FL_PRIVATE_FD;
@@ -533,6 +536,164 @@ int __blkid_probe_filter_types(blkid_probe pr, int chain, int flag, char *names[
 	return 0;
 }
 
+/*
+ * Reads @len bytes from @off (relative to the begin of the probing area)
+ * to @data.
+ */
+static int read_buffer_area(blkid_probe pr, unsigned char *data,
+			    blkid_loff_t off, blkid_loff_t len)
+{
+	ssize_t ret;
+
+	if (blkid_llseek(pr->fd, pr->off + off, SEEK_SET) < 0) {
+		errno = 0;
+		return -1;
+	}
+
+	DBG(LOWPROBE, ul_debug("\tbuffer read: off=%jd len=%jd pr=%p",
+				off, len, pr));
+
+	ret = read(pr->fd, data, len);
+	if (ret != (ssize_t) len) {
+		DBG(LOWPROBE, ul_debug("\tbuffer read: return %zd error %m", ret));
+		if (ret >= 0)
+			errno = 0;
+		return -1;
+	}
+
+	pr->buf_bytes += len;
+	return 0;
+}
+
+/*
+ * Fills the gap <off, off + len) in the new buffer -- from @src (data for
+ * area which starts at @src_off) if available, otherwise from the device.
+ */
+static int fill_buffer_area(blkid_probe pr, unsigned char *data,
+			    blkid_loff_t off, blkid_loff_t len,
+			    const unsigned char *src, blkid_loff_t src_off)
+{
+	if (src) {
+		memcpy(data, src + (off - src_off), len);
+		return 0;
+	}
+	return read_buffer_area(pr, data, off, len);
+}
+
+/*
+ * Allocates a new buffer for area <start, end). The buffer is merged with
+ * all overlapping and adjacent buffers -- data already available in the
+ * buffers are copied, only the gaps are read from the device (or copied
+ * from @src if the data for the area <start, end) are already available).
+ *
+ * The merged buffer is allocated with a free space behind the data, so the
+ * next adjacent area is read to the end of the buffer and the data are not
+ * copied again (the buffer grows in place).
+ *
+ * The merged buffers are not deallocated (callers may still use pointers to
+ * the buffers), they are moved to pr->merged list and deallocated by
+ * blkid_probe_free_merged() when no prober is running.
+ */
+static struct blkid_bufinfo *read_buffer(blkid_probe pr,
+				blkid_loff_t start, blkid_loff_t end,
+				const unsigned char *src)
+{
+	struct list_head *p, *pnext, *first = NULL, *last = &pr->buffers;
+	struct blkid_bufinfo *bf;
+	blkid_loff_t cur, size, src_off = start, req_start = start;
+
+	/* find overlapping and adjacent buffers */
+	list_for_each(p, &pr->buffers) {
+		struct blkid_bufinfo *x =
+				list_entry(p, struct blkid_bufinfo, bufs);
+
+		if (x->off + x->len < start)
+			continue;
+		if (x->off > end) {
+			last = p;
+			break;
+		}
+		if (!first)
+			first = p;
+		start = min(start, x->off);
+		end = max(end, x->off + x->len);
+	}
+
+	/* the area extends the only one buffer, grow the buffer in place */
+	if (first && first->next == last) {
+		bf = list_entry(first, struct blkid_bufinfo, bufs);
+
+		if (bf->off <= req_start && end - bf->off <= bf->size) {
+			cur = bf->off + bf->len;
+			if (cur < end &&
+			    fill_buffer_area(pr, bf->data + bf->len, cur,
+					     end - cur, src, src_off))
+				return NULL;
+
+			DBG(LOWPROBE, ul_debug("\textended buffer: off=%jd len=%jd pr=%p",
+					bf->off, end - bf->off, pr));
+			bf->len = end - bf->off;
+			pr->lastbuf = bf;
+			return bf;
+		}
+	}
+
+	/* reserve space for the next areas if the buffer is merged, so the
+	 * data are copied only log(n) times for n adjacent reads */
+	size = end - start;
+	if (first && pr->size > end)
+		size += min(end - start, pr->size - end);
+
+	/* allocate info and space for data by one call */
+	bf = calloc(1, sizeof(struct blkid_bufinfo) + size);
+	if (!bf) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	bf->data = ((unsigned char *) bf) + sizeof(struct blkid_bufinfo);
+	bf->len = end - start;
+	bf->size = size;
+	bf->off = start;
+	INIT_LIST_HEAD(&bf->bufs);
+
+	/* copy already available data and read the gaps */
+	cur = start;
+	for (p = first; p && p != last; p = p->next) {
+		struct blkid_bufinfo *x =
+				list_entry(p, struct blkid_bufinfo, bufs);
+
+		if (x->off > cur &&
+		    fill_buffer_area(pr, bf->data + (cur - start), cur,
+				     x->off - cur, src, src_off))
+			goto err;
+		memcpy(bf->data + (x->off - start), x->data, x->len);
+		cur = x->off + x->len;
+	}
+	if (cur < end &&
+	    fill_buffer_area(pr, bf->data + (cur - start), cur,
+			     end - cur, src, src_off))
+		goto err;
+
+	if (first) {
+		DBG(LOWPROBE, ul_debug("\tmerged buffer: off=%jd len=%jd pr=%p",
+				bf->off, bf->len, pr));
+		for (p = first; p != last; p = pnext) {
+			pnext = p->next;
+			list_del(p);
+			list_add_tail(p, &pr->merged);
+		}
+	}
+
+	/* keep the list sorted by offset */
+	list_add_tail(&bf->bufs, last);
+	pr->lastbuf = bf;
+	return bf;
+err:
+	free(bf);
+	return NULL;
+}
+
 unsigned char *blkid_probe_get_buffer(blkid_probe pr,
 				blkid_loff_t off, blkid_loff_t len)
 {
@@ -557,78 +718,128 @@ unsigned char *blkid_probe_get_buffer(blkid_probe pr,
 				pr->off + off - pr->parent->off, len);
 	}
 
-	list_for_each(p, &pr->buffers) {
-		struct blkid_bufinfo *x =
-				list_entry(p, struct blkid_bufinfo, bufs);
+	/* probers usually read the same or the next area again */
+	bf = pr->lastbuf;
+	if (bf && (bf->off > off || off + len > bf->off + bf->len))
+		bf = NULL;
 
-		if (x->off <= off && off + len <= x->off + x->len) {
-			DBG(LOWPROBE, ul_debug("\treuse buffer: off=%jd len=%jd pr=%p",
-							x->off, x->len, pr));
-			bf = x;
-			break;
-		}
-	}
+	/* the buffers do not overlap, so only the last buffer which starts
+	 * before @off may contain the requested area */
 	if (!bf) {
-		ssize_t ret;
+		list_for_each(p, &pr->buffers) {
+			struct blkid_bufinfo *x =
+					list_entry(p, struct blkid_bufinfo, bufs);
 
-		if (blkid_llseek(pr->fd, pr->off + off, SEEK_SET) < 0) {
-			errno = 0;
-			return NULL;
+			if (x->off > off)
+				break;
+			if (off + len <= x->off + x->len) {
+				DBG(LOWPROBE, ul_debug("\treuse buffer: off=%jd len=%jd pr=%p",
+								x->off, x->len, pr));
+				bf = x;
+				break;
+			}
 		}
+	}
+	if (bf) {
+		pr->buf_hits++;
+		pr->lastbuf = bf;
+	} else {
+		blkid_loff_t start = off, end = off + len;
+
+		pr->buf_misses++;
+
+		if (pr->readahead > 0) {
+			/* align to the read-ahead blocks, but don't read
+			 * behind end of the probing area */
+			blkid_loff_t ra_end;
+
+			start -= start % pr->readahead;
+			ra_end = end + pr->readahead - 1;
+			ra_end -= ra_end % pr->readahead;
+			if (ra_end > pr->size)
+				ra_end = max(end, pr->size);
+			end = ra_end;
+		}
+
+		bf = read_buffer(pr, start, end, NULL);
 
-		/* allocate info and space for data by why call */
-		bf = calloc(1, sizeof(struct blkid_bufinfo) + len);
-		if (!bf) {
-			errno = ENOMEM;
+		/* read-ahead failed, try the requested area only */
+		if (!bf && (start != off || end != off + len) && errno != ENOMEM)
+			bf = read_buffer(pr, off, off + len, NULL);
+		if (!bf)
 			return NULL;
-		}
+	}
 
-		bf->data = ((unsigned char *) bf) + sizeof(struct blkid_bufinfo);
-		bf->len = len;
-		bf->off = off;
-		INIT_LIST_HEAD(&bf->bufs);
+	return bf->data + (off - bf->off);
+}
+
+/*
+ * Stores already read @data for area <off, off + len) to the probing buffers,
+ * see blkid_probe_prefetch().
+ *
+ * Returns: 0 on success, or -1 in case of error.
+ */
+int blkid_probe_add_buffer(blkid_probe pr, blkid_loff_t off,
+			   blkid_loff_t len, const unsigned char *data)
+{
+	if (len <= 0 || off < 0 || off + len > pr->size)
+		return -1;
 
-		DBG(LOWPROBE, ul_debug("\tbuffer read: off=%jd len=%jd pr=%p",
+	DBG(LOWPROBE, ul_debug("\tadd buffer: off=%jd len=%jd pr=%p",
 				off, len, pr));
 
-		ret = read(pr->fd, bf->data, len);
-		if (ret != (ssize_t) len) {
-			DBG(LOWPROBE, ul_debug("\tbuffer read: return %zd error %m", ret));
-			free(bf);
-			if (ret >= 0)
-				errno = 0;
-			return NULL;
-		}
-		list_add_tail(&bf->bufs, &pr->buffers);
-	}
+	return read_buffer(pr, off, off + len, data) ? 0 : -1;
+}
 
-	return off ? bf->data + (off - bf->off) : bf->data;
+static void free_buffers_list(struct list_head *head,
+			      uint64_t *read_ct, uint64_t *len_ct)
+{
+	while (!list_empty(head)) {
+		struct blkid_bufinfo *bf = list_entry(head->next,
+						struct blkid_bufinfo, bufs);
+		(*read_ct)++;
+		*len_ct += bf->len;
+		list_del(&bf->bufs);
+		free(bf);
+	}
+	INIT_LIST_HEAD(head);
 }
 
+/*
+ * Deallocates buffers replaced by merged buffers. It's necessary to call this
+ * function only when nobody uses pointers to the buffers (between probers).
+ */
+void blkid_probe_free_merged(blkid_probe pr)
+{
+	uint64_t merged_ct = 0, mlen_ct = 0;
+
+	if (list_empty(&pr->merged))
+		return;
+
+	free_buffers_list(&pr->merged, &merged_ct, &mlen_ct);
+
+	DBG(LOWPROBE, ul_debug("freed %"PRIu64" merged buffer(s), %"PRIu64" bytes",
+			merged_ct, mlen_ct));
+}
 
 static void blkid_probe_reset_buffer(blkid_probe pr)
 {
-	uint64_t read_ct = 0, len_ct = 0;
+	uint64_t buf_ct = 0, len_ct = 0, merged_ct = 0, mlen_ct = 0;
 
-	if (!pr || list_empty(&pr->buffers))
+	if (!pr || (list_empty(&pr->buffers) && list_empty(&pr->merged)))
 		return;
 
 	DBG(LOWPROBE, ul_debug("reseting probing buffers pr=%p", pr));
 
-	while (!list_empty(&pr->buffers)) {
-		struct blkid_bufinfo *bf = list_entry(pr->buffers.next,
-						struct blkid_bufinfo, bufs);
-		read_ct++;
-		len_ct += bf->len;
-		list_del(&bf->bufs);
-		free(bf);
-	}
+	free_buffers_list(&pr->buffers, &buf_ct, &len_ct);
+	free_buffers_list(&pr->merged, &merged_ct, &mlen_ct);
+	pr->lastbuf = NULL;
 
 	DBG(LOWPROBE, ul_debug("buffers summary: %"PRIu64" bytes "
-			"by %"PRIu64" read() call(s)",
-			len_ct, read_ct));
-
-	INIT_LIST_HEAD(&pr->buffers);
+			"in %"PRIu64" buffer(s) (+%"PRIu64" merged), "
+			"%"PRIu64" hits, %"PRIu64" misses, %"PRIu64" bytes read",
+			len_ct, buf_ct, merged_ct,
+			pr->buf_hits, pr->buf_misses, pr->buf_bytes));
 }
 
 /*
@@ -1557,6 +1768,54 @@ unsigned int blkid_probe_get_sectorsize(blkid_probe pr)
 	return pr->blkssz;
 }
 
+/**
+ * blkid_probe_set_readahead:
+ * @pr: probe
+ * @size: size of the read-ahead blocks in bytes or 0
+ *
+ * All reads from the device are aligned and extended to blocks of @size
+ * bytes (default is 4096), so the next small requests to the same area don't
+ * read the device again. The zero @size disables the read-ahead.
+ *
+ * Returns: 0 on success, or -1 in case of error.
+ */
+int blkid_probe_set_readahead(blkid_probe pr, size_t size)
+{
+	if (!pr)
+		return -1;
+
+	DBG(LOWPROBE, ul_debug("read-ahead set to %zu bytes", size));
+	pr->readahead = size;
+	return 0;
+}
+
+/**
+ * blkid_probe_get_buffer_stats:
+ * @pr: probe
+ * @hits: returns number of requests satisfied from the buffers (optional)
+ * @misses: returns number of requests which required read() (optional)
+ * @bytes: returns number of bytes read from the device (optional)
+ *
+ * The counters are accumulated for whole life of the probe (they are not
+ * reset by blkid_probe_set_device()).
+ *
+ * Returns: 0 on success, or -1 in case of error.
+ */
+int blkid_probe_get_buffer_stats(blkid_probe pr, uint64_t *hits,
+				 uint64_t *misses, uint64_t *bytes)
+{
+	if (!pr)
+		return -1;
+
+	if (hits)
+		*hits = pr->buf_hits;
+	if (misses)
+		*misses = pr->buf_misses;
+	if (bytes)
+		*bytes = pr->buf_bytes;
+	return 0;
+}
+
 /**
  * blkid_probe_get_sectors:
  * @pr: probe
@@ -19,6 +19,7 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #ifdef HAVE_ERRNO_H
 #include <errno.h>
 #endif
@@ -58,6 +59,10 @@ static void debug_dump_dev(blkid_dev dev);
  *	The following tags may be present, depending on the device contents
  *	<LABEL="label">	(user supplied) label (volume name, etc)
  *	<UUID="uuid">	(generated) universally unique identifier (serial no)
+ *
+ * The cache is written in the text format. The binary format (see struct
+ * blkid_bincache_header) is written if CACHE_FORMAT=binary is specified in
+ * blkid.conf, both formats are accepted on input.
  */
 
 static char *skip_over_blank(char *cp)
@@ -375,10 +380,312 @@ done:
 	return ret;
 }
 
+#define bincache_header(_c)	((struct blkid_bincache_header *) (_c)->bic_map)
+#define bincache_devs(_c)	((struct blkid_bincache_dev *) \
+					((char *) (_c)->bic_map + \
+					 sizeof(struct blkid_bincache_header)))
+#define bincache_tags(_c)	((struct blkid_bincache_tag *) \
+					(bincache_devs(_c) + bincache_header(_c)->ndevs))
+#define bincache_devno_hash(_c)	((uint32_t *) \
+					(bincache_tags(_c) + bincache_header(_c)->ntags))
+#define bincache_name_hash(_c)	(bincache_devno_hash(_c) + bincache_header(_c)->nbuckets)
+#define bincache_tag_hash(_c)	(bincache_name_hash(_c) + bincache_header(_c)->nbuckets)
+#define bincache_pool(_c)	((const char *) \
+					(bincache_tag_hash(_c) + bincache_header(_c)->nbuckets))
+
+/*
+ * Checks that all offsets and indexes in the file are within the file, so
+ * the rest of the code does not need to care about it.
+ */
+static int bincache_is_valid(blkid_cache cache)
+{
+	struct blkid_bincache_header *hdr = bincache_header(cache);
+	struct blkid_bincache_dev *devs;
+	struct blkid_bincache_tag *tags;
+	uint32_t *hash;
+	const char *pool;
+	uint64_t sz;
+	size_t i;
+
+	if (hdr->endian != BLKID_BINCACHE_ENDIAN ||
+	    hdr->version != BLKID_BINCACHE_VERSION) {
+		DBG(READ, ul_debug("unsupported binary cache version"));
+		return 0;
+	}
+	if (!hdr->nbuckets || (hdr->nbuckets & (hdr->nbuckets - 1)) ||
+	    !hdr->poolsz)
+		return 0;
+
+	sz = sizeof(*hdr)
+	     + (uint64_t) hdr->ndevs * sizeof(struct blkid_bincache_dev)
+	     + (uint64_t) hdr->ntags * sizeof(struct blkid_bincache_tag)
+	     + (uint64_t) hdr->nbuckets * 3 * sizeof(uint32_t)
+	     + hdr->poolsz;
+	if (sz != cache->bic_mapsz)
+		return 0;
+
+	devs = bincache_devs(cache);
+	tags = bincache_tags(cache);
+	pool = bincache_pool(cache);
+
+	if (pool[hdr->poolsz - 1] != '\0')
+		return 0;
+
+	for (i = 0; i < hdr->ndevs; i++) {
+		if (devs[i].name >= hdr->poolsz ||
+		    devs[i].tags > hdr->ntags ||
+		    devs[i].ntags > hdr->ntags - devs[i].tags ||
+		    devs[i].next_devno > hdr->ndevs ||
+		    devs[i].next_name > hdr->ndevs)
+			return 0;
+	}
+	for (i = 0; i < hdr->ntags; i++) {
+		if (tags[i].name >= hdr->poolsz ||
+		    tags[i].value >= hdr->poolsz ||
+		    tags[i].dev >= hdr->ndevs ||
+		    tags[i].next > hdr->ntags)
+			return 0;
+	}
+
+	hash = bincache_devno_hash(cache);
+	for (i = 0; i < (size_t) hdr->nbuckets * 2; i++) {
+		if (hash[i] > hdr->ndevs)
+			return 0;
+	}
+	hash = bincache_tag_hash(cache);
+	for (i = 0; i < hdr->nbuckets; i++) {
+		if (hash[i] > hdr->ntags)
+			return 0;
+	}
+	return 1;
+}
+
+void blkid_unmap_cache(blkid_cache cache)
+{
+	if (!cache->bic_map)
+		return;
+
+	DBG(READ, ul_debug("unmapping binary cache"));
+	munmap(cache->bic_map, cache->bic_mapsz);
+	free(cache->bic_maploaded);
+
+	cache->bic_map = NULL;
+	cache->bic_mapsz = 0;
+	cache->bic_maploaded = NULL;
+}
+
+/* Returns index of the device in the map or -1 */
+static int bincache_lookup_devname(blkid_cache cache, const char *devname)
+{
+	struct blkid_bincache_header *hdr = bincache_header(cache);
+	struct blkid_bincache_dev *devs = bincache_devs(cache);
+	const char *pool = bincache_pool(cache);
+	uint32_t i, n, idx;
+
+	idx = bincache_name_hash(cache)[blkid_bincache_strhash(2166136261U, devname)
+					 & (hdr->nbuckets - 1)];
+
+	/* @n protects against loops in corrupted file */
+	for (n = 0; idx && n < hdr->ndevs; idx = devs[i].next_name, n++) {
+		i = idx - 1;
+		if (strcmp(pool + devs[i].name, devname) == 0)
+			return i;
+	}
+	return -1;
+}
+
+/*
+ * Moves the device from the map to the in-memory cache. The devices which
+ * are already in the in-memory cache are never overwritten by the map.
+ */
+static blkid_dev bincache_load_dev(blkid_cache cache, uint32_t i)
+{
+	struct blkid_bincache_dev *bd = &bincache_devs(cache)[i];
+	struct blkid_bincache_tag *tags = bincache_tags(cache);
+	const char *pool = bincache_pool(cache);
+	unsigned int changed = cache->bic_flags & BLKID_BIC_FL_CHANGED;
+	blkid_dev dev;
+	uint32_t t;
+
+	if (cache->bic_maploaded[i])
+		return NULL;
+	cache->bic_maploaded[i] = 1;
+
+	DBG(READ, ul_debug("loading dev %s from binary cache", pool + bd->name));
+
+	if (*(pool + bd->name) != '/' || access(pool + bd->name, F_OK) < 0)
+		return NULL;
+
+	dev = blkid_new_dev();
+	if (!dev)
+		return NULL;
+	dev->bid_name = strdup(pool + bd->name);
+	if (!dev->bid_name) {
+		blkid_free_dev(dev);
+		return NULL;
+	}
+	dev->bid_cache = cache;
+	dev->bid_devno = bd->devno;
+	dev->bid_time = bd->time;
+	dev->bid_utime = bd->utime;
+	dev->bid_pri = bd->pri;
+	list_add_tail(&dev->bid_devs, &cache->bic_devs);
+
+	for (t = bd->tags; t < bd->tags + bd->ntags; t++) {
+		const char *value = pool + tags[t].value;
+
+		if (blkid_set_tag(dev, pool + tags[t].name, value, strlen(value)) < 0)
+			break;
+	}
+
+	/* the cache file has been read, not modified */
+	if (!changed)
+		cache->bic_flags &= ~BLKID_BIC_FL_CHANGED;
+
+	if (dev->bid_type == NULL) {
+		DBG(READ, ul_debug("blkid: device %s has no TYPE", dev->bid_name));
+		blkid_free_dev(dev);
+		return NULL;
+	}
+
+	DBG(READ, blkid_debug_dump_dev(dev));
+	return dev;
+}
+
+/*
+ * Moves all the remaining devices from the map to the in-memory cache and
+ * unmaps the cache file.
+ */
+void blkid_read_cache_all(blkid_cache cache)
+{
+	uint32_t i;
+
+	if (!cache->bic_map)
+		return;
+
+	for (i = 0; i < bincache_header(cache)->ndevs; i++)
+		bincache_load_dev(cache, i);
+
+	blkid_unmap_cache(cache);
+}
+
+/* Returns the device from the map if it was not in the in-memory cache yet */
+blkid_dev blkid_read_cache_devname(blkid_cache cache, const char *devname)
+{
+	int i;
+
+	if (!cache->bic_map)
+		return NULL;
+
+	i = bincache_lookup_devname(cache, devname);
+	return i >= 0 ? bincache_load_dev(cache, i) : NULL;
+}
+
+void blkid_read_cache_devno(blkid_cache cache, dev_t devno)
+{
+	struct blkid_bincache_header *hdr;
+	struct blkid_bincache_dev *devs;
+	uint32_t i, n, idx;
+
+	if (!cache->bic_map)
+		return;
+
+	hdr = bincache_header(cache);
+	devs = bincache_devs(cache);
+	idx = bincache_devno_hash(cache)[blkid_bincache_devnohash(devno)
+					  & (hdr->nbuckets - 1)];
+
+	for (n = 0; idx && n < hdr->ndevs; idx = devs[i].next_devno, n++) {
+		i = idx - 1;
+		if (devs[i].devno == (uint64_t) devno)
+			bincache_load_dev(cache, i);
+	}
+}
+
+void blkid_read_cache_tag(blkid_cache cache, const char *type, const char *value)
+{
+	struct blkid_bincache_header *hdr;
+	struct blkid_bincache_tag *tags;
+	const char *pool;
+	uint32_t i, n, idx;
+
+	if (!cache->bic_map)
+		return;
+
+	hdr = bincache_header(cache);
+	tags = bincache_tags(cache);
+	pool = bincache_pool(cache);
+	idx = bincache_tag_hash(cache)[blkid_bincache_taghash(type, value)
+					& (hdr->nbuckets - 1)];
+
+	for (n = 0; idx && n < hdr->ntags; idx = tags[i].next, n++) {
+		i = idx - 1;
+		if (strcmp(pool + tags[i].name, type) == 0 &&
+		    strcmp(pool + tags[i].value, value) == 0)
+			bincache_load_dev(cache, tags[i].dev);
+	}
+}
+
+/*
+ * Maps the binary cache file. Returns 1 if the file is in the binary format
+ * (valid or not), 0 if it is not.
+ */
+static int bincache_map(blkid_cache cache, int fd, struct stat *st)
+{
+	char magic[BLKID_BINCACHE_MAGICSZ];
+	struct list_head *p;
+	void *map;
+
+	if ((size_t) st->st_size < sizeof(struct blkid_bincache_header) ||
+	    pread(fd, magic, sizeof(magic), 0) != sizeof(magic) ||
+	    memcmp(magic, BLKID_BINCACHE_MAGIC, sizeof(magic)) != 0)
+		return 0;
+
+	map = mmap(NULL, st->st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		DBG(READ, ul_debug("failed to map binary cache %s",
+					cache->bic_filename));
+		return 1;
+	}
+
+	blkid_unmap_cache(cache);
+	cache->bic_map = map;
+	cache->bic_mapsz = st->st_size;
+
+	if (!bincache_is_valid(cache)) {
+		DBG(READ, ul_debug("blkid: invalid binary cache %s",
+					cache->bic_filename));
+		blkid_unmap_cache(cache);
+		return 1;
+	}
+
+	cache->bic_maploaded = calloc(1, bincache_header(cache)->ndevs + 1);
+	if (!cache->bic_maploaded) {
+		blkid_unmap_cache(cache);
+		return 1;
+	}
+
+	/* re-read, the devices we already have are more recent than the file */
+	list_for_each(p, &cache->bic_devs) {
+		blkid_dev dev = list_entry(p, struct blkid_struct_dev, bid_devs);
+		int i = bincache_lookup_devname(cache, dev->bid_name);
+
+		if (i >= 0)
+			cache->bic_maploaded[i] = 1;
+	}
+
+	DBG(READ, ul_debug("mapped binary cache %s: %u devices",
+				cache->bic_filename,
+				bincache_header(cache)->ndevs));
+	return 1;
+}
+
 /*
  * Parse the specified filename, and return the data in the supplied or
  * a newly allocated cache struct.  If the file doesn't exist, return a
  * new empty cache struct.
+ *
+ * The binary cache file is only mapped, devices are read on demand.
  */
 void blkid_read_cache(blkid_cache cache)
 {
@@ -408,6 +715,14 @@ void blkid_read_cache(blkid_cache cache)
 	DBG(CACHE, ul_debug("reading cache file %s",
 				cache->bic_filename));
 
+	if (bincache_map(cache, fd, &st)) {
+		cache->bic_ftime = st.st_mtime;
+		goto errout;
+	}
+
+	/* the file has been replaced by the text version */
+	blkid_unmap_cache(cache);
+
 	file = fdopen(fd, "r" UL_CLOEXECSTR);
 	if (!file)
 		goto errout;
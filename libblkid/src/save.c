@@ -52,6 +52,172 @@ static int save_dev(blkid_dev dev, FILE *file)
 	return 0;
 }
 
+static int is_saved_dev(blkid_dev dev)
+{
+	return dev->bid_name[0] == '/' && dev->bid_type &&
+	       !(dev->bid_flags & BLKID_BID_FL_REMOVABLE);
+}
+
+/* tag names are shared, there are only a few different names */
+#define BINCACHE_MAXNAMES	32
+
+struct bincache_names {
+	const char	*str[BINCACHE_MAXNAMES];
+	uint32_t	off[BINCACHE_MAXNAMES];
+	size_t		n;
+};
+
+static uint32_t add_string(char *pool, uint32_t *poolsz, const char *str)
+{
+	uint32_t off = *poolsz;
+	size_t len = strlen(str) + 1;
+
+	memcpy(pool + off, str, len);
+	*poolsz += len;
+	return off;
+}
+
+static uint32_t add_name(char *pool, uint32_t *poolsz,
+			 struct bincache_names *names, const char *str)
+{
+	size_t i;
+
+	for (i = 0; i < names->n; i++) {
+		if (strcmp(names->str[i], str) == 0)
+			return names->off[i];
+	}
+	if (names->n == BINCACHE_MAXNAMES)
+		return add_string(pool, poolsz, str);
+
+	names->str[names->n] = str;
+	names->off[names->n] = add_string(pool, poolsz, str);
+	return names->off[names->n++];
+}
+
+/*
+ * Writes the cache in the binary format, see struct blkid_bincache_header.
+ */
+static int save_bincache(blkid_cache cache, FILE *file)
+{
+	struct blkid_bincache_header hdr;
+	struct bincache_names names = { .n = 0 };
+	struct blkid_bincache_dev *devs = NULL;
+	struct blkid_bincache_tag *tags = NULL;
+	uint32_t *hash = NULL, *devno_hash, *name_hash, *tag_hash;
+	char *pool = NULL;
+	uint64_t sz = 1;
+	size_t ndevs = 0, ntags = 0, nbuckets = 16, i;
+	struct list_head *p, *t;
+	int rc = -BLKID_ERR_MEM;
+
+	memset(&hdr, 0, sizeof(hdr));
+
+	list_for_each(p, &cache->bic_devs) {
+		blkid_dev dev = list_entry(p, struct blkid_struct_dev, bid_devs);
+
+		if (!is_saved_dev(dev))
+			continue;
+		ndevs++;
+		sz += strlen(dev->bid_name) + 1;
+		list_for_each(t, &dev->bid_tags) {
+			blkid_tag tag = list_entry(t, struct blkid_struct_tag, bit_tags);
+
+			ntags++;
+			sz += strlen(tag->bit_name) + strlen(tag->bit_val) + 2;
+		}
+	}
+	if (sz > UINT32_MAX || ntags > UINT32_MAX / 2)
+		return -BLKID_ERR_PARAM;
+	while (nbuckets < ndevs)
+		nbuckets <<= 1;
+
+	devs = calloc(ndevs ? ndevs : 1, sizeof(*devs));
+	tags = calloc(ntags ? ntags : 1, sizeof(*tags));
+	hash = calloc(nbuckets * 3, sizeof(*hash));
+	pool = malloc(sz);
+	if (!devs || !tags || !hash || !pool)
+		goto done;
+
+	devno_hash = hash;
+	name_hash = hash + nbuckets;
+	tag_hash = hash + nbuckets * 2;
+
+	/* offset 0 is empty string */
+	pool[0] = '\0';
+	hdr.poolsz = 1;
+
+	list_for_each(p, &cache->bic_devs) {
+		blkid_dev dev = list_entry(p, struct blkid_struct_dev, bid_devs);
+		struct blkid_bincache_dev *bd = &devs[hdr.ndevs];
+
+		if (!is_saved_dev(dev))
+			continue;
+
+		DBG(SAVE, ul_debug("device %s, type %s", dev->bid_name, dev->bid_type));
+
+		bd->devno = dev->bid_devno;
+		bd->time = dev->bid_time;
+		bd->utime = dev->bid_utime;
+		bd->pri = dev->bid_pri;
+		bd->name = add_string(pool, &hdr.poolsz, dev->bid_name);
+		bd->tags = hdr.ntags;
+
+		list_for_each(t, &dev->bid_tags) {
+			blkid_tag tag = list_entry(t, struct blkid_struct_tag, bit_tags);
+			struct blkid_bincache_tag *bt = &tags[hdr.ntags++];
+
+			bt->name = add_name(pool, &hdr.poolsz, &names, tag->bit_name);
+			bt->value = add_string(pool, &hdr.poolsz, tag->bit_val);
+			bt->dev = hdr.ndevs;
+		}
+		bd->ntags = hdr.ntags - bd->tags;
+		hdr.ndevs++;
+	}
+
+	/* add to the chains in reverse order, so lookups follow the file order */
+	for (i = hdr.ndevs; i > 0; i--) {
+		struct blkid_bincache_dev *bd = &devs[i - 1];
+		uint32_t h;
+
+		h = blkid_bincache_devnohash(bd->devno) & (nbuckets - 1);
+		bd->next_devno = devno_hash[h];
+		devno_hash[h] = i;
+
+		h = blkid_bincache_strhash(2166136261U, pool + bd->name) & (nbuckets - 1);
+		bd->next_name = name_hash[h];
+		name_hash[h] = i;
+	}
+	for (i = hdr.ntags; i > 0; i--) {
+		struct blkid_bincache_tag *bt = &tags[i - 1];
+		uint32_t h;
+
+		h = blkid_bincache_taghash(pool + bt->name, pool + bt->value)
+				& (nbuckets - 1);
+		bt->next = tag_hash[h];
+		tag_hash[h] = i;
+	}
+
+	memcpy(hdr.magic, BLKID_BINCACHE_MAGIC, sizeof(hdr.magic));
+	hdr.endian = BLKID_BINCACHE_ENDIAN;
+	hdr.version = BLKID_BINCACHE_VERSION;
+	hdr.nbuckets = nbuckets;
+
+	if (fwrite(&hdr, sizeof(hdr), 1, file) != 1 ||
+	    (hdr.ndevs && fwrite(devs, sizeof(*devs), hdr.ndevs, file) != hdr.ndevs) ||
+	    (hdr.ntags && fwrite(tags, sizeof(*tags), hdr.ntags, file) != hdr.ntags) ||
+	    fwrite(hash, sizeof(*hash), nbuckets * 3, file) != nbuckets * 3 ||
+	    fwrite(pool, 1, hdr.poolsz, file) != hdr.poolsz)
+		rc = -BLKID_ERR_IO;
+	else
+		rc = 0;
+done:
+	free(devs);
+	free(tags);
+	free(hash);
+	free(pool);
+	return rc;
+}
+
 /*
  * Write out the cache struct to the cache file on disk.
  */
@@ -68,8 +234,15 @@ int blkid_flush_cache(blkid_cache cache)
 	if (!cache)
 		return -BLKID_ERR_PARAM;
 
-	if (list_empty(&cache->bic_devs) ||
-	    !(cache->bic_flags & BLKID_BIC_FL_CHANGED)) {
+	if (!(cache->bic_flags & BLKID_BIC_FL_CHANGED)) {
+		DBG(SAVE, ul_debug("skipping cache file write"));
+		return 0;
+	}
+
+	/* the file is rewritten, so all devices from the old file are necessary */
+	blkid_read_cache_all(cache);
+
+	if (list_empty(&cache->bic_devs)) {
 		DBG(SAVE, ul_debug("skipping cache file write"));
 		return 0;
 	}
@@ -103,13 +276,13 @@ int blkid_flush_cache(blkid_cache cache)
 	}
 
 	/*
-	 * Try and create a temporary file in the same directory so
-	 * that in case of error we don't overwrite the cache file.
-	 * If the cache file doesn't yet exist, it isn't a regular
-	 * file (e.g. /dev/null or a socket), or we couldn't create
-	 * a temporary file then we open it directly.
+	 * Create a temporary file in the same directory and rename it, so
+	 * that in case of error we don't overwrite the cache file, and the
+	 * file mmap()-ed by another process is never modified. If the cache
+	 * file isn't a regular file (e.g. /dev/null or a socket) then we
+	 * open it directly.
 	 */
-	if (ret == 0 && S_ISREG(st.st_mode)) {
+	if (ret < 0 || S_ISREG(st.st_mode)) {
 		tmp = malloc(strlen(filename) + 8);
 		if (tmp) {
 			sprintf(tmp, "%s-XXXXXX", filename);
@@ -125,7 +298,7 @@ int blkid_flush_cache(blkid_cache cache)
 		}
 	}
 
-	if (!file) {
+	if (!file && ret == 0 && !S_ISREG(st.st_mode)) {
 		file = fopen(filename, "w" UL_CLOEXECSTR);
 		opened = filename;
 	}
@@ -138,12 +311,16 @@ int blkid_flush_cache(blkid_cache cache)
 		goto errout;
 	}
 
-	list_for_each(p, &cache->bic_devs) {
-		blkid_dev dev = list_entry(p, struct blkid_struct_dev, bid_devs);
-		if (!dev->bid_type || (dev->bid_flags & BLKID_BID_FL_REMOVABLE))
-			continue;
-		if ((ret = save_dev(dev, file)) < 0)
-			break;
+	if (cache->bic_flags & BLKID_BIC_FL_BINARY)
+		ret = save_bincache(cache, file);
+	else {
+		list_for_each(p, &cache->bic_devs) {
+			blkid_dev dev = list_entry(p, struct blkid_struct_dev, bid_devs);
+			if (!is_saved_dev(dev))
+				continue;
+			if ((ret = save_dev(dev, file)) < 0)
+				break;
+		}
 	}
 
 	if (ret >= 0) {
@@ -195,22 +372,29 @@ int main(int argc, char **argv)
 	int ret;
 
 	blkid_init_debug(BLKID_DEBUG_ALL);
-	if (argc > 2) {
-		fprintf(stderr, "Usage: %s [filename]\n"
-			"Test loading/saving a cache (filename)\n", argv[0]);
+	if (argc < 2 || argc > 3) {
+		fprintf(stderr, "Usage: %s <filename>\n"
+			"Test loading/saving a cache (filename)\n"
+			"       %s <from> <to>\n"
+			"Convert cache file (the output format is set by blkid.conf)\n",
+			argv[0], argv[0]);
 		exit(1);
 	}
 
-	if ((ret = blkid_get_cache(&cache, "/dev/null")) != 0) {
+	if ((ret = blkid_get_cache(&cache, argc == 3 ? argv[1] : "/dev/null")) != 0) {
 		fprintf(stderr, "%s: error creating cache (%d)\n",
 			argv[0], ret);
 		exit(1);
 	}
-	if ((ret = blkid_probe_all(cache)) < 0) {
+	if (argc == 3) {
+		blkid_read_cache_all(cache);
+		cache->bic_flags |= BLKID_BIC_FL_CHANGED;
+	} else if ((ret = blkid_probe_all(cache)) < 0) {
 		fprintf(stderr, "error (%d) probing devices\n", ret);
 		exit(1);
 	}
-	cache->bic_filename = strdup(argv[1]);
+	free(cache->bic_filename);
+	cache->bic_filename = strdup(argv[argc - 1]);
 
 	if ((ret = blkid_flush_cache(cache)) < 0) {
 		fprintf(stderr, "error (%d) saving cache\n", ret);
@@ -78,6 +78,7 @@
 
 static int superblocks_probe(blkid_probe pr, struct blkid_chain *chn);
 static int superblocks_safeprobe(blkid_probe pr, struct blkid_chain *chn);
+static void superblocks_free(blkid_probe pr, void *data);
 
 static int blkid_probe_set_usage(blkid_probe pr, int usage);
 
@@ -171,8 +172,34 @@ const struct blkid_chaindrv superblocks_drv = {
 	.has_fltr     = TRUE,
 	.probe        = superblocks_probe,
 	.safeprobe    = superblocks_safeprobe,
+	.free_data    = superblocks_free
 };
 
+/*
+ * Index of all magic strings from idinfos[] sorted by on-disk offset. The
+ * index is built only once and it's used to read all areas with magic
+ * strings by a few large read() calls and to skip probers without a matching
+ * magic string.
+ */
+struct sb_magic_entry {
+	blkid_loff_t			off;	/* begin of the 1KiB block with magic */
+	size_t				idx;	/* prober index in idinfos[] */
+	const struct blkid_idmag	*mag;
+};
+
+struct sb_magics_index {
+	size_t			nents;
+	struct sb_magic_entry	ents[];
+};
+
+static struct sb_magics_index *magics_index;
+
+/* max gap between two magic areas to read the areas by one read() */
+#define SB_MAGICS_MAXGAP	(32 * 1024)
+
+/* max size of one read() */
+#define SB_MAGICS_MAXREAD	(256 * 1024)
+
 /**
  * blkid_probe_enable_superblocks:
  * @pr: probe
@@ -330,12 +357,296 @@ int blkid_superblocks_get_name(size_t idx, const char **name, int *usage)
 	return -1;
 }
 
+static void superblocks_free(blkid_probe pr __attribute__((__unused__)),
+			     void *data)
+{
+	free(data);
+}
+
+static int cmp_magic_entries(const void *a, const void *b)
+{
+	const struct sb_magic_entry *x = (const struct sb_magic_entry *) a,
+				    *y = (const struct sb_magic_entry *) b;
+
+	if (x->off != y->off)
+		return x->off < y->off ? -1 : 1;
+	if (x->idx != y->idx)
+		return x->idx < y->idx ? -1 : 1;
+	return x->mag < y->mag ? -1 : x->mag > y->mag;
+}
+
+static const struct sb_magics_index *superblocks_get_magics(void)
+{
+	struct sb_magics_index *idx;
+	size_t i, n = 0;
+
+	if (magics_index)
+		return magics_index;
+
+	for (i = 0; i < ARRAY_SIZE(idinfos); i++) {
+		const struct blkid_idmag *mag;
+
+		for (mag = &idinfos[i]->magics[0]; mag->magic; mag++)
+			n++;
+	}
+
+	idx = malloc(sizeof(struct sb_magics_index) +
+		     n * sizeof(struct sb_magic_entry));
+	if (!idx)
+		return NULL;
+
+	for (n = 0, i = 0; i < ARRAY_SIZE(idinfos); i++) {
+		const struct blkid_idmag *mag;
+
+		for (mag = &idinfos[i]->magics[0]; mag->magic; mag++, n++) {
+			idx->ents[n].off = (mag->kboff + (mag->sboff >> 10)) << 10;
+			idx->ents[n].idx = i;
+			idx->ents[n].mag = mag;
+		}
+	}
+
+	qsort(idx->ents, n, sizeof(struct sb_magic_entry), cmp_magic_entries);
+	idx->nents = n;
+
+	/* probing may run in more threads (see blkid_probe_all_parallel()),
+	 * the first complete index wins */
+	if (!__sync_bool_compare_and_swap(&magics_index, NULL, idx))
+		free(idx);
+	else
+		DBG(LOWPROBE, ul_debug("superblocks magics index: %zu entries", n));
+
+	return magics_index;
+}
+
+/*
+ * Returns 1 if the prober is not usable for the current device.
+ */
+static int superblocks_is_ignored(blkid_probe pr, struct blkid_chain *chn,
+				  size_t i)
+{
+	const struct blkid_idinfo *id = idinfos[i];
+
+	if (chn->fltr && blkid_bmp_get_item(chn->fltr, i))
+		return 1;
+
+	if (id->minsz && id->minsz > pr->size)
+		return 1;	/* the device is too small */
+
+	/* don't probe for RAIDs, swap or journal on CD/DVDs */
+	if ((id->usage & (BLKID_USAGE_RAID | BLKID_USAGE_OTHER)) &&
+	    blkid_probe_is_cdrom(pr))
+		return 1;
+
+	/* don't probe for RAIDs on floppies */
+	if ((id->usage & BLKID_USAGE_RAID) && blkid_probe_is_tiny(pr))
+		return 1;
+
+	return 0;
+}
+
+static inline int magic_is_readable(blkid_probe pr,
+				    const struct sb_magic_entry *e)
+{
+	return e->off + 1024 <= pr->size;
+}
+
+/*
+ * Reads area <start, end) and removes probers with a matching magic string
+ * from the @skip bitmap. If the read() failed then the probers are removed
+ * too -- the probers will use the usual blkid_probe_get_idmag() way.
+ */
+static void superblocks_check_magics(blkid_probe pr, struct blkid_chain *chn,
+				     const struct sb_magics_index *idx,
+				     unsigned long *skip, size_t first, size_t last,
+				     blkid_loff_t start, blkid_loff_t end)
+{
+	unsigned char *buf;
+	size_t i;
+
+	DBG(LOWPROBE, ul_debug("\tmagics read: off=%jd len=%jd",
+				start, end - start));
+
+	buf = blkid_probe_get_buffer(pr, start, end - start);
+	if (!buf)
+		errno = 0;
+
+	for (i = first; i < last; i++) {
+		const struct sb_magic_entry *e = &idx->ents[i];
+		const struct blkid_idmag *mag = e->mag;
+
+		if (superblocks_is_ignored(pr, chn, e->idx)
+		    || !magic_is_readable(pr, e))
+			continue;
+		if (!buf || !memcmp(mag->magic,
+				    buf + (e->off - start) + (mag->sboff & 0x3ff),
+				    mag->len))
+			blkid_bmp_unset_item(skip, e->idx);
+	}
+}
+
+typedef void (*magics_area_fn)(blkid_probe pr, struct blkid_chain *chn,
+				const struct sb_magics_index *idx,
+				size_t first, size_t last,
+				blkid_loff_t start, blkid_loff_t end, void *data);
+
+/*
+ * Merges readable magic strings of the usable probers to a few large areas
+ * and calls @fn for each area. The entries <first, last) from the index are
+ * within the area.
+ */
+static void superblocks_foreach_magics_area(blkid_probe pr,
+				struct blkid_chain *chn,
+				const struct sb_magics_index *idx,
+				magics_area_fn fn, void *data)
+{
+	blkid_loff_t start = 0, end = 0;
+	size_t i, first = 0;
+	int have_range = 0;
+
+	for (i = 0; i <= idx->nents; i++) {
+		const struct sb_magic_entry *e = NULL;
+
+		if (i < idx->nents) {
+			e = &idx->ents[i];
+
+			if (superblocks_is_ignored(pr, chn, e->idx)
+			    || !magic_is_readable(pr, e))
+				continue;
+			if (have_range && e->off <= end + SB_MAGICS_MAXGAP
+			    && e->off + 1024 - start <= SB_MAGICS_MAXREAD) {
+				end = max(end, e->off + 1024);
+				continue;
+			}
+		}
+
+		if (have_range)
+			fn(pr, chn, idx, first, i, start, end, data);
+		if (!e)
+			break;
+
+		first = i;
+		start = e->off;
+		end = e->off + 1024;
+		have_range = 1;
+	}
+}
+
+static void check_magics_area(blkid_probe pr, struct blkid_chain *chn,
+			      const struct sb_magics_index *idx,
+			      size_t first, size_t last,
+			      blkid_loff_t start, blkid_loff_t end, void *data)
+{
+	superblocks_check_magics(pr, chn, idx, (unsigned long *) data,
+				 first, last, start, end);
+}
+
+/*
+ * Reads all areas with magic strings by a few large reads and marks probers
+ * without any matching magic string in the @skip bitmap.
+ */
+static void superblocks_read_magics(blkid_probe pr, struct blkid_chain *chn,
+				    unsigned long *skip)
+{
+	const struct sb_magics_index *idx = superblocks_get_magics();
+	size_t i;
+
+	if (!idx)
+		return;
+
+	for (i = 0; i < idx->nents; i++) {
+		const struct sb_magic_entry *e = &idx->ents[i];
+
+		if (!superblocks_is_ignored(pr, chn, e->idx))
+			blkid_bmp_set_item(skip, e->idx);
+	}
+
+	/* behind end of the device, keep it on blkid_probe_get_idmag() */
+	for (i = 0; i < idx->nents; i++) {
+		const struct sb_magic_entry *e = &idx->ents[i];
+
+		if (!superblocks_is_ignored(pr, chn, e->idx)
+		    && !magic_is_readable(pr, e))
+			blkid_bmp_unset_item(skip, e->idx);
+	}
+
+	superblocks_foreach_magics_area(pr, chn, idx, check_magics_area, skip);
+}
+
+struct magics_areas {
+	struct blkid_area	*areas;
+	size_t			nareas;
+	size_t			max;
+};
+
+static void add_magics_area(blkid_probe pr __attribute__((__unused__)),
+			    struct blkid_chain *chn __attribute__((__unused__)),
+			    const struct sb_magics_index *idx __attribute__((__unused__)),
+			    size_t first __attribute__((__unused__)),
+			    size_t last __attribute__((__unused__)),
+			    blkid_loff_t start, blkid_loff_t end, void *data)
+{
+	struct magics_areas *ma = (struct magics_areas *) data;
+
+	if (!ma->areas)
+		return;
+	if (ma->nareas == ma->max) {
+		struct blkid_area *tmp;
+
+		tmp = realloc(ma->areas, (ma->max + 8) * sizeof(struct blkid_area));
+		if (!tmp) {
+			free(ma->areas);
+			ma->areas = NULL;
+			return;
+		}
+		ma->areas = tmp;
+		ma->max += 8;
+	}
+	ma->areas[ma->nareas].off = start;
+	ma->areas[ma->nareas].len = end - start;
+	ma->nareas++;
+}
+
+/*
+ * Returns areas which will be read by superblocks_read_magics() for the
+ * current superblocks chain setting. The areas are sorted by offset. The
+ * @areas array has to be deallocated by free().
+ *
+ * Returns: number of areas or -1 in case of error.
+ */
+int blkid_superblocks_get_magics_areas(blkid_probe pr, struct blkid_area **areas)
+{
+	struct blkid_chain *chn = &pr->chains[BLKID_CHAIN_SUBLKS];
+	const struct sb_magics_index *idx;
+	struct magics_areas ma = { .max = 0 };
+
+	*areas = NULL;
+	if (!chn->enabled || pr->size <= 0)
+		return 0;
+
+	idx = superblocks_get_magics();
+	if (!idx)
+		return -1;
+
+	ma.areas = malloc(8 * sizeof(struct blkid_area));
+	if (!ma.areas)
+		return -1;
+	ma.max = 8;
+
+	superblocks_foreach_magics_area(pr, chn, idx, add_magics_area, &ma);
+	if (!ma.areas)
+		return -1;
+
+	*areas = ma.areas;
+	return ma.nareas;
+}
+
 /*
  * The blkid_do_probe() backend.
  */
 static int superblocks_probe(blkid_probe pr, struct blkid_chain *chn)
 {
 	size_t i;
+	unsigned long *skip;
 	int rc = BLKID_PROBE_NONE;
 
 	if (!pr || chn->idx < -1)
@@ -355,6 +666,17 @@ static int superblocks_probe(blkid_probe pr, struct blkid_chain *chn)
 	DBG(LOWPROBE, ul_debug("--> starting probing loop [SUBLKS idx=%d]",
 		chn->idx));
 
+	if (!chn->data)
+		chn->data = calloc(1, blkid_bmp_nbytes(ARRAY_SIZE(idinfos)));
+	if (!chn->data)
+		return -ENOMEM;
+	skip = (unsigned long *) chn->data;
+
+	if (chn->idx < 0) {
+		memset(skip, 0, blkid_bmp_nbytes(ARRAY_SIZE(idinfos)));
+		superblocks_read_magics(pr, chn, skip);
+	}
+
 	i = chn->idx < 0 ? 0 : chn->idx + 1U;
 
 	for ( ; i < ARRAY_SIZE(idinfos); i++) {
@@ -365,26 +687,14 @@ static int superblocks_probe(blkid_probe pr, struct blkid_chain *chn)
 		chn->idx = i;
 		id = idinfos[i];
 
-		if (chn->fltr && blkid_bmp_get_item(chn->fltr, i)) {
+		if (superblocks_is_ignored(pr, chn, i)) {
 			DBG(LOWPROBE, ul_debug("filter out: %s", id->name));
 			rc = BLKID_PROBE_NONE;
 			continue;
 		}
 
-		if (id->minsz && id->minsz > pr->size) {
-			rc = BLKID_PROBE_NONE;
-			continue;	/* the device is too small */
-		}
-
-		/* don't probe for RAIDs, swap or journal on CD/DVDs */
-		if ((id->usage & (BLKID_USAGE_RAID | BLKID_USAGE_OTHER)) &&
-		    blkid_probe_is_cdrom(pr)) {
-			rc = BLKID_PROBE_NONE;
-			continue;
-		}
-
-		/* don't probe for RAIDs on floppies */
-		if ((id->usage & BLKID_USAGE_RAID) && blkid_probe_is_tiny(pr)) {
+		/* magic string not found by superblocks_read_magics() */
+		if (blkid_bmp_get_item(skip, i)) {
 			rc = BLKID_PROBE_NONE;
 			continue;
 		}
@@ -401,6 +711,7 @@ static int superblocks_probe(blkid_probe pr, struct blkid_chain *chn)
 		if (id->probefunc) {
 			DBG(LOWPROBE, ul_debug("\tcall probefunc()"));
 			rc = id->probefunc(pr, mag);
+			blkid_probe_free_merged(pr);
 			if (rc != BLKID_PROBE_OK) {
 				blkid_probe_chain_reset_vals(pr, chn);
 				if (rc < 0)
@@ -353,6 +353,7 @@ blkid_dev blkid_find_dev_with_tag(blkid_cache cache,
 try_again:
 	pri = -1;
 	dev = 0;
+	blkid_read_cache_tag(cache, type, value);
 	head = blkid_find_head_cache(cache, type);
 
 	if (head) {
@@ -52,6 +52,9 @@ static int probe_sysfs_tp(blkid_probe pr,
 	if (!dev || sysfs_init(&sysfs, dev, NULL) != 0)
 		return 1;
 
+	/* every attribute is checked and then read */
+	sysfs_enable_cache(&sysfs, 1);
+
 	rc = 1;		/* nothing (default) */
 
 	for (i = 0; i < ARRAY_SIZE(topology_vals); i++) {
@@ -23,6 +23,22 @@
 #include "blkidP.h"
 #include "sysfs.h"
 
+static void blkid_value_to_tag(blkid_dev dev, const char *name,
+			       const char *data, size_t len)
+{
+	if (strncmp(name, "PART_ENTRY_", 11) == 0) {
+		if (strcmp(name, "PART_ENTRY_UUID") == 0)
+			blkid_set_tag(dev, "PARTUUID", data, len);
+		else if (strcmp(name, "PART_ENTRY_NAME") == 0)
+			blkid_set_tag(dev, "PARTLABEL", data, len);
+
+	} else if (!strstr(name, "_ID")) {
+		/* superblock UUID, LABEL, ...
+		 * but not {SYSTEM,APPLICATION,..._ID} */
+		blkid_set_tag(dev, name, data, len);
+	}
+}
+
 static void blkid_probe_to_tags(blkid_probe pr, blkid_dev dev)
 {
 	const char *data;
@@ -35,20 +51,65 @@ static void blkid_probe_to_tags(blkid_probe pr, blkid_dev dev)
 	for (n = 0; n < nvals; n++) {
 		if (blkid_probe_get_value(pr, n, &name, &data, &len) != 0)
 			continue;
-		if (strncmp(name, "PART_ENTRY_", 11) == 0) {
-			if (strcmp(name, "PART_ENTRY_UUID") == 0)
-				blkid_set_tag(dev, "PARTUUID", data, len);
-			else if (strcmp(name, "PART_ENTRY_NAME") == 0)
-				blkid_set_tag(dev, "PARTLABEL", data, len);
-
-		} else if (!strstr(name, "_ID")) {
-			/* superblock UUID, LABEL, ...
-			 * but not {SYSTEM,APPLICATION,..._ID} */
-			blkid_set_tag(dev, name, data, len);
-		}
+		blkid_value_to_tag(dev, name, data, len);
 	}
 }
 
+static void blkid_preprobe_to_tags(struct blkid_preprobe *pp, blkid_dev dev)
+{
+	int n;
+
+	for (n = 0; n < pp->nvals; n++) {
+		struct blkid_prval *v = &pp->vals[n];
+
+		blkid_value_to_tag(dev, v->name, (char *) v->data, v->len);
+	}
+}
+
+/*
+ * Low-level probing of the device as used by blkid_verify(). Returns
+ * blkid_do_safeprobe() result or -1 if the device cannot be assigned to @pr.
+ */
+int blkid_verify_probe(blkid_probe pr, int fd)
+{
+	if (blkid_probe_set_device(pr, fd, 0, 0))
+		return -1;		/* failed to read the device */
+
+	/* enable superblocks probing */
+	blkid_probe_enable_superblocks(pr, TRUE);
+	blkid_probe_set_superblocks_flags(pr,
+		BLKID_SUBLKS_LABEL | BLKID_SUBLKS_UUID |
+		BLKID_SUBLKS_TYPE | BLKID_SUBLKS_SECTYPE);
+
+	/* enable partitions probing */
+	blkid_probe_enable_partitions(pr, TRUE);
+	blkid_probe_set_partitions_flags(pr, BLKID_PARTS_ENTRY_DETAILS);
+
+	/* probe */
+	return blkid_do_safeprobe(pr);
+}
+
+/*
+ * Returns 1 if the cached @dev data are still valid for device described by
+ * @st and does not have to be revalidated.
+ */
+int blkid_dev_is_fresh(blkid_dev dev, struct stat *st, time_t now)
+{
+	time_t diff = now - dev->bid_time;
+
+	return now >= dev->bid_time &&
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+	    (st->st_mtime < dev->bid_time ||
+	        (st->st_mtime == dev->bid_time &&
+		 st->st_mtim.tv_nsec / 1000 <= dev->bid_utime)) &&
+#else
+	    st->st_mtime <= dev->bid_time &&
+#endif
+	    (diff < BLKID_PROBE_MIN ||
+		(dev->bid_flags & BLKID_BID_FL_VERIFIED &&
+		 diff < BLKID_PROBE_INTERVAL));
+}
+
 /*
  * Verify that the data in dev is consistent with what is on the actual
  * block device (using the devname field only).  Normally this will be
@@ -62,9 +123,10 @@ blkid_dev blkid_verify(blkid_cache cache, blkid_dev dev)
 {
 	blkid_tag_iterate iter;
 	const char *type, *value;
+	struct blkid_preprobe *pp;
 	struct stat st;
 	time_t diff, now;
-	int fd;
+	int fd = -1, rc;
 
 	if (!dev || !cache)
 		return NULL;
@@ -87,17 +149,7 @@ blkid_dev blkid_verify(blkid_cache cache, blkid_dev dev)
 		return NULL;
 	}
 
-	if (now >= dev->bid_time &&
-#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
-	    (st.st_mtime < dev->bid_time ||
-	        (st.st_mtime == dev->bid_time &&
-		 st.st_mtim.tv_nsec / 1000 <= dev->bid_utime)) &&
-#else
-	    st.st_mtime <= dev->bid_time &&
-#endif
-	    (diff < BLKID_PROBE_MIN ||
-		(dev->bid_flags & BLKID_BID_FL_VERIFIED &&
-		 diff < BLKID_PROBE_INTERVAL)))
+	if (blkid_dev_is_fresh(dev, &st, now))
 		return dev;
 
 #ifndef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
@@ -118,6 +170,16 @@ blkid_dev blkid_verify(blkid_cache cache, blkid_dev dev)
 		blkid_free_dev(dev);
 		return NULL;
 	}
+
+	/* already probed by blkid_probe_all_parallel() */
+	pp = blkid_cache_get_preprobe(cache, st.st_rdev);
+	if (pp) {
+		DBG(PROBE, ul_debug("%s: using parallel probing result",
+					dev->bid_name));
+		rc = pp->rc;
+		goto probed;
+	}
+
 	if (!cache->probe) {
 		cache->probe = blkid_new_probe();
 		if (!cache->probe) {
@@ -134,31 +196,15 @@ blkid_dev blkid_verify(blkid_cache cache, blkid_dev dev)
 		goto open_err;
 	}
 
-	if (blkid_probe_set_device(cache->probe, fd, 0, 0)) {
-		/* failed to read the device */
-		close(fd);
-		blkid_free_dev(dev);
-		return NULL;
-	}
-
+	rc = blkid_verify_probe(cache->probe, fd);
+probed:
 	/* remove old cache info */
 	iter = blkid_tag_iterate_begin(dev);
 	while (blkid_tag_next(iter, &type, &value) == 0)
 		blkid_set_tag(dev, type, NULL, 0);
 	blkid_tag_iterate_end(iter);
 
-	/* enable superblocks probing */
-	blkid_probe_enable_superblocks(cache->probe, TRUE);
-	blkid_probe_set_superblocks_flags(cache->probe,
-		BLKID_SUBLKS_LABEL | BLKID_SUBLKS_UUID |
-		BLKID_SUBLKS_TYPE | BLKID_SUBLKS_SECTYPE);
-
-	/* enable partitions probing */
-	blkid_probe_enable_partitions(cache->probe, TRUE);
-	blkid_probe_set_partitions_flags(cache->probe, BLKID_PARTS_ENTRY_DETAILS);
-
-	/* probe */
-	if (blkid_do_safeprobe(cache->probe)) {
+	if (rc) {
 		/* found nothing or error */
 		blkid_free_dev(dev);
 		dev = NULL;
@@ -178,15 +224,20 @@ blkid_dev blkid_verify(blkid_cache cache, blkid_dev dev)
 		dev->bid_flags |= BLKID_BID_FL_VERIFIED;
 		cache->bic_flags |= BLKID_BIC_FL_CHANGED;
 
-		blkid_probe_to_tags(cache->probe, dev);
+		if (pp)
+			blkid_preprobe_to_tags(pp, dev);
+		else
+			blkid_probe_to_tags(cache->probe, dev);
 
 		DBG(PROBE, ul_debug("%s: devno 0x%04llx, type %s",
 			   dev->bid_name, (long long)st.st_rdev, dev->bid_type));
 	}
 
-	blkid_reset_probe(cache->probe);
-	blkid_probe_reset_superblocks_filter(cache->probe);
-	close(fd);
+	if (fd >= 0) {
+		blkid_reset_probe(cache->probe);
+		blkid_probe_reset_superblocks_filter(cache->probe);
+		close(fd);
+	}
 	return dev;
 }
 
@@ -25,14 +25,25 @@
 #include <blkid.h>
 
 #include "canonicalize.h"
+#include "list.h"
 #include "mountP.h"
 #include "loopdev.h"
 #include "strutils.h"
 
 /*
  * Canonicalized (resolved) paths & tags cache
+ *
+ * The entries are hashed by paths, by "TAG\0value" keys and by device names
+ * (tags only). All the entries are also in the LRU list, the list is used
+ * to remove the least recently used entries if the cache is larger than the
+ * memory limit (see mnt_cache_set_memory_limit()).
+ *
+ * The entries are never removed when added, the strings returned by the cache
+ * are still used by the callers (e.g. mnt_table_find_srcpath() keeps the
+ * canonicalized path while it resolves tags). The cache is shrunk only by
+ * mnt_cache_shrink() at the points where nothing refers to the cache strings.
  */
-#define MNT_CACHE_CHUNKSZ	128
+#define MNT_CACHE_HASHSZ	64	/* initial number of buckets */
 
 #define MNT_CACHE_ISTAG		(1 << 1) /* entry is TAG */
 #define MNT_CACHE_ISPATH	(1 << 2) /* entry is path */
@@ -43,14 +54,28 @@ struct mnt_cache_entry {
 	char			*key;	/* search key (e.g. uncanonicalized path) */
 	char			*value;	/* value (e.g. canonicalized path) */
 	int			flag;
+
+	size_t			size;	/* allocated memory for the entry */
+	unsigned int		khash;	/* hash of the key */
+	unsigned int		vhash;	/* hash of the devname (tags only) */
+
+	struct mnt_cache_entry	*knext;	/* next entry in keys bucket */
+	struct mnt_cache_entry	*vnext;	/* next entry in devnames bucket */
+	struct list_head	lru;	/* least recently used is the first */
 };
 
 struct libmnt_cache {
-	struct mnt_cache_entry	*ents;
+	struct list_head	lru;	/* all entries */
 	size_t			nents;
-	size_t			nallocs;
 	int			refcount;
 
+	struct mnt_cache_entry	**keys;	/* paths and tags hash */
+	struct mnt_cache_entry	**devs;	/* devname to tags hash */
+	size_t			nbuckets;	/* power of 2 */
+
+	size_t			memsz;	/* memory used by entries */
+	size_t			maxmem;	/* memory limit or 0 */
+
 	/* blkid_evaluate_tag() works in two ways:
 	 *
 	 * 1/ all tags are evaluated by udev /dev/disk/by-* symlinks,
@@ -77,9 +102,18 @@ struct libmnt_cache *mnt_new_cache(void)
 		return NULL;
 	DBG(CACHE, ul_debugobj(cache, "alloc"));
 	cache->refcount = 1;
+	INIT_LIST_HEAD(&cache->lru);
 	return cache;
 }
 
+static void free_cache_entry(struct mnt_cache_entry *e)
+{
+	if (e->value != e->key)
+		free(e->value);
+	free(e->key);
+	free(e);
+}
+
 /**
  * mnt_free_cache:
  * @cache: pointer to struct libmnt_cache instance
@@ -89,20 +123,19 @@ struct libmnt_cache *mnt_new_cache(void)
  */
 void mnt_free_cache(struct libmnt_cache *cache)
 {
-	size_t i;
-
 	if (!cache)
 		return;
 
 	DBG(CACHE, ul_debugobj(cache, "free [refcount=%d]", cache->refcount));
 
-	for (i = 0; i < cache->nents; i++) {
-		struct mnt_cache_entry *e = &cache->ents[i];
-		if (e->value != e->key)
-			free(e->value);
-		free(e->key);
+	while (!list_empty(&cache->lru)) {
+		struct mnt_cache_entry *e = list_entry(cache->lru.next,
+					struct mnt_cache_entry, lru);
+		list_del(&e->lru);
+		free_cache_entry(e);
 	}
-	free(cache->ents);
+	free(cache->keys);
+	free(cache->devs);
 	if (cache->bc)
 		blkid_put_cache(cache->bc);
 	free(cache);
@@ -166,6 +199,164 @@ int mnt_cache_set_targets(struct libmnt_cache *cache,
 }
 
 
+/**
+ * mnt_cache_set_memory_limit:
+ * @cache: cache pointer
+ * @bytes: memory limit or 0
+ *
+ * Sets the maximal memory used by the cached paths and tags. The least
+ * recently used entries are removed from the cache if the limit is exceeded.
+ * The default is 0 (unlimited).
+ *
+ * The entries are removed when a table that uses the @cache (see
+ * mnt_table_set_cache()) is reset by mnt_reset_table() or when the table
+ * parses a new file. Note that the strings returned by the mnt_resolve_*()
+ * functions are owned by the cache. If the limit is set, then the strings are
+ * valid only until the next reset or parse of such table, so copy the result
+ * if you need it for a longer time.
+ *
+ * Returns: negative number in case of error, or 0 o success.
+ */
+int mnt_cache_set_memory_limit(struct libmnt_cache *cache, size_t bytes)
+{
+	assert(cache);
+	if (!cache)
+		return -EINVAL;
+
+	DBG(CACHE, ul_debugobj(cache, "memory limit: %zu", bytes));
+	cache->maxmem = bytes;
+	return 0;
+}
+
+static inline unsigned int hash_tag(const char *token, const char *value)
+{
+	unsigned int h = mnt_hash_data(MNT_HASH_INIT, token, strlen(token) + 1);
+
+	return mnt_hash_data(h, value, strlen(value));
+}
+
+static inline unsigned int hash_devname(const char *devname)
+{
+	return mnt_hash_data(MNT_HASH_INIT, devname, strlen(devname));
+}
+
+static inline void cache_touch_entry(struct libmnt_cache *cache,
+				     struct mnt_cache_entry *e)
+{
+	list_del(&e->lru);
+	list_add_tail(&e->lru, &cache->lru);
+}
+
+static void cache_hash_entry(struct libmnt_cache *cache,
+			     struct mnt_cache_entry *e)
+{
+	size_t i = e->khash & (cache->nbuckets - 1);
+
+	e->knext = cache->keys[i];
+	cache->keys[i] = e;
+
+	if (e->flag & MNT_CACHE_ISTAG) {
+		i = e->vhash & (cache->nbuckets - 1);
+		e->vnext = cache->devs[i];
+		cache->devs[i] = e;
+	}
+}
+
+/* removes the entry from the hashes and from the LRU list */
+static void cache_unlink_entry(struct libmnt_cache *cache,
+			       struct mnt_cache_entry *e)
+{
+	struct mnt_cache_entry **pp;
+
+	for (pp = &cache->keys[e->khash & (cache->nbuckets - 1)]; *pp;
+	     pp = &(*pp)->knext) {
+		if (*pp == e) {
+			*pp = e->knext;
+			break;
+		}
+	}
+	if (e->flag & MNT_CACHE_ISTAG) {
+		for (pp = &cache->devs[e->vhash & (cache->nbuckets - 1)]; *pp;
+		     pp = &(*pp)->vnext) {
+			if (*pp == e) {
+				*pp = e->vnext;
+				break;
+			}
+		}
+	}
+	list_del(&e->lru);
+	cache->nents--;
+	cache->memsz -= e->size;
+}
+
+/* resizes the hashes to have at least one bucket for each entry */
+static int cache_resize_hashes(struct libmnt_cache *cache)
+{
+	struct mnt_cache_entry **keys, **devs;
+	struct list_head *p;
+	size_t sz = cache->nbuckets ? cache->nbuckets * 2 : MNT_CACHE_HASHSZ;
+
+	keys = calloc(sz, sizeof(struct mnt_cache_entry *));
+	devs = calloc(sz, sizeof(struct mnt_cache_entry *));
+	if (!keys || !devs) {
+		free(keys);
+		free(devs);
+		return -ENOMEM;
+	}
+
+	free(cache->keys);
+	free(cache->devs);
+	cache->keys = keys;
+	cache->devs = devs;
+	cache->nbuckets = sz;
+
+	/* the older entries are in the buckets behind the newer entries */
+	list_for_each(p, &cache->lru)
+		cache_hash_entry(cache, list_entry(p, struct mnt_cache_entry, lru));
+
+	DBG(CACHE, ul_debugobj(cache, "hashes resized to %zu buckets", sz));
+	return 0;
+}
+
+/*
+ * Removes the least recently used entries to keep the cache smaller than the
+ * memory limit. The tags read by mnt_cache_read_tags() for the same device
+ * are removed together, otherwise the cache would be incomplete.
+ *
+ * The function invalidates all strings returned by the cache, so it has to be
+ * called only when nothing refers to the strings.
+ */
+void mnt_cache_shrink(struct libmnt_cache *cache)
+{
+	if (!cache || !cache->maxmem)
+		return;
+
+	while (cache->memsz > cache->maxmem && !list_empty(&cache->lru)) {
+		struct mnt_cache_entry *e = list_entry(cache->lru.next,
+					struct mnt_cache_entry, lru);
+		DBG(CACHE, ul_debugobj(cache, "remove entry (%s): %s: %s",
+			(e->flag & MNT_CACHE_ISPATH) ? "path" : "tag",
+			e->value, e->key));
+
+		if (e->flag & MNT_CACHE_TAGREAD) {
+			struct mnt_cache_entry *x, *next;
+
+			for (x = cache->devs[e->vhash & (cache->nbuckets - 1)];
+			     x; x = next) {
+				next = x->vnext;
+				if (x == e ||
+				    !(x->flag & MNT_CACHE_TAGREAD) ||
+				    strcmp(x->value, e->value) != 0)
+					continue;
+				cache_unlink_entry(cache, x);
+				free_cache_entry(x);
+			}
+		}
+		cache_unlink_entry(cache, e);
+		free_cache_entry(e);
+	}
+}
+
 /* note that the @key could be the same pointer as @value */
 static int cache_add_entry(struct libmnt_cache *cache, char *key,
 					char *value, int flag)
@@ -176,21 +367,33 @@ static int cache_add_entry(struct libmnt_cache *cache, char *key,
 	assert(value);
 	assert(key);
 
-	if (cache->nents == cache->nallocs) {
-		size_t sz = cache->nallocs + MNT_CACHE_CHUNKSZ;
+	if (cache->nents >= cache->nbuckets && cache_resize_hashes(cache))
+		return -ENOMEM;
 
-		e = realloc(cache->ents, sz * sizeof(struct mnt_cache_entry));
-		if (!e)
-			return -ENOMEM;
-		cache->ents = e;
-		cache->nallocs = sz;
-	}
+	e = calloc(1, sizeof(*e));
+	if (!e)
+		return -ENOMEM;
 
-	e = &cache->ents[cache->nents];
 	e->key = key;
 	e->value = value;
 	e->flag = flag;
+	e->size = sizeof(*e) + strlen(key) + 1;
+
+	if (flag & MNT_CACHE_ISTAG) {
+		const char *tagval = key + strlen(key) + 1;
+
+		e->size += strlen(tagval) + 1;
+		e->khash = hash_tag(key, tagval);
+		e->vhash = hash_devname(value);
+	} else
+		e->khash = mnt_hash_path(key);
+	if (value != key)
+		e->size += strlen(value) + 1;
+
+	cache_hash_entry(cache, e);
+	list_add_tail(&e->lru, &cache->lru);
 	cache->nents++;
+	cache->memsz += e->size;
 
 	DBG(CACHE, ul_debugobj(cache, "add entry [%2zd] (%s): %s: %s",
 			cache->nents,
@@ -240,20 +443,24 @@ static int cache_add_tag(struct libmnt_cache *cache, const char *tagname,
  */
 static const char *cache_find_path(struct libmnt_cache *cache, const char *path)
 {
-	size_t i;
+	struct mnt_cache_entry *e;
+	unsigned int h;
 
 	assert(cache);
 	assert(path);
 
-	if (!cache || !path)
+	if (!cache || !path || !cache->nents)
 		return NULL;
 
-	for (i = 0; i < cache->nents; i++) {
-		struct mnt_cache_entry *e = &cache->ents[i];
-		if (!(e->flag & MNT_CACHE_ISPATH))
+	h = mnt_hash_path(path);
+
+	for (e = cache->keys[h & (cache->nbuckets - 1)]; e; e = e->knext) {
+		if (e->khash != h || !(e->flag & MNT_CACHE_ISPATH))
 			continue;
-		if (streq_except_trailing_slash(path, e->key))
+		if (streq_except_trailing_slash(path, e->key)) {
+			cache_touch_entry(cache, e);
 			return e->value;
+		}
 	}
 	return NULL;
 }
@@ -264,25 +471,53 @@ static const char *cache_find_path(struct libmnt_cache *cache, const char *path)
 static const char *cache_find_tag(struct libmnt_cache *cache,
 			const char *token, const char *value)
 {
-	size_t i;
+	struct mnt_cache_entry *e;
+	unsigned int h;
 	size_t tksz;
 
 	assert(cache);
 	assert(token);
 	assert(value);
 
-	if (!cache || !token || !value)
+	if (!cache || !token || !value || !cache->nents)
 		return NULL;
 
+	h = hash_tag(token, value);
 	tksz = strlen(token);
 
-	for (i = 0; i < cache->nents; i++) {
-		struct mnt_cache_entry *e = &cache->ents[i];
-		if (!(e->flag & MNT_CACHE_ISTAG))
+	for (e = cache->keys[h & (cache->nbuckets - 1)]; e; e = e->knext) {
+		if (e->khash != h || !(e->flag & MNT_CACHE_ISTAG))
 			continue;
 		if (strcmp(token, e->key) == 0 &&
-		    strcmp(value, e->key + tksz + 1) == 0)
+		    strcmp(value, e->key + tksz + 1) == 0) {
+			cache_touch_entry(cache, e);
 			return e->value;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Returns the first tag entry for @devname with @flag, if @token is not NULL
+ * then the entry with the tag name is returned.
+ */
+static struct mnt_cache_entry *cache_find_devname(struct libmnt_cache *cache,
+			const char *devname, const char *token, int flag)
+{
+	struct mnt_cache_entry *e;
+	unsigned int h;
+
+	if (!cache->nents)
+		return NULL;
+
+	h = hash_devname(devname);
+
+	for (e = cache->devs[h & (cache->nbuckets - 1)]; e; e = e->vnext) {
+		if (e->vhash != h || !(e->flag & flag))
+			continue;
+		if (strcmp(e->value, devname) == 0 &&		/* dev name */
+		    (!token || strcmp(token, e->key) == 0))	/* tag name */
+			return e;
 	}
 	return NULL;
 }
@@ -290,22 +525,18 @@ static const char *cache_find_tag(struct libmnt_cache *cache,
 static char *cache_find_tag_value(struct libmnt_cache *cache,
 			const char *devname, const char *token)
 {
-	size_t i;
+	struct mnt_cache_entry *e;
 
 	assert(cache);
 	assert(devname);
 	assert(token);
 
-	for (i = 0; i < cache->nents; i++) {
-		struct mnt_cache_entry *e = &cache->ents[i];
-		if (!(e->flag & MNT_CACHE_ISTAG))
-			continue;
-		if (strcmp(e->value, devname) == 0 &&	/* dev name */
-		    strcmp(token, e->key) == 0)	/* tag name */
-			return e->key + strlen(token) + 1;	/* tag value */
-	}
+	e = cache_find_devname(cache, devname, token, MNT_CACHE_ISTAG);
+	if (!e)
+		return NULL;
 
-	return NULL;
+	cache_touch_entry(cache, e);
+	return e->key + strlen(token) + 1;	/* tag value */
 }
 
 /**
@@ -335,14 +566,9 @@ int mnt_cache_read_tags(struct libmnt_cache *cache, const char *devname)
 	DBG(CACHE, ul_debugobj(cache, "tags for %s requested", devname));
 
 	/* check if device is already cached */
-	for (i = 0; i < cache->nents; i++) {
-		struct mnt_cache_entry *e = &cache->ents[i];
-		if (!(e->flag & MNT_CACHE_TAGREAD))
-			continue;
-		if (strcmp(e->value, devname) == 0)
-			/* tags have already been read */
-			return 0;
-	}
+	if (cache_find_devname(cache, devname, NULL, MNT_CACHE_TAGREAD))
+		/* tags have already been read */
+		return 0;
 
 	pr =  blkid_new_probe_from_filename(devname);
 	if (!pr)
@@ -739,6 +965,8 @@ int test_resolve_path(struct libmnt_test *ts, int argc, char *argv[])
 	cache = mnt_new_cache();
 	if (!cache)
 		return -ENOMEM;
+	if (argc > 1)
+		mnt_cache_set_memory_limit(cache, strtoul(argv[1], NULL, 10));
 
 	while(fgets(line, sizeof(line), stdin)) {
 		size_t sz = strlen(line);
@@ -749,6 +977,9 @@ int test_resolve_path(struct libmnt_test *ts, int argc, char *argv[])
 
 		p = mnt_resolve_path(line, cache);
 		printf("%s : %s\n", line, p);
+
+		/* the result is not used anymore */
+		mnt_cache_shrink(cache);
 	}
 	mnt_unref_cache(cache);
 	return 0;
@@ -781,7 +1012,7 @@ int test_read_tags(struct libmnt_test *ts, int argc, char *argv[])
 {
 	char line[BUFSIZ];
 	struct libmnt_cache *cache;
-	size_t i;
+	struct list_head *p;
 
 	cache = mnt_new_cache();
 	if (!cache)
@@ -816,8 +1047,9 @@ int test_read_tags(struct libmnt_test *ts, int argc, char *argv[])
 		}
 	}
 
-	for (i = 0; i < cache->nents; i++) {
-		struct mnt_cache_entry *e = &cache->ents[i];
+	list_for_each(p, &cache->lru) {
+		struct mnt_cache_entry *e = list_entry(p,
+					struct mnt_cache_entry, lru);
 		if (!(e->flag & MNT_CACHE_ISTAG))
 			continue;
 
@@ -833,7 +1065,7 @@ int test_read_tags(struct libmnt_test *ts, int argc, char *argv[])
 int main(int argc, char *argv[])
 {
 	struct libmnt_test ts[] = {
-		{ "--resolve-path", test_resolve_path, "  resolve paths from stdin" },
+		{ "--resolve-path", test_resolve_path, "[<limit>]  resolve paths from stdin" },
 		{ "--resolve-spec", test_resolve_spec, "  evaluate specs from stdin" },
 		{ "--read-tags", test_read_tags,       "  read devname or TAG from stdin (\"quit\" to exit)" },
 		{ NULL }
@@ -171,6 +171,11 @@ static int fix_optstr(struct libmnt_context *cxt)
 
 	fs = cxt->fs;
 
+	/* the options are modified in place below */
+	rc = mnt_fs_unshare(fs);
+	if (rc)
+		goto done;
+
 	/*
 	 * The "user" options is our business (so we can modify the option),
 	 * the exception is command line for /sbin/mount.<type> helpers. Let's
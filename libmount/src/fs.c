@@ -38,6 +38,76 @@ struct libmnt_fs *mnt_new_fs(void)
 	return fs;
 }
 
+/*
+ * The mountinfo parser stores the strings in the parser arena (see
+ * struct libmnt_arena), these strings are not allocated by malloc().
+ */
+static inline int fs_str_in_arena(const struct libmnt_fs *fs, const char *str)
+{
+	return str && fs->arena
+		&& str >= fs->arena->data
+		&& str < fs->arena->data + fs->arena->size;
+}
+
+static inline void fs_free_str(struct libmnt_fs *fs, char *str)
+{
+	if (!fs_str_in_arena(fs, str))
+		free(str);
+}
+
+/* makes a private copy of the arena string; necessary before realloc() */
+static int fs_unshare_str(struct libmnt_fs *fs, char **str)
+{
+	char *p;
+
+	if (!fs_str_in_arena(fs, *str))
+		return 0;
+	p = strdup(*str);
+	if (!p)
+		return -ENOMEM;
+	*str = p;
+	return 0;
+}
+
+/*
+ * Copies all strings from the parser arena, the @fs is independent on the
+ * arena after this call.
+ *
+ * Returns: 0 on success or negative number in case of error.
+ */
+int mnt_fs_unshare(struct libmnt_fs *fs)
+{
+	int rc = 0;
+
+	assert(fs);
+
+	if (!fs->arena)
+		return 0;
+
+	DBG(FS, ul_debugobj(fs, "unshare arena strings"));
+
+	if (!rc)
+		rc = fs_unshare_str(fs, &fs->source);
+	if (!rc)
+		rc = fs_unshare_str(fs, &fs->root);
+	if (!rc)
+		rc = fs_unshare_str(fs, &fs->target);
+	if (!rc)
+		rc = fs_unshare_str(fs, &fs->fstype);
+	if (!rc)
+		rc = fs_unshare_str(fs, &fs->vfs_optstr);
+	if (!rc)
+		rc = fs_unshare_str(fs, &fs->opt_fields);
+	if (!rc)
+		rc = fs_unshare_str(fs, &fs->fs_optstr);
+	if (rc)
+		return rc;
+
+	mnt_unref_arena(fs->arena);
+	fs->arena = NULL;
+	return 0;
+}
+
 /**
  * mnt_free_fs:
  * @fs: fs pointer
@@ -51,25 +121,28 @@ void mnt_free_fs(struct libmnt_fs *fs)
 {
 	if (!fs)
 		return;
+	if (fs->tab)
+		mnt_table_reset_index(fs->tab);
 	list_del(&fs->ents);
 	DBG(FS, ul_debugobj(fs, "free [refcount=%d]", fs->refcount));
 
-	free(fs->source);
+	fs_free_str(fs, fs->source);
 	free(fs->bindsrc);
 	free(fs->tagname);
 	free(fs->tagval);
-	free(fs->root);
+	fs_free_str(fs, fs->root);
 	free(fs->swaptype);
-	free(fs->target);
-	free(fs->fstype);
+	fs_free_str(fs, fs->target);
+	fs_free_str(fs, fs->fstype);
 	free(fs->optstr);
-	free(fs->vfs_optstr);
-	free(fs->fs_optstr);
+	fs_free_str(fs, fs->vfs_optstr);
+	fs_free_str(fs, fs->fs_optstr);
 	free(fs->user_optstr);
 	free(fs->attrs);
-	free(fs->opt_fields);
+	fs_free_str(fs, fs->opt_fields);
 	free(fs->comment);
 
+	mnt_unref_arena(fs->arena);
 	free(fs);
 }
 
@@ -223,6 +296,8 @@ struct libmnt_fs *mnt_copy_fs(struct libmnt_fs *dest,
 	dest->usedsize   = src->usedsize;
 	dest->priority   = src->priority;
 
+	if (dest->tab)
+		mnt_table_reset_index(dest->tab);
 	return dest;
 err:
 	if (!org)
@@ -379,7 +454,7 @@ int __mnt_fs_set_source_ptr(struct libmnt_fs *fs, char *source)
 	}
 
 	if (fs->source != source)
-		free(fs->source);
+		fs_free_str(fs, fs->source);
 
 	free(fs->tagname);
 	free(fs->tagval);
@@ -387,6 +462,9 @@ int __mnt_fs_set_source_ptr(struct libmnt_fs *fs, char *source)
 	fs->source = source;
 	fs->tagname = t;
 	fs->tagval = v;
+
+	if (fs->tab)
+		mnt_table_reset_index(fs->tab);
 	return 0;
 }
 
@@ -543,9 +621,11 @@ int mnt_fs_set_target(struct libmnt_fs *fs, const char *target)
 		if (!p)
 			return -ENOMEM;
 	}
-	free(fs->target);
+	fs_free_str(fs, fs->target);
 	fs->target = p;
 
+	if (fs->tab)
+		mnt_table_reset_index(fs->tab);
 	return 0;
 }
 
@@ -655,7 +735,7 @@ int __mnt_fs_set_fstype_ptr(struct libmnt_fs *fs, char *fstype)
 	assert(fs);
 
 	if (fstype != fs->fstype)
-		free(fs->fstype);
+		fs_free_str(fs, fs->fstype);
 
 	fs->fstype = fstype;
 	fs->flags &= ~MNT_FS_PSEUDO;
@@ -837,8 +917,8 @@ int mnt_fs_set_options(struct libmnt_fs *fs, const char *optstr)
 		}
 	}
 
-	free(fs->fs_optstr);
-	free(fs->vfs_optstr);
+	fs_free_str(fs, fs->fs_optstr);
+	fs_free_str(fs, fs->vfs_optstr);
 	free(fs->user_optstr);
 	free(fs->optstr);
 
@@ -874,8 +954,16 @@ int mnt_fs_append_options(struct libmnt_fs *fs, const char *optstr)
 		return 0;
 
 	rc = mnt_split_optstr((char *) optstr, &u, &v, &f, 0, 0);
-	if (rc)
+	if (!rc)
+		rc = fs_unshare_str(fs, &fs->vfs_optstr);
+	if (!rc)
+		rc = fs_unshare_str(fs, &fs->fs_optstr);
+	if (rc) {
+		free(v);
+		free(f);
+		free(u);
 		return rc;
+	}
 
 	if (!rc && v)
 		rc = mnt_optstr_append_option(&fs->vfs_optstr, v, NULL);
@@ -917,8 +1005,16 @@ int mnt_fs_prepend_options(struct libmnt_fs *fs, const char *optstr)
 		return 0;
 
 	rc = mnt_split_optstr((char *) optstr, &u, &v, &f, 0, 0);
-	if (rc)
+	if (!rc)
+		rc = fs_unshare_str(fs, &fs->vfs_optstr);
+	if (!rc)
+		rc = fs_unshare_str(fs, &fs->fs_optstr);
+	if (rc) {
+		free(v);
+		free(f);
+		free(u);
 		return rc;
+	}
 
 	if (!rc && v)
 		rc = mnt_optstr_prepend_option(&fs->vfs_optstr, v, NULL);
@@ -1142,7 +1238,7 @@ int mnt_fs_set_root(struct libmnt_fs *fs, const char *root)
 		if (!p)
 			return -ENOMEM;
 	}
-	free(fs->root);
+	fs_free_str(fs, fs->root);
 	fs->root = p;
 	return 0;
 }
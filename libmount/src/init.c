@@ -30,6 +30,7 @@ UL_DEBUG_DEFINE_MASKANEMS(libmount) =
 	{ "utils", MNT_DEBUG_UTILS },
 	{ "cxt", MNT_DEBUG_CXT },
 	{ "diff", MNT_DEBUG_DIFF },
+	{ "monitor", MNT_DEBUG_MONITOR },
 	{ NULL, 0 }
 };
 
@@ -0,0 +1,701 @@
+/*
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ */
+
+/**
+ * SECTION: monitor
+ * @title: Monitor
+ * @short_description: incrementally updated table of the mounted filesystems
+ *
+ * The monitor keeps a table of the mounted filesystems and updates the table
+ * in place when the mountinfo file is changed. The mount IDs are used as
+ * stable keys; only new and modified mountinfo lines are parsed and the
+ * unchanged entries are kept in the table. The changes are reported by
+ * struct libmnt_tabdiff, so the monitor is an alternative to
+ * mnt_diff_tables() for long-running processes.
+ *
+ * <informalexample>
+ *   <programlisting>
+ *	struct libmnt_monitor *mn = mnt_new_monitor();
+ *	struct libmnt_tabdiff *df = mnt_new_tabdiff();
+ *
+ *	mnt_monitor_update(mn, NULL);		// read the current state
+ *
+ *	while (mnt_monitor_wait(mn, -1) > 0) {
+ *		mnt_monitor_update(mn, df);
+ *		while (mnt_tabdiff_next_change(df, itr, &old, &new, &oper) == 0)
+ *			...
+ *	}
+ *   </programlisting>
+ * </informalexample>
+ *
+ * Note that the entries in the monitor table must not be modified by
+ * the caller.
+ */
+#include <poll.h>
+
+#include "mountP.h"
+#include "pathnames.h"
+
+struct monitor_entry {
+	int			id;		/* mount ID */
+	unsigned int		gen;		/* the last update with the entry */
+	size_t			len;		/* size of the line */
+	char			*line;		/* mountinfo line (not terminated) */
+	struct libmnt_fs	*fs;		/* entry in the monitor table */
+	struct monitor_entry	*next;		/* hash chain */
+};
+
+struct libmnt_monitor {
+	int			refcount;
+	int			fd;		/* file descriptor for poll() */
+	char			*filename;	/* mountinfo path */
+	pid_t			tid;		/* TID for kernel_fs_postparse() */
+
+	struct libmnt_table	*tb;		/* the current table */
+
+	char			*buf;		/* file content */
+	size_t			bufsz;		/* allocated size of buf */
+
+	struct monitor_entry	**ents;		/* entries hashed by mount ID */
+	size_t			nbuckets;	/* power of 2 */
+	size_t			nents;
+	unsigned int		gen;		/* update counter */
+};
+
+#define MONITOR_HASHSZ		256
+#define MONITOR_BUFSZ		(64 * 1024)
+
+/**
+ * mnt_new_monitor:
+ *
+ * The new monitor follows /proc/self/mountinfo, see mnt_monitor_set_file().
+ *
+ * Returns: newly allocated struct libmnt_monitor or NULL.
+ */
+struct libmnt_monitor *mnt_new_monitor(void)
+{
+	struct libmnt_monitor *mn = calloc(1, sizeof(*mn));
+
+	if (!mn)
+		return NULL;
+
+	mn->refcount = 1;
+	mn->fd = -1;
+	mn->tid = -1;
+
+	mn->tb = mnt_new_table();
+	if (!mn->tb)
+		goto err;
+	mn->tb->fmt = MNT_FMT_MOUNTINFO;
+
+	DBG(MONITOR, ul_debugobj(mn, "alloc"));
+	return mn;
+err:
+	free(mn);
+	return NULL;
+}
+
+/**
+ * mnt_ref_monitor:
+ * @mn: monitor pointer
+ *
+ * Increments reference counter.
+ */
+void mnt_ref_monitor(struct libmnt_monitor *mn)
+{
+	if (mn)
+		mn->refcount++;
+}
+
+static void free_monitor_entries(struct libmnt_monitor *mn)
+{
+	size_t i;
+
+	for (i = 0; i < mn->nbuckets; i++) {
+		struct monitor_entry *e = mn->ents[i];
+
+		while (e) {
+			struct monitor_entry *next = e->next;
+
+			mnt_unref_fs(e->fs);
+			free(e->line);
+			free(e);
+			e = next;
+		}
+	}
+	free(mn->ents);
+	mn->ents = NULL;
+	mn->nbuckets = mn->nents = 0;
+}
+
+/**
+ * mnt_unref_monitor:
+ * @mn: monitor pointer
+ *
+ * De-increments reference counter, on zero the @mn is automatically
+ * deallocated.
+ */
+void mnt_unref_monitor(struct libmnt_monitor *mn)
+{
+	if (!mn)
+		return;
+
+	mn->refcount--;
+	if (mn->refcount > 0)
+		return;
+
+	DBG(MONITOR, ul_debugobj(mn, "free"));
+
+	free_monitor_entries(mn);
+	mnt_unref_table(mn->tb);
+	if (mn->fd >= 0)
+		close(mn->fd);
+	free(mn->filename);
+	free(mn->buf);
+	free(mn);
+}
+
+/**
+ * mnt_monitor_set_file:
+ * @mn: monitor pointer
+ * @filename: mountinfo file or NULL for /proc/self/mountinfo
+ *
+ * Sets the followed file. The current table is not reset, so the next
+ * mnt_monitor_update() reports differences against the new file.
+ *
+ * Returns: 0 on success, negative number in case of error.
+ */
+int mnt_monitor_set_file(struct libmnt_monitor *mn, const char *filename)
+{
+	char *p = NULL;
+
+	if (!mn)
+		return -EINVAL;
+	if (filename) {
+		p = strdup(filename);
+		if (!p)
+			return -ENOMEM;
+	}
+
+	free(mn->filename);
+	mn->filename = p;
+	mn->tid = -1;
+
+	if (mn->fd >= 0) {
+		close(mn->fd);
+		mn->fd = -1;
+	}
+	return 0;
+}
+
+static const char *monitor_get_filename(struct libmnt_monitor *mn)
+{
+	return mn->filename ? mn->filename : _PATH_PROC_MOUNTINFO;
+}
+
+/**
+ * mnt_monitor_get_fd:
+ * @mn: monitor pointer
+ *
+ * The file descriptor is usable for poll() or epoll(); the kernel reports
+ * the mount table changes by POLLPRI (EPOLLPRI). Call mnt_monitor_update()
+ * after the event.
+ *
+ * Returns: file descriptor or negative number in case of error.
+ */
+int mnt_monitor_get_fd(struct libmnt_monitor *mn)
+{
+	if (!mn)
+		return -EINVAL;
+
+	if (mn->fd < 0) {
+		const char *filename = monitor_get_filename(mn);
+
+		mn->fd = open(filename, O_RDONLY | O_CLOEXEC);
+		if (mn->fd < 0)
+			return -errno;
+
+		DBG(MONITOR, ul_debugobj(mn, "opened %s [fd=%d]", filename, mn->fd));
+	}
+	return mn->fd;
+}
+
+/**
+ * mnt_monitor_wait:
+ * @mn: monitor pointer
+ * @timeout: number of milliseconds, -1 to block indefinitely
+ *
+ * Waits for a change of the mount table.
+ *
+ * Returns: 1 on change, 0 on timeout, negative number in case of error.
+ */
+int mnt_monitor_wait(struct libmnt_monitor *mn, int timeout)
+{
+	struct pollfd fds[1];
+	int rc, fd = mnt_monitor_get_fd(mn);
+
+	if (fd < 0)
+		return fd;
+
+	fds[0].fd = fd;
+	fds[0].events = POLLPRI;
+	fds[0].revents = 0;
+
+	do {
+		rc = poll(fds, 1, timeout);
+	} while (rc < 0 && errno == EINTR);
+
+	if (rc < 0)
+		return -errno;
+	return rc ? 1 : 0;
+}
+
+/* reads the whole file to mn->buf, returns the file size */
+static ssize_t monitor_read_file(struct libmnt_monitor *mn)
+{
+	size_t sz = 0;
+	int fd = mnt_monitor_get_fd(mn);
+
+	if (fd < 0)
+		return fd;
+	if (lseek(fd, 0, SEEK_SET) < 0)
+		return -errno;
+
+	while (1) {
+		ssize_t ret;
+
+		if (sz + 1 >= mn->bufsz) {
+			size_t n = mn->bufsz ? mn->bufsz * 2 : MONITOR_BUFSZ;
+			char *x = realloc(mn->buf, n);
+
+			if (!x)
+				return -ENOMEM;
+			mn->buf = x;
+			mn->bufsz = n;
+		}
+
+		ret = read(fd, mn->buf + sz, mn->bufsz - sz - 1);
+		if (ret < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			return -errno;
+		}
+		if (ret == 0)
+			break;
+		sz += ret;
+	}
+
+	mn->buf[sz] = '\0';
+	return sz;
+}
+
+static inline size_t monitor_hash(struct libmnt_monitor *mn, int id)
+{
+	return ((unsigned int) id * 2654435761U) & (mn->nbuckets - 1);
+}
+
+static struct monitor_entry *monitor_get_entry(struct libmnt_monitor *mn, int id)
+{
+	struct monitor_entry *e;
+
+	if (!mn->nbuckets)
+		return NULL;
+
+	for (e = mn->ents[monitor_hash(mn, id)]; e; e = e->next) {
+		if (e->id == id)
+			return e;
+	}
+	return NULL;
+}
+
+static int monitor_resize(struct libmnt_monitor *mn)
+{
+	struct monitor_entry **old = mn->ents;
+	size_t i, oldsz = mn->nbuckets;
+	size_t sz = oldsz ? oldsz * 2 : MONITOR_HASHSZ;
+
+	mn->ents = calloc(sz, sizeof(struct monitor_entry *));
+	if (!mn->ents) {
+		mn->ents = old;
+		return -ENOMEM;
+	}
+	mn->nbuckets = sz;
+
+	for (i = 0; i < oldsz; i++) {
+		struct monitor_entry *e = old[i];
+
+		while (e) {
+			struct monitor_entry *next = e->next;
+			size_t h = monitor_hash(mn, e->id);
+
+			e->next = mn->ents[h];
+			mn->ents[h] = e;
+			e = next;
+		}
+	}
+	free(old);
+	return 0;
+}
+
+static struct monitor_entry *monitor_new_entry(struct libmnt_monitor *mn, int id)
+{
+	struct monitor_entry *e;
+	size_t h;
+
+	if (mn->nents >= mn->nbuckets && monitor_resize(mn) != 0)
+		return NULL;
+
+	e = calloc(1, sizeof(*e));
+	if (!e)
+		return NULL;
+
+	e->id = id;
+	h = monitor_hash(mn, id);
+	e->next = mn->ents[h];
+	mn->ents[h] = e;
+	mn->nents++;
+	return e;
+}
+
+static void monitor_remove_entry(struct libmnt_monitor *mn, struct monitor_entry *e)
+{
+	struct monitor_entry **p = &mn->ents[monitor_hash(mn, e->id)];
+
+	while (*p && *p != e)
+		p = &(*p)->next;
+	if (*p)
+		*p = e->next;
+
+	mnt_unref_fs(e->fs);
+	free(e->line);
+	free(e);
+	mn->nents--;
+}
+
+static int monitor_set_line(struct monitor_entry *e, const char *line, size_t len)
+{
+	char *p = realloc(e->line, len);
+
+	if (!p && len)
+		return -ENOMEM;
+	memcpy(p, line, len);
+	e->line = p;
+	e->len = len;
+	return 0;
+}
+
+static inline int streq_or_null(const char *a, const char *b)
+{
+	return (!a && !b) || (a && b && strcmp(a, b) == 0);
+}
+
+/* returns MNT_TABDIFF_* for the modified mountinfo line or 0 */
+static int monitor_get_change(struct libmnt_fs *old, struct libmnt_fs *new)
+{
+	const char *v1, *v2, *f1, *f2;
+
+	if (!streq_or_null(mnt_fs_get_source(old), mnt_fs_get_source(new)))
+		return -1;		/* reused ID */
+
+	if (!streq_or_null(mnt_fs_get_target(old), mnt_fs_get_target(new)))
+		return MNT_TABDIFF_MOVE;
+
+	v1 = mnt_fs_get_vfs_options(old);
+	v2 = mnt_fs_get_vfs_options(new);
+	f1 = mnt_fs_get_fs_options(old);
+	f2 = mnt_fs_get_fs_options(new);
+
+	if ((v1 && v2 && strcmp(v1, v2)) || (f1 && f2 && strcmp(f1, f2)))
+		return MNT_TABDIFF_REMOUNT;
+	return 0;
+}
+
+/* reports broken line by the table parser error callback */
+static int monitor_parse_error(struct libmnt_monitor *mn, int nlines)
+{
+	struct libmnt_table *tb = mn->tb;
+	int rc;
+
+	if (!tb->errcb)
+		return 0;
+	rc = tb->errcb(tb, monitor_get_filename(mn), nlines);
+	return rc < 0 ? rc : 0;
+}
+
+/* applies one mountinfo line to the table */
+static int monitor_apply_line(struct libmnt_monitor *mn,
+			      struct libmnt_tabdiff *df,
+			      const char *line, size_t len, int nlines)
+{
+	struct monitor_entry *e;
+	struct libmnt_fs *fs = NULL, *old;
+	char *end = NULL;
+	int id, rc, change;
+
+	errno = 0;
+	id = strtol(line, &end, 10);
+	if (errno || !end || end == line || end >= line + len) {
+		DBG(MONITOR, ul_debugobj(mn, "ignore unparsable line"));
+		return monitor_parse_error(mn, nlines);
+	}
+
+	e = monitor_get_entry(mn, id);
+	if (e && e->gen == mn->gen) {
+		DBG(MONITOR, ul_debugobj(mn, "ignore duplicate ID %d", id));
+		return 0;
+	}
+	if (e && e->len == len && memcmp(e->line, line, len) == 0) {
+		e->gen = mn->gen;		/* unchanged */
+		return 0;
+	}
+
+	rc = __mnt_table_parse_mountinfo_line(mn->tb, line, len,
+				monitor_get_filename(mn), &mn->tid, &fs);
+	if (rc == -ENOMEM)
+		return rc;
+	if (rc) {
+		DBG(MONITOR, ul_debugobj(mn, "ignore broken line [ID=%d]", id));
+		return monitor_parse_error(mn, nlines);
+	}
+
+	if (!e) {
+		/* new mountpoint */
+		e = monitor_new_entry(mn, id);
+		if (!e || monitor_set_line(e, line, len) != 0) {
+			if (e)
+				monitor_remove_entry(mn, e);
+			mnt_unref_fs(fs);
+			return -ENOMEM;
+		}
+		e->fs = fs;
+		e->gen = mn->gen;
+
+		rc = mnt_table_add_fs(mn->tb, fs);
+		if (!rc && df)
+			rc = mnt_tabdiff_add_entry(df, NULL, fs, MNT_TABDIFF_MOUNT);
+		return rc;
+	}
+
+	/* modified mountpoint */
+	rc = monitor_set_line(e, line, len);
+	if (rc) {
+		mnt_unref_fs(fs);
+		return rc;
+	}
+	old = e->fs;
+	e->fs = fs;
+	e->gen = mn->gen;
+
+	rc = mnt_table_replace_fs(mn->tb, old, fs);
+	change = monitor_get_change(old, fs);
+
+	if (!rc && df && change < 0) {
+		rc = mnt_tabdiff_add_entry(df, old, NULL, MNT_TABDIFF_UMOUNT);
+		if (!rc)
+			rc = mnt_tabdiff_add_entry(df, NULL, fs, MNT_TABDIFF_MOUNT);
+	} else if (!rc && df && change > 0)
+		rc = mnt_tabdiff_add_entry(df, old, fs, change);
+
+	mnt_unref_fs(old);
+	return rc;
+}
+
+/**
+ * mnt_monitor_update:
+ * @mn: monitor pointer
+ * @df: diff handler or NULL
+ *
+ * Reads the mountinfo file and applies the changes to the monitor table
+ * (see mnt_monitor_get_table()). The first update reads the current state.
+ * Only the new and modified lines are parsed, the unchanged entries are
+ * kept in the table. Broken lines are ignored and reported by the table
+ * parser error callback, see mnt_table_set_parser_errcb().
+ *
+ * The changes are stored in @df and accessible by mnt_tabdiff_next_change().
+ *
+ * Returns: number of changes, negative number in case of error.
+ */
+int mnt_monitor_update(struct libmnt_monitor *mn, struct libmnt_tabdiff *df)
+{
+	struct libmnt_iter itr;
+	struct libmnt_fs *fs;
+	char *p, *end;
+	ssize_t sz;
+	int rc = 0, nchanges = 0, nlines = 0;
+
+	if (!mn)
+		return -EINVAL;
+	if (df)
+		mnt_tabdiff_reset(df);
+
+	sz = monitor_read_file(mn);
+	if (sz < 0)
+		return sz;
+
+	mn->gen++;
+	DBG(MONITOR, ul_debugobj(mn, "update #%u [%zd bytes, %zu entries]",
+				mn->gen, sz, mn->nents));
+
+	/* new and modified entries */
+	for (p = mn->buf, end = mn->buf + sz; rc == 0 && p < end; ) {
+		char *nl = memchr(p, '\n', end - p);
+		size_t len = nl ? (size_t) (nl - p) : (size_t) (end - p);
+
+		nlines++;
+		if (len)
+			rc = monitor_apply_line(mn, df, p, len, nlines);
+		p += len + 1;
+	}
+	if (rc)
+		goto done;
+
+	/* removed entries */
+	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
+	while (mnt_table_next_fs(mn->tb, &itr, &fs) == 0) {
+		struct monitor_entry *e = monitor_get_entry(mn, mnt_fs_get_id(fs));
+
+		if (e && e->fs == fs && e->gen == mn->gen)
+			continue;
+		if (df) {
+			rc = mnt_tabdiff_add_entry(df, fs, NULL, MNT_TABDIFF_UMOUNT);
+			if (rc)
+				goto done;
+		}
+		if (e && e->fs == fs)
+			monitor_remove_entry(mn, e);
+		mnt_table_remove_fs(mn->tb, fs);
+	}
+done:
+	if (df)
+		nchanges = mnt_tabdiff_get_nchanges(df);
+
+	DBG(MONITOR, ul_debugobj(mn, "update done [rc=%d, changes=%d]", rc, nchanges));
+	return rc ? rc : nchanges;
+}
+
+/**
+ * mnt_monitor_get_table:
+ * @mn: monitor pointer
+ *
+ * The table is updated by mnt_monitor_update() and it's valid as long as the
+ * monitor is referenced; use mnt_ref_table() to keep it longer. Don't modify
+ * the table or the entries, only mnt_table_set_parser_errcb() is allowed.
+ *
+ * Returns: the table with the current mountinfo entries.
+ */
+struct libmnt_table *mnt_monitor_get_table(struct libmnt_monitor *mn)
+{
+	return mn ? mn->tb : NULL;
+}
+
+#ifdef TEST_PROGRAM
+
+static void print_changes(struct libmnt_tabdiff *df)
+{
+	struct libmnt_iter *itr = mnt_new_iter(MNT_ITER_FORWARD);
+	struct libmnt_fs *old, *new;
+	int change;
+
+	if (!itr)
+		return;
+
+	while(mnt_tabdiff_next_change(df, itr, &old, &new, &change) == 0) {
+
+		printf("%s on %s: ", mnt_fs_get_source(new ? new : old),
+				     mnt_fs_get_target(new ? new : old));
+
+		switch(change) {
+		case MNT_TABDIFF_MOVE:
+			printf("MOVED from %s\n", mnt_fs_get_target(old));
+			break;
+		case MNT_TABDIFF_UMOUNT:
+			printf("UMOUNTED\n");
+			break;
+		case MNT_TABDIFF_REMOUNT:
+			printf("REMOUNTED from '%s' to '%s'\n",
+					mnt_fs_get_options(old),
+					mnt_fs_get_options(new));
+			break;
+		case MNT_TABDIFF_MOUNT:
+			printf("MOUNTED\n");
+			break;
+		default:
+			printf("unknown change!\n");
+		}
+	}
+	mnt_free_iter(itr);
+}
+
+int test_update(struct libmnt_test *ts, int argc, char *argv[])
+{
+	struct libmnt_monitor *mn = mnt_new_monitor();
+	struct libmnt_tabdiff *df = mnt_new_tabdiff();
+	int i, rc = -1;
+
+	if (!mn || !df) {
+		warnx("failed to allocate resources");
+		goto done;
+	}
+
+	for (i = 1; i < argc; i++) {
+		rc = mnt_monitor_set_file(mn, argv[i]);
+		if (!rc)
+			rc = mnt_monitor_update(mn, i == 1 ? NULL : df);
+		if (rc < 0)
+			goto done;
+		if (i > 1) {
+			printf("%s:\n", argv[i]);
+			print_changes(df);
+		}
+	}
+
+	printf("%d entries\n", mnt_table_get_nents(mnt_monitor_get_table(mn)));
+	rc = 0;
+done:
+	mnt_free_tabdiff(df);
+	mnt_unref_monitor(mn);
+	return rc;
+}
+
+int test_wait(struct libmnt_test *ts, int argc, char *argv[])
+{
+	struct libmnt_monitor *mn = mnt_new_monitor();
+	struct libmnt_tabdiff *df = mnt_new_tabdiff();
+	int rc = -1;
+
+	if (!mn || !df) {
+		warnx("failed to allocate resources");
+		goto done;
+	}
+
+	rc = mnt_monitor_update(mn, NULL);
+	if (rc < 0)
+		goto done;
+
+	printf("waiting for changes...\n");
+	while ((rc = mnt_monitor_wait(mn, -1)) > 0) {
+		rc = mnt_monitor_update(mn, df);
+		if (rc < 0)
+			break;
+		print_changes(df);
+	}
+done:
+	mnt_free_tabdiff(df);
+	mnt_unref_monitor(mn);
+	return rc < 0 ? rc : 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct libmnt_test tss[] = {
+		{ "--update", test_update, "<file> [<file> ...]  apply changes from the files" },
+		{ "--wait",   test_wait,   "  follow /proc/self/mountinfo" },
+		{ NULL }
+	};
+
+	return mnt_run_test(tss, argc, argv);
+}
+
+#endif /* TEST_PROGRAM */
@@ -48,6 +48,7 @@
 #define MNT_DEBUG_UTILS		(1 << 9)
 #define MNT_DEBUG_CXT		(1 << 10)
 #define MNT_DEBUG_DIFF		(1 << 11)
+#define MNT_DEBUG_MONITOR	(1 << 12)
 #define MNT_DEBUG_ALL		0xFFFF
 
 UL_DEBUG_DECLARE_MASK(libmount);
@@ -79,6 +80,11 @@ extern int mnt_run_test(struct libmnt_test *tests, int argc, char *argv[]);
 #endif
 
 /* utils.c */
+#define MNT_HASH_INIT	2166136261U
+extern unsigned int mnt_hash_data(unsigned int hash, const void *data, size_t len);
+extern unsigned int mnt_hash_path(const char *path)
+			__attribute__((nonnull));
+
 extern int mnt_valid_tagname(const char *tagname);
 extern int append_string(char **a, const char *b);
 
@@ -109,6 +115,11 @@ extern void mnt_free_filesystems(char **filesystems);
 extern char *mnt_get_kernel_cmdline_option(const char *name);
 
 /* tab.c */
+extern void mnt_table_reset_index(struct libmnt_table *tb);
+extern struct libmnt_fs *mnt_table_find_id(struct libmnt_table *tb, int id);
+extern int mnt_table_replace_fs(struct libmnt_table *tb, struct libmnt_fs *old,
+				struct libmnt_fs *fs);
+
 extern int mnt_table_set_parser_fltrcb(	struct libmnt_table *tb,
 					int (*cb)(struct libmnt_fs *, void *),
 					void *data);
@@ -149,6 +160,18 @@ struct libmnt_iter {
 	} while(0)
 
 
+/*
+ * Parser arena -- the whole file in one buffer, the mountinfo parser stores
+ * the fs strings as slices of the buffer. Every fs with strings in the arena
+ * keeps a reference.
+ */
+struct libmnt_arena {
+	int		refcount;
+	size_t		size;		/* allocated size of data[] */
+	size_t		used;		/* file size */
+	char		data[];
+};
+
 /*
  * This struct represents one entry in a mtab/fstab/mountinfo file.
  * (note that fstab[1] means the first column from fstab, and so on...)
@@ -193,6 +216,9 @@ struct libmnt_fs {
 
 	char		*comment;	/* fstab comment */
 
+	struct libmnt_table *tab;	/* table with the entry or NULL */
+	struct libmnt_arena *arena;	/* parser buffer with strings or NULL */
+
 	void		*userdata;	/* library independent data */
 };
 
@@ -209,6 +235,21 @@ struct libmnt_fs {
 				   || mnt_fs_is_netfs(_f) \
 				   || mnt_fs_is_swaparea(_f)))
 
+/*
+ * Lookup indexes for libmnt_table, see tab.c
+ */
+enum {
+	MNT_TABIDX_TARGET = 0,		/* target path */
+	MNT_TABIDX_SRCPATH,		/* source path (not tags) */
+	MNT_TABIDX_DEVNO,		/* st_dev */
+	MNT_TABIDX_ID,			/* mountinfo ID */
+	MNT_TABIDX_PARENT,		/* mountinfo parent ID */
+
+	MNT_TABIDX_NR
+};
+
+struct libmnt_tabidx;
+
 /*
  * mtab/fstab/mountinfo file
  */
@@ -231,9 +272,16 @@ struct libmnt_table {
 
 	struct list_head	ents;	/* list of entries (libmnt_fs) */
 	void		*userdata;
+
+	struct libmnt_tabidx	*idx[MNT_TABIDX_NR];	/* lazy lookup indexes */
 };
 
 extern struct libmnt_table *__mnt_new_table_from_file(const char *filename, int fmt);
+extern void mnt_unref_arena(struct libmnt_arena *ar);
+extern int __mnt_table_parse_mountinfo_line(struct libmnt_table *tb,
+				const char *line, size_t len,
+				const char *filename, pid_t *tid,
+				struct libmnt_fs **fs);
 
 /*
  * Tab file format
@@ -345,6 +393,9 @@ struct libmnt_context
 /* default flags */
 #define MNT_FL_DEFAULT		0
 
+/* cache.c */
+extern void mnt_cache_shrink(struct libmnt_cache *cache);
+
 /* lock.c */
 extern int mnt_lock_use_simplelock(struct libmnt_lock *ml, int enable);
 
@@ -370,6 +421,13 @@ extern int __mnt_fs_set_source_ptr(struct libmnt_fs *fs, char *source)
 			__attribute__((nonnull(1)));
 extern int __mnt_fs_set_fstype_ptr(struct libmnt_fs *fs, char *fstype)
 			__attribute__((nonnull(1)));
+extern int mnt_fs_unshare(struct libmnt_fs *fs);
+
+/* tab_diff.c */
+extern int mnt_tabdiff_reset(struct libmnt_tabdiff *df);
+extern int mnt_tabdiff_add_entry(struct libmnt_tabdiff *df, struct libmnt_fs *old,
+				 struct libmnt_fs *new, int oper);
+extern int mnt_tabdiff_get_nchanges(struct libmnt_tabdiff *df);
 
 /* context.c */
 extern int mnt_context_mtab_writable(struct libmnt_context *cxt);
@@ -62,6 +62,218 @@ static int is_mountinfo(struct libmnt_table *tb)
 	return 0;
 }
 
+/*
+ * Lookup indexes
+ *
+ * The indexes are hash tables with pointers to the table entries. The index is
+ * built on the first lookup and it is dropped when the table is modified
+ * (add/remove entry) or when any indexed field of the entry is modified (see
+ * fs->tab). The hash chains keep the table order, so the lookups return the
+ * same entries as the linear search.
+ */
+struct mnt_tabidx_ent {
+	struct libmnt_fs	*fs;
+	unsigned int		hash;
+	struct mnt_tabidx_ent	*next;
+};
+
+struct libmnt_tabidx {
+	size_t			nbuckets;	/* power of 2 */
+	size_t			ntags;		/* number of entries with tags */
+	struct mnt_tabidx_ent	**buckets;
+	struct mnt_tabidx_ent	ents[];
+};
+
+static const char *tabidx_names[] = {
+	[MNT_TABIDX_TARGET]  = "target",
+	[MNT_TABIDX_SRCPATH] = "srcpath",
+	[MNT_TABIDX_DEVNO]   = "devno",
+	[MNT_TABIDX_ID]      = "id",
+	[MNT_TABIDX_PARENT]  = "parent"
+};
+
+static unsigned int tabidx_hash_key(int type, const void *key)
+{
+	switch (type) {
+	case MNT_TABIDX_TARGET:
+	case MNT_TABIDX_SRCPATH:
+		return mnt_hash_path((const char *) key);
+	case MNT_TABIDX_DEVNO:
+		return mnt_hash_data(MNT_HASH_INIT, key, sizeof(dev_t));
+	case MNT_TABIDX_ID:
+	case MNT_TABIDX_PARENT:
+		return mnt_hash_data(MNT_HASH_INIT, key, sizeof(int));
+	}
+	return 0;
+}
+
+/* returns 0 and @hash if the @fs is indexable, or 1 */
+static int tabidx_hash_fs(int type, struct libmnt_fs *fs, unsigned int *hash)
+{
+	const char *p;
+
+	switch (type) {
+	case MNT_TABIDX_TARGET:
+		p = mnt_fs_get_target(fs);
+		if (!p)
+			return 1;
+		*hash = tabidx_hash_key(type, p);
+		break;
+	case MNT_TABIDX_SRCPATH:
+		p = mnt_fs_get_srcpath(fs);
+		if (!p)
+			return 1;
+		*hash = tabidx_hash_key(type, p);
+		break;
+	case MNT_TABIDX_DEVNO:
+		*hash = tabidx_hash_key(type, &fs->devno);
+		break;
+	case MNT_TABIDX_ID:
+		*hash = tabidx_hash_key(type, &fs->id);
+		break;
+	case MNT_TABIDX_PARENT:
+		*hash = tabidx_hash_key(type, &fs->parent);
+		break;
+	}
+	return 0;
+}
+
+static int tabidx_match(int type, struct libmnt_fs *fs, const void *key)
+{
+	switch (type) {
+	case MNT_TABIDX_TARGET:
+		return mnt_fs_streq_target(fs, (const char *) key);
+	case MNT_TABIDX_SRCPATH:
+		return mnt_fs_streq_srcpath(fs, (const char *) key);
+	case MNT_TABIDX_DEVNO:
+		return fs->devno == *((const dev_t *) key);
+	case MNT_TABIDX_ID:
+		return fs->id == *((const int *) key);
+	case MNT_TABIDX_PARENT:
+		return fs->parent == *((const int *) key);
+	}
+	return 0;
+}
+
+static struct libmnt_tabidx *table_get_index(struct libmnt_table *tb, int type)
+{
+	struct libmnt_tabidx *idx;
+	struct list_head *p;
+	size_t nbuckets = 16, n = 0;
+
+	if (tb->idx[type])
+		return tb->idx[type];
+
+	while (nbuckets < (size_t) tb->nents)
+		nbuckets <<= 1;
+
+	idx = calloc(1, sizeof(*idx)
+			+ tb->nents * sizeof(struct mnt_tabidx_ent)
+			+ nbuckets * sizeof(struct mnt_tabidx_ent *));
+	if (!idx)
+		return NULL;
+
+	idx->nbuckets = nbuckets;
+	idx->buckets = (struct mnt_tabidx_ent **) (idx->ents + tb->nents);
+
+	/* backwardly and prepend to the chains to keep the table order */
+	list_for_each_backwardly(p, &tb->ents) {
+		struct libmnt_fs *fs = list_entry(p, struct libmnt_fs, ents);
+		struct mnt_tabidx_ent *e, **b;
+		unsigned int hash;
+
+		if (type == MNT_TABIDX_SRCPATH && mnt_fs_get_tag(fs, NULL, NULL) == 0)
+			idx->ntags++;
+		if (tabidx_hash_fs(type, fs, &hash) != 0)
+			continue;
+		if (n == (size_t) tb->nents)
+			break;			/* nents out of sync, paranoia */
+
+		e = &idx->ents[n++];
+		e->fs = fs;
+		e->hash = hash;
+
+		b = &idx->buckets[hash & (nbuckets - 1)];
+		e->next = *b;
+		*b = e;
+	}
+
+	DBG(TAB, ul_debugobj(tb, "%s index: %zu entries, %zu buckets",
+				tabidx_names[type], n, nbuckets));
+	tb->idx[type] = idx;
+	return idx;
+}
+
+/*
+ * Looks up the first (MNT_ITER_FORWARD) or the last (MNT_ITER_BACKWARD) entry
+ * matching the @key in the index.
+ *
+ * Returns: 0 if the index has been used (@fs is NULL if not found), negative
+ * number if the index is unavailable; the caller has to fallback to the linear
+ * search.
+ */
+static int table_index_find(struct libmnt_table *tb, int type,
+			    const void *key, int direction,
+			    struct libmnt_fs **fs)
+{
+	struct libmnt_tabidx *idx = table_get_index(tb, type);
+	struct mnt_tabidx_ent *e;
+	unsigned int hash;
+
+	*fs = NULL;
+	if (!idx)
+		return -ENOMEM;
+
+	hash = tabidx_hash_key(type, key);
+
+	for (e = idx->buckets[hash & (idx->nbuckets - 1)]; e; e = e->next) {
+		if (e->hash != hash || !tabidx_match(type, e->fs, key))
+			continue;
+		*fs = e->fs;
+		if (direction == MNT_ITER_FORWARD)
+			break;
+	}
+	return 0;
+}
+
+/*
+ * Drops all lookup indexes, the indexes will be rebuilt on the next lookup.
+ */
+void mnt_table_reset_index(struct libmnt_table *tb)
+{
+	size_t i;
+
+	if (!tb)
+		return;
+	for (i = 0; i < ARRAY_SIZE(tb->idx); i++) {
+		free(tb->idx[i]);
+		tb->idx[i] = NULL;
+	}
+}
+
+/*
+ * Returns entry with mountinfo @id or NULL.
+ *
+ * Don't export to library API!
+ */
+struct libmnt_fs *mnt_table_find_id(struct libmnt_table *tb, int id)
+{
+	struct libmnt_iter itr;
+	struct libmnt_fs *fs = NULL;
+
+	if (!tb)
+		return NULL;
+	if (table_index_find(tb, MNT_TABIDX_ID, &id, MNT_ITER_FORWARD, &fs) == 0)
+		return fs;
+
+	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
+	while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
+		if (fs->id == id)
+			return fs;
+	}
+	return NULL;
+}
+
 /**
  * mnt_new_table:
  *
@@ -109,6 +321,10 @@ int mnt_reset_table(struct libmnt_table *tb)
 	}
 
 	tb->nents = 0;
+	mnt_table_reset_index(tb);
+
+	/* nothing refers to the cached strings now */
+	mnt_cache_shrink(tb->cache);
 	return 0;
 }
 
@@ -444,6 +660,8 @@ int mnt_table_add_fs(struct libmnt_table *tb, struct libmnt_fs *fs)
 	mnt_ref_fs(fs);
 	list_add_tail(&fs->ents, &tb->ents);
 	tb->nents++;
+	fs->tab = tb;
+	mnt_table_reset_index(tb);
 
 	DBG(TAB, ul_debugobj(tb, "add entry: %s %s",
 			mnt_fs_get_source(fs), mnt_fs_get_target(fs)));
@@ -472,11 +690,34 @@ int mnt_table_remove_fs(struct libmnt_table *tb, struct libmnt_fs *fs)
 	list_del(&fs->ents);
 	INIT_LIST_HEAD(&fs->ents);	/* otherwise FS still points to the list */
 
+	fs->tab = NULL;
+	mnt_table_reset_index(tb);
+
 	mnt_unref_fs(fs);
 	tb->nents--;
 	return 0;
 }
 
+/*
+ * Replaces @old with @fs at the same position in the table. The @old entry
+ * is unreferenced like by mnt_table_remove_fs().
+ *
+ * Don't export to library API!
+ */
+int mnt_table_replace_fs(struct libmnt_table *tb, struct libmnt_fs *old,
+			 struct libmnt_fs *fs)
+{
+	if (!tb || !old || !fs || old->tab != tb)
+		return -EINVAL;
+
+	mnt_ref_fs(fs);
+	list_add(&fs->ents, &old->ents);
+	fs->tab = tb;
+	tb->nents++;
+
+	return mnt_table_remove_fs(tb, old);
+}
+
 /**
  * mnt_table_get_root_fs:
  * @tb: mountinfo file (/proc/self/mountinfo)
@@ -524,6 +765,24 @@ int mnt_table_get_root_fs(struct libmnt_table *tb, struct libmnt_fs **root)
 	return *root ? 0 : -EINVAL;
 }
 
+static void next_child_update(struct libmnt_fs *fs, int parent_id,
+			      int lastchld_id, struct libmnt_fs **chld,
+			      int *chld_id)
+{
+	int id = mnt_fs_get_id(fs);
+
+	/* avoid an infinite loop. This only happens in rare cases
+	 * such as in early userspace when the rootfs is its own parent */
+	if (id == parent_id)
+		return;
+
+	if ((!lastchld_id || id > lastchld_id) &&
+	    (!*chld || id < *chld_id)) {
+		*chld = fs;
+		*chld_id = id;
+	}
+}
+
 /**
  * mnt_table_next_child_fs:
  * @tb: mountinfo file (/proc/self/mountinfo)
@@ -540,6 +799,7 @@ int mnt_table_next_child_fs(struct libmnt_table *tb, struct libmnt_iter *itr,
 			struct libmnt_fs *parent, struct libmnt_fs **chld)
 {
 	struct libmnt_fs *fs;
+	struct libmnt_tabidx *idx;
 	int parent_id, lastchld_id = 0, chld_id = 0;
 
 	if (!tb || !itr || !parent || !is_mountinfo(tb))
@@ -558,24 +818,25 @@ int mnt_table_next_child_fs(struct libmnt_table *tb, struct libmnt_iter *itr,
 
 	*chld = NULL;
 
-	mnt_reset_iter(itr, MNT_ITER_FORWARD);
-	while(mnt_table_next_fs(tb, itr, &fs) == 0) {
-		int id;
-
-		if (mnt_fs_get_parent_id(fs) != parent_id)
-			continue;
-
-		id = mnt_fs_get_id(fs);
-
-		/* avoid an infinite loop. This only happens in rare cases
-		 * such as in early userspace when the rootfs is its own parent */
-		if (id == parent_id)
-			continue;
+	idx = table_get_index(tb, MNT_TABIDX_PARENT);
+	if (idx) {
+		/* walk the chain with the children only */
+		unsigned int hash = tabidx_hash_key(MNT_TABIDX_PARENT, &parent_id);
+		struct mnt_tabidx_ent *e;
 
-		if ((!lastchld_id || id > lastchld_id) &&
-		    (!*chld || id < chld_id)) {
-			*chld = fs;
-			chld_id = id;
+		for (e = idx->buckets[hash & (idx->nbuckets - 1)]; e; e = e->next) {
+			if (e->hash != hash || e->fs->parent != parent_id)
+				continue;
+			next_child_update(e->fs, parent_id, lastchld_id,
+					  chld, &chld_id);
+		}
+	} else {
+		mnt_reset_iter(itr, MNT_ITER_FORWARD);
+		while(mnt_table_next_fs(tb, itr, &fs) == 0) {
+			if (mnt_fs_get_parent_id(fs) != parent_id)
+				continue;
+			next_child_update(fs, parent_id, lastchld_id,
+					  chld, &chld_id);
 		}
 	}
 
@@ -727,6 +988,7 @@ static int mnt_table_move_parent(struct libmnt_table *tb, int oldid, int newid)
 		if (fs->parent == oldid)
 			fs->parent = newid;
 	}
+	mnt_table_reset_index(tb);
 	return 0;
 }
 
@@ -904,10 +1166,15 @@ struct libmnt_fs *mnt_table_find_target(struct libmnt_table *tb, const char *pat
 	DBG(TAB, ul_debugobj(tb, "lookup TARGET: '%s'", path));
 
 	/* native @target */
-	mnt_reset_iter(&itr, direction);
-	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
-		if (mnt_fs_streq_target(fs, path))
+	if (table_index_find(tb, MNT_TABIDX_TARGET, path, direction, &fs) == 0) {
+		if (fs)
 			return fs;
+	} else {
+		mnt_reset_iter(&itr, direction);
+		while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
+			if (mnt_fs_streq_target(fs, path))
+				return fs;
+		}
 	}
 	if (!tb->cache || !(cn = mnt_resolve_path(path, tb->cache)))
 		return NULL;
@@ -915,10 +1182,15 @@ struct libmnt_fs *mnt_table_find_target(struct libmnt_table *tb, const char *pat
 	DBG(TAB, ul_debugobj(tb, "lookup canonical TARGET: '%s'", cn));
 
 	/* canonicalized paths in struct libmnt_table */
-	mnt_reset_iter(&itr, direction);
-	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
-		if (mnt_fs_streq_target(fs, cn))
+	if (table_index_find(tb, MNT_TABIDX_TARGET, cn, direction, &fs) == 0) {
+		if (fs)
 			return fs;
+	} else {
+		mnt_reset_iter(&itr, direction);
+		while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
+			if (mnt_fs_streq_target(fs, cn))
+				return fs;
+		}
 	}
 
 	/* non-canonicaled path in struct libmnt_table
@@ -978,12 +1250,18 @@ struct libmnt_fs *mnt_table_find_srcpath(struct libmnt_table *tb, const char *pa
 	DBG(TAB, ul_debugobj(tb, "lookup SRCPATH: '%s'", path));
 
 	/* native paths */
-	mnt_reset_iter(&itr, direction);
-	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
-		if (mnt_fs_streq_srcpath(fs, path))
+	if (table_index_find(tb, MNT_TABIDX_SRCPATH, path, direction, &fs) == 0) {
+		if (fs)
 			return fs;
-		if (mnt_fs_get_tag(fs, NULL, NULL) == 0)
-			ntags++;
+		ntags = tb->idx[MNT_TABIDX_SRCPATH]->ntags;
+	} else {
+		mnt_reset_iter(&itr, direction);
+		while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
+			if (mnt_fs_streq_srcpath(fs, path))
+				return fs;
+			if (mnt_fs_get_tag(fs, NULL, NULL) == 0)
+				ntags++;
+		}
 	}
 
 	if (!path || !tb->cache || !(cn = mnt_resolve_path(path, tb->cache)))
@@ -995,10 +1273,15 @@ struct libmnt_fs *mnt_table_find_srcpath(struct libmnt_table *tb, const char *pa
 
 	/* canonicalized paths in struct libmnt_table */
 	if (ntags < nents) {
-		mnt_reset_iter(&itr, direction);
-		while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
-			if (mnt_fs_streq_srcpath(fs, cn))
+		if (table_index_find(tb, MNT_TABIDX_SRCPATH, cn, direction, &fs) == 0) {
+			if (fs)
 				return fs;
+		} else {
+			mnt_reset_iter(&itr, direction);
+			while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
+				if (mnt_fs_streq_srcpath(fs, cn))
+					return fs;
+			}
 		}
 	}
 
@@ -1143,6 +1426,38 @@ struct libmnt_fs *mnt_table_find_source(struct libmnt_table *tb,
 	return fs;
 }
 
+/*
+ * Index based variant of mnt_table_find_pair() for tables without cache, the
+ * hash chain of the @target is evaluated by mnt_fs_match_source() only.
+ *
+ * Returns: 0 if the index has been used or negative number.
+ */
+static int table_index_find_pair(struct libmnt_table *tb, const char *source,
+				 const char *target, int direction,
+				 struct libmnt_fs **fs)
+{
+	struct libmnt_tabidx *idx = table_get_index(tb, MNT_TABIDX_TARGET);
+	struct mnt_tabidx_ent *e;
+	unsigned int hash;
+
+	*fs = NULL;
+	if (!idx)
+		return -ENOMEM;
+
+	hash = tabidx_hash_key(MNT_TABIDX_TARGET, target);
+
+	for (e = idx->buckets[hash & (idx->nbuckets - 1)]; e; e = e->next) {
+		if (e->hash != hash
+		    || !mnt_fs_streq_target(e->fs, target)
+		    || !mnt_fs_match_source(e->fs, source, NULL))
+			continue;
+		*fs = e->fs;
+		if (direction == MNT_ITER_FORWARD)
+			break;
+	}
+	return 0;
+}
+
 /**
  * mnt_table_find_pair
  * @tb: tab pointer
@@ -1153,6 +1468,8 @@ struct libmnt_fs *mnt_table_find_source(struct libmnt_table *tb,
  * This function is implemented by mnt_fs_match_source() and
  * mnt_fs_match_target() functions. It means that this is more expensive than
  * others mnt_table_find_* function, because every @tab entry is fully evaluated.
+ * The lookup index is used for tables without cache, in this case only native
+ * paths and tags are compared.
  *
  * Returns: a tab entry or NULL.
  */
@@ -1172,6 +1489,11 @@ struct libmnt_fs *mnt_table_find_pair(struct libmnt_table *tb, const char *sourc
 
 	DBG(TAB, ul_debugobj(tb, "lookup SOURCE: %s TARGET: %s", source, target));
 
+	/* without cache only native paths are compared, use the index */
+	if (!tb->cache
+	    && table_index_find_pair(tb, source, target, direction, &fs) == 0)
+		return fs;
+
 	mnt_reset_iter(&itr, direction);
 	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
 
@@ -1209,6 +1531,9 @@ struct libmnt_fs *mnt_table_find_devno(struct libmnt_table *tb,
 
 	DBG(TAB, ul_debugobj(tb, "lookup DEVNO: %d", (int) devno));
 
+	if (table_index_find(tb, MNT_TABIDX_DEVNO, &devno, direction, &fs) == 0)
+		return fs;
+
 	mnt_reset_iter(&itr, direction);
 
 	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
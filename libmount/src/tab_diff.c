@@ -19,6 +19,7 @@ struct tabdiff_entry {
 	struct libmnt_fs *new_fs;	/* pointer to the new FS */
 
 	struct list_head changes;
+	struct tabdiff_entry *idnext;	/* next MOUNT entry in the ID hash chain */
 };
 
 struct libmnt_tabdiff {
@@ -26,6 +27,10 @@ struct libmnt_tabdiff {
 
 	struct list_head changes;	/* list with modified entries */
 	struct list_head unused;	/* list with unused entries */
+
+	struct tabdiff_entry **ids;	/* MOUNT entries hashed by mount ID */
+	size_t nids;			/* number of allocated ID buckets */
+	size_t idmask;			/* used buckets - 1, or 0 if not hashed */
 };
 
 /**
@@ -77,7 +82,13 @@ void mnt_free_tabdiff(struct libmnt_tabdiff *df)
 			                  struct tabdiff_entry, changes);
 		free_tabdiff_entry(de);
 	}
+	while (!list_empty(&df->unused)) {
+		struct tabdiff_entry *de = list_entry(df->unused.next,
+			                  struct tabdiff_entry, changes);
+		free_tabdiff_entry(de);
+	}
 
+	free(df->ids);
 	free(df);
 }
 
@@ -122,7 +133,7 @@ int mnt_tabdiff_next_change(struct libmnt_tabdiff *df, struct libmnt_iter *itr,
 	return rc;
 }
 
-static int tabdiff_reset(struct libmnt_tabdiff *df)
+int mnt_tabdiff_reset(struct libmnt_tabdiff *df)
 {
 	assert(df);
 
@@ -145,11 +156,12 @@ static int tabdiff_reset(struct libmnt_tabdiff *df)
 	}
 
 	df->nchanges = 0;
+	df->idmask = 0;
 	return 0;
 }
 
-static int tabdiff_add_entry(struct libmnt_tabdiff *df, struct libmnt_fs *old,
-			     struct libmnt_fs *new, int oper)
+int mnt_tabdiff_add_entry(struct libmnt_tabdiff *df, struct libmnt_fs *old,
+			  struct libmnt_fs *new, int oper)
 {
 	struct tabdiff_entry *de;
 
@@ -184,31 +196,116 @@ static int tabdiff_add_entry(struct libmnt_tabdiff *df, struct libmnt_fs *old,
 	return 0;
 }
 
+int mnt_tabdiff_get_nchanges(struct libmnt_tabdiff *df)
+{
+	return df ? df->nchanges : 0;
+}
+
+static inline unsigned int tabdiff_hash_id(int id)
+{
+	return mnt_hash_data(MNT_HASH_INIT, &id, sizeof(id));
+}
+
+/*
+ * Adds all MOUNT entries to the ID hash. The hash chains keep order of the
+ * changes, so tabdiff_get_mount() returns the same entry as a linear search.
+ */
+static int tabdiff_hash_mounts(struct libmnt_tabdiff *df)
+{
+	struct list_head *p;
+	size_t nbuckets = 16;
+
+	while (nbuckets < (size_t) df->nchanges)
+		nbuckets <<= 1;
+
+	if (nbuckets > df->nids) {
+		struct tabdiff_entry **x = realloc(df->ids, nbuckets * sizeof(*x));
+
+		if (!x)
+			return -ENOMEM;
+		df->ids = x;
+		df->nids = nbuckets;
+	}
+	memset(df->ids, 0, nbuckets * sizeof(*df->ids));
+
+	list_for_each_backwardly(p, &df->changes) {
+		struct tabdiff_entry *de, **b;
+
+		de = list_entry(p, struct tabdiff_entry, changes);
+		if (de->oper != MNT_TABDIFF_MOUNT || !de->new_fs)
+			continue;
+
+		b = &df->ids[tabdiff_hash_id(mnt_fs_get_id(de->new_fs)) & (nbuckets - 1)];
+		de->idnext = *b;
+		*b = de;
+	}
+
+	df->idmask = nbuckets - 1;
+	return 0;
+}
+
+static int tabdiff_is_mount(struct tabdiff_entry *de, const char *src, int id)
+{
+	const char *s;
+
+	if (de->oper != MNT_TABDIFF_MOUNT || !de->new_fs ||
+	    mnt_fs_get_id(de->new_fs) != id)
+		return 0;
+
+	s = mnt_fs_get_source(de->new_fs);
+
+	if (s == NULL && src == NULL)
+		return 1;
+	if (s && src && strcmp(s, src) == 0)
+		return 1;
+	return 0;
+}
+
 static struct tabdiff_entry *tabdiff_get_mount(struct libmnt_tabdiff *df,
 					       const char *src,
 					       int id)
 {
+	struct tabdiff_entry *de;
 	struct list_head *p;
 
 	assert(df);
 
-	list_for_each(p, &df->changes) {
-		struct tabdiff_entry *de;
+	if (df->idmask) {
+		for (de = df->ids[tabdiff_hash_id(id) & df->idmask]; de; de = de->idnext) {
+			if (tabdiff_is_mount(de, src, id))
+				return de;
+		}
+		return NULL;
+	}
 
+	list_for_each(p, &df->changes) {
 		de = list_entry(p, struct tabdiff_entry, changes);
+		if (tabdiff_is_mount(de, src, id))
+			return de;
+	}
+	return NULL;
+}
 
-		if (de->oper == MNT_TABDIFF_MOUNT && de->new_fs &&
-		    mnt_fs_get_id(de->new_fs) == id) {
+/*
+ * Returns entry from @tb with the same mount ID, source and target as @fs. If
+ * there is no such entry (or the table has no mount IDs) then returns the
+ * first entry with the same source and target.
+ */
+static struct libmnt_fs *tabdiff_find_fs(struct libmnt_table *tb,
+					 struct libmnt_fs *fs)
+{
+	const char *src = mnt_fs_get_source(fs),
+		   *tgt = mnt_fs_get_target(fs);
+	int id = mnt_fs_get_id(fs);
 
-			const char *s = mnt_fs_get_source(de->new_fs);
+	if (id > 0 && src && *src && tgt && *tgt) {
+		struct libmnt_fs *x = mnt_table_find_id(tb, id);
 
-			if (s == NULL && src == NULL)
-				return de;
-			if (s && src && strcmp(s, src) == 0)
-				return de;
-		}
+		if (x && mnt_fs_match_target(x, tgt, tb->cache)
+		       && mnt_fs_match_source(x, src, tb->cache))
+			return x;
 	}
-	return NULL;
+	return mnt_table_find_pair(tb, src, tgt, MNT_ITER_FORWARD);
 }
 
 /**
@@ -220,6 +317,10 @@ static struct tabdiff_entry *tabdiff_get_mount(struct libmnt_tabdiff *df,
  * Compares @old_tab and @new_tab, the result is stored in @df and accessible by
  * mnt_tabdiff_next_change().
  *
+ * The entries are joined by mount ID (if available) and by source and target
+ * paths. The lookups are hash based for tables without cache, so the diff
+ * runs in linear time.
+ *
  * Returns: number of changes, negative number in case of error.
  */
 int mnt_diff_tables(struct libmnt_tabdiff *df, struct libmnt_table *old_tab,
@@ -232,7 +333,7 @@ int mnt_diff_tables(struct libmnt_tabdiff *df, struct libmnt_table *old_tab,
 	if (!df || !old_tab || !new_tab)
 		return -EINVAL;
 
-	tabdiff_reset(df);
+	mnt_tabdiff_reset(df);
 
 	no = mnt_table_get_nents(old_tab);
 	nn = mnt_table_get_nents(new_tab);
@@ -249,25 +350,22 @@ int mnt_diff_tables(struct libmnt_tabdiff *df, struct libmnt_table *old_tab,
 	/* all mounted or umounted */
 	if (!no && nn) {
 		while(mnt_table_next_fs(new_tab, &itr, &fs) == 0)
-			tabdiff_add_entry(df, NULL, fs, MNT_TABDIFF_MOUNT);
+			mnt_tabdiff_add_entry(df, NULL, fs, MNT_TABDIFF_MOUNT);
 		goto done;
 
 	} else if (no && !nn) {
 		while(mnt_table_next_fs(old_tab, &itr, &fs) == 0)
-			tabdiff_add_entry(df, fs, NULL, MNT_TABDIFF_UMOUNT);
+			mnt_tabdiff_add_entry(df, fs, NULL, MNT_TABDIFF_UMOUNT);
 		goto done;
 	}
 
 	/* search newly mounted or modified */
 	while(mnt_table_next_fs(new_tab, &itr, &fs) == 0) {
-		struct libmnt_fs *o_fs;
-		const char *src = mnt_fs_get_source(fs),
-			   *tgt = mnt_fs_get_target(fs);
+		struct libmnt_fs *o_fs = tabdiff_find_fs(old_tab, fs);
 
-		o_fs = mnt_table_find_pair(old_tab, src, tgt, MNT_ITER_FORWARD);
 		if (!o_fs)
 			/* 'fs' is not in the old table -- so newly mounted */
-			tabdiff_add_entry(df, NULL, fs, MNT_TABDIFF_MOUNT);
+			mnt_tabdiff_add_entry(df, NULL, fs, MNT_TABDIFF_MOUNT);
 		else {
 			/* is modified? */
 			const char *v1 = mnt_fs_get_vfs_options(o_fs),
@@ -276,27 +374,28 @@ int mnt_diff_tables(struct libmnt_tabdiff *df, struct libmnt_table *old_tab,
 				   *f2 = mnt_fs_get_fs_options(fs);
 
 			if ((v1 && v2 && strcmp(v1, v2)) || (f1 && f2 && strcmp(f1, f2)))
-				tabdiff_add_entry(df, o_fs, fs, MNT_TABDIFF_REMOUNT);
+				mnt_tabdiff_add_entry(df, o_fs, fs, MNT_TABDIFF_REMOUNT);
 		}
 	}
 
 	/* search umounted or moved */
+	if (df->nchanges)
+		tabdiff_hash_mounts(df);	/* on error use linear search */
+
 	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
 	while(mnt_table_next_fs(old_tab, &itr, &fs) == 0) {
-		const char *src = mnt_fs_get_source(fs),
-			   *tgt = mnt_fs_get_target(fs);
-
-		if (!mnt_table_find_pair(new_tab, src, tgt, MNT_ITER_FORWARD)) {
+		if (!tabdiff_find_fs(new_tab, fs)) {
 			struct tabdiff_entry *de;
 
-			de = tabdiff_get_mount(df, src,	mnt_fs_get_id(fs));
+			de = tabdiff_get_mount(df, mnt_fs_get_source(fs),
+						   mnt_fs_get_id(fs));
 			if (de) {
 				mnt_ref_fs(fs);
 				mnt_unref_fs(de->old_fs);
 				de->oper = MNT_TABDIFF_MOVE;
 				de->old_fs = fs;
 			} else
-				tabdiff_add_entry(df, fs, NULL, MNT_TABDIFF_UMOUNT);
+				mnt_tabdiff_add_entry(df, fs, NULL, MNT_TABDIFF_UMOUNT);
 		}
 	}
 done:
@@ -305,6 +404,7 @@ done:
 }
 
 #ifdef TEST_PROGRAM
+#include <sys/time.h>
 
 int test_diff(struct libmnt_test *ts, int argc, char *argv[])
 {
@@ -362,10 +462,116 @@ done:
 	return rc;
 }
 
+/*
+ * Writes synthetic mountinfo with @nents entries to a temporary file in @dir.
+ * If @modified is true then every 10th entry is remounted, moved and umounted
+ * and a new entry is added for every umounted one.
+ */
+static char *bench_mountinfo(const char *dir, int nents, int modified)
+{
+	char *name = NULL;
+	FILE *f;
+	int fd, i;
+
+	if (asprintf(&name, "%s/tabdiff-bench-XXXXXX", dir) < 0)
+		return NULL;
+	fd = mkstemp(name);
+	if (fd < 0 || !(f = fdopen(fd, "w"))) {
+		if (fd >= 0) {
+			close(fd);
+			unlink(name);
+		}
+		free(name);
+		return NULL;
+	}
+
+	for (i = 0; i < nents; i++) {
+		int id = i + 20, n = modified ? i % 10 : -1;
+
+		if (n == 1) {
+			fprintf(f, "%d 19 0:%d / /bench/new/%d rw,relatime - tmpfs new%d rw\n",
+					id + nents, id + nents, i, i);
+			continue;
+		}
+		fprintf(f, "%d 19 0:%d / /bench/%s%d %s,relatime - tmpfs bench%d rw\n",
+				id, id, n == 2 ? "moved/" : "", i,
+				n == 0 ? "ro" : "rw", i);
+	}
+	fclose(f);
+	return name;
+}
+
+int test_bench(struct libmnt_test *ts, int argc, char *argv[])
+{
+	struct libmnt_table *tb_old = NULL, *tb_new = NULL;
+	struct libmnt_tabdiff *diff = NULL;
+	struct libmnt_iter *itr = NULL;
+	struct timeval start, end;
+	char *f_old, *f_new;
+	int nents = argc > 2 ? atoi(argv[2]) : 100000;
+	int rc = -1, change, count[MNT_TABDIFF_PROPAGATION + 1] = { 0 };
+
+	if (argc < 2)
+		return -EINVAL;
+
+	f_old = bench_mountinfo(argv[1], nents, 0);
+	f_new = bench_mountinfo(argv[1], nents, 1);
+	if (!f_old || !f_new) {
+		warn("failed to create mountinfo files");
+		goto done;
+	}
+
+	tb_old = mnt_new_table_from_file(f_old);
+	tb_new = mnt_new_table_from_file(f_new);
+	diff = mnt_new_tabdiff();
+	itr = mnt_new_iter(MNT_ITER_FORWARD);
+
+	if (!tb_old || !tb_new || !diff || !itr) {
+		warnx("failed to allocate resources");
+		goto done;
+	}
+
+	gettimeofday(&start, NULL);
+	rc = mnt_diff_tables(diff, tb_old, tb_new);
+	gettimeofday(&end, NULL);
+	if (rc < 0)
+		goto done;
+
+	while(mnt_tabdiff_next_change(diff, itr, NULL, NULL, &change) == 0) {
+		if (change > 0 && change <= MNT_TABDIFF_PROPAGATION)
+			count[change]++;
+	}
+
+	printf("entries: %d\n", nents);
+	printf("changes: %d\n", rc);
+	printf("mounted: %d\n", count[MNT_TABDIFF_MOUNT]);
+	printf("umounted: %d\n", count[MNT_TABDIFF_UMOUNT]);
+	printf("remounted: %d\n", count[MNT_TABDIFF_REMOUNT]);
+	printf("moved: %d\n", count[MNT_TABDIFF_MOVE]);
+
+	fprintf(stderr, "diff time: %ld ms\n",
+			(end.tv_sec - start.tv_sec) * 1000
+			+ (end.tv_usec - start.tv_usec) / 1000);
+	rc = 0;
+done:
+	if (f_old)
+		unlink(f_old);
+	if (f_new)
+		unlink(f_new);
+	free(f_old);
+	free(f_new);
+	mnt_unref_table(tb_old);
+	mnt_unref_table(tb_new);
+	mnt_free_tabdiff(diff);
+	mnt_free_iter(itr);
+	return rc;
+}
+
 int main(int argc, char *argv[])
 {
 	struct libmnt_test tss[] = {
 		{ "--diff", test_diff, "<old> <new> prints change" },
+		{ "--bench", test_bench, "<dir> [<nents>] diff synthetic mountinfo files in <dir>" },
 		{ NULL }
 	};
 
@@ -208,6 +208,120 @@ static int mnt_parse_mountinfo_line(struct libmnt_fs *fs, char *s)
 	return rc;
 }
 
+static inline char *skip_nonblank(char *p)
+{
+	while (*p && !isblank(*p))
+		++p;
+	return p;
+}
+
+/*
+ * Returns the next blank separated field from @s and terminates the field,
+ * @s is set to the rest of the string.
+ */
+static char *next_field(char **s)
+{
+	char *p = (char *) skip_blank(*s), *end;
+
+	if (!*p)
+		return NULL;
+	end = skip_nonblank(p);
+	if (*end)
+		*end++ = '\0';
+	*s = end;
+	return p;
+}
+
+/*
+ * Parses one line from a mountinfo file in the parser arena. The @fs strings
+ * point to the @s, the line is modified in place (terminated fields,
+ * unmangled strings). The caller has to set fs->arena.
+ */
+static int mnt_parse_mountinfo_arena_line(struct libmnt_fs *fs, char *s)
+{
+	unsigned int maj, min;
+	char *fstype, *src, *p, *end = NULL;
+	size_t sz;
+
+	assert(fs->arena);
+
+	/* (1) id, (2) parent */
+	if (next_number(&s, &fs->id) != 0 || next_number(&s, &fs->parent) != 0)
+		goto err;
+
+	/* (3) maj:min */
+	s = (char *) skip_blank(s);
+	errno = 0;
+	maj = strtoul(s, &end, 10);
+	if (errno || !end || end == s || *end != ':')
+		goto err;
+	s = end + 1;
+	min = strtoul(s, &end, 10);
+	if (errno || !end || end == s || (*end != ' ' && *end != '\t'))
+		goto err;
+	s = end;
+
+	fs->root = next_field(&s);		/* (4) mountroot */
+	fs->target = next_field(&s);		/* (5) target */
+	if (!fs->root || !fs->target)
+		goto err;
+
+	/* (6) vfs options, terminated later, the separator could follow
+	 * immediately after the options */
+	fs->vfs_optstr = p = (char *) skip_blank(s);
+	if (!*p)
+		goto err;
+	s = skip_nonblank(p);
+
+	/* (7) optional fields, terminated by " - " */
+	p = strstr(s, " - ");
+	if (!p)
+		goto err;
+	if (p > s + 1) {
+		fs->opt_fields = s + 1;
+		*p = '\0';
+	}
+	*s = '\0';
+	s = p + 3;
+
+	fstype = next_field(&s);		/* (8) FS type */
+	src = next_field(&s);			/* (9) source */
+	fs->fs_optstr = next_field(&s);		/* (10) fs options */
+	if (!fstype || !src || !fs->fs_optstr)
+		goto err;
+
+	fs->flags |= MNT_FS_KERNEL;
+	fs->devno = makedev(maj, min);
+
+	/* remove "(deleted)" suffix */
+	sz = strlen(fs->target);
+	if (sz > PATH_DELETED_SUFFIX_SZ) {
+		p = fs->target + (sz - PATH_DELETED_SUFFIX_SZ);
+
+		if (strcmp(p, PATH_DELETED_SUFFIX) == 0)
+			*p = '\0';
+	}
+
+	unmangle_string(fs->root);
+	unmangle_string(fs->target);
+	unmangle_string(fs->vfs_optstr);
+	unmangle_string(fstype);
+	unmangle_string(src);
+	unmangle_string(fs->fs_optstr);
+
+	__mnt_fs_set_fstype_ptr(fs, fstype);
+	__mnt_fs_set_source_ptr(fs, src);
+
+	/* merge VFS and FS options to one string */
+	fs->optstr = mnt_fs_strdup_options(fs);
+	if (!fs->optstr)
+		return -ENOMEM;
+	return 0;
+err:
+	DBG(TAB, ul_debug("mountinfo parse error: '%s'", s));
+	return -EINVAL;
+}
+
 /*
  * Parses one line from utab file
  */
@@ -614,6 +728,8 @@ int mnt_table_parse_stream(struct libmnt_table *tb, FILE *f, const char *filenam
 	if (filename && strcmp(filename, _PATH_PROC_MOUNTS) == 0)
 		flags = MNT_FS_KERNEL;
 
+	mnt_cache_shrink(tb->cache);
+
 	while (!feof(f)) {
 		struct libmnt_fs *fs = mnt_new_fs();
 
@@ -651,6 +767,213 @@ err:
 	return rc;
 }
 
+/*
+ * Reads the whole file to the arena. The /proc files don't support mmap()
+ * and report zero size, so use read() with a large buffer.
+ */
+static struct libmnt_arena *read_arena(int fd)
+{
+	struct libmnt_arena *ar;
+	struct stat st;
+	size_t sz = 64 * 1024;
+
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+		sz = st.st_size + 1;
+
+	ar = malloc(sizeof(*ar) + sz);
+	if (!ar)
+		return NULL;
+	ar->refcount = 1;
+	ar->size = sz;
+	ar->used = 0;
+
+	while (1) {
+		ssize_t ret;
+
+		if (ar->used + 1 >= ar->size) {
+			struct libmnt_arena *x;
+
+			sz = ar->size * 2;
+			x = realloc(ar, sizeof(*ar) + sz);
+			if (!x)
+				goto err;
+			ar = x;
+			ar->size = sz;
+		}
+
+		ret = read(fd, ar->data + ar->used, ar->size - ar->used - 1);
+		if (ret < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			goto err;
+		}
+		if (ret == 0)
+			break;
+		ar->used += ret;
+	}
+
+	ar->data[ar->used] = '\0';
+	return ar;
+err:
+	free(ar);
+	return NULL;
+}
+
+void mnt_unref_arena(struct libmnt_arena *ar)
+{
+	if (ar && --ar->refcount <= 0)
+		free(ar);
+}
+
+/*
+ * Returns the format of the first non-blank non-comment line in the arena.
+ */
+static int guess_arena_format(struct libmnt_arena *ar)
+{
+	char *s = ar->data;
+
+	while (*s) {
+		char *end = strchr(s, '\n');
+		int fmt = MNT_FMT_GUESS;
+
+		s = (char *) skip_blank(s);
+		if (end)
+			*end = '\0';
+		if (*s && *s != '#' && *s != '\n')
+			fmt = guess_table_format(s);
+		if (end)
+			*end = '\n';
+
+		if (fmt != MNT_FMT_GUESS)
+			return fmt;
+		if (!end)
+			break;
+		s = end + 1;
+	}
+	return MNT_FMT_GUESS;
+}
+
+/*
+ * Parses mountinfo from the arena. The strings are not copied, every @fs
+ * keeps a reference to the arena.
+ */
+static int mnt_table_parse_arena(struct libmnt_table *tb,
+				 struct libmnt_arena *ar,
+				 const char *filename)
+{
+	char *s = ar->data, *end = ar->data + ar->used;
+	int nlines = 0, rc = 0;
+	pid_t tid = -1;
+
+	DBG(TAB, ul_debugobj(tb, "%s: start parsing [entries=%d, filter=%s, arena=%zu]",
+				filename, mnt_table_get_nents(tb),
+				tb->fltrcb ? "yes" : "not", ar->used));
+
+	while (s < end) {
+		struct libmnt_fs *fs;
+		char *line = s, *nl;
+
+		nl = memchr(s, '\n', end - s);
+		if (nl) {
+			*nl = '\0';
+			s = nl + 1;
+		} else
+			s = end;
+		nlines++;
+
+		if (nl && nl > line && *(nl - 1) == '\r')
+			*(nl - 1) = '\0';
+		line = (char *) skip_blank(line);
+		if (!*line || *line == '#')
+			continue;
+
+		fs = mnt_new_fs();
+		if (!fs) {
+			rc = -ENOMEM;
+			goto err;
+		}
+		fs->arena = ar;
+		ar->refcount++;
+
+		rc = mnt_parse_mountinfo_arena_line(fs, line);
+		if (rc) {
+			DBG(TAB, ul_debugobj(tb, "%s:%d: mountinfo parse error",
+						filename, nlines));
+			rc = tb->errcb ? tb->errcb(tb, filename, nlines) : 1;
+		}
+
+		if (!rc && tb->fltrcb && tb->fltrcb(fs, tb->fltrcb_data))
+			rc = 1;	/* filtered out by callback... */
+
+		if (!rc) {
+			rc = mnt_table_add_fs(tb, fs);
+			if (rc == 0)
+				rc = kernel_fs_postparse(tb, fs, &tid, filename);
+		}
+		mnt_unref_fs(fs);
+
+		if (rc) {
+			if (rc == 1)
+				continue;	/* recoverable error */
+			if (s >= end)
+				break;
+			goto err;		/* fatal error */
+		}
+	}
+
+	DBG(TAB, ul_debugobj(tb, "%s: stop parsing (%d entries)",
+				filename, mnt_table_get_nents(tb)));
+	return 0;
+err:
+	DBG(TAB, ul_debugobj(tb, "%s: parse error (rc=%d)", filename, rc));
+	return rc;
+}
+
+/*
+ * Parses one mountinfo @line (@len bytes, not terminated) to the new entry
+ * @fs. The entry is not added to @tb, the table is used for the postparse
+ * only.
+ *
+ * Returns: 0 on success or negative number in case of error.
+ */
+int __mnt_table_parse_mountinfo_line(struct libmnt_table *tb,
+				     const char *line, size_t len,
+				     const char *filename, pid_t *tid,
+				     struct libmnt_fs **fs)
+{
+	struct libmnt_arena *ar;
+	struct libmnt_fs *x;
+	int rc;
+
+	assert(tb);
+	assert(fs);
+
+	*fs = NULL;
+	x = mnt_new_fs();
+	if (!x)
+		return -ENOMEM;
+	ar = malloc(sizeof(*ar) + len + 1);
+	if (!ar) {
+		mnt_unref_fs(x);
+		return -ENOMEM;
+	}
+	ar->refcount = 1;
+	ar->size = ar->used = len + 1;
+	memcpy(ar->data, line, len);
+	ar->data[len] = '\0';
+	x->arena = ar;
+
+	rc = mnt_parse_mountinfo_arena_line(x, ar->data);
+	if (!rc)
+		rc = kernel_fs_postparse(tb, x, tid, filename);
+	if (rc) {
+		mnt_unref_fs(x);
+		return rc;
+	}
+	*fs = x;
+	return 0;
+}
+
 /**
  * mnt_table_parse_file:
  * @tb: tab pointer
@@ -675,12 +998,42 @@ int mnt_table_parse_file(struct libmnt_table *tb, const char *filename)
 		return -EINVAL;
 
 	f = fopen(filename, "r" UL_CLOEXECSTR);
-	if (f) {
-		rc = mnt_table_parse_stream(tb, f, filename);
-		fclose(f);
-	} else
+	if (!f)
 		return -errno;
 
+	mnt_cache_shrink(tb->cache);
+
+	/*
+	 * mountinfo is parsed from one buffer without strdup() for each field,
+	 * it's the most expensive part of the parser for huge mount tables
+	 */
+	if (!tb->comms && (tb->fmt == MNT_FMT_GUESS ||
+			   tb->fmt == MNT_FMT_MOUNTINFO)) {
+		struct libmnt_arena *ar = read_arena(fileno(f));
+
+		if (ar && ar->used == 0)
+			rc = 0;
+		else if (ar && (tb->fmt == MNT_FMT_MOUNTINFO ||
+				guess_arena_format(ar) == MNT_FMT_MOUNTINFO)) {
+			tb->fmt = MNT_FMT_MOUNTINFO;
+			rc = mnt_table_parse_arena(tb, ar, filename);
+		} else if (ar) {
+			/* not mountinfo, use the generic parser */
+			FILE *m = fmemopen(ar->data, ar->used, "r");
+
+			if (m) {
+				rc = mnt_table_parse_stream(tb, m, filename);
+				fclose(m);
+			} else
+				rc = -errno;
+		} else
+			rc = -errno;
+
+		mnt_unref_arena(ar);
+	} else
+		rc = mnt_table_parse_stream(tb, f, filename);
+
+	fclose(f);
 	return rc;
 }
 
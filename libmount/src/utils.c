@@ -62,6 +62,35 @@ int is_file_empty(const char *name)
 	return (stat(name, &st) != 0 || st.st_size == 0);
 }
 
+/*
+ * FNV-1a hash of @len bytes of @data. Use MNT_HASH_INIT as @hash for the
+ * first call, the result could be used as @hash to continue with the next
+ * data.
+ */
+unsigned int mnt_hash_data(unsigned int hash, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+
+	while (len--) {
+		hash ^= *p++;
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+/*
+ * Returns hash of the @path, the last trailing slash is ignored, so the
+ * paths equal for streq_except_trailing_slash() have the same hash.
+ */
+unsigned int mnt_hash_path(const char *path)
+{
+	size_t len = strlen(path);
+
+	if (len && path[len - 1] == '/')
+		len--;
+	return mnt_hash_data(MNT_HASH_INIT, path, len);
+}
+
 int mnt_valid_tagname(const char *tagname)
 {
 	if (tagname && *tagname && (
@@ -0,0 +1,211 @@
+/*
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ *
+ * Generates a table with synthetic data and reports how many rows per second
+ * are printed by scols_print_table().
+ */
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <sys/time.h>
+
+#include "c.h"
+#include "nls.h"
+#include "strutils.h"
+#include "xalloc.h"
+
+#include "libsmartcols.h"
+
+enum { COL_NAME, COL_SIZE, COL_TYPE, COL_LABEL, COL_PATH };
+
+static void setup_columns(struct libscols_table *tb, int tree)
+{
+	if (!scols_table_new_column(tb, "NAME", 0.2, tree ? SCOLS_FL_TREE : 0) ||
+	    !scols_table_new_column(tb, "SIZE", 6, SCOLS_FL_RIGHT) ||
+	    !scols_table_new_column(tb, "TYPE", 4, 0) ||
+	    !scols_table_new_column(tb, "LABEL", 0.1, SCOLS_FL_TRUNC) ||
+	    !scols_table_new_column(tb, "PATH", 0.3, SCOLS_FL_NOEXTREMES))
+		err(EXIT_FAILURE, "failed to create output columns");
+}
+
+static void add_lines(struct libscols_table *tb, size_t nrows, int tree,
+		      int sortkeys)
+{
+	struct libscols_line *parent = NULL;
+	uint64_t size;
+	size_t i;
+
+	for (i = 0; i < nrows; i++) {
+		struct libscols_line *ln;
+		char *p;
+
+		/* every 8th line is a parent of the next lines */
+		if (tree && i % 8 == 0)
+			parent = NULL;
+
+		ln = scols_table_new_line(tb, parent);
+		if (!ln)
+			err(EXIT_FAILURE, "failed to create output line");
+		if (tree && i % 8 == 0)
+			parent = ln;
+
+		if (xasprintf(&p, "dev%zu", i) < 0 ||
+		    scols_line_refer_data(ln, COL_NAME, p))
+			goto fail;
+		size = (uint64_t) ((i * 7919) % nrows) * 4096 * 1021;
+		p = size_to_human_string(SIZE_SUFFIX_1LETTER, size);
+		if (!p || scols_line_refer_data(ln, COL_SIZE, p))
+			goto fail;
+		if (sortkeys)
+			scols_cell_set_sortkey(scols_line_get_cell(ln, COL_SIZE), size);
+		else
+			scols_cell_set_userdata(scols_line_get_cell(ln, COL_SIZE),
+						(void *) (uintptr_t) size);
+		if (scols_line_set_data(ln, COL_TYPE, i % 8 ? "part" : "disk"))
+			goto fail;
+		if (xasprintf(&p, i % 5 ? "label-%zu" : "\xc5\xbelu\xc5\xa5ou\xc4\x8dk\xc3\xbd-k\xc5\xaf\xc5\x88-%zu", i) < 0 ||
+		    scols_line_refer_data(ln, COL_LABEL, p))
+			goto fail;
+		if (xasprintf(&p, "/dev/disk/by-path/pci-0000:00:%02zx.0-scsi-0:0:%zu:0", i % 256, i) < 0 ||
+		    scols_line_refer_data(ln, COL_PATH, p))
+			goto fail;
+	}
+	return;
+fail:
+	err(EXIT_FAILURE, "failed to create cell data");
+}
+
+/* compares userdata, the old way to sort by numbers */
+static int cmp_userdata(struct libscols_cell *a, struct libscols_cell *b,
+			__attribute__((__unused__)) void *data)
+{
+	uintptr_t x = (uintptr_t) scols_cell_get_userdata(a),
+		  y = (uintptr_t) scols_cell_get_userdata(b);
+
+	return x == y ? 0 : x > y ? 1 : -1;
+}
+
+static double timediff(struct timeval *start, struct timeval *end)
+{
+	return (end->tv_sec - start->tv_sec) + (end->tv_usec - start->tv_usec) / 1000000.0;
+}
+
+static void __attribute__((__noreturn__)) usage(FILE *out)
+{
+	fprintf(out, " %s [options] [<rows>]\n\n", program_invocation_short_name);
+	fputs(" -a, --arena          allocate lines from table arena\n", out);
+	fputs(" -r, --raw            use raw output format\n", out);
+	fputs(" -s, --sort <how>     sort by size, label, multi (label,size desc),\n"
+	      "                      or func (size by callback)\n", out);
+	fputs(" -t, --tree           use tree output\n", out);
+
+	exit(out == stderr ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+int main(int argc, char *argv[])
+{
+	struct libscols_table *tb;
+	struct timeval start, end;
+	size_t nrows = 100000;
+	FILE *out;
+	double sec, build;
+	int c, tree = 0;
+	const char *sort = NULL;
+
+	static const struct option longopts[] = {
+		{ "arena",	0, 0, 'a' },
+		{ "raw",	0, 0, 'r' },
+		{ "sort",	1, 0, 's' },
+		{ "tree",       0, 0, 't' },
+		{ NULL, 0, 0, 0 },
+	};
+
+	setlocale(LC_ALL, "");
+
+	scols_init_debug(0);
+
+	tb = scols_new_table();
+	if (!tb)
+		err(EXIT_FAILURE, "faild to create output table");
+
+	while((c = getopt_long(argc, argv, "ars:t", longopts, NULL)) != -1) {
+		switch(c) {
+		case 'a':
+			scols_table_enable_arena(tb, 1);
+			break;
+		case 'r':
+			scols_table_enable_raw(tb, 1);
+			break;
+		case 's':
+			sort = optarg;
+			break;
+		case 't':
+			tree = 1;
+			break;
+		default:
+			usage(stderr);
+		}
+	}
+	if (optind < argc)
+		nrows = strtou32_or_err(argv[optind], "failed to parse number of rows");
+
+	out = fopen("/dev/null", "w");
+	if (!out)
+		err(EXIT_FAILURE, "/dev/null");
+	scols_table_set_stream(tb, out);
+
+	setup_columns(tb, tree);
+
+	gettimeofday(&start, NULL);
+	add_lines(tb, nrows, tree, !sort || strcmp(sort, "func") != 0);
+	gettimeofday(&end, NULL);
+	build = timediff(&start, &end);
+
+	if (sort) {
+		struct libscols_column *cls[2];
+		int flags[2] = { 0, SCOLS_SORT_DESC };
+		size_t ncls = 1;
+
+		if (strcmp(sort, "size") == 0)
+			cls[0] = scols_table_get_column(tb, COL_SIZE);
+		else if (strcmp(sort, "label") == 0)
+			cls[0] = scols_table_get_column(tb, COL_LABEL);
+		else if (strcmp(sort, "multi") == 0) {
+			cls[0] = scols_table_get_column(tb, COL_LABEL);
+			cls[1] = scols_table_get_column(tb, COL_SIZE);
+			ncls = 2;
+		} else if (strcmp(sort, "func") == 0) {
+			cls[0] = scols_table_get_column(tb, COL_SIZE);
+			scols_column_set_cmpfunc(cls[0], cmp_userdata, NULL);
+		} else
+			errx(EXIT_FAILURE, "unsupported sort '%s'", sort);
+
+		gettimeofday(&start, NULL);
+		if (scols_sort_table_by(tb, cls, flags, ncls))
+			errx(EXIT_FAILURE, "failed to sort table");
+		gettimeofday(&end, NULL);
+		printf("sort: %.3f s\n", timediff(&start, &end));
+	}
+
+	gettimeofday(&start, NULL);
+	if (scols_print_table(tb))
+		errx(EXIT_FAILURE, "failed to print table");
+	gettimeofday(&end, NULL);
+	sec = timediff(&start, &end);
+
+	gettimeofday(&start, NULL);
+	scols_unref_table(tb);
+	gettimeofday(&end, NULL);
+
+	printf("rows: %zu\n", nrows);
+	printf("build: %.3f s\n", build);
+	printf("time: %.3f s\n", sec);
+	printf("free: %.3f s\n", timediff(&start, &end));
+	printf("rows/s: %.0f\n", sec > 0 ? nrows / sec : 0.0);
+
+	fclose(out);
+	return EXIT_SUCCESS;
+}
@@ -24,6 +24,7 @@
 #include <string.h>
 #include <ctype.h>
 
+#include "mbsalign.h"
 #include "smartcolsP.h"
 
 /*
@@ -31,6 +32,14 @@
  * handled by libscols_line.
  */
 
+static void reset_cell_width(struct libscols_cell *ce)
+{
+	free(ce->encdata);
+	ce->encdata = NULL;
+	ce->width = 0;
+	ce->has_width = 0;
+}
+
 /**
  * scols_reset_cell:
  * @ce: pointer to a struct libscols_cell instance
@@ -49,6 +58,7 @@ int scols_reset_cell(struct libscols_cell *ce)
 	/*DBG(CELL, ul_debugobj(ce, "reset"));*/
 	free(ce->data);
 	free(ce->color);
+	free(ce->encdata);
 	memset(ce, 0, sizeof(*ce));
 	return 0;
 }
@@ -77,6 +87,7 @@ int scols_cell_set_data(struct libscols_cell *ce, const char *str)
 	}
 	free(ce->data);
 	ce->data = p;
+	reset_cell_width(ce);
 	return 0;
 }
 
@@ -100,6 +111,7 @@ int scols_cell_refer_data(struct libscols_cell *ce, char *str)
 		return -EINVAL;
 	free(ce->data);
 	ce->data = str;
+	reset_cell_width(ce);
 	return 0;
 }
 
@@ -115,6 +127,41 @@ const char *scols_cell_get_data(const struct libscols_cell *ce)
 	return ce ? ce->data : NULL;
 }
 
+/*
+ * Returns the cell data with control and non-printable chars encoded by
+ * mbs_safe_encode() and the number of cells in @width. The result is cached
+ * in the cell, so the data are decoded only once for all width counting and
+ * printing. The encoded copy is allocated only if the data are unsafe.
+ */
+const char *__scols_cell_get_safe_data(struct libscols_cell *ce, size_t *width)
+{
+	assert(ce);
+	assert(width);
+
+	if (!ce || !ce->data) {
+		*width = 0;
+		return NULL;
+	}
+
+	if (!ce->has_width) {
+		size_t len = strlen(ce->data), bytes = 0;
+
+		ce->width = mbs_safe_nwidth(ce->data, len, &bytes);
+		if (bytes != len) {
+			/* something has to be encoded */
+			ce->encdata = mbs_safe_encode(ce->data, &ce->width);
+			if (!ce->encdata) {
+				*width = 0;
+				return NULL;
+			}
+		}
+		ce->has_width = 1;
+	}
+
+	*width = ce->width;
+	return ce->encdata ? ce->encdata : ce->data;
+}
+
 /**
  * scols_cell_set_userdata:
  * @ce: a pointer to a struct libscols_cell instance
@@ -143,6 +190,46 @@ void *scols_cell_get_userdata(struct libscols_cell *ce)
 	return ce ? ce->userdata : NULL;
 }
 
+/**
+ * scols_cell_set_sortkey:
+ * @ce: a pointer to a struct libscols_cell instance
+ * @key: numeric sort key
+ *
+ * Binds numeric @key to @ce. If any cell in the column has the key then
+ * scols_sort_table() orders the column by the keys rather than by the column
+ * cmpfunc. The cells without the key are ordered before all other cells.
+ *
+ * Returns: 0, a negative value in case of an error.
+ */
+int scols_cell_set_sortkey(struct libscols_cell *ce, uint64_t key)
+{
+	assert(ce);
+	if (!ce)
+		return -EINVAL;
+	ce->sortkey = key;
+	ce->has_sortkey = 1;
+	return 0;
+}
+
+/**
+ * scols_cell_get_sortkey:
+ * @ce: a pointer to a struct libscols_cell instance
+ * @key: returns numeric sort key
+ *
+ * Returns: 0, 1 if the key is not set, a negative value in case of an error.
+ */
+int scols_cell_get_sortkey(const struct libscols_cell *ce, uint64_t *key)
+{
+	assert(ce);
+	if (!ce)
+		return -EINVAL;
+	if (!ce->has_sortkey)
+		return 1;
+	if (key)
+		*key = ce->sortkey;
+	return 0;
+}
+
 /**
  * scols_cmpstr_cells:
  * @a: pointer to cell
@@ -240,8 +327,11 @@ int scols_cell_copy_content(struct libscols_cell *dest,
 	rc = scols_cell_set_data(dest, scols_cell_get_data(src));
 	if (!rc)
 		rc = scols_cell_set_color(dest, scols_cell_get_color(src));
-	if (!rc)
+	if (!rc) {
 		dest->userdata = src->userdata;
+		dest->sortkey = src->sortkey;
+		dest->has_sortkey = src->has_sortkey;
+	}
 
 	DBG(CELL, ul_debugobj((void *) src, "copy into %p", dest));
 	return rc;
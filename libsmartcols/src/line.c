@@ -42,12 +42,18 @@ struct libscols_line *scols_new_line(void)
 	if (!ln)
 		return NULL;
 
+	__scols_init_line(ln);
+	return ln;
+}
+
+/* initializes zeroized line, the memory is not owned by the line */
+void __scols_init_line(struct libscols_line *ln)
+{
 	DBG(LINE, ul_debugobj(ln, "alloc"));
 	ln->refcount = 1;
 	INIT_LIST_HEAD(&ln->ln_lines);
 	INIT_LIST_HEAD(&ln->ln_children);
 	INIT_LIST_HEAD(&ln->ln_branch);
-	return ln;
 }
 
 /**
@@ -67,7 +73,9 @@ void scols_ref_line(struct libscols_line *ln)
  * @ln: a pointer to a struct libscols_line instance
  *
  * Decreases the refcount of @ln. When the count falls to zero, the instance
- * is automatically deallocated.
+ * is automatically deallocated. The memory of the lines allocated in the
+ * table arena is released by scols_unref_table(), see
+ * scols_table_enable_arena().
  */
 void scols_unref_line(struct libscols_line *ln)
 {
@@ -78,7 +86,8 @@ void scols_unref_line(struct libscols_line *ln)
 		list_del(&ln->ln_children);
 		scols_line_free_cells(ln);
 		free(ln->color);
-		free(ln);
+		if (!ln->in_arena)
+			free(ln);
 		return;
 	}
 }
@@ -101,9 +110,11 @@ void scols_line_free_cells(struct libscols_line *ln)
 	for (i = 0; i < ln->ncells; i++)
 		scols_reset_cell(&ln->cells[i]);
 
-	free(ln->cells);
+	if (!ln->cells_in_arena)
+		free(ln->cells);
 	ln->ncells = 0;
 	ln->cells = NULL;
+	ln->cells_in_arena = 0;
 }
 
 /**
@@ -121,6 +132,7 @@ void scols_line_free_cells(struct libscols_line *ln)
 int scols_line_alloc_cells(struct libscols_line *ln, size_t n)
 {
 	struct libscols_cell *ce;
+	size_t i;
 
 	assert(ln);
 
@@ -136,7 +148,18 @@ int scols_line_alloc_cells(struct libscols_line *ln, size_t n)
 
 	DBG(LINE, ul_debugobj(ln, "alloc %zu cells", n));
 
-	ce = realloc(ln->cells, n * sizeof(struct libscols_cell));
+	for (i = n; i < ln->ncells; i++)
+		scols_reset_cell(&ln->cells[i]);
+
+	if (ln->cells_in_arena) {
+		/* arena memory cannot be resized, move cells to heap */
+		ce = malloc(n * sizeof(struct libscols_cell));
+		if (!ce)
+			return -errno;
+		memcpy(ce, ln->cells, min(n, ln->ncells) * sizeof(struct libscols_cell));
+		ln->cells_in_arena = 0;
+	} else
+		ce = realloc(ln->cells, n * sizeof(struct libscols_cell));
 	if (!ce)
 		return -errno;
 
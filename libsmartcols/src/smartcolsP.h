@@ -69,6 +69,13 @@ struct libscols_cell {
 	char	*data;
 	char	*color;
 	void    *userdata;
+
+	char	*encdata;	/* encoded data, NULL if the data are safe */
+	size_t	width;		/* number of cells of the encoded data */
+	uint64_t sortkey;	/* numeric key for scols_sort_table() */
+
+	unsigned int has_width :1,	/* encdata and width are valid */
+		     has_sortkey :1;	/* sortkey is valid */
 };
 
 
@@ -116,6 +123,9 @@ struct libscols_line {
 	struct list_head	ln_children;
 
 	struct libscols_line	*parent;
+
+	unsigned int	in_arena	:1,	/* allocated by table arena */
+			cells_in_arena	:1;	/* cells[] allocated by table arena */
 };
 
 enum {
@@ -124,6 +134,17 @@ enum {
 	SCOLS_FMT_EXPORT		/* COLNAME="data" ... */
 };
 
+/*
+ * Memory chunk for lines and cells, see scols_table_enable_arena()
+ */
+struct libscols_arena {
+	struct libscols_arena	*next;	/* previously allocated chunk */
+	size_t			size;	/* size of the chunk data */
+	size_t			used;	/* number of used bytes */
+};
+
+#define scols_arena_data(_ar)	((char *) ((_ar) + 1))
+
 /*
  * The table
  */
@@ -143,6 +164,12 @@ struct libscols_table {
 	struct list_head	tb_lines;
 	struct libscols_symbols	*symbols;
 
+	struct libscols_column	**cols_idx;	/* columns by seqnum */
+	size_t			cols_idxsz;
+	struct libscols_line	**lines_idx;	/* lines by seqnum */
+	size_t			lines_idxsz;
+	struct libscols_arena	*arena;		/* memory for lines and cells */
+
 	int	format;		/* SCOLS_FMT_* */
 
 	/* flags */
@@ -150,9 +177,15 @@ struct libscols_table {
 			colors_wanted	:1,	/* enable colors */
 			is_term		:1,	/* isatty() */
 			maxout		:1,	/* maximalize output */
-			no_headings	:1;	/* don't print header */
+			no_headings	:1,	/* don't print header */
+			stream		:1,	/* print lines when added */
+			stream_started	:1,	/* header and widths already done */
+			use_arena	:1;	/* allocate new lines from arena */
 };
 
+/* the stream mode is not supported for trees */
+#define scols_table_is_streaming(_tb)	((_tb)->stream && !(_tb)->ntreecols)
+
 #define IS_ITER_FORWARD(_i)	((_i)->direction == SCOLS_ITER_FORWARD)
 #define IS_ITER_BACKWARD(_i)	((_i)->direction == SCOLS_ITER_BACKWARD)
 
@@ -170,4 +203,14 @@ struct libscols_table {
 				(itr)->p->next : (itr)->p->prev; \
 	} while(0)
 
+/* line.c */
+extern void __scols_init_line(struct libscols_line *ln);
+
+/* cell.c */
+extern const char *__scols_cell_get_safe_data(struct libscols_cell *ce,
+					      size_t *width);
+
+/* table_print.c */
+extern int __scols_print_stream(struct libscols_table *tb);
+
 #endif /* _LIBSMARTCOLS_PRIVATE_H */
@@ -37,6 +37,83 @@
 #define is_last_column(_tb, _cl) \
 		list_entry_is_last(&(_cl)->cl_columns, &(_tb)->tb_columns)
 
+#define SCOLS_ARENA_ALIGN	sizeof(void *)
+#define SCOLS_ARENA_MINSZ	(16 * 1024)
+#define SCOLS_ARENA_MAXSZ	(1024 * 1024)
+
+/*
+ * Returns zeroized memory from the table arena. The memory is deallocated by
+ * scols_unref_table() only.
+ */
+static void *arena_alloc(struct libscols_table *tb, size_t sz)
+{
+	struct libscols_arena *ar = tb->arena;
+	char *p;
+
+	sz = (sz + SCOLS_ARENA_ALIGN - 1) & ~(SCOLS_ARENA_ALIGN - 1);
+
+	if (!ar || ar->size - ar->used < sz) {
+		size_t chunksz = ar ? min(ar->size * 2, (size_t) SCOLS_ARENA_MAXSZ)
+				    : SCOLS_ARENA_MINSZ;
+
+		chunksz = max(chunksz, sz);
+		ar = malloc(sizeof(*ar) + chunksz);
+		if (!ar)
+			return NULL;
+
+		DBG(TAB, ul_debugobj(tb, "new arena chunk %zu bytes", chunksz));
+		ar->size = chunksz;
+		ar->used = 0;
+		ar->next = tb->arena;
+		tb->arena = ar;
+	}
+
+	p = scols_arena_data(ar) + ar->used;
+	ar->used += sz;
+	return memset(p, 0, sz);
+}
+
+static void arena_free(struct libscols_table *tb)
+{
+	while (tb->arena) {
+		struct libscols_arena *ar = tb->arena;
+
+		tb->arena = ar->next;
+		free(ar);
+	}
+}
+
+/*
+ * Stores @ptr to the @idx array at @n position, the array is enlarged if
+ * necessary. The already used positions are not overwritten, the oldest
+ * item with the same seqnum is accessible by index.
+ */
+static int index_add(void ***idx, size_t *idxsz, size_t n, void *ptr)
+{
+	if (n >= *idxsz) {
+		size_t sz = max(*idxsz * 2, (size_t) 64);
+		void **tmp;
+
+		while (sz <= n)
+			sz *= 2;
+		tmp = realloc(*idx, sz * sizeof(void *));
+		if (!tmp)
+			return -ENOMEM;
+		memset(tmp + *idxsz, 0, (sz - *idxsz) * sizeof(void *));
+		*idx = tmp;
+		*idxsz = sz;
+	}
+	if (!(*idx)[n])
+		(*idx)[n] = ptr;
+	return 0;
+}
+
+static void index_remove(void **idx, size_t idxsz, size_t n, void *ptr)
+{
+	if (n < idxsz && idx[n] == ptr)
+		idx[n] = NULL;
+}
+
 
 /**
  * scols_new_table:
@@ -87,6 +164,9 @@ void scols_unref_table(struct libscols_table *tb)
 		scols_table_remove_lines(tb);
 		scols_table_remove_columns(tb);
 		scols_unref_symbols(tb->symbols);
+		arena_free(tb);
+		free(tb->lines_idx);
+		free(tb->cols_idx);
 		free(tb->linesep);
 		free(tb->colsep);
 		free(tb);
@@ -110,6 +190,9 @@ int scols_table_add_column(struct libscols_table *tb, struct libscols_column *cl
 	if (!tb || !cl || !list_empty(&tb->tb_lines))
 		return -EINVAL;
 
+	if (index_add((void ***) &tb->cols_idx, &tb->cols_idxsz, tb->ncols, cl))
+		return -ENOMEM;
+
 	if (cl->flags & SCOLS_FL_TREE)
 		tb->ntreecols++;
 
@@ -149,6 +232,7 @@ int scols_table_remove_column(struct libscols_table *tb,
 		tb->ntreecols--;
 
 	DBG(TAB, ul_debugobj(tb, "remove column %p", cl));
+	index_remove((void **) tb->cols_idx, tb->cols_idxsz, cl->seqnum, cl);
 	list_del_init(&cl->cl_columns);
 	tb->ncols--;
 	scols_unref_column(cl);
@@ -379,6 +463,8 @@ struct libscols_column *scols_table_get_column(struct libscols_table *tb,
 		return NULL;
 	if (n >= tb->ncols)
 		return NULL;
+	if (n < tb->cols_idxsz && tb->cols_idx[n])
+		return tb->cols_idx[n];
 
 	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
 	while (scols_table_next_column(tb, &itr, &cl) == 0) {
@@ -396,6 +482,9 @@ struct libscols_column *scols_table_get_column(struct libscols_table *tb,
  * Note that this function calls scols_line_alloc_cells() if number
  * of the cells in the line is too small for @tb.
  *
+ * If the stream mode is enabled (see scols_table_enable_stream()) then all
+ * lines previously added to @tb are printed and removed from the table.
+ *
  * Returns: 0, a negative value in case of an error.
  */
 int scols_table_add_line(struct libscols_table *tb, struct libscols_line *ln)
@@ -413,6 +502,16 @@ int scols_table_add_line(struct libscols_table *tb, struct libscols_line *ln)
 			return rc;
 	}
 
+	/* the previously added lines are complete now */
+	if (scols_table_is_streaming(tb)) {
+		int rc = __scols_print_stream(tb);
+		if (rc)
+			return rc;
+	}
+
+	if (index_add((void ***) &tb->lines_idx, &tb->lines_idxsz, tb->nlines, ln))
+		return -ENOMEM;
+
 	DBG(TAB, ul_debugobj(tb, "add line %p", ln));
 	list_add_tail(&ln->ln_lines, &tb->tb_lines);
 	ln->seqnum = tb->nlines++;
@@ -440,6 +539,7 @@ int scols_table_remove_line(struct libscols_table *tb,
 		return -EINVAL;
 
 	DBG(TAB, ul_debugobj(tb, "remove line %p", ln));
+	index_remove((void **) tb->lines_idx, tb->lines_idxsz, ln->seqnum, ln);
 	list_del_init(&ln->ln_lines);
 	tb->nlines--;
 	scols_unref_line(ln);
@@ -509,6 +609,11 @@ int scols_table_next_line(struct libscols_table *tb,
  *   scols_table_add_line(tb, ln);
  *   scols_line_add_child(parent, ln);
  *
+ * The @parent is ignored in the stream mode, the parental line has been
+ * already printed and deallocated.
+ *
+ * The line and its cells are allocated from the table memory if the arena
+ * is enabled, see scols_table_enable_arena().
  *
  * Returns: newly allocate line
  */
@@ -523,13 +628,27 @@ struct libscols_line *scols_table_new_line(struct libscols_table *tb,
 	if (!tb || !tb->ncols)
 		return NULL;
 
-	ln = scols_new_line();
-	if (!ln)
-		return NULL;
+	if (tb->use_arena && !scols_table_is_streaming(tb)) {
+		ln = arena_alloc(tb, sizeof(*ln));
+		if (!ln)
+			return NULL;
+		__scols_init_line(ln);
+		ln->in_arena = 1;
+
+		ln->cells = arena_alloc(tb, tb->ncols * sizeof(struct libscols_cell));
+		if (!ln->cells)
+			goto err;
+		ln->ncells = tb->ncols;
+		ln->cells_in_arena = 1;
+	} else {
+		ln = scols_new_line();
+		if (!ln)
+			return NULL;
+	}
 
 	if (scols_table_add_line(tb, ln))
 		goto err;
-	if (parent)
+	if (parent && !scols_table_is_streaming(tb))
 		scols_line_add_child(parent, ln);
 
 	scols_unref_line(ln);	/* ref-counter incremented by scols_table_add_line() */
@@ -542,15 +661,12 @@ err:
 /**
  * scols_table_get_line:
  * @tb: table
- * @n: column number (0..N)
+ * @n: line number (0..N)
  *
- * This is a shortcut for
+ * The lines are indexed by the order in which they were added to the table,
+ * the access does not depend on number of lines in the table.
  *
- *   ln = scols_new_line();
- *   scols_line_set_....(cl, ...);
- *   scols_table_add_line(tb, ln);
- *
- * Returns: a newly allocate line
+ * Returns: pointer to line or NULL
  */
 struct libscols_line *scols_table_get_line(struct libscols_table *tb,
 					   size_t n)
@@ -563,6 +679,8 @@ struct libscols_line *scols_table_get_line(struct libscols_table *tb,
 		return NULL;
 	if (n >= tb->nlines)
 		return NULL;
+	if (n < tb->lines_idxsz && tb->lines_idx[n])
+		return tb->lines_idx[n];
 
 	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
 	while (scols_table_next_line(tb, &itr, &ln) == 0) {
@@ -819,6 +937,63 @@ int scols_table_enable_maxout(struct libscols_table *tb, int enable)
 	return 0;
 }
 
+/**
+ * scols_table_enable_stream:
+ * @tb: table
+ * @enable: 1 or 0
+ *
+ * Enable/disable the stream mode. In this mode a line is printed (and removed
+ * from the table) as soon as the next line is added to the table, the rest of
+ * the lines is printed by scols_print_table(). It means that the application
+ * must not access the line after it adds a next line to @tb.
+ *
+ * The data are not available when the header is printed, so the widths of
+ * the columns are based on the width hints and column headers only (see
+ * scols_column_set_whint()). The raw and export output formats do not use
+ * the column widths at all.
+ *
+ * The stream mode is not supported for tree-like output, the lines are
+ * printed by scols_print_table() as usual if the table contains a tree
+ * column.
+ *
+ * Returns: 0 on success, negative number in case of an error.
+ */
+int scols_table_enable_stream(struct libscols_table *tb, int enable)
+{
+	assert(tb);
+	if (!tb)
+		return -EINVAL;
+	DBG(TAB, ul_debugobj(tb, "stream: %s", enable ? "ENABLE" : "DISABLE"));
+	tb->stream = enable ? 1 : 0;
+	return 0;
+}
+
+/**
+ * scols_table_enable_arena:
+ * @tb: table
+ * @enable: 1 or 0
+ *
+ * Enable/disable allocation of the lines from the table memory. The lines
+ * created by scols_table_new_line() and its cells are allocated in large
+ * memory chunks owned by @tb rather than individually. It's faster and the
+ * memory is released in bulk by scols_unref_table().
+ *
+ * The application must not use such lines (e.g. by scols_ref_line()) after
+ * the table is deallocated. The arena is not used in the stream mode, see
+ * scols_table_enable_stream().
+ *
+ * Returns: 0 on success, negative number in case of an error.
+ */
+int scols_table_enable_arena(struct libscols_table *tb, int enable)
+{
+	assert(tb);
+	if (!tb)
+		return -EINVAL;
+	DBG(TAB, ul_debugobj(tb, "arena: %s", enable ? "ENABLE" : "DISABLE"));
+	tb->use_arena = enable ? 1 : 0;
+	return 0;
+}
+
 /**
  * scols_table_colors_wanted:
  * @tb: table
@@ -904,6 +1079,30 @@ int scols_table_is_maxout(struct libscols_table *tb)
 	return tb && tb->maxout;
 }
 
+/**
+ * scols_table_is_stream:
+ * @tb: table
+ *
+ * Returns: 1 if the stream mode is enabled.
+ */
+int scols_table_is_stream(struct libscols_table *tb)
+{
+	assert(tb);
+	return tb && tb->stream;
+}
+
+/**
+ * scols_table_is_arena:
+ * @tb: table
+ *
+ * Returns: 1 if the lines are allocated from the table arena.
+ */
+int scols_table_is_arena(struct libscols_table *tb)
+{
+	assert(tb);
+	return tb && tb->use_arena;
+}
+
 /**
  * scols_table_is_tree:
  * @tb: table
@@ -1008,22 +1207,292 @@ char *scols_table_get_line_separator(struct libscols_table *tb)
 
 }
 
-static int cells_cmp_wrapper(struct list_head *a, struct list_head *b, void *data)
+/*
+ * Sorting
+ *
+ * The lines are copied to an array together with the precomputed key of the
+ * first sort column (the numeric key or the first bytes of the string), so
+ * most of the comparisons don't touch the cells at all.
+ */
+enum {
+	SORT_U64,	/* numeric keys, see scols_cell_set_sortkey() */
+	SORT_STR,	/* strcmp() */
+	SORT_FUNC	/* column cmpfunc */
+};
+
+struct sort_key {
+	struct libscols_column	*cl;
+	int			type;		/* SORT_* */
+	int			desc;		/* descending order */
+};
+
+struct sort_item {
+	struct libscols_line	*ln;
+	struct libscols_cell	*ce;		/* cell of the first column */
+	uint64_t		key;		/* first key or string prefix */
+	int			has_key;	/* 0 if no key or no data */
+	int			complete;	/* the string prefix is whole string */
+};
+
+struct sort_ctl {
+	struct sort_key		*keys;
+	size_t			nkeys;
+
+	struct sort_item	*items;		/* lines to sort */
+	struct sort_item	*tmp;		/* merge and radix buffer */
+	size_t			nitems;		/* size of the buffers */
+};
+
+#define SORT_RADIX_MIN	256	/* use merge sort for smaller arrays */
+#define SORT_INSERT_MAX	16	/* use insertion sort for smaller arrays */
+
+static uint64_t str_prefix(const char *str, int *complete)
 {
-	struct libscols_column *cl = (struct libscols_column *) data;
-	struct libscols_line *ra, *rb;
-	struct libscols_cell *ca, *cb;
+	uint64_t x = 0;
+	size_t i;
 
-	assert(a);
-	assert(b);
-	assert(cl);
+	for (i = 0; i < sizeof(x); i++) {
+		x <<= 8;
+		if (*str)
+			x |= (unsigned char) *str++;
+	}
+	*complete = *str == '\0';
+	return x;
+}
+
+static int cmp_cells(struct sort_key *k, struct libscols_line *a,
+		     struct libscols_line *b)
+{
+	struct libscols_cell *ca = scols_line_get_cell(a, k->cl->seqnum),
+			     *cb = scols_line_get_cell(b, k->cl->seqnum);
+	int ha, hb;
+
+	switch (k->type) {
+	case SORT_U64:
+		ha = ca && ca->has_sortkey;
+		hb = cb && cb->has_sortkey;
+		if (!ha || !hb)
+			return ha - hb;
+		return ca->sortkey == cb->sortkey ? 0 :
+		       ca->sortkey > cb->sortkey ? 1 : -1;
+	case SORT_STR:
+		return scols_cmpstr_cells(ca, cb, NULL);
+	default:
+		return k->cl->cmpfunc(ca, cb, k->cl->cmpfunc_data);
+	}
+}
+
+static int cmp_items(struct sort_ctl *ctl, const struct sort_item *a,
+		     const struct sort_item *b)
+{
+	size_t i;
+
+	for (i = 0; i < ctl->nkeys; i++) {
+		struct sort_key *k = &ctl->keys[i];
+		int rc;
+
+		if (i == 0 && k->type == SORT_FUNC)
+			rc = k->cl->cmpfunc(a->ce, b->ce, k->cl->cmpfunc_data);
+		else if (i == 0) {
+			if (a->has_key != b->has_key)
+				rc = a->has_key - b->has_key;
+			else if (a->key != b->key)
+				rc = a->key > b->key ? 1 : -1;
+			else if (k->type == SORT_STR && a->has_key
+				 && !(a->complete && b->complete))
+				rc = strcmp(a->ce->data, b->ce->data);
+			else
+				rc = 0;
+		} else
+			rc = cmp_cells(k, a->ln, b->ln);
+
+		if (rc)
+			return k->desc ? -rc : rc;
+	}
+	return 0;
+}
+
+static void init_item(struct sort_ctl *ctl, struct sort_item *it,
+		      struct libscols_line *ln)
+{
+	struct sort_key *k = &ctl->keys[0];
+	struct libscols_cell *ce = scols_line_get_cell(ln, k->cl->seqnum);
 
-	ra = list_entry(a, struct libscols_line, ln_lines);
-	rb = list_entry(b, struct libscols_line, ln_lines);
-	ca = scols_line_get_cell(ra, cl->seqnum);
-	cb = scols_line_get_cell(rb, cl->seqnum);
+	it->ln = ln;
+	it->ce = ce;
+	it->key = 0;
+	it->has_key = 0;
+	it->complete = 0;
 
-	return cl->cmpfunc(ca, cb, cl->cmpfunc_data);
+	if (!ce)
+		return;
+	if (k->type == SORT_U64 && ce->has_sortkey) {
+		it->key = ce->sortkey;
+		it->has_key = 1;
+	} else if (k->type == SORT_STR && ce->data) {
+		it->key = str_prefix(ce->data, &it->complete);
+		it->has_key = 1;
+	}
+}
+
+/*
+ * Stable top-down merge sort of @n items in @src, @dst is a copy of @src and
+ * it's used as output. The recursion keeps the small subarrays in CPU cache.
+ */
+static void merge_sort_items(struct sort_ctl *ctl, struct sort_item *src,
+			     struct sort_item *dst, size_t n)
+{
+	size_t mid = n / 2, i = 0, j = mid, k = 0;
+
+	if (n <= SORT_INSERT_MAX) {
+		for (i = 1; i < n; i++) {
+			struct sort_item x = dst[i];
+
+			for (j = i; j > 0 && cmp_items(ctl, &x, &dst[j - 1]) < 0; j--)
+				dst[j] = dst[j - 1];
+			dst[j] = x;
+		}
+		return;
+	}
+
+	/* sort both halves of @dst into @src, then merge them back to @dst */
+	merge_sort_items(ctl, dst, src, mid);
+	merge_sort_items(ctl, dst + mid, src + mid, n - mid);
+
+	if (cmp_items(ctl, &src[mid - 1], &src[mid]) <= 0) {
+		memcpy(dst, src, n * sizeof(*src));	/* already ordered */
+		return;
+	}
+	while (i < mid && j < n)
+		dst[k++] = cmp_items(ctl, &src[j], &src[i]) < 0 ? src[j++] : src[i++];
+	while (i < mid)
+		dst[k++] = src[i++];
+	while (j < n)
+		dst[k++] = src[j++];
+}
+
+static void merge_sort(struct sort_ctl *ctl, size_t n)
+{
+	memcpy(ctl->tmp, ctl->items, n * sizeof(*ctl->items));
+	merge_sort_items(ctl, ctl->tmp, ctl->items, n);
+}
+
+/* stable LSD radix sort for one numeric key */
+static void radix_sort(struct sort_ctl *ctl, size_t n)
+{
+	struct sort_item *cur = ctl->tmp, *oth = ctl->items, *x;
+	int desc = ctl->keys[0].desc;
+	size_t i, nokey = 0, off, m, shift;
+	size_t a, b;
+
+	/* lines without key go first (last in descending order) */
+	for (i = 0; i < n; i++)
+		nokey += !ctl->items[i].has_key;
+
+	off = desc ? 0 : nokey;
+	m = n - nokey;
+	a = desc ? m : 0;	/* position of the next line without key */
+	b = off;		/* position of the next line with key */
+	for (i = 0; i < n; i++) {
+		if (ctl->items[i].has_key)
+			cur[b++] = ctl->items[i];
+		else
+			cur[a++] = ctl->items[i];
+	}
+	memcpy(oth, cur, n * sizeof(*cur));
+
+	for (shift = 0; shift < 64 && m > 1; shift += 8) {
+		size_t count[256] = { 0 }, pos[256];
+		uint64_t mask = desc ? ~0ULL : 0;
+		size_t sum = 0;
+
+		for (i = off; i < off + m; i++)
+			count[((cur[i].key ^ mask) >> shift) & 0xff]++;
+		if (count[((cur[off].key ^ mask) >> shift) & 0xff] == m)
+			continue;	/* the same digit in all keys */
+
+		for (i = 0; i < 256; i++) {
+			pos[i] = off + sum;
+			sum += count[i];
+		}
+		for (i = off; i < off + m; i++)
+			oth[pos[((cur[i].key ^ mask) >> shift) & 0xff]++] = cur[i];
+		x = cur, cur = oth, oth = x;
+	}
+
+	if (cur != ctl->items)
+		memcpy(ctl->items, cur, n * sizeof(*cur));
+}
+
+static int ensure_sort_buffers(struct sort_ctl *ctl, size_t n)
+{
+	struct sort_item *x;
+
+	if (n <= ctl->nitems)
+		return 0;
+
+	x = realloc(ctl->items, n * sizeof(*x));
+	if (!x)
+		return -ENOMEM;
+	ctl->items = x;
+	x = realloc(ctl->tmp, n * sizeof(*x));
+	if (!x)
+		return -ENOMEM;
+	ctl->tmp = x;
+	ctl->nitems = n;
+	return 0;
+}
+
+/* sorts table lines (@children is 0) or children of a line (@children is 1) */
+static int sort_line_list(struct sort_ctl *ctl, struct list_head *head, int children)
+{
+	struct list_head *p;
+	size_t i, n = 0;
+	int rc;
+
+	list_for_each(p, head)
+		n++;
+	if (n < 2)
+		return 0;
+
+	rc = ensure_sort_buffers(ctl, n);
+	if (rc)
+		return rc;
+
+	i = 0;
+	list_for_each(p, head) {
+		struct libscols_line *ln = children ?
+				list_entry(p, struct libscols_line, ln_children) :
+				list_entry(p, struct libscols_line, ln_lines);
+		init_item(ctl, &ctl->items[i++], ln);
+	}
+
+	if (ctl->nkeys == 1 && ctl->keys[0].type == SORT_U64 && n >= SORT_RADIX_MIN)
+		radix_sort(ctl, n);
+	else
+		merge_sort(ctl, n);
+
+	INIT_LIST_HEAD(head);
+	for (i = 0; i < n; i++) {
+		struct libscols_line *ln = ctl->items[i].ln;
+
+		list_add_tail(children ? &ln->ln_children : &ln->ln_lines, head);
+	}
+	return 0;
+}
+
+static int column_has_sortkeys(struct libscols_table *tb, struct libscols_column *cl)
+{
+	struct list_head *p;
+
+	list_for_each(p, &tb->tb_lines) {
+		struct libscols_line *ln = list_entry(p, struct libscols_line, ln_lines);
+		struct libscols_cell *ce = scols_line_get_cell(ln, cl->seqnum);
+
+		if (ce && ce->has_sortkey)
+			return 1;
+	}
+	return 0;
 }
 
 /**
@@ -1031,7 +1500,8 @@ static int cells_cmp_wrapper(struct list_head *a, struct list_head *b, void *dat
  * @tb: table
  * @cl: order by this column
  *
- * Orders the table by the column. See also scols_column_set_cmpfunc().
+ * Orders the table by the column. This is a shortcut for
+ * scols_sort_table_by() with one column in ascending order.
  *
  * Returns: 0, a negative value in case of an error.
  */
@@ -1043,7 +1513,81 @@ int scols_sort_table(struct libscols_table *tb, struct libscols_column *cl)
 	if (!tb || !cl)
 		return -EINVAL;
 
-	DBG(TAB, ul_debugobj(tb, "sorting table"));
-	list_sort(&tb->tb_lines, cells_cmp_wrapper, cl);
-	return 0;
+	return scols_sort_table_by(tb, &cl, NULL, 1);
+}
+
+/**
+ * scols_sort_table_by:
+ * @tb: table
+ * @cls: array of columns, order by the first one, then by the second, ...
+ * @flags: array of SCOLS_SORT_* flags for the columns or NULL
+ * @ncols: number of items in @cls (and @flags)
+ *
+ * Orders the table by the columns. The sort is stable, the lines with equal
+ * keys keep their original order. The children of the lines are ordered too
+ * if the table is tree-like.
+ *
+ * The column is ordered by the numeric keys if the cells have any key
+ * (see scols_cell_set_sortkey()), otherwise by the column cmpfunc (see
+ * scols_column_set_cmpfunc()), otherwise by strcmp() of the cells data.
+ *
+ * Returns: 0, a negative value in case of an error.
+ */
+int scols_sort_table_by(struct libscols_table *tb,
+			struct libscols_column **cls,
+			const int *flags, size_t ncols)
+{
+	struct sort_ctl ctl = { .nkeys = ncols };
+	size_t i;
+	int rc;
+
+	assert(tb);
+	assert(cls);
+
+	if (!tb || !cls || !ncols)
+		return -EINVAL;
+
+	DBG(TAB, ul_debugobj(tb, "sorting table by %zu columns", ncols));
+
+	ctl.keys = calloc(ncols, sizeof(struct sort_key));
+	if (!ctl.keys)
+		return -ENOMEM;
+
+	for (i = 0; i < ncols; i++) {
+		struct sort_key *k = &ctl.keys[i];
+
+		if (!cls[i]) {
+			rc = -EINVAL;
+			goto done;
+		}
+		k->cl = cls[i];
+		k->desc = flags && (flags[i] & SCOLS_SORT_DESC);
+
+		if (column_has_sortkeys(tb, k->cl))
+			k->type = SORT_U64;
+		else if (!k->cl->cmpfunc || k->cl->cmpfunc == scols_cmpstr_cells)
+			k->type = SORT_STR;
+		else
+			k->type = SORT_FUNC;
+	}
+
+	rc = sort_line_list(&ctl, &tb->tb_lines, 0);
+
+	if (!rc && scols_table_is_tree(tb)) {
+		struct list_head *p;
+
+		list_for_each(p, &tb->tb_lines) {
+			struct libscols_line *ln = list_entry(p,
+						struct libscols_line, ln_lines);
+			if (!list_empty(&ln->ln_branch))
+				rc = sort_line_list(&ctl, &ln->ln_branch, 1);
+			if (rc)
+				break;
+		}
+	}
+done:
+	free(ctl.keys);
+	free(ctl.items);
+	free(ctl.tmp);
+	return rc;
 }
@@ -35,6 +35,7 @@ struct libscols_buffer {
 	char	*encdata;	/* encoded buffer mbs_safe_encode() */
 
 	size_t	bufsz;		/* size of the buffer */
+	size_t	encsz;		/* size of the encoded buffer */
 	size_t	art_idx;	/* begin of the tree ascii art or zero */
 };
 
@@ -47,6 +48,7 @@ static struct libscols_buffer *new_buffer(size_t sz)
 
 	buf->cur = buf->begin = ((char *) buf) + sizeof(struct libscols_buffer);
 	buf->encdata = NULL;
+	buf->encsz = 0;
 	buf->bufsz = sz;
 
 	DBG(BUFF, ul_debugobj(buf, "alloc (size=%zu)", sz));
@@ -114,48 +116,177 @@ static char *buffer_get_data(struct libscols_buffer *buf)
 	return buf ? buf->begin : NULL;
 }
 
-/* encode data by mbs_safe_encode() to avoid control and non-printable chars */
-static char *buffer_get_safe_data(struct libscols_buffer *buf, size_t *cells)
+/* enlarge the encoded buffer to @sz bytes */
+static int buffer_alloc_encdata(struct libscols_buffer *buf, size_t sz)
 {
-	char *data = buffer_get_data(buf);
-	char *res = NULL;
+	char *x;
 
+	if (sz <= buf->encsz)
+		return 0;
+	x = realloc(buf->encdata, sz);
+	if (!x)
+		return -ENOMEM;
+	buf->encdata = x;
+	buf->encsz = sz;
+	return 0;
+}
+
+#define is_last_column(_tb, _cl) \
+		list_entry_is_last(&(_cl)->cl_columns, &(_tb)->tb_columns)
+
+#define colsep(tb) ((tb)->colsep ? (tb)->colsep : " ")
+#define linesep(tb) ((tb)->linesep ? (tb)->linesep : "\n")
+
+/* returns pointer to the end of used data */
+static int line_ascii_art_to_buffer(struct libscols_table *tb,
+				    struct libscols_line *ln,
+				    struct libscols_buffer *buf)
+{
+	const char *art;
+	int rc;
+
+	assert(ln);
+	assert(buf);
+
+	if (!ln->parent)
+		return 0;
+
+	rc = line_ascii_art_to_buffer(tb, ln->parent, buf);
+	if (rc)
+		return rc;
+
+	if (list_entry_is_last(&ln->ln_children, &ln->parent->ln_branch))
+		art = "  ";
+	else
+		art = tb->symbols->vert;
+
+	return buffer_append_data(buf, art);
+}
+
+/* adds the tree ascii art of the @ln to @buf */
+static int tree_art_to_buffer(struct libscols_table *tb,
+			      struct libscols_line *ln,
+			      struct libscols_buffer *buf)
+{
+	int rc;
+
+	assert(ln->parent);
+
+	rc = line_ascii_art_to_buffer(tb, ln->parent, buf);
+
+	if (!rc && list_entry_is_last(&ln->ln_children, &ln->parent->ln_branch))
+		rc = buffer_append_data(buf, tb->symbols->right);
+	else if (!rc)
+		rc = buffer_append_data(buf, tb->symbols->branch);
+	if (!rc)
+		buffer_set_art_index(buf);
+	return rc;
+}
+
+static int cell_to_buffer(struct libscols_table *tb,
+			  struct libscols_line *ln,
+			  struct libscols_column *cl,
+			  struct libscols_buffer *buf)
+{
+	const char *data;
+	struct libscols_cell *ce;
+	int rc = 0;
+
+	assert(tb);
+	assert(ln);
+	assert(cl);
+	assert(buf);
+	assert(cl->seqnum <= tb->ncols);
+
+	buffer_reset_data(buf);
+
+	ce = scols_line_get_cell(ln, cl->seqnum);
+	data = ce ? scols_cell_get_data(ce) : NULL;
 	if (!data)
-		goto nothing;
+		return 0;
 
-	if (!buf->encdata) {
-		buf->encdata = malloc(mbs_safe_encode_size(buf->bufsz) + 1);
-		if (!buf->encdata)
-			goto nothing;
-	}
+	if (!scols_column_is_tree(cl))
+		return buffer_set_data(buf, data);
 
-	res = mbs_safe_encode_to_buffer(data, cells, buf->encdata);
-	if (!res || !*cells || *cells == (size_t) -1)
-		goto nothing;
-	return res;
-nothing:
-	*cells = 0;
-	return NULL;
+	/*
+	 * Tree stuff
+	 */
+	if (ln->parent)
+		rc = tree_art_to_buffer(tb, ln, buf);
+	if (!rc)
+		rc = buffer_append_data(buf, data);
+	return rc;
 }
 
-/* returns size in bytes of the ascii art (according to art_idx) in safe encoding */
-static size_t buffer_get_safe_art_size(struct libscols_buffer *buf)
+/*
+ * Returns the number of cells of the @cl data in @ln including the tree ascii
+ * art. The width of the data is cached in the cell, only the tree ascii art is
+ * composed in @buf.
+ */
+static int cell_width(struct libscols_table *tb,
+		      struct libscols_line *ln,
+		      struct libscols_column *cl,
+		      struct libscols_buffer *buf,
+		      size_t *width)
 {
-	char *data = buffer_get_data(buf);
-	size_t bytes = 0;
+	struct libscols_cell *ce = scols_line_get_cell(ln, cl->seqnum);
+	int rc = 0;
 
-	if (!data || !buf->art_idx)
+	*width = 0;
+	if (!ce || !__scols_cell_get_safe_data(ce, width))
 		return 0;
 
-	mbs_safe_nwidth(data, buf->art_idx, &bytes);
-	return bytes;
+	if (ln->parent && scols_column_is_tree(cl)) {
+		buffer_reset_data(buf);
+		rc = tree_art_to_buffer(tb, ln, buf);
+		if (!rc)
+			*width += mbs_safe_width(buffer_get_data(buf));
+	}
+	return rc;
 }
 
-#define is_last_column(_tb, _cl) \
-		list_entry_is_last(&(_cl)->cl_columns, &(_tb)->tb_columns)
+/*
+ * Returns the @ce data with control and non-printable chars encoded, for the
+ * tree column prefixed by the tree ascii art. The @cells returns number of
+ * cells and @art the size of the ascii art in bytes.
+ */
+static const char *cell_get_safe_data(struct libscols_table *tb,
+				      struct libscols_line *ln,	/* optional */
+				      struct libscols_column *cl,
+				      struct libscols_cell *ce,	/* optional */
+				      struct libscols_buffer *buf,
+				      size_t *cells, size_t *art)
+{
+	const char *data;
+	size_t width = 0, artcells = 0, artsz, sz;
 
-#define colsep(tb) ((tb)->colsep ? (tb)->colsep : " ")
-#define linesep(tb) ((tb)->linesep ? (tb)->linesep : "\n")
+	*art = 0;
+	*cells = 0;
+
+	data = ce ? __scols_cell_get_safe_data(ce, &width) : NULL;
+	if (!data)
+		return NULL;
+	if (!ln || !ln->parent || !scols_column_is_tree(cl)) {
+		*cells = width;
+		return data;
+	}
+
+	buffer_reset_data(buf);
+	if (tree_art_to_buffer(tb, ln, buf) != 0)
+		return NULL;
+
+	artsz = strlen(buffer_get_data(buf));
+	sz = strlen(data);
+	if (buffer_alloc_encdata(buf, mbs_safe_encode_size(artsz) + sz + 1))
+		return NULL;
+
+	if (mbs_safe_encode_to_buffer(buffer_get_data(buf), &artcells, buf->encdata))
+		*art = strlen(buf->encdata);
+
+	memcpy(buf->encdata + *art, data, sz + 1);
+	*cells = artcells + width;
+	return buf->encdata;
+}
 
 static int print_data(struct libscols_table *tb,
 		      struct libscols_column *cl,
@@ -163,7 +294,7 @@ static int print_data(struct libscols_table *tb,
 		      struct libscols_cell *ce,	/* optional */
 		      struct libscols_buffer *buf)
 {
-	size_t len = 0, i, width, bytes;
+	size_t len = 0, i, width, bytes, art = 0;
 	const char *color = NULL;
 	char *data;
 
@@ -204,10 +335,12 @@ static int print_data(struct libscols_table *tb,
 			color = cl->color;
 	}
 
-	/* encode, note that 'len' and 'width' are number of cells, not bytes */
-	data = buffer_get_safe_data(buf, &len);
-	if (!data)
+	/* encoded data, note that 'len' and 'width' are number of cells, not bytes */
+	data = (char *) cell_get_safe_data(tb, ln, cl, ce, buf, &len, &art);
+	if (!data || !len) {
 		data = "";
+		len = art = 0;
+	}
 	width = cl->width;
 	bytes = strlen(data);
 
@@ -216,6 +349,13 @@ static int print_data(struct libscols_table *tb,
 
 	/* truncate data */
 	if (len > width && scols_column_is_trunc(cl)) {
+		/* don't modify the data cached in the cell */
+		if (data != buf->encdata) {
+			if (buffer_alloc_encdata(buf, bytes + 1))
+				return -ENOMEM;
+			memcpy(buf->encdata, data, bytes + 1);
+			data = buf->encdata;
+		}
 		len = width;
 		bytes = mbs_truncate(data, &len);	/* updates 'len' */
 
@@ -237,7 +377,6 @@ static int print_data(struct libscols_table *tb,
 				len = xw;
 		} else if (color) {
 			char *p = data;
-			size_t art = buffer_get_safe_art_size(buf);
 
 			/* we don't want to colorize tree ascii art */
 			if (scols_column_is_tree(cl) && art && art < bytes) {
@@ -268,76 +407,6 @@ static int print_data(struct libscols_table *tb,
 	return 0;
 }
 
-/* returns pointer to the end of used data */
-static int line_ascii_art_to_buffer(struct libscols_table *tb,
-				    struct libscols_line *ln,
-				    struct libscols_buffer *buf)
-{
-	const char *art;
-	int rc;
-
-	assert(ln);
-	assert(buf);
-
-	if (!ln->parent)
-		return 0;
-
-	rc = line_ascii_art_to_buffer(tb, ln->parent, buf);
-	if (rc)
-		return rc;
-
-	if (list_entry_is_last(&ln->ln_children, &ln->parent->ln_branch))
-		art = "  ";
-	else
-		art = tb->symbols->vert;
-
-	return buffer_append_data(buf, art);
-}
-
-static int cell_to_buffer(struct libscols_table *tb,
-			  struct libscols_line *ln,
-			  struct libscols_column *cl,
-			  struct libscols_buffer *buf)
-{
-	const char *data;
-	struct libscols_cell *ce;
-	int rc = 0;
-
-	assert(tb);
-	assert(ln);
-	assert(cl);
-	assert(buf);
-	assert(cl->seqnum <= tb->ncols);
-
-	buffer_reset_data(buf);
-
-	ce = scols_line_get_cell(ln, cl->seqnum);
-	data = ce ? scols_cell_get_data(ce) : NULL;
-	if (!data)
-		return 0;
-
-	if (!scols_column_is_tree(cl))
-		return buffer_set_data(buf, data);
-
-	/*
-	 * Tree stuff
-	 */
-	if (ln->parent) {
-		rc = line_ascii_art_to_buffer(tb, ln->parent, buf);
-
-		if (!rc && list_entry_is_last(&ln->ln_children, &ln->parent->ln_branch))
-			rc = buffer_append_data(buf, tb->symbols->right);
-		else if (!rc)
-			rc = buffer_append_data(buf, tb->symbols->branch);
-		if (!rc)
-			buffer_set_art_index(buf);
-	}
-
-	if (!rc)
-		rc = buffer_append_data(buf, data);
-	return rc;
-}
-
 /*
  * Prints data, data maybe be printed in more formats (raw, NAME=xxx pairs) and
  * control and non-printable chars maybe encoded in \x?? hex encoding.
@@ -356,7 +425,9 @@ static int print_line(struct libscols_table *tb,
 
 	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
 	while (rc == 0 && scols_table_next_column(tb, &itr, &cl) == 0) {
-		rc = cell_to_buffer(tb, ln, cl, buf);
+		/* the human readable output uses data cached in the cells */
+		if (scols_table_is_raw(tb) || scols_table_is_export(tb))
+			rc = cell_to_buffer(tb, ln, cl, buf);
 		if (!rc)
 			rc = print_data(tb, cl, ln,
 					scols_line_get_cell(ln, cl->seqnum),
@@ -487,7 +558,8 @@ static void dbg_columns(struct libscols_table *tb)
 }
 
 /*
- * This function counts column width.
+ * This function counts width of all columns (or only the columns with extreme
+ * fields if @extreme is true), all lines are walked only once.
  *
  * For the SCOLS_FL_NOEXTREMES columns is possible to call this function two
  * times.  The first pass counts width and average width. If the column
@@ -495,69 +567,93 @@ static void dbg_columns(struct libscols_table *tb)
  * is marked as "extreme". In the second pass all extreme fields are ignored
  * and column width is counted from non-extreme fields only.
  */
-static int count_column_width(struct libscols_table *tb,
-			      struct libscols_column *cl,
-			      struct libscols_buffer *buf)
+static int count_column_widths(struct libscols_table *tb,
+			       struct libscols_buffer *buf,
+			       int extreme)
 {
+	struct libscols_column *cl;
 	struct libscols_line *ln;
-	struct libscols_iter itr;
-	int count = 0, rc = 0;
-	size_t sum = 0;
+	struct libscols_iter itr, litr;
+	struct colsum {
+		size_t	sum;
+		size_t	count;
+	} *sums;
+	int rc = 0;
 
 	assert(tb);
-	assert(cl);
 
-	cl->width = 0;
+	sums = calloc(tb->ncols, sizeof(*sums));
+	if (!sums)
+		return -ENOMEM;
 
 	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
-	while (scols_table_next_line(tb, &itr, &ln) == 0) {
-		size_t len;
-		char *data;
+	while (scols_table_next_column(tb, &itr, &cl) == 0) {
+		if (!extreme || cl->is_extreme)
+			cl->width = 0;
+	}
 
-		rc = cell_to_buffer(tb, ln, cl, buf);
-		if (rc)
-			return rc;
+	scols_reset_iter(&litr, SCOLS_ITER_FORWARD);
+	while (rc == 0 && scols_table_next_line(tb, &litr, &ln) == 0) {
 
-		data = buffer_get_data(buf);
-		len = data ? mbs_safe_width(data) : 0;
+		scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
+		while (scols_table_next_column(tb, &itr, &cl) == 0) {
+			size_t len;
 
-		if (len == (size_t) -1)		/* ignore broken multibyte strings */
-			len = 0;
-		if (len > cl->width_max)
-			cl->width_max = len;
+			if (extreme && !cl->is_extreme)
+				continue;
 
-		if (cl->is_extreme && len > cl->width_avg * 2)
-			continue;
-		else if (scols_column_is_noextremes(cl)) {
-			sum += len;
-			count++;
+			rc = cell_width(tb, ln, cl, buf, &len);
+			if (rc)
+				break;
+
+			if (len == (size_t) -1)		/* ignore broken multibyte strings */
+				len = 0;
+			if (len > cl->width_max)
+				cl->width_max = len;
+
+			if (cl->is_extreme && len > cl->width_avg * 2)
+				continue;
+			else if (scols_column_is_noextremes(cl)) {
+				sums[cl->seqnum].sum += len;
+				sums[cl->seqnum].count++;
+			}
+			if (len > cl->width)
+				cl->width = len;
 		}
-		if (len > cl->width)
-			cl->width = len;
 	}
 
-	if (count && cl->width_avg == 0) {
-		cl->width_avg = sum / count;
+	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
+	while (rc == 0 && scols_table_next_column(tb, &itr, &cl) == 0) {
+		struct colsum *cs = &sums[cl->seqnum];
 
-		if (cl->width_max > cl->width_avg * 2)
-			cl->is_extreme = 1;
-	}
+		if (extreme && !cl->is_extreme)
+			continue;
 
-	/* check and set minimal column width */
-	if (scols_cell_get_data(&cl->header))
-		cl->width_min = mbs_safe_width(scols_cell_get_data(&cl->header));
+		if (cs->count && cl->width_avg == 0) {
+			cl->width_avg = cs->sum / cs->count;
 
-	/* enlarge to minimal width */
-	if (cl->width < cl->width_min && !scols_column_is_strict_width(cl))
-		cl->width = cl->width_min;
+			if (cl->width_max > cl->width_avg * 2)
+				cl->is_extreme = 1;
+		}
+
+		/* check and set minimal column width */
+		if (scols_cell_get_data(&cl->header))
+			__scols_cell_get_safe_data(&cl->header, &cl->width_min);
+
+		/* enlarge to minimal width */
+		if (cl->width < cl->width_min && !scols_column_is_strict_width(cl))
+			cl->width = cl->width_min;
 
-	/* use relative size for large columns */
-	else if (cl->width_hint >= 1 && cl->width < (size_t) cl->width_hint
-		 && cl->width_min < (size_t) cl->width_hint)
+		/* use relative size for large columns */
+		else if (cl->width_hint >= 1 && cl->width < (size_t) cl->width_hint
+			 && cl->width_min < (size_t) cl->width_hint)
 
-		cl->width = (size_t) cl->width_hint;
+			cl->width = (size_t) cl->width_hint;
+
+		ON_DBG(COL, dbg_column(tb, cl));
+	}
 
-	ON_DBG(COL, dbg_column(tb, cl));
+	free(sums);
 	return rc;
 }
 
@@ -578,12 +674,12 @@ static int recount_widths(struct libscols_table *tb, struct libscols_buffer *buf
 
 	/* set basic columns width
 	 */
+	rc = count_column_widths(tb, buf, 0);
+	if (rc)
+		return rc;
+
 	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
 	while (scols_table_next_column(tb, &itr, &cl) == 0) {
-		rc = count_column_width(tb, cl, buf);
-		if (rc)
-			return rc;
-
 		width += cl->width + (is_last_column(tb, cl) ? 0 : 1);
 		extremes += cl->is_extreme;
 	}
@@ -594,25 +690,32 @@ static int recount_widths(struct libscols_table *tb, struct libscols_buffer *buf
 	/* reduce columns with extreme fields
 	 */
 	if (width > tb->termwidth && extremes) {
+		size_t *org_width = malloc(tb->ncols * sizeof(size_t));
+
 		DBG(TAB, ul_debugobj(tb, "   reduce width (extreme columns)"));
+		if (!org_width)
+			return -ENOMEM;
 
 		scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
-		while (scols_table_next_column(tb, &itr, &cl) == 0) {
-			size_t org_width;
+		while (scols_table_next_column(tb, &itr, &cl) == 0)
+			org_width[cl->seqnum] = cl->width;
 
+		rc = count_column_widths(tb, buf, 1);
+		if (rc) {
+			free(org_width);
+			return rc;
+		}
+
+		scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
+		while (scols_table_next_column(tb, &itr, &cl) == 0) {
 			if (!cl->is_extreme)
 				continue;
-
-			org_width = cl->width;
-			rc = count_column_width(tb, cl, buf);
-			if (rc)
-				return rc;
-
-			if (org_width > cl->width)
-				width -= org_width - cl->width;
+			if (org_width[cl->seqnum] > cl->width)
+				width -= org_width[cl->seqnum] - cl->width;
 			else
 				extremes--;	/* hmm... nothing reduced */
 		}
+		free(org_width);
 	}
 
 	if (width < tb->termwidth) {
@@ -726,6 +829,32 @@ static int recount_widths(struct libscols_table *tb, struct libscols_buffer *buf
 	return rc;
 }
 
+/*
+ * The data are unknown when the stream mode starts printing, so the widths of
+ * the columns are based on the width hints and headers only.
+ */
+static void stream_count_widths(struct libscols_table *tb)
+{
+	struct libscols_column *cl;
+	struct libscols_iter itr;
+
+	DBG(TAB, ul_debugobj(tb, "counting stream widths (termwidth=%zu)", tb->termwidth));
+
+	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
+	while (scols_table_next_column(tb, &itr, &cl) == 0) {
+		if (cl->width_hint >= 1)
+			cl->width = (size_t) cl->width_hint;
+		else
+			cl->width = (size_t) (cl->width_hint * tb->termwidth);
+
+		__scols_cell_get_safe_data(&cl->header, &cl->width_min);
+		if (cl->width < cl->width_min)
+			cl->width = cl->width_min;
+
+		ON_DBG(COL, dbg_column(tb, cl));
+	}
+}
+
 static size_t strlen_line(struct libscols_line *ln)
 {
 	size_t i, sz = 0;
@@ -742,48 +871,104 @@ static size_t strlen_line(struct libscols_line *ln)
 	return sz;
 }
 
+static void init_output(struct libscols_table *tb)
+{
+	if (!tb->symbols)
+		scols_table_set_symbols(tb, NULL);	/* use default */
+
+	tb->is_term = isatty(STDOUT_FILENO) ? 1 : 0;
+	tb->termwidth = tb->is_term ? get_terminal_width() : 0;
+	if (tb->termwidth <= 0)
+		tb->termwidth = 80;
+	tb->termwidth -= tb->termreduce;
+}
+
+/* allocates buffer large enough for all lines in the table */
+static struct libscols_buffer *new_table_buffer(struct libscols_table *tb)
+{
+	size_t bufsz = tb->termwidth;
+	struct libscols_line *ln;
+	struct libscols_iter itr;
+
+	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
+	while (scols_table_next_line(tb, &itr, &ln) == 0) {
+		size_t sz = strlen_line(ln);
+		if (sz > bufsz)
+			bufsz = sz;
+	}
 
+	return new_buffer(bufsz + 1);	/* data + space for \0 */
+}
+
+/*
+ * Prints and removes all lines from the table in the stream mode. The header
+ * is printed (and the column widths are set) before the first line.
+ */
+int __scols_print_stream(struct libscols_table *tb)
+{
+	struct libscols_buffer *buf;
+	int rc = 0;
+
+	assert(tb);
+
+	if (list_empty(&tb->tb_lines))
+		return 0;
+
+	if (!tb->stream_started) {
+		DBG(TAB, ul_debugobj(tb, "start stream printing"));
+		init_output(tb);
+		if (!(scols_table_is_raw(tb) || scols_table_is_export(tb)))
+			stream_count_widths(tb);
+	}
+
+	buf = new_table_buffer(tb);
+	if (!buf)
+		return -ENOMEM;
+
+	if (!tb->stream_started) {
+		rc = print_header(tb, buf);
+		tb->stream_started = 1;
+	}
+
+	while (rc == 0 && !list_empty(&tb->tb_lines)) {
+		struct libscols_line *ln = list_entry(tb->tb_lines.next,
+						struct libscols_line, ln_lines);
+		rc = print_line(tb, ln, buf);
+
+		if (ln->parent)
+			scols_line_remove_child(ln->parent, ln);
+		scols_table_remove_line(tb, ln);
+	}
+
+	free_buffer(buf);
+	return rc;
+}
 
 /**
  * scols_print_table:
  * @tb: table
  *
- * Prints the table to the output stream.
+ * Prints the table to the output stream. In the stream mode prints only the
+ * lines not printed yet, see scols_table_enable_stream().
  *
  * Returns: 0, a negative value in case of an error.
  */
 int scols_print_table(struct libscols_table *tb)
 {
 	int rc = 0;
-	size_t bufsz;
-	struct libscols_line *ln;
-	struct libscols_iter itr;
 	struct libscols_buffer *buf;
 
 	assert(tb);
 	if (!tb)
 		return -1;
 
-	DBG(TAB, ul_debugobj(tb, "printing"));
-	if (!tb->symbols)
-		scols_table_set_symbols(tb, NULL);	/* use default */
-
-	tb->is_term = isatty(STDOUT_FILENO) ? 1 : 0;
-	tb->termwidth = tb->is_term ? get_terminal_width() : 0;
-	if (tb->termwidth <= 0)
-		tb->termwidth = 80;
-	tb->termwidth -= tb->termreduce;
-
-	bufsz = tb->termwidth;
+	if (scols_table_is_streaming(tb))
+		return __scols_print_stream(tb);
 
-	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
-	while (scols_table_next_line(tb, &itr, &ln) == 0) {
-		size_t sz = strlen_line(ln);
-		if (sz > bufsz)
-			bufsz = sz;
-	}
+	DBG(TAB, ul_debugobj(tb, "printing"));
+	init_output(tb);
 
-	buf = new_buffer(bufsz + 1);	/* data + space for \0 */
+	buf = new_table_buffer(tb);
 	if (!buf)
 		return -ENOMEM;
 
@@ -142,12 +142,14 @@ static void add_lines(struct libscols_table *tb, const char *dirname)
 static void __attribute__((__noreturn__)) usage(FILE *out)
 {
 	fprintf(out, " %s [options] [<dir> ...]\n\n", program_invocation_short_name);
+	fputs(" -a, --arena          allocate lines from table arena\n", out);
 	fputs(" -c, --csv            display a csv-like output\n", out);
 	fputs(" -i, --ascii          use ascii characters only\n", out);
 	fputs(" -l, --list           use list format output\n", out);
 	fputs(" -n, --noheadings     don't print headings\n", out);
 	fputs(" -p, --pairs          use key=\"value\" output format\n", out);
 	fputs(" -r, --raw            use raw output format\n", out);
+	fputs(" -s, --stream         print lines when added\n", out);
 
 	exit(out == stderr ? EXIT_FAILURE : EXIT_SUCCESS);
 }
@@ -158,12 +160,14 @@ int main(int argc, char *argv[])
 	int c, notree = 0;
 
 	static const struct option longopts[] = {
+		{ "arena",	0, 0, 'a' },
 		{ "ascii",	0, 0, 'i' },
 		{ "csv",        0, 0, 'c' },
 		{ "list",       0, 0, 'l' },
 		{ "noheadings",	0, 0, 'n' },
 		{ "pairs",      0, 0, 'p' },
 		{ "raw",      0, 0, 'r' },
+		{ "stream",     0, 0, 's' },
 
 		{ NULL, 0, 0, 0 },
 	};
@@ -176,8 +180,11 @@ int main(int argc, char *argv[])
 	if (!tb)
 		err(EXIT_FAILURE, "faild to create output table");
 
-	while((c = getopt_long(argc, argv, "cilnpr", longopts, NULL)) != -1) {
+	while((c = getopt_long(argc, argv, "acilnprs", longopts, NULL)) != -1) {
 		switch(c) {
+		case 'a':
+			scols_table_enable_arena(tb, 1);
+			break;
 		case 'c':
 			scols_table_set_column_separator(tb, ",");
 			scols_table_enable_raw(tb, 1);
@@ -200,6 +207,9 @@ int main(int argc, char *argv[])
 			scols_table_enable_raw(tb, 1);
 			notree = 1;
 			break;
+		case 's':
+			scols_table_enable_stream(tb, 1);
+			break;
 		default:
 			usage(stderr);
 		}
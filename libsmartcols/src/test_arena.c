@@ -0,0 +1,111 @@
+/*
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ *
+ * Removes and re-adds table lines, the output has to be the same with and
+ * without the table arena.
+ */
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+#include "c.h"
+#include "nls.h"
+
+#include "libsmartcols.h"
+
+enum { COL_NAME, COL_DATA, COL_EXTRA, NCOLS };
+
+static struct libscols_line *add_line(struct libscols_table *tb, const char *name)
+{
+	struct libscols_line *ln = scols_table_new_line(tb, NULL);
+
+	if (!ln ||
+	    scols_line_set_data(ln, COL_NAME, name) ||
+	    scols_line_set_data(ln, COL_DATA, "data") ||
+	    scols_line_set_data(ln, COL_EXTRA, "extra"))
+		err(EXIT_FAILURE, "failed to create output line");
+	return ln;
+}
+
+static void print_table(struct libscols_table *tb, const char *title)
+{
+	size_t i;
+
+	printf("--- %s\n", title);
+	scols_print_table(tb);
+
+	/* the lines accessible by the number */
+	for (i = 0; i < 12; i++) {
+		struct libscols_line *ln = scols_table_get_line(tb, i);
+
+		if (ln)
+			printf("line %zu: %s\n", i, scols_cell_get_data(
+					scols_line_get_cell(ln, COL_NAME)));
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	struct libscols_table *tb;
+	struct libscols_line *ln, *lines[6];
+	char name[16];
+	size_t i;
+
+	setlocale(LC_ALL, "");
+
+	tb = scols_new_table();
+	if (!tb)
+		err(EXIT_FAILURE, "failed to create output table");
+	if (argc == 2 && strcmp(argv[1], "--arena") == 0)
+		scols_table_enable_arena(tb, 1);
+	else if (argc != 1)
+		errx(EXIT_FAILURE, "usage: %s [--arena]", program_invocation_short_name);
+
+	scols_table_enable_raw(tb, 1);
+	if (!scols_table_new_column(tb, "NAME", 0, 0) ||
+	    !scols_table_new_column(tb, "DATA", 0, 0) ||
+	    !scols_table_new_column(tb, "EXTRA", 0, 0))
+		err(EXIT_FAILURE, "failed to create output columns");
+
+	for (i = 0; i < 6; i++) {
+		snprintf(name, sizeof(name), "line%zu", i);
+		lines[i] = add_line(tb, name);
+	}
+	print_table(tb, "added");
+
+	/* the removed seqnums are reused by the next lines */
+	scols_table_remove_line(tb, lines[1]);
+	scols_table_remove_line(tb, lines[5]);
+	add_line(tb, "new6");
+	add_line(tb, "new7");
+	print_table(tb, "removed 1 and 5, added two lines");
+
+	/* remove a line and add it back to the table */
+	ln = lines[2];
+	scols_ref_line(ln);
+	scols_table_remove_line(tb, ln);
+	print_table(tb, "removed 2");
+	scols_table_add_line(tb, ln);
+	scols_unref_line(ln);
+	print_table(tb, "added 2 back");
+
+	/* shrink and enlarge cells, they are moved out of the arena */
+	ln = lines[3];
+	if (scols_line_alloc_cells(ln, NCOLS - 1) ||
+	    scols_line_alloc_cells(ln, NCOLS + 1) ||
+	    scols_line_set_data(ln, COL_DATA, "resized"))
+		err(EXIT_FAILURE, "failed to resize cells");
+	print_table(tb, "resized cells of 3");
+	scols_table_remove_line(tb, ln);
+	print_table(tb, "removed 3");
+
+	scols_table_remove_lines(tb);
+	add_line(tb, "again0");
+	add_line(tb, "again1");
+	print_table(tb, "removed all, added two lines");
+
+	scols_unref_table(tb);
+	return EXIT_SUCCESS;
+}
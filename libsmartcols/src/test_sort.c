@@ -0,0 +1,253 @@
+/*
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ *
+ * Checks the order of the lines after scols_sort_table_by().
+ */
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+#include "c.h"
+#include "nls.h"
+
+#include "libsmartcols.h"
+
+enum { COL_ID, COL_KEY, COL_SUBKEY };
+
+static struct libscols_table *new_table(int tree)
+{
+	struct libscols_table *tb = scols_new_table();
+
+	if (!tb)
+		err(EXIT_FAILURE, "failed to create output table");
+
+	scols_table_enable_ascii(tb, 1);
+	if (!scols_table_new_column(tb, "ID", 0.3, tree ? SCOLS_FL_TREE : 0) ||
+	    !scols_table_new_column(tb, "KEY", 0.3, 0) ||
+	    !scols_table_new_column(tb, "SUBKEY", 0.3, 0))
+		err(EXIT_FAILURE, "failed to create output columns");
+	return tb;
+}
+
+static struct libscols_line *add_line(struct libscols_table *tb,
+				      struct libscols_line *parent,
+				      const char *id, const char *key,
+				      const char *subkey)
+{
+	struct libscols_line *ln = scols_table_new_line(tb, parent);
+
+	if (!ln ||
+	    scols_line_set_data(ln, COL_ID, id) ||
+	    scols_line_set_data(ln, COL_KEY, key) ||
+	    scols_line_set_data(ln, COL_SUBKEY, subkey))
+		err(EXIT_FAILURE, "failed to create output line");
+	return ln;
+}
+
+static void sort_by(struct libscols_table *tb, const int *cols,
+		    const int *flags, size_t ncols)
+{
+	struct libscols_column *cls[3];
+	size_t i;
+
+	for (i = 0; i < ncols; i++)
+		cls[i] = scols_table_get_column(tb, cols[i]);
+	if (scols_sort_table_by(tb, cls, flags, ncols))
+		err(EXIT_FAILURE, "failed to sort table");
+}
+
+static void print_table(struct libscols_table *tb)
+{
+	scols_table_enable_raw(tb, !scols_table_is_tree(tb));
+	scols_print_table(tb);
+	scols_unref_table(tb);
+}
+
+/* KEY ascending, SUBKEY descending on equal KEYs */
+static int test_multi(void)
+{
+	struct libscols_table *tb = new_table(0);
+	const int cols[] = { COL_KEY, COL_SUBKEY };
+	const int flags[] = { 0, SCOLS_SORT_DESC };
+
+	add_line(tb, NULL, "1", "b", "x");
+	add_line(tb, NULL, "2", "a", "x");
+	add_line(tb, NULL, "3", "b", "z");
+	add_line(tb, NULL, "4", "c", "a");
+	add_line(tb, NULL, "5", "a", "y");
+	add_line(tb, NULL, "6", "b", "y");
+
+	sort_by(tb, cols, flags, 2);
+	print_table(tb);
+	return 0;
+}
+
+/* descending order, the keys with the same 8-byte prefix are compared completely */
+static int test_desc(void)
+{
+	struct libscols_table *tb = new_table(0);
+	const int cols[] = { COL_KEY };
+	const int flags[] = { SCOLS_SORT_DESC };
+
+	add_line(tb, NULL, "1", "sda", "-");
+	add_line(tb, NULL, "2", "sdb10-partition", "-");
+	add_line(tb, NULL, "3", "sdb1-partition", "-");
+	add_line(tb, NULL, "4", "sdc", "-");
+	add_line(tb, NULL, "5", "", "-");
+	add_line(tb, NULL, "6", "sdb10-partitiom", "-");
+
+	sort_by(tb, cols, flags, 1);
+	print_table(tb);
+	return 0;
+}
+
+/* equal KEYs keep the order of the lines (more lines than the insertion sort) */
+static int test_stable(void)
+{
+	struct libscols_table *tb = new_table(0);
+	const int cols[] = { COL_KEY };
+	char id[16], key[16];
+	size_t i;
+
+	for (i = 0; i < 40; i++) {
+		snprintf(id, sizeof(id), "%zu", i);
+		snprintf(key, sizeof(key), "key%zu", (i * 7) % 3);
+		add_line(tb, NULL, id, key, "-");
+	}
+
+	sort_by(tb, cols, NULL, 1);
+	print_table(tb);
+	return 0;
+}
+
+/*
+ * One numeric key and many lines use the radix sort. The order is checked
+ * rather than printed: the lines without sortkey go first (last in
+ * descending order) and the lines with equal keys keep their order.
+ */
+struct radix_pos {
+	int	 nokey;
+	uint64_t key;
+	size_t	 id;
+};
+
+static int check_radix(int desc)
+{
+	struct libscols_table *tb = new_table(0);
+	struct libscols_column *cl = scols_table_get_column(tb, COL_KEY);
+	struct libscols_iter *itr = scols_new_iter(SCOLS_ITER_FORWARD);
+	struct libscols_line *ln;
+	struct radix_pos prev = { 0 }, cur;
+	const int flags[] = { desc ? SCOLS_SORT_DESC : 0 };
+	uint64_t rnd = 42;
+	size_t i, n = 1000;
+	int rc = 0;
+	char id[16];
+
+	if (!itr)
+		err(EXIT_FAILURE, "failed to allocate iterator");
+
+	for (i = 0; i < n; i++) {
+		snprintf(id, sizeof(id), "%zu", i);
+		ln = add_line(tb, NULL, id, "-", "-");
+		if (i % 97 == 0)
+			continue;	/* no sortkey */
+
+		/* few distinct values, they differ in all bytes */
+		rnd = rnd * 6364136223846793005ULL + 1442695040888963407ULL;
+		scols_cell_set_sortkey(scols_line_get_cell(ln, COL_KEY),
+				(rnd >> 56) % 64 * 0x0101010101010101ULL);
+	}
+
+	if (scols_sort_table_by(tb, &cl, flags, 1))
+		err(EXIT_FAILURE, "failed to sort table");
+
+	for (i = 0; scols_table_next_line(tb, itr, &ln) == 0; i++) {
+		cur.id = strtoul(scols_cell_get_data(
+				scols_line_get_cell(ln, COL_ID)), NULL, 10);
+		cur.nokey = scols_cell_get_sortkey(
+				scols_line_get_cell(ln, COL_KEY), &cur.key) != 0;
+		if (cur.nokey)
+			cur.key = 0;
+
+		/* expected order: (nokey, key, id) ascending, or
+		 * (!nokey, key descending, id ascending) */
+		if (i && (prev.nokey != cur.nokey ?
+				(desc ? prev.nokey : cur.nokey) :
+			  prev.key != cur.key ?
+				(desc ? prev.key < cur.key : prev.key > cur.key) :
+			  prev.id > cur.id))
+			rc = 1;
+		if (cur.nokey != (cur.id % 97 == 0))
+			rc = 1;
+		prev = cur;
+	}
+	if (i != n)
+		rc = 1;
+
+	printf("radix %s: %s\n", desc ? "descending" : "ascending",
+			rc ? "FAILED" : "OK");
+	scols_free_iter(itr);
+	scols_unref_table(tb);
+	return rc;
+}
+
+static int test_radix(void)
+{
+	return check_radix(0) | check_radix(1);
+}
+
+/* children are sorted under their parents */
+static int test_tree(void)
+{
+	struct libscols_table *tb = new_table(1);
+	struct libscols_line *a, *b;
+	const int cols[] = { COL_KEY };
+
+	a = add_line(tb, NULL, "1", "d", "-");
+	add_line(tb, a, "1-1", "c", "-");
+	b = add_line(tb, a, "1-2", "a", "-");
+	add_line(tb, b, "1-2-1", "z", "-");
+	add_line(tb, b, "1-2-2", "b", "-");
+	add_line(tb, a, "1-3", "b", "-");
+	a = add_line(tb, NULL, "2", "a", "-");
+	add_line(tb, a, "2-1", "y", "-");
+	add_line(tb, a, "2-2", "x", "-");
+	add_line(tb, NULL, "3", "c", "-");
+
+	sort_by(tb, cols, NULL, 1);
+	print_table(tb);
+	return 0;
+}
+
+static const struct {
+	const char *name;
+	int (*func)(void);
+} tests[] = {
+	{ "multi",  test_multi },
+	{ "desc",   test_desc },
+	{ "stable", test_stable },
+	{ "radix",  test_radix },
+	{ "tree",   test_tree },
+};
+
+int main(int argc, char *argv[])
+{
+	size_t i;
+
+	setlocale(LC_ALL, "");
+
+	if (argc == 2) {
+		for (i = 0; i < ARRAY_SIZE(tests); i++) {
+			if (strcmp(argv[1], tests[i].name) == 0)
+				return tests[i].func() ? EXIT_FAILURE : EXIT_SUCCESS;
+		}
+	}
+
+	fprintf(stderr, " %s <test>\n\n", program_invocation_short_name);
+	for (i = 0; i < ARRAY_SIZE(tests); i++)
+		fprintf(stderr, "  %s\n", tests[i].name);
+	return EXIT_FAILURE;
+}
@@ -86,6 +86,10 @@
 #if defined(__linux__) && defined(HAVE_SYS_SYSCALL_H)
 #include <sys/syscall.h>
 #endif
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
+#include <poll.h>
 
 #include "all-io.h"
 #include "uuidP.h"
@@ -213,6 +217,12 @@ static int get_node_id(unsigned char *node_id)
 /* Assume that the gettimeofday() has microsecond granularity */
 #define MAX_ADJUSTMENT 10
 
+/* Number of time UUIDs reserved at once by uuid_generate_time() */
+#define UUID_TIME_BULK	1000
+
+/* Number of random UUIDs generated from one random_get_bytes() call */
+#define UUID_RANDOM_BULK	64
+
 /*
  * Get clock from global sequence clock counter.
  *
@@ -332,29 +342,232 @@ try_again:
 }
 
 #if defined(HAVE_UUIDD) && defined(HAVE_SYS_UN_H)
+# include <sys/mman.h>
+# ifndef SOCK_CLOEXEC
+#  define SOCK_CLOEXEC 0
+# endif
+# ifndef MSG_CMSG_CLOEXEC
+#  define MSG_CMSG_CLOEXEC 0
+# endif
 /*
- * Try using the uuidd daemon to generate the UUID
+ * The connection to uuidd is kept open and reused by the next request, the
+ * daemon serves more requests per connection. There is only one connection
+ * per process; a thread takes it over for the time of the request, so it's
+ * never used concurrently, and returns it back when done. The connection is
+ * not used in the child process after fork().
  *
- * Returns 0 on success, non-zero on failure.
+ * The application may close the descriptor or reuse its number (dup2(),
+ * close_range(), daemonizing), so the descriptor is kept together with the
+ * socket inode number and checked by fstat() before it's used or closed.
+ * The slot is 0 when empty, otherwise it's (inode << 32 | (fd + 1)).
  */
-static int get_uuid_via_daemon(int op, uuid_t out, int *num)
+static uint64_t	daemon_slot;
+static pid_t	daemon_pid;
+
+static uint32_t daemon_fd_ino(int fd)
+{
+	struct stat st;
+
+	if (fstat(fd, &st) != 0 || !S_ISSOCK(st.st_mode))
+		return 0;
+	return (uint32_t) st.st_ino;
+}
+
+/* takes over the connection, returns -1 if there is no usable connection */
+static int daemon_get_fd(void)
+{
+	uint64_t slot = __sync_lock_test_and_set(&daemon_slot, 0);
+	int fd = (int) (uint32_t) slot - 1;
+
+	if (fd < 0 || daemon_fd_ino(fd) != (uint32_t) (slot >> 32))
+		return -1;	/* not ours anymore, don't touch it */
+	if (daemon_pid != getpid()) {
+		close(fd);	/* inherited from parent */
+		return -1;
+	}
+	return fd;
+}
+
+/* returns the connection back, or closes it if there is already another */
+static void daemon_put_fd(int fd)
+{
+	uint32_t ino = daemon_fd_ino(fd);
+	uint64_t slot = ((uint64_t) ino << 32) | (uint32_t) (fd + 1);
+
+	daemon_pid = getpid();
+	if (!ino || !__sync_bool_compare_and_swap(&daemon_slot, 0, slot))
+		close(fd);
+}
+
+static const char *daemon_socket_path = UUIDD_SOCKET_PATH;
+
+/* don't wait for the daemon reply longer (milliseconds), the UUID is
+ * generated locally then */
+#define UUIDD_REPLY_TIMEOUT	1000
+
+static int daemon_connect(void)
 {
-	char op_buf[64];
-	int op_len;
-	int s;
-	ssize_t ret;
-	int32_t reply_len = 0, expected = 16;
 	struct sockaddr_un srv_addr;
+	int s;
 
-	if ((s = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+	if ((s = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0)
 		return -1;
 
 	srv_addr.sun_family = AF_UNIX;
-	strcpy(srv_addr.sun_path, UUIDD_SOCKET_PATH);
+	strcpy(srv_addr.sun_path, daemon_socket_path);
 
 	if (connect(s, (const struct sockaddr *) &srv_addr,
-		    sizeof(struct sockaddr_un)) < 0)
-		goto fail;
+		    sizeof(struct sockaddr_un)) < 0) {
+		close(s);
+		return -1;
+	}
+	return s;
+}
+
+/* waits for data from the daemon, returns 0 if there are data to read */
+static int daemon_wait(int s)
+{
+	struct pollfd pfd = { .fd = s, .events = POLLIN };
+	int rc;
+
+	do {
+		rc = poll(&pfd, 1, UUIDD_REPLY_TIMEOUT);
+	} while (rc < 0 && errno == EINTR);
+
+	return rc == 1 ? 0 : -1;
+}
+
+/* reads @len bytes from the daemon, returns 0 on success */
+static int daemon_read(int s, char *buf, size_t len)
+{
+	while (len) {
+		ssize_t ret;
+
+		if (daemon_wait(s) != 0)
+			return -1;
+		ret = read(s, buf, len);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return -1;
+		buf += ret;
+		len -= ret;
+	}
+	return 0;
+}
+
+/*
+ * Reads the reply length, the file descriptor (if any) is returned in @fd.
+ */
+static int read_reply_len(int s, int32_t *reply_len, int *fd)
+{
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+	union {
+		struct cmsghdr	cmsg;
+		char		buf[CMSG_SPACE(sizeof(int))];
+	} ctl;
+	ssize_t ret;
+
+	if (!fd)
+		return daemon_read(s, (char *) reply_len, sizeof(*reply_len));
+
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = reply_len;
+	iov.iov_len = sizeof(*reply_len);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = ctl.buf;
+	msg.msg_controllen = sizeof(ctl.buf);
+
+	if (daemon_wait(s) != 0)
+		return -1;
+	do {
+		ret = recvmsg(s, &msg, MSG_CMSG_CLOEXEC);
+	} while (ret < 0 && errno == EINTR);
+	if (ret <= 0)
+		return -1;
+
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level == SOL_SOCKET &&
+		    cmsg->cmsg_type == SCM_RIGHTS &&
+		    cmsg->cmsg_len == CMSG_LEN(sizeof(int)))
+			memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+	}
+	if (ret < (ssize_t) sizeof(*reply_len) &&
+	    daemon_read(s, (char *) reply_len + ret, sizeof(*reply_len) - ret))
+		return -1;
+	return 0;
+}
+
+/*
+ * Returns 0 on success, 1 on empty reply and -1 on error.
+ */
+static int daemon_request(int s, const char *op_buf, int op_len,
+			  char *reply, int32_t expected, int *fd)
+{
+	int32_t reply_len = 0;
+
+	/* MSG_NOSIGNAL, the daemon may already closed the connection */
+	if (send(s, op_buf, op_len, MSG_NOSIGNAL) != op_len)
+		return -1;
+	if (read_reply_len(s, &reply_len, fd) != 0)
+		return -1;
+	if (reply_len == 0 && fd)
+		return 1;
+	if (reply_len != expected)
+		return -1;
+	if (daemon_read(s, reply, reply_len) != 0)
+		return -1;
+	return 0;
+}
+
+/*
+ * Sends request to the daemon and reads the reply, the connection to the
+ * daemon is reused if possible.
+ *
+ * Returns 0 on success, non-zero on failure.
+ */
+static int call_daemon(const char *op_buf, int op_len,
+		       char *reply, int32_t expected, int *fd)
+{
+	int s, rc = -1;
+
+	s = daemon_get_fd();
+	if (s >= 0) {
+		rc = daemon_request(s, op_buf, op_len, reply, expected, fd);
+		if (rc < 0) {
+			/* closed by daemon (e.g. timeout), try a new connection */
+			close(s);
+			s = -1;
+		}
+	}
+	if (s < 0) {
+		s = daemon_connect();
+		if (s < 0)
+			return -1;
+		rc = daemon_request(s, op_buf, op_len, reply, expected, fd);
+		if (rc < 0) {
+			close(s);
+			return -1;
+		}
+	}
+
+	daemon_put_fd(s);
+	return rc;
+}
+
+/*
+ * Try using the uuidd daemon to generate the UUID
+ *
+ * Returns 0 on success, non-zero on failure.
+ */
+static int get_uuid_via_daemon(int op, uuid_t out, int *num)
+{
+	char op_buf[64];
+	int op_len;
+	int32_t expected = 16;
 
 	op_buf[0] = op;
 	op_len = 1;
@@ -364,30 +577,85 @@ static int get_uuid_via_daemon(int op, uuid_t out, int *num)
 		expected += sizeof(*num);
 	}
 
-	ret = write(s, op_buf, op_len);
-	if (ret < 1)
-		goto fail;
+	if (call_daemon(op_buf, op_len, op_buf, expected, NULL) != 0)
+		return -1;
 
-	ret = read_all(s, (char *) &reply_len, sizeof(reply_len));
-	if (ret < 0)
-		goto fail;
+	if (op == UUIDD_OP_BULK_TIME_UUID)
+		memcpy(num, op_buf+16, sizeof(int));
 
-	if (reply_len != expected)
-		goto fail;
+	memcpy(out, op_buf, 16);
+	return 0;
+}
 
-	ret = read_all(s, op_buf, reply_len);
+/*
+ * The ring of time UUID ranges shared by uuidd (if enabled, see uuidd.h).
+ * It's mapped on the first use and kept mapped, also if the daemon exits,
+ * because other threads may still read it.
+ */
+static struct uuidd_ring	*daemon_ring;
+static time_t			daemon_ring_retry;
 
-	if (op == UUIDD_OP_BULK_TIME_UUID)
-		memcpy(op_buf+16, num, sizeof(int));
+/* don't ask the daemon for the ring more often */
+#define UUIDD_RING_RETRY	10
 
-	memcpy(out, op_buf, 16);
+static struct uuidd_ring *get_daemon_ring(time_t now)
+{
+	struct uuidd_ring *ring = daemon_ring, *r;
+	char op = UUIDD_OP_GET_RING, reply[2 * sizeof(uint32_t)];
+	uint32_t magic, size;
+	struct stat st;
+	int fd = -1;
 
-	close(s);
-	return ((ret == expected) ? 0 : -1);
+	if (ring && ring->magic == UUIDD_RING_MAGIC)
+		return ring;
+	if (now < daemon_ring_retry)
+		return NULL;
+	daemon_ring_retry = now + UUIDD_RING_RETRY;
+
+	if (call_daemon(&op, 1, reply, sizeof(reply), &fd) != 0)
+		goto fail;
 
+	memcpy(&magic, reply, sizeof(magic));
+	memcpy(&size, reply + sizeof(magic), sizeof(size));
+	if (fd < 0 || magic != UUIDD_RING_MAGIC ||
+	    size != sizeof(struct uuidd_ring) ||
+	    fstat(fd, &st) != 0 || st.st_size < (off_t) size)
+		goto fail;
+
+	r = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (r == MAP_FAILED)
+		return NULL;
+	if (r->nslots != UUIDD_RING_SLOTS) {
+		munmap(r, size);
+		return NULL;
+	}
+	if (!__sync_bool_compare_and_swap(&daemon_ring, ring, r)) {
+		munmap(r, size);	/* mapped by another thread */
+		return daemon_ring;
+	}
+	return r;
 fail:
-	close(s);
-	return -1;
+	if (fd >= 0)
+		close(fd);
+	return NULL;
+}
+
+/*
+ * Try to claim range of time UUIDs from the ring shared by uuidd, it's
+ * only memory access, the daemon is called only when the ring is not
+ * mapped yet.
+ *
+ * Returns 0 on success, non-zero on failure.
+ */
+static int get_uuid_via_ring(uuid_t out, int *num)
+{
+	time_t now = time(NULL);
+	struct uuidd_ring *ring = get_daemon_ring(now);
+
+	if (!ring)
+		return -1;
+	return uuidd_ring_claim(ring, out, num, now);
 }
 
 #else /* !defined(HAVE_UUIDD) && defined(HAVE_SYS_UN_H) */
@@ -395,6 +663,11 @@ static int get_uuid_via_daemon(int op, uuid_t out, int *num)
 {
 	return -1;
 }
+
+static int get_uuid_via_ring(uuid_t out, int *num)
+{
+	return -1;
+}
 #endif
 
 int __uuid_generate_time(uuid_t out, int *num)
@@ -426,6 +699,47 @@ int __uuid_generate_time(uuid_t out, int *num)
 	return ret;
 }
 
+/*
+ * Returns the next UUID from the range reserved by get_clock().
+ */
+static inline void uuid_time_next(struct uuid *uu)
+{
+	uu->time_low++;
+	if (uu->time_low == 0) {
+		uu->time_mid++;
+		if (uu->time_mid == 0)
+			uu->time_hi_and_version++;
+	}
+}
+
+#if defined(HAVE_TLS) && defined(HAVE_LIBPTHREAD)
+static unsigned int	fork_gen;
+static int		fork_gen_ok;
+static pthread_once_t	fork_gen_once = PTHREAD_ONCE_INIT;
+
+static void fork_gen_child(void)
+{
+	fork_gen++;
+}
+
+static void fork_gen_init(void)
+{
+	fork_gen_ok = pthread_atfork(NULL, NULL, fork_gen_child) == 0;
+}
+
+/*
+ * Returns a number which is changed in the child after fork(). It's cheaper
+ * than getpid(), which is a syscall on current glibc.
+ */
+static unsigned int get_fork_gen(void)
+{
+	pthread_once(&fork_gen_once, fork_gen_init);
+	return fork_gen_ok ? fork_gen : (unsigned int) getpid();
+}
+#else
+# define get_fork_gen()	((unsigned int) getpid())
+#endif
+
 /*
  * Generate time-based UUID and store it to @out
  *
@@ -433,40 +747,51 @@ int __uuid_generate_time(uuid_t out, int *num)
  * or, if uuidd is not usable, by using the global clock state counter (see get_clock()).
  * If neither of these is possible (e.g. because of insufficient permissions), it generates
  * the UUID anyway, but returns -1. Otherwise, returns 0.
+ *
+ * The UUIDs are reserved in bulks per thread, so the daemon or the clock state
+ * file are used only once per UUID_TIME_BULK UUIDs. If uuidd shares the ring
+ * of pre-reserved ranges, the bulk is claimed from the ring without a call
+ * to the daemon. The clock state is
+ * updated before the first UUID of the bulk is returned, so the reserved range
+ * is never reused, even if the process crashes. The range is dropped after
+ * fork() and if it's older than one second.
  */
 static int uuid_generate_time_generic(uuid_t out) {
 #ifdef HAVE_TLS
 	THREAD_LOCAL int		num = 0;
 	THREAD_LOCAL struct uuid	uu;
 	THREAD_LOCAL time_t		last_time = 0;
+	THREAD_LOCAL unsigned int	last_fork_gen = 0;
+	THREAD_LOCAL int		ret = 0;
 	time_t				now;
 
 	if (num > 0) {
 		now = time(0);
-		if (now > last_time+1)
+		if (now > last_time+1 || get_fork_gen() != last_fork_gen)
 			num = 0;
 	}
 	if (num <= 0) {
-		num = 1000;
-		if (get_uuid_via_daemon(UUIDD_OP_BULK_TIME_UUID,
-					out, &num) == 0) {
-			last_time = time(0);
-			uuid_unpack(out, &uu);
-			num--;
-			return 0;
+		num = UUID_TIME_BULK;
+		if (get_uuid_via_ring(out, &num) == 0 ||
+		    get_uuid_via_daemon(UUIDD_OP_BULK_TIME_UUID,
+					out, &num) == 0)
+			ret = 0;
+		else {
+			/* reserve the range in the clock state file */
+			num = UUID_TIME_BULK;
+			ret = __uuid_generate_time(out, &num);
 		}
-		num = 0;
+		last_time = time(0);
+		last_fork_gen = get_fork_gen();
+		uuid_unpack(out, &uu);
+		num--;
+		return ret;
 	}
 	if (num > 0) {
-		uu.time_low++;
-		if (uu.time_low == 0) {
-			uu.time_mid++;
-			if (uu.time_mid == 0)
-				uu.time_hi_and_version++;
-		}
+		uuid_time_next(&uu);
 		num--;
 		uuid_pack(&uu, out);
-		return 0;
+		return ret;
 	}
 #else
 	if (get_uuid_via_daemon(UUIDD_OP_TIME_UUID, out, 0) == 0)
@@ -492,11 +817,47 @@ int uuid_generate_time_safe(uuid_t out)
 	return uuid_generate_time_generic(out);
 }
 
+/*
+ * Generate @n time-based UUIDs and store them to @out array.
+ *
+ * The UUIDs are reserved by ranges of up to UUID_TIME_BULK UUIDs from the
+ * uuidd daemon or from the clock state file, and the rest of the range is
+ * computed locally. Returns 0 if all UUIDs have been generated in a safe
+ * manner (see uuid_generate_time_safe()), otherwise returns -1.
+ */
+int uuid_generate_time_bulk(uuid_t *out, size_t n)
+{
+	int rc = 0;
+
+	while (n > 0) {
+		struct uuid uu;
+		int i, num = n > UUID_TIME_BULK ? UUID_TIME_BULK : (int) n;
+
+		if (get_uuid_via_ring(out[0], &num) == 0) {
+			if ((size_t) num > n)
+				num = n;	/* rest of the range is unused */
+		} else if (get_uuid_via_daemon(UUIDD_OP_BULK_TIME_UUID,
+					out[0], &num) != 0 ||
+		    num < 1 || (size_t) num > n) {
+			num = n > UUID_TIME_BULK ? UUID_TIME_BULK : (int) n;
+			if (__uuid_generate_time(out[0], &num) != 0)
+				rc = -1;
+		}
+
+		uuid_unpack(out[0], &uu);
+		for (i = 1; i < num; i++) {
+			uuid_time_next(&uu);
+			uuid_pack(&uu, out[i]);
+		}
+		out += num;
+		n -= num;
+	}
+	return rc;
+}
 
 void __uuid_generate_random(uuid_t out, int *num)
 {
-	uuid_t	buf;
-	struct uuid uu;
+	unsigned char buf[UUID_RANDOM_BULK * sizeof(uuid_t)];
 	int i, n;
 
 	if (!num || !*num)
@@ -504,15 +865,24 @@ void __uuid_generate_random(uuid_t out, int *num)
 	else
 		n = *num;
 
-	for (i = 0; i < n; i++) {
-		random_get_bytes(buf, sizeof(buf));
-		uuid_unpack(buf, &uu);
+	/*
+	 * Read the random data for more UUIDs at once and set the version and
+	 * variant bits in place; it is the same as uuid_unpack(), update of
+	 * the clock_seq and time_hi_and_version fields and uuid_pack().
+	 */
+	for (i = 0; i < n; ) {
+		int k, chunk = n - i > UUID_RANDOM_BULK ? UUID_RANDOM_BULK : n - i;
+		unsigned char *p = buf;
 
-		uu.clock_seq = (uu.clock_seq & 0x3FFF) | 0x8000;
-		uu.time_hi_and_version = (uu.time_hi_and_version & 0x0FFF)
-			| 0x4000;
-		uuid_pack(&uu, out);
-		out += sizeof(uuid_t);
+		random_get_bytes(buf, chunk * sizeof(uuid_t));
+
+		for (k = 0; k < chunk; k++, p += sizeof(uuid_t)) {
+			p[6] = (p[6] & 0x0F) | 0x40;	/* time_hi_and_version */
+			p[8] = (p[8] & 0x3F) | 0x80;	/* clock_seq */
+			memcpy(out, p, sizeof(uuid_t));
+			out += sizeof(uuid_t);
+		}
+		i += chunk;
 	}
 }
 
@@ -524,6 +894,20 @@ void uuid_generate_random(uuid_t out)
 	__uuid_generate_random(out, &num);
 }
 
+/*
+ * Generate @n random UUIDs and store them to @out array.
+ */
+void uuid_generate_random_bulk(uuid_t *out, size_t n)
+{
+	while (n > 0) {
+		int num = n > INT_MAX ? INT_MAX : (int) n;
+
+		__uuid_generate_random(out[0], &num);
+		out += num;
+		n -= num;
+	}
+}
+
 /*
  * Check whether good random source (/dev/random or /dev/urandom)
  * is available.
@@ -549,3 +933,127 @@ void uuid_generate(uuid_t out)
 	else
 		uuid_generate_time(out);
 }
+
+#if defined(TEST_PROGRAM) && defined(HAVE_UUIDD) && defined(HAVE_SYS_UN_H)
+#include <sys/wait.h>
+
+/* returns the descriptor of the kept connection, or -1 */
+static int test_slot_fd(void)
+{
+	return (int) (uint32_t) daemon_slot - 1;
+}
+
+static int test_requests(const char *msg, size_t n)
+{
+	size_t i;
+	uuid_t uu;
+	int fd = -1;
+
+	for (i = 0; i < n; i++) {
+		if (get_uuid_via_daemon(UUIDD_OP_TIME_UUID, uu, 0) != 0) {
+			printf("%s: request failed\n", msg);
+			return -1;
+		}
+		/* all the requests use the same connection */
+		if (i == 0)
+			fd = test_slot_fd();
+		else if (fd < 0 || fd != test_slot_fd()) {
+			printf("%s: connection not reused\n", msg);
+			return -1;
+		}
+	}
+	printf("%s: OK\n", msg);
+	return 0;
+}
+
+/* the daemon accepts connections, but it never replies */
+static int test_silent_daemon(const char *path)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	struct timeval start, end;
+	uuid_t uu;
+	int s, fd, rc;
+
+	if (snprintf(addr.sun_path, sizeof(addr.sun_path), "%s-silent", path)
+			>= (int) sizeof(addr.sun_path))
+		errx(EXIT_FAILURE, "socket path too long");
+	unlink(addr.sun_path);
+	s = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (s < 0 || bind(s, (struct sockaddr *) &addr, sizeof(addr)) != 0 ||
+	    listen(s, 8) != 0)
+		err(EXIT_FAILURE, "cannot create %s", addr.sun_path);
+
+	fd = daemon_get_fd();
+	if (fd >= 0)
+		close(fd);
+	daemon_socket_path = addr.sun_path;
+
+	gettimeofday(&start, NULL);
+	rc = get_uuid_via_daemon(UUIDD_OP_TIME_UUID, uu, 0);
+	gettimeofday(&end, NULL);
+
+	close(s);
+	unlink(addr.sun_path);
+	daemon_socket_path = path;
+
+	if (rc == 0) {
+		printf("silent daemon: unexpected reply\n");
+		return -1;
+	}
+	if (end.tv_sec - start.tv_sec > 2 * UUIDD_REPLY_TIMEOUT / 1000) {
+		printf("silent daemon: request not timed out\n");
+		return -1;
+	}
+	printf("silent daemon: OK\n");
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int pipefd[2], fd, status;
+	char c;
+	pid_t pid;
+
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s <uuidd-socket>\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	daemon_socket_path = argv[1];
+
+	if (test_requests("persistent connection", 100))
+		return EXIT_FAILURE;
+
+	/* the application reuses the descriptor number, the descriptor has
+	 * not to be used or closed by the library */
+	if (pipe(pipefd) != 0)
+		err(EXIT_FAILURE, "pipe failed");
+	fd = test_slot_fd();
+	if (dup2(pipefd[1], fd) != fd)
+		err(EXIT_FAILURE, "dup2 failed");
+	if (test_requests("reused descriptor", 10))
+		return EXIT_FAILURE;
+	if (fcntl(pipefd[0], F_SETFL, O_NONBLOCK) != 0 ||
+	    fcntl(fd, F_GETFD) < 0 || test_slot_fd() == fd ||
+	    read(pipefd[0], &c, 1) != -1 || errno != EAGAIN)
+		errx(EXIT_FAILURE, "the application descriptor used by library");
+	printf("application descriptor untouched: OK\n");
+
+	/* the child process does not share the connection with parent */
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0)
+		err(EXIT_FAILURE, "fork failed");
+	if (pid == 0)
+		exit(test_requests("child process", 10) ? EXIT_FAILURE : EXIT_SUCCESS);
+	if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+	    WEXITSTATUS(status) != EXIT_SUCCESS)
+		return EXIT_FAILURE;
+	if (test_requests("parent after fork", 10))
+		return EXIT_FAILURE;
+
+	if (test_silent_daemon(argv[1]))
+		return EXIT_FAILURE;
+
+	return EXIT_SUCCESS;
+}
+#endif /* TEST_PROGRAM */
@@ -40,6 +40,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "uuid.h"
 
@@ -60,6 +61,80 @@ static int test_uuid(const char * uuid, int isValid)
 	return 0;
 }
 
+static int cmp_uuid_bytes(const void *a, const void *b)
+{
+	return memcmp(a, b, sizeof(uuid_t));
+}
+
+/*
+ * The time UUIDs are reserved in bulks, make sure that the UUIDs from
+ * more bulks are unique.
+ */
+static int test_time_unique(size_t n)
+{
+	uuid_t *ary = malloc(n * sizeof(uuid_t));
+	size_t i;
+	int failed = 0;
+
+	if (!ary)
+		return 1;
+	for (i = 0; i < n; i++)
+		uuid_generate_time(ary[i]);
+
+	qsort(ary, n, sizeof(uuid_t), cmp_uuid_bytes);
+	for (i = 1; i < n; i++) {
+		if (memcmp(ary[i - 1], ary[i], sizeof(uuid_t)) == 0)
+			failed++;
+	}
+	printf("%zu time UUIDs, %d duplicates\n", n, failed);
+	free(ary);
+	return failed ? 1 : 0;
+}
+
+/*
+ * Check the bulk generators (type, variant and uniqueness of the UUIDs) and
+ * compare uuid_unparse_many() with uuid_unparse().
+ */
+static int test_bulk(size_t n)
+{
+	uuid_t *ary = malloc(2 * n * sizeof(uuid_t));
+	char *strs = malloc(2 * n * 37);
+	char str[37];
+	size_t i;
+	int failed = 0;
+
+	if (!ary || !strs) {
+		free(ary);
+		free(strs);
+		return 1;
+	}
+	uuid_generate_random_bulk(ary, n);
+	uuid_generate_time_bulk(ary + n, n);
+
+	for (i = 0; i < 2 * n; i++) {
+		if (uuid_type(ary[i]) != (i < n ? 4 : 1) ||
+		    uuid_variant(ary[i]) != UUID_VARIANT_DCE)
+			failed++;
+	}
+
+	uuid_unparse_many((const uuid_t *) ary, 2 * n, strs);
+	for (i = 0; i < 2 * n; i++) {
+		uuid_unparse(ary[i], str);
+		if (strcmp(str, strs + i * 37) != 0)
+			failed++;
+	}
+
+	qsort(ary, 2 * n, sizeof(uuid_t), cmp_uuid_bytes);
+	for (i = 1; i < 2 * n; i++) {
+		if (memcmp(ary[i - 1], ary[i], sizeof(uuid_t)) == 0)
+			failed++;
+	}
+	printf("%zu bulk UUIDs, %d failures\n", 2 * n, failed);
+	free(ary);
+	free(strs);
+	return failed ? 1 : 0;
+}
+
 #ifdef __GNUC__
 #define ATTR(x) __attribute__(x)
 #else
@@ -171,6 +246,8 @@ main(int argc ATTR((unused)) , char **argv ATTR((unused)))
 	failed += test_uuid("84949cc5-4701-4a84-895b0354c584a981b", 0);
 	failed += test_uuid("g4949cc5-4701-4a84-895b-354c584a981b", 0);
 	failed += test_uuid("84949cc5-4701-4a84-895b-354c584a981g", 0);
+	failed += test_time_unique(100000);
+	failed += test_bulk(100000);
 
 	if (failed) {
 		printf("%d failures.\n", failed);
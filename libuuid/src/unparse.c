@@ -33,44 +33,64 @@
  */
 
 #include <stdio.h>
+#include <stddef.h>
 
 #include "uuidP.h"
 
-static const char *fmt_lower =
-	"%08x-%04x-%04x-%02x%02x-%02x%02x%02x%02x%02x%02x";
-
-static const char *fmt_upper =
-	"%08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X";
+static const char hex_lower[] = "0123456789abcdef";
+static const char hex_upper[] = "0123456789ABCDEF";
 
 #ifdef UUID_UNPARSE_DEFAULT_UPPER
-#define FMT_DEFAULT fmt_upper
+#define HEX_DEFAULT hex_upper
 #else
-#define FMT_DEFAULT fmt_lower
+#define HEX_DEFAULT hex_lower
 #endif
 
-static void uuid_unparse_x(const uuid_t uu, char *out, const char *fmt)
+/*
+ * The UUID string is the 16 bytes in the network (big-endian) order, so
+ * it's possible to convert the bytes directly without uuid_unpack(). This
+ * is the same as the "%08x-%04x-%04x-%02x%02x-%02x%02x%02x%02x%02x%02x"
+ * format.
+ */
+static inline void uuid_unparse_x(const uuid_t uu, char *out, const char *hex)
 {
-	struct uuid uuid;
+	const unsigned char *p = uu;
+	size_t i;
 
-	uuid_unpack(uu, &uuid);
-	sprintf(out, fmt,
-		uuid.time_low, uuid.time_mid, uuid.time_hi_and_version,
-		uuid.clock_seq >> 8, uuid.clock_seq & 0xFF,
-		uuid.node[0], uuid.node[1], uuid.node[2],
-		uuid.node[3], uuid.node[4], uuid.node[5]);
+	for (i = 0; i < sizeof(uuid_t); i++) {
+		if (i == 4 || i == 6 || i == 8 || i == 10)
+			*out++ = '-';
+		*out++ = hex[p[i] >> 4];
+		*out++ = hex[p[i] & 0x0F];
+	}
+	*out = '\0';
 }
 
 void uuid_unparse_lower(const uuid_t uu, char *out)
 {
-	uuid_unparse_x(uu, out,	fmt_lower);
+	uuid_unparse_x(uu, out,	hex_lower);
 }
 
 void uuid_unparse_upper(const uuid_t uu, char *out)
 {
-	uuid_unparse_x(uu, out,	fmt_upper);
+	uuid_unparse_x(uu, out,	hex_upper);
 }
 
 void uuid_unparse(const uuid_t uu, char *out)
 {
-	uuid_unparse_x(uu, out, FMT_DEFAULT);
+	uuid_unparse_x(uu, out, HEX_DEFAULT);
+}
+
+/*
+ * Converts @n UUIDs from @uu array to strings. The @out buffer has to be
+ * at least @n * 37 bytes, the strings are stored one after another and each
+ * string is terminated by '\0' (like @n calls of uuid_unparse() with the
+ * out pointer moved by 37 bytes).
+ */
+void uuid_unparse_many(const uuid_t *uu, size_t n, char *out)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++, out += 37)
+		uuid_unparse_x(uu[i], out, HEX_DEFAULT);
 }
@@ -80,6 +80,8 @@ void uuid_generate(uuid_t out);
 void uuid_generate_random(uuid_t out);
 void uuid_generate_time(uuid_t out);
 int uuid_generate_time_safe(uuid_t out);
+void uuid_generate_random_bulk(uuid_t *out, size_t n);
+int uuid_generate_time_bulk(uuid_t *out, size_t n);
 
 /* isnull.c */
 int uuid_is_null(const uuid_t uu);
@@ -91,6 +93,7 @@ int uuid_parse(const char *in, uuid_t uu);
 void uuid_unparse(const uuid_t uu, char *out);
 void uuid_unparse_lower(const uuid_t uu, char *out);
 void uuid_unparse_upper(const uuid_t uu, char *out);
+void uuid_unparse_many(const uuid_t *uu, size_t n, char *out);
 
 /* uuid_time.c */
 time_t uuid_time(const uuid_t uu, struct timeval *ret_tv);
@@ -35,6 +35,10 @@
 #ifndef _UUID_UUIDD_H
 #define _UUID_UUIDD_H
 
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
 #define UUIDD_DIR		_PATH_LOCALSTATEDIR "/uuidd"
 #define UUIDD_SOCKET_PATH	UUIDD_DIR "/request"
 #define UUIDD_PIDFILE_PATH	UUIDD_DIR "/uuidd.pid"
@@ -46,9 +50,92 @@
 #define UUIDD_OP_RANDOM_UUID		3
 #define UUIDD_OP_BULK_TIME_UUID		4
 #define UUIDD_OP_BULK_RANDOM_UUID	5
-#define UUIDD_MAX_OP			UUIDD_OP_BULK_RANDOM_UUID
+#define UUIDD_OP_GET_RING		6
+#define UUIDD_MAX_OP			UUIDD_OP_GET_RING
 
 extern int __uuid_generate_time(uuid_t out, int *num);
 extern void __uuid_generate_random(uuid_t out, int *num);
 
+/*
+ * Shared ring of pre-reserved time UUID ranges.
+ *
+ * The daemon returns file descriptor of the ring (by SCM_RIGHTS) for
+ * UUIDD_OP_GET_RING request, the reply is UUIDD_RING_MAGIC and size of the
+ * ring or an empty reply if the ring is not enabled.
+ *
+ * The daemon fills the slots by ranges reserved by __uuid_generate_time().
+ * The slot for ticket T is slots[T % UUIDD_RING_SLOTS] and it's valid if
+ * slot seq is T. The clients claim the tickets by incrementing @head, the
+ * daemon publishes the tickets by incrementing @tail and it never writes to
+ * the slot of unclaimed ticket. The slot is written as seqlock, so a client
+ * which claims the ticket too late (the slot has been already reused)
+ * detects that and claims another ticket.
+ */
+#define UUIDD_RING_MAGIC	0x55524e47	/* "URNG" */
+#define UUIDD_RING_SLOTS	64
+#define UUIDD_RING_RANGE	1000		/* UUIDs per slot */
+#define UUIDD_RING_WRITING	(~(uint64_t) 0)	/* slot is being updated */
+#define UUIDD_RING_MAXAGE	1		/* seconds */
+
+struct uuidd_ring_slot {
+	uint64_t	seq;		/* ticket or UUIDD_RING_WRITING */
+	int64_t		stamp;		/* when the range has been reserved */
+	unsigned char	uuid[16];	/* the first UUID of the range */
+	int32_t		num;		/* number of UUIDs in the range */
+	int32_t		__pad;
+};
+
+struct uuidd_ring {
+	uint32_t	magic;		/* zero when the daemon exits */
+	uint32_t	nslots;
+
+	uint64_t	head __attribute__((aligned(64)));	/* next ticket to claim */
+	uint64_t	tail __attribute__((aligned(64)));	/* first unpublished ticket */
+
+	struct uuidd_ring_slot slots[UUIDD_RING_SLOTS] __attribute__((aligned(64)));
+};
+
+/*
+ * Claims range of time UUIDs from the ring, the first UUID is stored to
+ * @out and number of the UUIDs in the range to @num.
+ *
+ * Returns 0 on success, -1 if the ring is empty.
+ */
+static inline int uuidd_ring_claim(struct uuidd_ring *ring, uuid_t out,
+				   int *num, time_t now)
+{
+	int tries;
+
+	for (tries = 0; tries < UUIDD_RING_SLOTS; tries++) {
+		struct uuidd_ring_slot *sl;
+		uint64_t h, t;
+		int64_t stamp;
+		int n;
+
+		h = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+		t = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+		if (h >= t)
+			return -1;
+		if (!__sync_bool_compare_and_swap(&ring->head, h, h + 1))
+			continue;
+
+		sl = &ring->slots[h % UUIDD_RING_SLOTS];
+		if (__atomic_load_n(&sl->seq, __ATOMIC_ACQUIRE) != h)
+			continue;
+		memcpy(out, sl->uuid, sizeof(sl->uuid));
+		n = sl->num;
+		stamp = sl->stamp;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&sl->seq, __ATOMIC_RELAXED) != h)
+			continue;	/* overwritten while reading */
+
+		if (n < 1 || n > UUIDD_RING_RANGE ||
+		    stamp + UUIDD_RING_MAXAGE < now)
+			continue;	/* invalid or too old range */
+		*num = n;
+		return 0;
+	}
+	return -1;
+}
+
 #endif /* _UUID_UUID_H */
@@ -17,13 +17,7 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <errno.h>
-#ifdef HAVE_GETOPT_H
 #include <getopt.h>
-#else
-extern int getopt(int argc, char * const argv[], const char *optstring);
-extern char *optarg;
-extern int optind;
-#endif
 
 #define OUTPUT_VALUE_ONLY	(1 << 1)
 #define OUTPUT_DEVICE_ONLY	(1 << 2)
@@ -34,6 +28,9 @@ extern int optind;
 #define LOWPROBE_TOPOLOGY	(1 << 1)
 #define LOWPROBE_SUPERBLOCKS	(1 << 2)
 
+/* number of devices read at once by blkid_probe_prefetch() */
+#define LOWPROBE_BATCH		32
+
 #define BLKID_EXIT_NOTFOUND	2	/* token or device not found */
 #define BLKID_EXIT_OTHER	4	/* bad usage or other error */
 #define BLKID_EXIT_AMBIVAL	8	/* ambivalent low-level probing detected */
@@ -68,7 +65,7 @@ static void usage(int error)
 	fprintf(out,
 		"Usage:\n"
 		" %1$s -L <label> | -U <uuid>\n\n"
-		" %1$s [-c <file>] [-ghlLv] [-o <format>] [-s <tag>] \n"
+		" %1$s [-c <file>] [-ghlLv] [-j <num>] [-o <format>] [-s <tag>] \n"
 		"       [-t <token>] [<dev> ...]\n\n"
 		" %1$s -p [-s <tag>] [-O <offset>] [-S <size>] \n"
 		"       [-o <format>] <dev> ...\n\n"
@@ -79,6 +76,8 @@ static void usage(int error)
 		" -d          don't encode non-printing characters\n"
 		" -h          print this usage message and exit\n"
 		" -g          garbage collect the blkid cache\n"
+		" -j, --jobs <num>\n"
+		"             probe all devices by <num> parallel threads\n"
 		" -o <format> output format; can be one of:\n"
 		"               value, device, export or full; (default: full)\n"
 		" -k          list all known filesystems/RAIDs and exit\n"
@@ -479,24 +478,44 @@ static int lowprobe_topology(blkid_probe pr)
 	return blkid_do_fullprobe(pr);
 }
 
-static int lowprobe_device(blkid_probe pr, const char *devname,
-			int chain, char *show[], int output,
-			blkid_loff_t offset, blkid_loff_t size)
+struct lowprobe_dev {
+	const char	*devname;
+	blkid_probe	pr;
+	int		fd;
+	int		err;	/* open() errno */
+	int		ready;	/* blkid_probe_set_device() success */
+};
+
+static void lowprobe_open(struct lowprobe_dev *dev,
+			  blkid_loff_t offset, blkid_loff_t size)
+{
+	dev->ready = 0;
+	dev->err = 0;
+	dev->fd = open(dev->devname, O_RDONLY|O_CLOEXEC);
+	if (dev->fd < 0)
+		dev->err = errno;
+	else if (blkid_probe_set_device(dev->pr, dev->fd, offset, size) == 0)
+		dev->ready = 1;
+}
+
+static int lowprobe_device(struct lowprobe_dev *dev, int chain,
+			   char *show[], int output)
 {
+	blkid_probe pr = dev->pr;
+	const char *devname = dev->devname;
 	const char *data;
 	const char *name;
 	int nvals = 0, n, num = 1;
 	size_t len;
-	int fd;
 	int rc = 0;
 	static int first = 1;
 
-	fd = open(devname, O_RDONLY|O_CLOEXEC);
-	if (fd < 0) {
+	if (dev->fd < 0) {
+		errno = dev->err;
 		fprintf(stderr, "error: %s: %m\n", devname);
 		return BLKID_EXIT_NOTFOUND;
 	}
-	if (blkid_probe_set_device(pr, fd, offset, size))
+	if (!dev->ready)
 		goto done;
 
 	if (chain & LOWPROBE_TOPOLOGY)
@@ -558,7 +577,8 @@ done:
 				"to see more details)\n",
 				devname);
 	}
-	close(fd);
+	close(dev->fd);
+	dev->fd = -1;
 
 	if (rc == -2)
 		return BLKID_EXIT_AMBIVAL;	/* ambivalent probing result */
@@ -667,9 +687,14 @@ int main(int argc, char **argv)
 	unsigned int i;
 	int output_format = 0;
 	int lookup = 0, gc = 0, lowprobe = 0, eval = 0;
-	int c;
+	int c, njobs = 1;
 	uintmax_t offset = 0, size = 0;
 
+	static const struct option longopts[] = {
+		{ "jobs", 1, 0, 'j' },
+		{ NULL, 0, 0, 0 },
+	};
+
 	static const ul_excl_t excl[] = {       /* rows and cols in in ASCII order */
 		{ 'n','u' },
 		{ 0 }
@@ -679,8 +704,9 @@ int main(int argc, char **argv)
 	show[0] = NULL;
 	atexit(close_stdout);
 
-	while ((c = getopt (argc, argv,
-			    "c:df:ghilL:n:ko:O:ps:S:t:u:U:w:Vv")) != EOF) {
+	while ((c = getopt_long (argc, argv,
+			    "c:df:ghij:lL:n:ko:O:ps:S:t:u:U:w:Vv",
+			    longopts, NULL)) != EOF) {
 
 		err_exclusive_options(c, NULL, excl, excl_st);
 
@@ -713,6 +739,11 @@ int main(int argc, char **argv)
 		case 'i':
 			lowprobe |= LOWPROBE_TOPOLOGY;
 			break;
+		case 'j':
+			njobs = strtos32_or_err(optarg, "invalid jobs argument");
+			if (njobs < 1)
+				errx(BLKID_EXIT_OTHER, "invalid jobs argument: %s", optarg);
+			break;
 		case 'l':
 			lookup++;
 			break;
@@ -836,7 +867,8 @@ int main(int argc, char **argv)
 		/*
 		 * Low-level API
 		 */
-		blkid_probe pr;
+		struct lowprobe_dev *devs;
+		unsigned int k, n, nprs;
 
 		if (!numdev) {
 			fprintf(stderr, "The low-level probing mode "
@@ -848,11 +880,21 @@ int main(int argc, char **argv)
 		if (!output_format  && (lowprobe & LOWPROBE_TOPOLOGY))
 			output_format = OUTPUT_EXPORT_LIST;
 
-		pr = blkid_new_probe();
-		if (!pr)
-			goto exit;
+		/*
+		 * The devices are probed in batches, the areas with magic
+		 * strings are read for all devices in the batch at once.
+		 */
+		nprs = min(numdev, (unsigned int) LOWPROBE_BATCH);
+		devs = xcalloc(nprs, sizeof(struct lowprobe_dev));
+
+		for (k = 0; k < nprs; k++) {
+			blkid_probe pr = devs[k].pr = blkid_new_probe();
+
+			if (!pr)
+				goto exit;
+			if (!(lowprobe & LOWPROBE_SUPERBLOCKS))
+				continue;
 
-		if (lowprobe & LOWPROBE_SUPERBLOCKS) {
 			blkid_probe_set_superblocks_flags(pr,
 				BLKID_SUBLKS_LABEL | BLKID_SUBLKS_UUID |
 				BLKID_SUBLKS_TYPE | BLKID_SUBLKS_SECTYPE |
@@ -867,15 +909,31 @@ int main(int argc, char **argv)
 				goto exit;
 		}
 
-		for (i = 0; i < numdev; i++) {
-			err = lowprobe_device(pr, devices[i], lowprobe, show,
-					output_format,
-					(blkid_loff_t) offset,
-					(blkid_loff_t) size);
-			if (err)
-				break;
+		for (i = 0, err = 0; i < numdev && !err; i += n) {
+			blkid_probe prs[LOWPROBE_BATCH];
+
+			n = min(numdev - i, nprs);
+			for (k = 0; k < n; k++) {
+				devs[k].devname = devices[i + k];
+				lowprobe_open(&devs[k], (blkid_loff_t) offset,
+						(blkid_loff_t) size);
+				prs[k] = devs[k].pr;
+			}
+			if (lowprobe & LOWPROBE_SUPERBLOCKS)
+				blkid_probe_prefetch(prs, n);
+
+			for (k = 0; k < n; k++) {
+				if (!err)
+					err = lowprobe_device(&devs[k], lowprobe,
+							show, output_format);
+				if (devs[k].fd >= 0)
+					close(devs[k].fd);
+			}
 		}
-		blkid_free_probe(pr);
+
+		for (k = 0; k < nprs; k++)
+			blkid_free_probe(devs[k].pr);
+		free(devs);
 	} else if (eval) {
 		/*
 		 * Evaluate API
@@ -910,7 +968,7 @@ int main(int argc, char **argv)
 		blkid_dev_iterate	iter;
 		blkid_dev		dev;
 
-		blkid_probe_all(cache);
+		blkid_probe_all_parallel(cache, njobs);
 
 		iter = blkid_dev_iterate_begin(cache);
 		blkid_dev_set_search(iter, search_type, search_value);
@@ -29,7 +29,6 @@
 # include <sys/ioctl.h>
 #endif
 #include <assert.h>
-#include <poll.h>
 #include <sys/statvfs.h>
 #include <sys/types.h>
 #ifdef HAVE_LIBUDEV
@@ -1048,19 +1047,17 @@ static int poll_match(struct libmnt_fs *fs)
 	return rc;
 }
 
-static int poll_table(struct libmnt_table *tb, const char *tabfile,
-		  int timeout, struct libscols_table *table, int direction)
+static int poll_table(const char *tabfile, int timeout,
+		      struct libscols_table *table, int direction)
 {
-	FILE *f = NULL;
 	int rc = -1;
 	struct libmnt_iter *itr = NULL;
-	struct libmnt_table *tb_new = NULL;
+	struct libmnt_monitor *mn = NULL;
 	struct libmnt_tabdiff *diff = NULL;
-	struct pollfd fds[1];
 
-	tb_new = mnt_new_table();
-	if (!tb_new) {
-		warn(_("failed to initialize libmount table"));
+	mn = mnt_new_monitor();
+	if (!mn) {
+		warn(_("failed to initialize libmount monitor"));
 		goto done;
 	}
 
@@ -1076,27 +1073,24 @@ static int poll_table(struct libmnt_table *tb, const char *tabfile,
 		goto done;
 	}
 
-	/* cache is unnecessary to detect changes */
-	mnt_table_set_cache(tb, NULL);
-	mnt_table_set_cache(tb_new, NULL);
+	mnt_table_set_parser_errcb(mnt_monitor_get_table(mn), parser_errcb);
 
-	f = fopen(tabfile, "r");
-	if (!f) {
+	/* the monitor keeps the table and applies the changes only */
+	if (mnt_monitor_set_file(mn, tabfile) != 0 ||
+	    mnt_monitor_get_fd(mn) < 0) {
 		warn(_("cannot open %s"), tabfile);
 		goto done;
 	}
-
-	mnt_table_set_parser_errcb(tb_new, parser_errcb);
-
-	fds[0].fd = fileno(f);
-	fds[0].events = POLLPRI;
+	if (mnt_monitor_update(mn, NULL) < 0) {
+		warn(_("%s: parse error"), tabfile);
+		goto done;
+	}
 
 	while (1) {
-		struct libmnt_table *tmp;
 		struct libmnt_fs *old, *new;
 		int change, count;
 
-		count = poll(fds, 1, timeout);
+		count = mnt_monitor_wait(mn, timeout);
 		if (count == 0)
 			break;	/* timeout */
 		if (count < 0) {
@@ -1104,10 +1098,7 @@ static int poll_table(struct libmnt_table *tb, const char *tabfile,
 			goto done;
 		}
 
-		rewind(f);
-		rc = mnt_table_parse_stream(tb_new, f, tabfile);
-		if (!rc)
-			rc = mnt_diff_tables(diff, tb, tb_new);
+		rc = mnt_monitor_update(mn, diff);
 		if (rc < 0)
 			goto done;
 
@@ -1134,13 +1125,7 @@ static int poll_table(struct libmnt_table *tb, const char *tabfile,
 				goto done;
 		}
 
-		/* swap tables */
-		tmp = tb;
-		tb = tb_new;
-		tb_new = tmp;
-
 		scols_table_remove_lines(table);
-		mnt_reset_table(tb_new);
 
 		if (count && (flags & FL_FIRSTONLY))
 			break;
@@ -1148,11 +1133,9 @@ static int poll_table(struct libmnt_table *tb, const char *tabfile,
 
 	rc = 0;
 done:
-	mnt_unref_table(tb_new);
 	mnt_free_tabdiff(diff);
 	mnt_free_iter(itr);
-	if (f)
-		fclose(f);
+	mnt_unref_monitor(mn);
 	return rc;
 }
 
@@ -1531,6 +1514,10 @@ int main(int argc, char *argv[])
 	scols_table_enable_export(table,     !!(flags & FL_EXPORT));
 	scols_table_enable_ascii(table,      !!(flags & FL_ASCII));
 	scols_table_enable_noheadings(table, !!(flags & FL_NOHEADINGS));
+	scols_table_enable_stream(table,     (flags & (FL_RAW | FL_EXPORT))
+					     && !(flags & FL_POLL));
+	/* --poll removes and adds lines, the arena would grow forever */
+	scols_table_enable_arena(table,      !(flags & FL_POLL));
 
 	for (i = 0; i < ncolumns; i++) {
 		int fl = get_column_flags(i);
@@ -1556,7 +1543,7 @@ int main(int argc, char *argv[])
 	 */
 	if (flags & FL_POLL) {
 		/* poll mode (accept the first tabfile only) */
-		rc = poll_table(tb, tabfiles ? *tabfiles : _PATH_PROC_MOUNTINFO, timeout, table, direction);
+		rc = poll_table(tabfiles ? *tabfiles : _PATH_PROC_MOUNTINFO, timeout, table, direction);
 
 	} else if ((flags & FL_TREE) && !(flags & FL_SUBMOUNTS)) {
 		/* whole tree */
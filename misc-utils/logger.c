@@ -47,6 +47,7 @@
 #include <sys/timex.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <poll.h>
 #include <sys/un.h>
 #include <arpa/inet.h>
 #include <netdb.h>
@@ -80,6 +81,12 @@ enum {
 	OPT_RFC5424
 };
 
+#define LOGGER_BATCH	64		/* max. messages sent at once */
+#define LOGGER_BATCHSZ	(64 * 1024)	/* max. size of the batch */
+#define LOGGER_READSZ	(64 * 1024)	/* stdin read() size */
+#define LOGGER_MAXLINE	(63 * 1024)	/* max. line, the message with the
+					   header fits to one UDP datagram */
+
 struct logger_ctl {
 	int fd;
 	int pri;
@@ -89,7 +96,20 @@ struct logger_ctl {
 	char *server;
 	char *port;
 	int socket_type;
-	void (*syslogfp)(const struct logger_ctl *ctl, const char *msg);
+	void (*syslogfp)(struct logger_ctl *ctl, const char *msg);
+
+	char *hdr;			/* pre-formatted hostname, tag and pid */
+	time_t stamp_sec;		/* second of the cached time stamp */
+	char stamp[64];			/* cached time stamp */
+	char stamp_tz[16];		/* cached RFC 5424 time zone offset */
+	char timeq[80];			/* cached RFC 5424 time quality */
+
+	char *buf;			/* formatted messages of the batch */
+	size_t bufsz;
+	size_t buflen;
+	size_t nmsgs;			/* number of messages in the batch */
+	size_t msgoff[LOGGER_BATCH + 1]; /* message offsets in buf */
+
 	unsigned int
 			prio_prefix:1,	/* read priority from intput */
 			stderr_printout:1, /* output message to stderr */
@@ -162,7 +182,11 @@ static int pencode(char *s)
 	return ((level & LOG_PRIMASK) | (facility & LOG_FACMASK));
 }
 
-static int unix_socket(const char *path, const int socket_type)
+/*
+ * Connects to the socket and narrows @socket_type to the type of the
+ * connection really used.
+ */
+static int unix_socket(const char *path, int *socket_type)
 {
 	int fd, i;
 	static struct sockaddr_un s_addr;	/* AF_UNIX address of local logger */
@@ -176,9 +200,9 @@ static int unix_socket(const char *path, const int socket_type)
 	for (i = 2; i; i--) {
 		int st = -1;
 
-		if (i == 2 && socket_type & TYPE_UDP)
+		if (i == 2 && *socket_type & TYPE_UDP)
 			st = SOCK_DGRAM;
-		if (i == 1 && socket_type & TYPE_TCP)
+		if (i == 1 && *socket_type & TYPE_TCP)
 			st = SOCK_STREAM;
 		if (st == -1 || (fd = socket(AF_UNIX, st, 0)) == -1)
 			continue;
@@ -192,11 +216,12 @@ static int unix_socket(const char *path, const int socket_type)
 	if (i == 0)
 		err(EXIT_FAILURE, _("socket %s"), path);
 
+	*socket_type = i == 2 ? TYPE_UDP : TYPE_TCP;
 	return fd;
 }
 
 static int inet_socket(const char *servername, const char *port,
-		       const int socket_type)
+		       int *socket_type)
 {
 	int fd, errcode, i;
 	struct addrinfo hints, *res;
@@ -204,12 +229,12 @@ static int inet_socket(const char *servername, const char *port,
 
 	for (i = 2; i; i--) {
 		memset(&hints, 0, sizeof(hints));
-		if (i == 2 && socket_type & TYPE_UDP) {
+		if (i == 2 && *socket_type & TYPE_UDP) {
 			hints.ai_socktype = SOCK_DGRAM;
 			if (port == NULL)
 				p = "syslog";
 		}
-		if (i == 1 && socket_type & TYPE_TCP) {
+		if (i == 1 && *socket_type & TYPE_TCP) {
 			hints.ai_socktype = SOCK_STREAM;
 			if (port == NULL)
 				p = "syslog-conn";
@@ -238,6 +263,7 @@ static int inet_socket(const char *servername, const char *port,
 	if (i == 0)
 		errx(EXIT_FAILURE, _("failed to connect to %s port %s"), servername, p);
 
+	*socket_type = i == 2 ? TYPE_UDP : TYPE_TCP;
 	return fd;
 }
 
@@ -287,105 +313,214 @@ static char *xgetlogin(void)
 	return cp;
 }
 
-static void syslog_rfc3164(const struct logger_ctl *ctl, const char *msg)
+static void buf_append(struct logger_ctl *ctl, const char *str, size_t len)
+{
+	if (ctl->bufsz < ctl->buflen + len + 1) {
+		ctl->bufsz = max(ctl->bufsz * 2, ctl->buflen + len + 1);
+		ctl->buf = xrealloc(ctl->buf, ctl->bufsz);
+	}
+	memcpy(ctl->buf + ctl->buflen, str, len);
+	ctl->buflen += len;
+	ctl->buf[ctl->buflen] = '\0';
+}
+
+static inline void buf_append_str(struct logger_ctl *ctl, const char *str)
+{
+	buf_append(ctl, str, strlen(str));
+}
+
+static void write_msgs(struct logger_ctl *ctl, size_t i)
+{
+	for (; i < ctl->nmsgs; i++)
+		if (write_all(ctl->fd, ctl->buf + ctl->msgoff[i],
+			      ctl->msgoff[i + 1] - ctl->msgoff[i]) < 0)
+			warn(_("write failed"));
+}
+
+/*
+ * Sends the batch of formatted messages. The stream sockets get all the
+ * messages by one write, datagram sockets by sendmmsg(), one message per
+ * datagram.
+ */
+static void logger_flush(struct logger_ctl *ctl)
+{
+	if (!ctl->nmsgs)
+		return;
+
+	if (ctl->socket_type == TYPE_TCP) {
+		if (write_all(ctl->fd, ctl->buf, ctl->buflen) < 0)
+			warn(_("write failed"));
+	} else {
+#ifdef HAVE_SENDMMSG
+		struct mmsghdr msgs[LOGGER_BATCH];
+		struct iovec iov[LOGGER_BATCH];
+		size_t i;
+
+		memset(msgs, 0, ctl->nmsgs * sizeof(struct mmsghdr));
+		for (i = 0; i < ctl->nmsgs; i++) {
+			iov[i].iov_base = ctl->buf + ctl->msgoff[i];
+			iov[i].iov_len = ctl->msgoff[i + 1] - ctl->msgoff[i];
+			msgs[i].msg_hdr.msg_iov = &iov[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+		for (i = 0; i < ctl->nmsgs; ) {
+			int rc = sendmmsg(ctl->fd, msgs + i, ctl->nmsgs - i, 0);
+
+			if (rc >= 0) {
+				i += rc;
+				continue;
+			}
+			if (errno == EINTR)
+				continue;
+			if (errno == ENOSYS) {
+				/* old kernel */
+				write_msgs(ctl, i);
+				break;
+			}
+			warn(_("write failed"));
+			i++;		/* drop the message */
+		}
+#else
+		write_msgs(ctl, 0);
+#endif
+	}
+	ctl->nmsgs = 0;
+	ctl->buflen = 0;
+}
+
+static void begin_msg(struct logger_ctl *ctl)
+{
+	char pri[16];
+
+	buf_append(ctl, pri, snprintf(pri, sizeof(pri), "<%d>", ctl->pri));
+}
+
+static void end_msg(struct logger_ctl *ctl)
+{
+	if (ctl->stderr_printout)
+		fprintf(stderr, "%s\n", ctl->buf + ctl->msgoff[ctl->nmsgs]);
+
+	/* more messages may be written to the stream at once, terminate
+	 * them to keep them separated */
+	if (ctl->socket_type == TYPE_TCP)
+		buf_append(ctl, "\n", 1);
+
+	ctl->msgoff[++ctl->nmsgs] = ctl->buflen;
+	if (ctl->nmsgs == LOGGER_BATCH || LOGGER_BATCHSZ <= ctl->buflen)
+		logger_flush(ctl);
+}
+
+static void syslog_rfc3164(struct logger_ctl *ctl, const char *msg)
 {
-	char *buf, pid[30], *cp, *tp, *hostname, *dot;
 	time_t now;
-	int len;
 
-	*pid = '\0';
 	if (ctl->fd < 0)
 		return;
-	if (ctl->pid)
-		snprintf(pid, sizeof(pid), "[%d]", ctl->pid);
 
-	cp = ctl->tag ? ctl->tag : xgetlogin();
+	if (!ctl->hdr) {
+		char pid[30], *cp, *hostname, *dot;
 
-	hostname = xgethostname();
-	dot = strchr(hostname, '.');
-	if (dot)
-		*dot = '\0';
+		*pid = '\0';
+		if (ctl->pid)
+			snprintf(pid, sizeof(pid), "[%d]", ctl->pid);
 
-	time(&now);
-	tp = ctime(&now) + 4;
+		cp = ctl->tag ? ctl->tag : xgetlogin();
 
-	len = xasprintf(&buf, "<%d>%.15s %s %.200s%s: %.400s",
-		 ctl->pri, tp, hostname, cp, pid, msg);
+		hostname = xgethostname();
+		dot = strchr(hostname, '.');
+		if (dot)
+			*dot = '\0';
 
-	if (write_all(ctl->fd, buf, len) < 0)
-		warn(_("write failed"));
-	if (ctl->stderr_printout)
-		fprintf(stderr, "%s\n", buf);
+		xasprintf(&ctl->hdr, " %s %.200s%s: ", hostname, cp, pid);
+		free(hostname);
+	}
 
-	free(hostname);
-	free(buf);
+	time(&now);
+	if (now != ctl->stamp_sec || !*ctl->stamp) {
+		ctl->stamp_sec = now;
+		snprintf(ctl->stamp, sizeof(ctl->stamp), "%.15s", ctime(&now) + 4);
+	}
+
+	begin_msg(ctl);
+	buf_append_str(ctl, ctl->stamp);
+	buf_append_str(ctl, ctl->hdr);
+	buf_append(ctl, msg, strnlen(msg, 400));
+	end_msg(ctl);
 }
 
-static void syslog_rfc5424(const  struct logger_ctl *ctl, const char *msg)
+static void syslog_rfc5424(struct logger_ctl *ctl, const char *msg)
 {
-	char *buf, *tag = NULL, *hostname = NULL;
-	char pid[32], time[64], timeq[80];
+	char usec[16];
 	struct ntptimeval ntptv;
 	struct timeval tv;
 	struct tm *tm;
-	int len;
 
-	*pid = *time = *timeq = '\0';
 	if (ctl->fd < 0)
 		return;
 
-	if (ctl->rfc5424_time) {
-		gettimeofday(&tv, NULL);
-		if ((tm = localtime(&tv.tv_sec)) != NULL) {
-			char fmt[64];
-
-			strftime(fmt, sizeof(fmt), " %Y-%m-%dT%H:%M:%S.%%06u%z",
-				 tm);
-			snprintf(time, sizeof(time), fmt, tv.tv_usec);
-		} else
-			err(EXIT_FAILURE, _("localtime() failed"));
-	}
+	if (!ctl->hdr) {
+		char *tag, *hostname = NULL, pid[32];
 
-	if (ctl->rfc5424_host) {
-		hostname = xgethostname();
-		/* Arbitrary looking 'if (var < strlen()) checks originate from
-		 * RFC 5424 - 6 Syslog Message Format definition.  */
-		if (255 < strlen(hostname))
-			errx(EXIT_FAILURE, _("hostname '%s' is too long"),
-			     hostname);
-	}
+		if (ctl->rfc5424_host) {
+			hostname = xgethostname();
+			/* Arbitrary looking 'if (var < strlen()) checks originate from
+			 * RFC 5424 - 6 Syslog Message Format definition.  */
+			if (255 < strlen(hostname))
+				errx(EXIT_FAILURE, _("hostname '%s' is too long"),
+				     hostname);
+		}
 
-	tag = ctl->tag ? ctl->tag : xgetlogin();
+		tag = ctl->tag ? ctl->tag : xgetlogin();
 
-	if (48 < strlen(tag))
-		errx(EXIT_FAILURE, _("tag '%s' is too long"), tag);
+		if (48 < strlen(tag))
+			errx(EXIT_FAILURE, _("tag '%s' is too long"), tag);
 
-	if (ctl->pid)
-		snprintf(pid, sizeof(pid), " %d", ctl->pid);
+		*pid = '\0';
+		if (ctl->pid)
+			snprintf(pid, sizeof(pid), " %d", ctl->pid);
 
-	if (ctl->rfc5424_tq) {
-		if (ntp_gettime(&ntptv) == TIME_OK)
-			snprintf(timeq, sizeof(timeq),
-				 " [timeQuality tzKnown=\"1\" isSynced=\"1\" syncAccuracy=\"%ld\"]",
-				 ntptv.maxerror);
-		else
-			snprintf(timeq, sizeof(timeq),
-				 " [timeQuality tzKnown=\"1\" isSynced=\"0\"]");
+		xasprintf(&ctl->hdr, "%s%s %s -%s",
+			  hostname ? " " : "",
+			  hostname ? hostname : "",
+			  tag, pid);
+		free(hostname);
 	}
 
-	len = xasprintf(&buf, "<%d>1%s%s%s %s -%s%s %s", ctl->pri, time,
-		  hostname ? " " : "",
-		  hostname ? hostname : "",
-		  tag, pid, timeq, msg);
-
-	if (write_all(ctl->fd, buf, len) < 0)
-		warn(_("write failed"));
-
-	if (ctl->stderr_printout)
-		fprintf(stderr, "%s\n", buf);
+	if (ctl->rfc5424_time) {
+		gettimeofday(&tv, NULL);
+		if (tv.tv_sec != ctl->stamp_sec || !*ctl->stamp) {
+			if ((tm = localtime(&tv.tv_sec)) == NULL)
+				err(EXIT_FAILURE, _("localtime() failed"));
+			ctl->stamp_sec = tv.tv_sec;
+			strftime(ctl->stamp, sizeof(ctl->stamp),
+				 " %Y-%m-%dT%H:%M:%S.", tm);
+			strftime(ctl->stamp_tz, sizeof(ctl->stamp_tz), "%z", tm);
+
+			if (ctl->rfc5424_tq) {
+				if (ntp_gettime(&ntptv) == TIME_OK)
+					snprintf(ctl->timeq, sizeof(ctl->timeq),
+						 " [timeQuality tzKnown=\"1\" isSynced=\"1\" syncAccuracy=\"%ld\"]",
+						 ntptv.maxerror);
+				else
+					snprintf(ctl->timeq, sizeof(ctl->timeq),
+						 " [timeQuality tzKnown=\"1\" isSynced=\"0\"]");
+			}
+		}
+	}
 
-	free(hostname);
-	free(buf);
+	begin_msg(ctl);
+	buf_append(ctl, "1", 1);
+	if (ctl->rfc5424_time) {
+		buf_append_str(ctl, ctl->stamp);
+		buf_append(ctl, usec, snprintf(usec, sizeof(usec), "%06u",
+					       (unsigned int) tv.tv_usec));
+		buf_append_str(ctl, ctl->stamp_tz);
+	}
+	buf_append_str(ctl, ctl->hdr);
+	buf_append_str(ctl, ctl->timeq);
+	buf_append(ctl, " ", 1);
+	buf_append_str(ctl, msg);
+	end_msg(ctl);
 }
 
 static void parse_rfc5424_flags(struct logger_ctl *ctl, char *optarg)
@@ -407,52 +542,56 @@ static void parse_rfc5424_flags(struct logger_ctl *ctl, char *optarg)
 	}
 }
 
-static void syslog_local(const struct logger_ctl *ctl, const char *msg)
+static void syslog_local(struct logger_ctl *ctl, const char *msg)
 {
-	char *buf, *tag;
-	char time[32], pid[32];
-	struct timeval tv;
-	struct tm *tm;
-	int len;
+	time_t now;
 
-	gettimeofday(&tv, NULL);
-	tm = localtime(&tv.tv_sec);
-	strftime(time, sizeof(time), "%h %e %T", tm);
+	if (!ctl->hdr) {
+		char *tag, pid[32];
 
-	tag = ctl->tag ? ctl->tag : program_invocation_short_name;
+		tag = ctl->tag ? ctl->tag : program_invocation_short_name;
 
-	if (ctl->pid)
-		snprintf(pid, sizeof(pid), "[%d]", ctl->pid);
-	else
-		pid[0] = '\0';
+		if (ctl->pid)
+			snprintf(pid, sizeof(pid), "[%d]", ctl->pid);
+		else
+			pid[0] = '\0';
 
-	len = xasprintf(&buf, "<%d>%s %s%s: %s", ctl->pri, time, tag, pid, msg);
-	if (write_all(ctl->fd, buf, len) < 0)
-		warn(_("write failed"));
-	if (ctl->stderr_printout)
-		fprintf(stderr, "%s\n", buf);
-	free(buf);
+		xasprintf(&ctl->hdr, " %s%s: ", tag, pid);
+	}
+
+	time(&now);
+	if (now != ctl->stamp_sec || !*ctl->stamp) {
+		ctl->stamp_sec = now;
+		strftime(ctl->stamp, sizeof(ctl->stamp), "%h %e %T",
+			 localtime(&now));
+	}
+
+	begin_msg(ctl);
+	buf_append_str(ctl, ctl->stamp);
+	buf_append_str(ctl, ctl->hdr);
+	buf_append_str(ctl, msg);
+	end_msg(ctl);
 }
 
 static void logger_open(struct logger_ctl *ctl)
 {
 	if (ctl->server) {
-		ctl->fd = inet_socket(ctl->server, ctl->port, ctl->socket_type);
+		ctl->fd = inet_socket(ctl->server, ctl->port, &ctl->socket_type);
 		if (!ctl->syslogfp)
 			ctl->syslogfp = syslog_rfc5424;
 		return;
 	}
 	if (ctl->unix_socket) {
-		ctl->fd = unix_socket(ctl->unix_socket, ctl->socket_type);
+		ctl->fd = unix_socket(ctl->unix_socket, &ctl->socket_type);
 		if (!ctl->syslogfp)
 			ctl->syslogfp = syslog_rfc5424;
 		return;
 	}
-	ctl->fd = unix_socket("/dev/log", ctl->socket_type);
+	ctl->fd = unix_socket("/dev/log", &ctl->socket_type);
 	ctl->syslogfp = syslog_local;
 }
 
-static void logger_command_line(const struct logger_ctl *ctl, char **argv)
+static void logger_command_line(struct logger_ctl *ctl, char **argv)
 {
 	char buf[4096];
 	char *p = buf;
@@ -478,31 +617,83 @@ static void logger_command_line(const struct logger_ctl *ctl, char **argv)
 		ctl->syslogfp(ctl, buf);
 }
 
+static void logger_stdin_line(struct logger_ctl *ctl, char *msg,
+			      int default_priority)
+{
+	ctl->pri = default_priority;
+	if (ctl->prio_prefix && msg[0] == '<')
+		msg = get_prio_prefix(msg, &ctl->pri);
+	ctl->syslogfp(ctl, msg);
+}
+
+/*
+ * Reads stdin by large chunks and logs all the complete lines of the chunk
+ * as one batch. The lines longer than LOGGER_MAXLINE are split.
+ */
 static void logger_stdin(struct logger_ctl *ctl)
 {
-	char *msg;
 	int default_priority = ctl->pri;
-	char buf[1024];
-
-	while (fgets(buf, sizeof(buf), stdin) != NULL) {
-		int len = strlen(buf);
-
-		/* some glibc versions are buggy, they add an additional
-		 * newline which is removed here.  */
-		if (0 < len && buf[len - 1] == '\n')
-			buf[len - 1] = '\0';
-		msg = buf;
-		ctl->pri = default_priority;
-		if (ctl->prio_prefix && msg[0] == '<')
-			msg = get_prio_prefix(msg, &ctl->pri);
-		ctl->syslogfp(ctl, msg);
+	int fd = fileno(stdin);
+	size_t len = 0;
+	char *buf = xmalloc(LOGGER_MAXLINE + LOGGER_READSZ + 1);
+
+	while (1) {
+		char *p, *nl, *end;
+		ssize_t rc;
+
+		rc = read(fd, buf + len, LOGGER_READSZ);
+		if (rc < 0 && errno == EAGAIN) {
+			struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+			/* non-blocking stdin */
+			poll(&pfd, 1, -1);
+			continue;
+		}
+		if (rc < 0 && errno == EINTR)
+			continue;
+		if (rc <= 0)
+			break;
+
+		p = buf;
+		end = buf + len + rc;
+		/* the rest of the previous chunk has no newline */
+		nl = memchr(buf + len, '\n', rc);
+		while (nl) {
+			*nl = '\0';
+			logger_stdin_line(ctl, p, default_priority);
+			p = nl + 1;
+			nl = memchr(p, '\n', end - p);
+		}
+		while (LOGGER_MAXLINE <= end - p) {
+			char c = p[LOGGER_MAXLINE];
+
+			p[LOGGER_MAXLINE] = '\0';
+			logger_stdin_line(ctl, p, default_priority);
+			p[LOGGER_MAXLINE] = c;
+			p += LOGGER_MAXLINE;
+		}
+		len = end - p;
+		if (len && p != buf)
+			memmove(buf, p, len);
+
+		logger_flush(ctl);
 	}
+
+	if (len) {
+		/* the last line without newline */
+		buf[len] = '\0';
+		logger_stdin_line(ctl, buf, default_priority);
+	}
+	free(buf);
 }
 
-static void logger_close(const struct logger_ctl *ctl)
+static void logger_close(struct logger_ctl *ctl)
 {
+	logger_flush(ctl);
 	if (close(ctl->fd) != 0)
 		err(EXIT_FAILURE, _("close failed"));
+	free(ctl->hdr);
+	free(ctl->buf);
 }
 
 static void __attribute__ ((__noreturn__)) usage(FILE *out)
@@ -47,6 +47,10 @@
 #include <libudev.h>
 #endif
 
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
+
 #include <assert.h>
 
 #include "c.h"
@@ -69,6 +73,7 @@ enum {
 	COL_MAJMIN,
 	COL_FSTYPE,
 	COL_TARGET,
+	COL_TARGETS,
 	COL_LABEL,
 	COL_UUID,
 	COL_PARTTYPE,
@@ -140,6 +145,7 @@ static struct colinfo infos[] = {
 	[COL_MAJMIN] = { "MAJ:MIN", 6, 0, N_("major:minor device number"), SORT_U64 },
 	[COL_FSTYPE] = { "FSTYPE",  0.1, SCOLS_FL_TRUNC, N_("filesystem type") },
 	[COL_TARGET] = { "MOUNTPOINT", 0.10, SCOLS_FL_TRUNC, N_("where the device is mounted") },
+	[COL_TARGETS] = { "MOUNTPOINTS", 0.10, SCOLS_FL_TRUNC, N_("all locations where device is mounted") },
 	[COL_LABEL]  = { "LABEL",   0.1, 0, N_("filesystem LABEL") },
 	[COL_UUID]   = { "UUID",    36,  0, N_("filesystem UUID") },
 
@@ -182,8 +188,9 @@ static struct colinfo infos[] = {
 
 struct lsblk {
 	struct libscols_table *table;	/* output table */
-	struct libscols_column *sort_col;/* sort output by this colum */
-	int sort_id;
+	struct libscols_column *sort_cols[ARRAY_SIZE(infos)];	/* sort output by these columns */
+	int sort_ids[ARRAY_SIZE(infos)];
+	size_t nsort;
 
 	unsigned int all_devices:1;	/* print all devices, including empty */
 	unsigned int bytes:1;		/* print SIZE in bytes */
@@ -224,13 +231,108 @@ static struct libmnt_table *mtab, *swaps;
 static struct libmnt_cache *mntcache;
 
 #ifdef HAVE_LIBUDEV
-struct udev *udev;
+/* libudev context must not be shared between threads */
+# ifdef HAVE_TLS
+static __thread struct udev *udev;
+# else
+static struct udev *udev;
+# endif
+#endif
+
+#ifdef HAVE_LIBPTHREAD
+/* protects getpwuid() and getgrgid() */
+static pthread_mutex_t lsblk_lock = PTHREAD_MUTEX_INITIALIZER;
+# define lock_lsblk()		pthread_mutex_lock(&lsblk_lock)
+# define unlock_lsblk()		pthread_mutex_unlock(&lsblk_lock)
+#else
+# define lock_lsblk()
+# define unlock_lsblk()
 #endif
 
+/* max number of threads to collect data about devices */
+#define LSBLK_MAXTHREADS	16
+
+#ifdef HAVE_LIBPTHREAD
+/*
+ * Whole-disks probed by libblkid right now. The partitions of one disk may be
+ * listed by more jobs (e.g. in the inverse tree), but the disk is never probed
+ * by more threads at the same time.
+ */
+static dev_t probed_disks[LSBLK_MAXTHREADS];
+static pthread_mutex_t probed_disks_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t probed_disks_cond = PTHREAD_COND_INITIALIZER;
+
+static void lock_disk(dev_t disk)
+{
+	size_t i, slot;
+
+	pthread_mutex_lock(&probed_disks_lock);
+	for (;;) {
+		slot = LSBLK_MAXTHREADS;
+		for (i = 0; i < LSBLK_MAXTHREADS; i++) {
+			if (probed_disks[i] == disk)
+				break;
+			if (!probed_disks[i] && slot == LSBLK_MAXTHREADS)
+				slot = i;
+		}
+		if (i == LSBLK_MAXTHREADS && slot < LSBLK_MAXTHREADS)
+			break;
+		pthread_cond_wait(&probed_disks_cond, &probed_disks_lock);
+	}
+	probed_disks[slot] = disk;
+	pthread_mutex_unlock(&probed_disks_lock);
+}
+
+static void unlock_disk(dev_t disk)
+{
+	size_t i;
+
+	pthread_mutex_lock(&probed_disks_lock);
+	for (i = 0; i < LSBLK_MAXTHREADS; i++) {
+		if (probed_disks[i] == disk) {
+			probed_disks[i] = 0;
+			break;
+		}
+	}
+	pthread_cond_broadcast(&probed_disks_cond);
+	pthread_mutex_unlock(&probed_disks_lock);
+}
+#else
+# define lock_disk(_d)		((void) (_d))
+# define unlock_disk(_d)	((void) (_d))
+#endif
+
+/*
+ * The devices are listed in two phases. The first phase reads all data about
+ * devices (sysfs, udev, libblkid) to rows; every top-level device from
+ * /sys/block is one job and the jobs are processed in parallel. The second
+ * phase creates the output lines from the rows in the original order; it
+ * starts as soon as all the previous jobs are done.
+ */
+struct lsblk_cell {
+	char		*data;
+	uint64_t	sortkey;
+	unsigned int	has_sortkey : 1;
+};
+
+struct lsblk_row {
+	struct lsblk_row	*parent;
+	struct lsblk_row	*next;
+	struct libscols_line	*scols_line;	/* used in the second phase */
+	struct lsblk_cell	*cells;		/* ncolumns items */
+};
+
+struct lsblk_job {
+	char			*name;		/* top-level device or NULL */
+	struct lsblk_row	*rows;
+	struct lsblk_row	**tail;
+	int			done;		/* the first phase is done */
+};
+
 struct blkdev_cxt {
 	struct blkdev_cxt *parent;
 
-	struct libscols_line *scols_line;
+	struct lsblk_row *row;
 	struct stat	st;
 
 	char *name;		/* kernel name in /sys/block */
@@ -387,73 +489,267 @@ static char *get_device_path(struct blkdev_cxt *cxt)
 	return xstrdup(path);
 }
 
+/*
+ * Mountpoints are looked up in an index built by init_mountpoints() from one
+ * parse of mountinfo and /proc/swaps. The index is read-only after that, so
+ * the lookups do not need any locking.
+ */
+struct lsblk_mnt {
+	struct libmnt_fs *fs;
+	const char	*srcpath;	/* native or canonicalized source path */
+	dev_t		devno;
+	size_t		pos;		/* position in the mount table */
+};
+
+static struct lsblk_mnt *mnts_bydev,	/* sorted by devno and position */
+			*mnts_bysrc;	/* sorted by srcpath and position */
+static size_t nmnts_bydev, nmnts_bysrc;
+
+static const char **swapareas;		/* sorted paths of active swaps */
+static size_t nswapareas;
+
+static int cmp_mnt_devno(const void *a, const void *b)
+{
+	const struct lsblk_mnt *x = a, *y = b;
+
+	if (x->devno != y->devno)
+		return x->devno < y->devno ? -1 : 1;
+	return x->pos < y->pos ? -1 : x->pos > y->pos ? 1 : 0;
+}
+
+static int cmp_mnt_srcpath(const void *a, const void *b)
+{
+	const struct lsblk_mnt *x = a, *y = b;
+	int rc = strcmp(x->srcpath, y->srcpath);
+
+	if (rc)
+		return rc;
+	return x->pos < y->pos ? -1 : x->pos > y->pos ? 1 : 0;
+}
+
+static int cmp_strings(const void *a, const void *b)
+{
+	return strcmp(*(const char * const *) a, *(const char * const *) b);
+}
+
+static void add_srcpath(struct lsblk_mnt *m, size_t *n, struct libmnt_fs *fs,
+			const char *path, size_t pos)
+{
+	m[*n].fs = fs;
+	m[*n].srcpath = path;
+	m[*n].devno = mnt_fs_get_devno(fs);
+	m[*n].pos = pos;
+	(*n)++;
+}
+
+/*
+ * Parses mountinfo and /proc/swaps and indexes the entries by devno and by
+ * source path. Every source path is indexed in the native and in the
+ * canonicalized form, so the device paths do not have to be canonicalized
+ * later.
+ */
+static void init_mountpoints(void)
+{
+	struct libmnt_iter *itr;
+	struct libmnt_fs *fs;
+	size_t n, pos = 0;
+
+	mntcache = mnt_new_cache();
+	mtab = mnt_new_table();
+	swaps = mnt_new_table();
+	itr = mnt_new_iter(MNT_ITER_FORWARD);
+	if (!mntcache || !mtab || !swaps || !itr)
+		err(EXIT_FAILURE, _("failed to initialize libmount table"));
+
+	mnt_table_set_cache(mtab, mntcache);
+	mnt_table_set_cache(swaps, mntcache);
+	mnt_table_parse_mtab(mtab, NULL);
+	mnt_table_parse_swaps(swaps, NULL);
+
+	n = mnt_table_get_nents(mtab);
+	mnts_bydev = xcalloc(n + 1, sizeof(struct lsblk_mnt));
+	mnts_bysrc = xcalloc(n * 2 + 1, sizeof(struct lsblk_mnt));
+
+	while (mnt_table_next_fs(mtab, itr, &fs) == 0) {
+		const char *src = mnt_fs_get_srcpath(fs), *cn;
+
+		add_srcpath(mnts_bydev, &nmnts_bydev, fs, src, pos);
+
+		if (src && *src == '/') {
+			add_srcpath(mnts_bysrc, &nmnts_bysrc, fs, src, pos);
+
+			cn = mnt_resolve_path(src, mntcache);
+			if (cn && strcmp(cn, src) != 0)
+				add_srcpath(mnts_bysrc, &nmnts_bysrc, fs, cn, pos);
+		}
+		pos++;
+	}
+
+	qsort(mnts_bydev, nmnts_bydev, sizeof(struct lsblk_mnt), cmp_mnt_devno);
+	qsort(mnts_bysrc, nmnts_bysrc, sizeof(struct lsblk_mnt), cmp_mnt_srcpath);
+
+	n = mnt_table_get_nents(swaps);
+	swapareas = xcalloc(n * 2 + 1, sizeof(char *));
+
+	mnt_reset_iter(itr, MNT_ITER_FORWARD);
+	while (mnt_table_next_fs(swaps, itr, &fs) == 0) {
+		const char *src = mnt_fs_get_srcpath(fs), *cn;
+
+		if (!src)
+			continue;
+		swapareas[nswapareas++] = src;
+
+		cn = mnt_resolve_path(src, mntcache);
+		if (cn && strcmp(cn, src) != 0)
+			swapareas[nswapareas++] = cn;
+	}
+	qsort(swapareas, nswapareas, sizeof(char *), cmp_strings);
+
+	mnt_free_iter(itr);
+}
+
+static void free_mountpoints(void)
+{
+	free(mnts_bydev);
+	free(mnts_bysrc);
+	free(swapareas);
+
+	mnt_unref_table(mtab);
+	mnt_unref_table(swaps);
+	mnt_unref_cache(mntcache);
+}
+
 static int is_active_swap(const char *filename)
 {
-	if (!swaps) {
-		swaps = mnt_new_table();
-		if (!swaps)
-			return 0;
-		if (!mntcache)
-			mntcache = mnt_new_cache();
-
-		mnt_table_set_cache(swaps, mntcache);
-		mnt_table_parse_swaps(swaps, NULL);
+	return bsearch(&filename, swapareas, nswapareas,
+		       sizeof(char *), cmp_strings) != NULL;
+}
+
+/* returns the first of @nmnts entries matching @key in the sorted @mnts */
+static struct lsblk_mnt *find_mnts(struct lsblk_mnt *mnts, size_t nmnts,
+				   const struct lsblk_mnt *key,
+				   int (*cmp)(const void *, const void *),
+				   size_t *n)
+{
+	size_t lo = 0, hi = nmnts, end;
+
+	/* the key has position 0, so this finds the lower bound */
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+
+		if (cmp(&mnts[mid], key) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (end = lo; end < nmnts; end++) {
+		struct lsblk_mnt x = mnts[end];
+
+		x.pos = 0;
+		if (cmp(&x, key) != 0)
+			break;
 	}
 
-	return mnt_table_find_srcpath(swaps, filename, MNT_ITER_BACKWARD) != 0;
+	*n = end - lo;
+	return *n ? &mnts[lo] : NULL;
+}
+
+/*
+ * Returns the mount table entries of the device in the table order. Note that
+ * maj:min in /proc/self/mountinfo does not have to match with devno as
+ * returned by stat(), so we have to try devname too.
+ */
+static struct lsblk_mnt *get_device_mnts(struct blkdev_cxt *cxt, size_t *n)
+{
+	struct lsblk_mnt key = { .devno = makedev(cxt->maj, cxt->min),
+				 .srcpath = cxt->filename };
+	struct lsblk_mnt *m;
+
+	m = find_mnts(mnts_bydev, nmnts_bydev, &key, cmp_mnt_devno, n);
+	if (!m)
+		m = find_mnts(mnts_bysrc, nmnts_bysrc, &key, cmp_mnt_srcpath, n);
+	return m;
 }
 
 static char *get_device_mountpoint(struct blkdev_cxt *cxt)
 {
+	struct lsblk_mnt *m;
 	struct libmnt_fs *fs;
 	const char *fsroot;
+	size_t n;
 
 	assert(cxt);
 	assert(cxt->filename);
 
-	if (!mtab) {
-		mtab = mnt_new_table();
-		if (!mtab)
-			return NULL;
-		if (!mntcache)
-			mntcache = mnt_new_cache();
-
-		mnt_table_set_cache(mtab, mntcache);
-		mnt_table_parse_mtab(mtab, NULL);
-	}
-
-	/* Note that maj:min in /proc/self/mouninfo does not have to match with
-	 * devno as returned by stat(), so we have to try devname too
-	 */
-	fs = mnt_table_find_devno(mtab, makedev(cxt->maj, cxt->min), MNT_ITER_BACKWARD);
-	if (!fs)
-		fs = mnt_table_find_srcpath(mtab, cxt->filename, MNT_ITER_BACKWARD);
-	if (!fs)
+	m = get_device_mnts(cxt, &n);
+	if (!m)
 		return is_active_swap(cxt->filename) ? xstrdup("[SWAP]") : NULL;
 
-	/* found */
+	/* the last mount wins */
+	fs = m[n - 1].fs;
+
 	fsroot = mnt_fs_get_root(fs);
 	if (fsroot && strcmp(fsroot, "/") != 0) {
 		/* hmm.. we found bind mount or btrfs subvolume, let's try to
 		 * get real FS root mountpoint */
-		struct libmnt_fs *rfs;
-		struct libmnt_iter *itr = mnt_new_iter(MNT_ITER_BACKWARD);
-
-		mnt_table_set_iter(mtab, itr, fs);
-		while (mnt_table_next_fs(mtab, itr, &rfs) == 0) {
-			fsroot = mnt_fs_get_root(rfs);
-			if ((!fsroot || strcmp(fsroot, "/") == 0)
-			    && mnt_fs_match_source(rfs, cxt->filename, mntcache)) {
-				fs = rfs;
+		struct lsblk_mnt key = { .srcpath = cxt->filename };
+		size_t i, pos = m[n - 1].pos;
+
+		m = find_mnts(mnts_bysrc, nmnts_bysrc, &key, cmp_mnt_srcpath, &n);
+		for (i = n; m && i > 0; i--) {
+			if (m[i - 1].pos > pos)
+				continue;
+			fsroot = mnt_fs_get_root(m[i - 1].fs);
+			if (!fsroot || strcmp(fsroot, "/") == 0) {
+				fs = m[i - 1].fs;
 				break;
 			}
 		}
-		mnt_free_iter(itr);
 	}
 
 	return xstrdup(mnt_fs_get_target(fs));
 }
 
+/* returns all mountpoints of the device separated by commas */
+#define is_parsable(_l)	(scols_table_is_raw((_l)->table) || \
+			 scols_table_is_export((_l)->table))
+
+/*
+ * Returns all mountpoints of the device. The commas are valid in paths, so
+ * the parsable output uses newlines, they are hex-escaped by the raw and
+ * export output.
+ */
+static char *get_device_mountpoints(struct blkdev_cxt *cxt)
+{
+	struct lsblk_mnt *m;
+	char *res = NULL;
+	size_t i, n, sz = 0;
+	char sep = is_parsable(lsblk) ? '\n' : ',';
+
+	assert(cxt);
+	assert(cxt->filename);
+
+	m = get_device_mnts(cxt, &n);
+	if (!m)
+		return is_active_swap(cxt->filename) ? xstrdup("[SWAP]") : NULL;
+
+	for (i = 0; i < n; i++) {
+		const char *tgt = mnt_fs_get_target(m[i].fs);
+		size_t len;
+
+		if (!tgt)
+			continue;
+		len = strlen(tgt);
+		res = xrealloc(res, sz + len + 2);
+		if (sz)
+			res[sz++] = sep;
+		memcpy(res + sz, tgt, len + 1);
+		sz += len;
+	}
+	return res;
+}
+
 #ifndef HAVE_LIBUDEV
 static int get_udev_properties(struct blkdev_cxt *cxt
 				__attribute__((__unused__)))
@@ -513,6 +809,7 @@ static int get_udev_properties(struct blkdev_cxt *cxt)
 static void probe_device(struct blkdev_cxt *cxt)
 {
 	blkid_probe pr = NULL;
+	dev_t disk = 0;
 
 	if (cxt->probed)
 		return;
@@ -530,9 +827,14 @@ static void probe_device(struct blkdev_cxt *cxt)
 	if (getuid() != 0)
 		return;				/* no permissions to read from the device */
 
+	/* partitions are probed together with the whole-disk */
+	if (sysfs_devno_to_wholedisk(cxt->sysfs.devno, NULL, 0, &disk) || !disk)
+		disk = cxt->sysfs.devno;
+	lock_disk(disk);
+
 	pr = blkid_new_probe_from_filename(cxt->filename);
 	if (!pr)
-		return;
+		goto done;
 
 	blkid_probe_enable_superblocks(pr, 1);
 	blkid_probe_set_superblocks_flags(pr, BLKID_SUBLKS_LABEL |
@@ -561,7 +863,8 @@ static void probe_device(struct blkdev_cxt *cxt)
 	}
 
 	blkid_free_probe(pr);
-	return;
+done:
+	unlock_disk(disk);
 }
 
 static int is_readonly_device(struct blkdev_cxt *cxt)
@@ -706,9 +1009,6 @@ static char *get_transport(struct blkdev_cxt *cxt)
 	return trans ? xstrdup(trans) : NULL;
 }
 
-#define is_parsable(_l)	(scols_table_is_raw((_l)->table) || \
-			 scols_table_is_export((_l)->table))
-
 static char *mk_name(const char *name)
 {
 	char *p;
@@ -733,52 +1033,37 @@ static char *mk_dm_name(const char *name)
 	return p;
 }
 
-/* stores data to scols cell userdata (invisible and independent on output)
- * to make the original values accessible for sort functions
+/* stores the original value as the cell sort key (invisible and independent
+ * on output), see scols_sort_table_by()
  */
-static void set_sortdata_u64(struct libscols_line *ln, int col, uint64_t x)
+static void set_sortdata_u64(struct lsblk_row *row, int col, uint64_t x)
 {
-	struct libscols_cell *ce = scols_line_get_cell(ln, col);
-	uint64_t *data;
-
-	if (!ce)
-		return;
-	data = xmalloc(sizeof(uint64_t));
-	*data = x;
-	scols_cell_set_userdata(ce, data);
+	row->cells[col].sortkey = x;
+	row->cells[col].has_sortkey = 1;
 }
 
-static void set_sortdata_u64_from_string(struct libscols_line *ln, int col, const char *str)
+static void set_sortdata_u64_from_string(struct lsblk_row *row, int col, const char *str)
 {
 	uint64_t x;
 
 	if (!str || sscanf(str, "%"SCNu64, &x) != 1)
 		return;
 
-	set_sortdata_u64(ln, col, x);
+	set_sortdata_u64(row, col, x);
 }
 
-static void unref_sortdata(struct libscols_table *tb)
+static int is_sort_column(int id)
 {
-	struct libscols_iter *itr;
-	struct libscols_line *ln;
+	size_t i;
 
-	if (!tb || !lsblk->sort_col)
-		return;
-	itr = scols_new_iter(SCOLS_ITER_FORWARD);
-	if (!itr)
-		return;
-	while (scols_table_next_line(tb, itr, &ln) == 0) {
-		struct libscols_cell *ce = scols_line_get_column_cell(ln,
-								lsblk->sort_col);
-		void *data = scols_cell_get_userdata(ce);
-		free(data);
+	for (i = 0; i < lsblk->nsort; i++) {
+		if (lsblk->sort_ids[i] == id)
+			return 1;
 	}
-
-	scols_free_iter(itr);
+	return 0;
 }
 
-static void set_scols_data(struct blkdev_cxt *cxt, int col, int id, struct libscols_line *ln)
+static void set_scols_data(struct blkdev_cxt *cxt, int col, int id, struct lsblk_row *ln)
 {
 	int sort = 0, st_rc = 0;
 	char *str = NULL;
@@ -787,7 +1072,7 @@ static void set_scols_data(struct blkdev_cxt *cxt, int col, int id, struct libsc
 				 id == COL_MODE))
 		st_rc = stat(cxt->filename, &cxt->st);
 
-	if (lsblk->sort_id == id)
+	if (is_sort_column(id))
 		sort = 1;
 
 	switch(id) {
@@ -803,16 +1088,24 @@ static void set_scols_data(struct blkdev_cxt *cxt, int col, int id, struct libsc
 		break;
 	case COL_OWNER:
 	{
-		struct passwd *pw = st_rc ? NULL : getpwuid(cxt->st.st_uid);
+		struct passwd *pw;
+
+		lock_lsblk();
+		pw = st_rc ? NULL : getpwuid(cxt->st.st_uid);
 		if (pw)
 			str = xstrdup(pw->pw_name);
+		unlock_lsblk();
 		break;
 	}
 	case COL_GROUP:
 	{
-		struct group *gr = st_rc ? NULL : getgrgid(cxt->st.st_gid);
+		struct group *gr;
+
+		lock_lsblk();
+		gr = st_rc ? NULL : getgrgid(cxt->st.st_gid);
 		if (gr)
 			str = xstrdup(gr->gr_name);
+		unlock_lsblk();
 		break;
 	}
 	case COL_MODE:
@@ -842,6 +1135,10 @@ static void set_scols_data(struct blkdev_cxt *cxt, int col, int id, struct libsc
 		if (!(cxt->nholders + cxt->npartitions))
 			str = get_device_mountpoint(cxt);
 		break;
+	case COL_TARGETS:
+		if (!(cxt->nholders + cxt->npartitions))
+			str = get_device_mountpoints(cxt);
+		break;
 	case COL_LABEL:
 		probe_device(cxt);
 		if (cxt->label)
@@ -1044,20 +1341,62 @@ static void set_scols_data(struct blkdev_cxt *cxt, int col, int id, struct libsc
 		break;
 	};
 
-	if (str)
-		scols_line_refer_data(ln, col, str);
+	ln->cells[col].data = str;
 }
 
-static void fill_table_line(struct blkdev_cxt *cxt, struct libscols_line *scols_parent)
+static void fill_table_line(struct lsblk_job *job, struct blkdev_cxt *cxt,
+			    struct lsblk_row *parent)
 {
+	struct lsblk_row *row = xcalloc(1, sizeof(*row));
 	int i;
 
-	cxt->scols_line = scols_table_new_line(lsblk->table, scols_parent);
-	if (!cxt->scols_line)
-		return;
+	row->parent = parent;
+	row->cells = xcalloc(ncolumns, sizeof(struct lsblk_cell));
+	*job->tail = row;
+	job->tail = &row->next;
+
+	cxt->row = row;
 
 	for (i = 0; i < ncolumns; i++)
-		set_scols_data(cxt, i, get_column_id(i), cxt->scols_line);
+		set_scols_data(cxt, i, get_column_id(i), row);
+}
+
+/* the second phase, moves the data from rows to the output table */
+static void add_job_lines(struct lsblk_job *job)
+{
+	struct lsblk_row *row, *next;
+	int i, stream = scols_table_is_stream(lsblk->table);
+
+	for (row = job->rows; row; row = row->next) {
+		/* in the stream mode the parental line is already printed and freed */
+		row->scols_line = scols_table_new_line(lsblk->table,
+				row->parent && !stream ? row->parent->scols_line : NULL);
+
+		for (i = 0; i < ncolumns; i++) {
+			struct lsblk_cell *ce = &row->cells[i];
+
+			if (!row->scols_line) {
+				free(ce->data);
+				continue;
+			}
+			if (ce->has_sortkey) {
+				struct libscols_cell *cell =
+					scols_line_get_cell(row->scols_line, i);
+				if (cell)
+					scols_cell_set_sortkey(cell, ce->sortkey);
+			}
+			if (ce->data)
+				scols_line_refer_data(row->scols_line, i, ce->data);
+		}
+	}
+
+	for (row = job->rows; row; row = next) {
+		next = row->next;
+		free(row->cells);
+		free(row);
+	}
+	job->rows = NULL;
+	job->tail = &job->rows;
 }
 
 static int set_cxt(struct blkdev_cxt *cxt,
@@ -1098,6 +1437,10 @@ static int set_cxt(struct blkdev_cxt *cxt,
 		}
 	}
 
+	/* read attributes by raw read() and list sysfs directories only once;
+	 * the cache is optional, so ignore errors */
+	sysfs_enable_cache(&cxt->sysfs, 1);
+
 	cxt->maj = major(devno);
 	cxt->min = minor(devno);
 	cxt->size = 0;
@@ -1132,18 +1475,20 @@ static int set_cxt(struct blkdev_cxt *cxt,
 	return 0;
 }
 
-static int process_blkdev(struct blkdev_cxt *cxt, struct blkdev_cxt *parent,
+static int process_blkdev(struct lsblk_job *job,
+			  struct blkdev_cxt *cxt, struct blkdev_cxt *parent,
 			  int do_partitions, const char *part_name);
 
 /*
  * List device partitions if any.
  */
-static int list_partitions(struct blkdev_cxt *wholedisk_cxt, struct blkdev_cxt *parent_cxt,
+static int list_partitions(struct lsblk_job *job,
+			   struct blkdev_cxt *wholedisk_cxt, struct blkdev_cxt *parent_cxt,
 			   const char *part_name)
 {
-	DIR *dir;
-	struct dirent *d;
 	struct blkdev_cxt part_cxt = {};
+	const char *name;
+	size_t idx = 0;
 	int r = -1;
 
 	assert(wholedisk_cxt);
@@ -1155,16 +1500,11 @@ static int list_partitions(struct blkdev_cxt *wholedisk_cxt, struct blkdev_cxt *
 	if (!wholedisk_cxt->npartitions || wholedisk_cxt->partition)
 		return -1;
 
-	dir = sysfs_opendir(&wholedisk_cxt->sysfs, NULL);
-	if (!dir)
-		err(EXIT_FAILURE, _("failed to open device directory in sysfs"));
-
-	while ((d = xreaddir(dir))) {
+	/* the directory has been already listed by sysfs_count_partitions() */
+	while ((name = sysfs_next_dirent(&wholedisk_cxt->sysfs, NULL,
+					 wholedisk_cxt->name, &idx))) {
 		/* Process particular partition only? */
-		if (part_name && strcmp(part_name, d->d_name))
-			continue;
-
-		if (!(sysfs_is_partition_dirent(dir, d, wholedisk_cxt->name)))
+		if (part_name && strcmp(part_name, name))
 			continue;
 
 		if (lsblk->inverse) {
@@ -1174,16 +1514,16 @@ static int list_partitions(struct blkdev_cxt *wholedisk_cxt, struct blkdev_cxt *
 			 *   `-<wholedisk_cxt>
 			 *    `-...
 			 */
-			if (set_cxt(&part_cxt, parent_cxt, wholedisk_cxt, d->d_name))
+			if (set_cxt(&part_cxt, parent_cxt, wholedisk_cxt, name))
 				goto next;
 
 			if (!parent_cxt && part_cxt.nholders)
 				goto next;
 
 			wholedisk_cxt->parent = &part_cxt;
-			fill_table_line(&part_cxt, parent_cxt ? parent_cxt->scols_line : NULL);
+			fill_table_line(job, &part_cxt, parent_cxt ? parent_cxt->row : NULL);
 			if (!lsblk->nodeps)
-				process_blkdev(wholedisk_cxt, &part_cxt, 0, NULL);
+				process_blkdev(job, wholedisk_cxt, &part_cxt, 0, NULL);
 		} else {
 			/*
 			 * <parent_cxt>
@@ -1191,32 +1531,36 @@ static int list_partitions(struct blkdev_cxt *wholedisk_cxt, struct blkdev_cxt *
 			 *   `-<part_cxt>
 			 *    `-...
 			 */
-			int ps = set_cxt(&part_cxt, wholedisk_cxt, wholedisk_cxt, d->d_name);
+			int ps = set_cxt(&part_cxt, wholedisk_cxt, wholedisk_cxt, name);
 
 			/* Print whole disk only once */
 			if (r)
-				fill_table_line(wholedisk_cxt, parent_cxt ? parent_cxt->scols_line : NULL);
+				fill_table_line(job, wholedisk_cxt, parent_cxt ? parent_cxt->row : NULL);
 			if (ps == 0 && !lsblk->nodeps)
-				process_blkdev(&part_cxt, wholedisk_cxt, 0, NULL);
+				process_blkdev(job, &part_cxt, wholedisk_cxt, 0, NULL);
 		}
 	next:
 		reset_blkdev_cxt(&part_cxt);
 		r = 0;
 	}
+	if (errno)
+		err(EXIT_FAILURE, _("failed to open device directory in sysfs"));
 
-	closedir(dir);
 	return r;
 }
 
-static int get_wholedisk_from_partition_dirent(DIR *dir, const char *dirname,
-				struct dirent *d, struct blkdev_cxt *cxt)
+static int get_wholedisk_from_partition_dirent(struct sysfs_cxt *sysfs,
+				const char *depname, const char *name,
+				struct blkdev_cxt *cxt)
 {
 	char path[PATH_MAX];
+	char attr[PATH_MAX];
 	char *p;
 	int len;
 
-	if ((len = readlink_at(dirfd(dir), dirname,
-			       d->d_name, path, sizeof(path) - 1)) < 0)
+	snprintf(attr, sizeof(attr), "%s/%s", depname, name);
+
+	if ((len = sysfs_readlink(sysfs, attr, path, sizeof(path) - 1)) < 0)
 		return 0;
 
 	path[len] = '\0';
@@ -1238,13 +1582,11 @@ static int get_wholedisk_from_partition_dirent(DIR *dir, const char *dirname,
 /*
  * List device dependencies: partitions, holders (inverse = 0) or slaves (inverse = 1).
  */
-static int list_deps(struct blkdev_cxt *cxt)
+static int list_deps(struct lsblk_job *job, struct blkdev_cxt *cxt)
 {
-	DIR *dir;
-	struct dirent *d;
 	struct blkdev_cxt dep = {};
-	char dirname[PATH_MAX];
-	const char *depname;
+	const char *depname, *name;
+	size_t idx = 0;
 
 	assert(cxt);
 
@@ -1255,67 +1597,215 @@ static int list_deps(struct blkdev_cxt *cxt)
 		return 0;
 
 	depname = lsblk->inverse ? "slaves" : "holders";
-	dir = sysfs_opendir(&cxt->sysfs, depname);
-	if (!dir)
-		return 0;
-
-	snprintf(dirname, sizeof(dirname), "%s/%s", cxt->sysfs.dir_path, depname);
 
-	while ((d = xreaddir(dir))) {
+	while ((name = sysfs_next_dirent(&cxt->sysfs, depname, NULL, &idx))) {
 		/* Is the dependency a partition? */
-		if (sysfs_is_partition_dirent(dir, d, NULL)) {
-		    if (!get_wholedisk_from_partition_dirent(dir, dirname, d, &dep))
-			    process_blkdev(&dep, cxt, 1, d->d_name);
+		if (sysfs_dirent_is_partition(&cxt->sysfs, depname, name)) {
+		    if (!get_wholedisk_from_partition_dirent(&cxt->sysfs,
+						depname, name, &dep))
+			    process_blkdev(job, &dep, cxt, 1, name);
 		}
 		/* The dependency is a whole device. */
-		else if (!set_cxt(&dep, cxt, NULL, d->d_name))
-			process_blkdev(&dep, cxt, 1, NULL);
+		else if (!set_cxt(&dep, cxt, NULL, name))
+			process_blkdev(job, &dep, cxt, 1, NULL);
 
 		reset_blkdev_cxt(&dep);
 	}
-	closedir(dir);
 
 	return 0;
 }
 
-static int process_blkdev(struct blkdev_cxt *cxt, struct blkdev_cxt *parent,
+static int process_blkdev(struct lsblk_job *job,
+			  struct blkdev_cxt *cxt, struct blkdev_cxt *parent,
 			  int do_partitions, const char *part_name)
 {
 	if (do_partitions && cxt->npartitions)
-		return list_partitions(cxt, parent, part_name);
+		return list_partitions(job, cxt, parent, part_name);
+
+	fill_table_line(job, cxt, parent ? parent->row : NULL);
+	return list_deps(job, cxt);
+}
+
+/* the first phase for one /sys/block entry */
+static void process_top_device(struct lsblk_job *job)
+{
+	struct blkdev_cxt cxt = {};
+
+	if (set_cxt(&cxt, NULL, NULL, job->name))
+		goto done;
+
+	if (is_maj_excluded(cxt.maj) || !is_maj_included(cxt.maj))
+		goto done;
+
+	/* Skip devices in the middle of dependency tree. */
+	if ((lsblk->inverse ? cxt.nholders : cxt.nslaves) > 0)
+		goto done;
+
+	process_blkdev(job, &cxt, NULL, 1, NULL);
+done:
+	reset_blkdev_cxt(&cxt);
+}
+
+#ifdef HAVE_LIBPTHREAD
+struct lsblk_pool {
+	struct lsblk_job	*jobs;
+	size_t			njobs;
+	size_t			next;		/* the next unprocessed job */
+	size_t			nout;		/* the next job for the output */
+
+	pthread_mutex_t		lock;		/* protects lsblk_job->done */
+	pthread_cond_t		done;		/* signaled when a job is done */
+};
+
+static void process_pool_job(struct lsblk_pool *pool, size_t i)
+{
+	process_top_device(&pool->jobs[i]);
+
+	pthread_mutex_lock(&pool->lock);
+	pool->jobs[i].done = 1;
+	pthread_cond_signal(&pool->done);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/*
+ * The second phase for the finished jobs. The jobs are added to the output in
+ * the original order, so only the done jobs at the begin of the not yet
+ * added jobs are used. If @wait is true then waits for all jobs.
+ */
+static void add_pool_lines(struct lsblk_pool *pool, int wait)
+{
+	while (pool->nout < pool->njobs) {
+		struct lsblk_job *job = &pool->jobs[pool->nout];
+		int done;
 
-	fill_table_line(cxt, parent ? parent->scols_line : NULL);
-	return list_deps(cxt);
+		pthread_mutex_lock(&pool->lock);
+		while (wait && !job->done)
+			pthread_cond_wait(&pool->done, &pool->lock);
+		done = job->done;
+		pthread_mutex_unlock(&pool->lock);
+
+		if (!done)
+			break;
+		add_job_lines(job);
+		pool->nout++;
+	}
+}
+
+static void *jobs_thread(void *data)
+{
+	struct lsblk_pool *pool = (struct lsblk_pool *) data;
+	size_t i;
+
+	while ((i = __sync_fetch_and_add(&pool->next, 1)) < pool->njobs)
+		process_pool_job(pool, i);
+
+#ifdef HAVE_LIBUDEV
+	udev_unref(udev);
+	udev = NULL;
+#endif
+	return NULL;
+}
+
+static size_t get_nthreads(size_t njobs)
+{
+	long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t n;
+
+#if defined(HAVE_LIBUDEV) && !defined(HAVE_TLS)
+	return 1;		/* one udev context for all */
+#endif
+	/* the threads mostly wait for sysfs, udev db or device I/O */
+	n = ncpus > 0 ? (size_t) ncpus * 2 : 1;
+	if (n > LSBLK_MAXTHREADS)
+		n = LSBLK_MAXTHREADS;
+	return min(n, njobs);
 }
 
+/*
+ * Both phases for all jobs. Only the main thread adds lines to the output
+ * table, so the lines are printed as soon as possible in the stream mode.
+ */
+static void process_jobs(struct lsblk_job *jobs, size_t njobs)
+{
+	struct lsblk_pool pool = { .jobs = jobs, .njobs = njobs };
+	size_t i, nthreads = get_nthreads(njobs);
+	pthread_t *threads;
+
+	if (nthreads <= 1) {
+		for (i = 0; i < njobs; i++) {
+			process_top_device(&jobs[i]);
+			add_job_lines(&jobs[i]);
+		}
+		return;
+	}
+
+	pthread_mutex_init(&pool.lock, NULL);
+	pthread_cond_init(&pool.done, NULL);
+
+	/* the main thread is one of the workers */
+	threads = xcalloc(nthreads - 1, sizeof(pthread_t));
+	for (i = 0; i < nthreads - 1; i++) {
+		if (pthread_create(&threads[i], NULL, jobs_thread, &pool) != 0)
+			break;
+	}
+	nthreads = i;
+
+	while ((i = __sync_fetch_and_add(&pool.next, 1)) < njobs) {
+		process_pool_job(&pool, i);
+		add_pool_lines(&pool, 0);
+	}
+	add_pool_lines(&pool, 1);
+
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+
+	pthread_cond_destroy(&pool.done);
+	pthread_mutex_destroy(&pool.lock);
+}
+#else
+static void process_jobs(struct lsblk_job *jobs, size_t njobs)
+{
+	size_t i;
+
+	for (i = 0; i < njobs; i++) {
+		process_top_device(&jobs[i]);
+		add_job_lines(&jobs[i]);
+	}
+}
+#endif /* HAVE_LIBPTHREAD */
+
 /* Iterate devices in sysfs */
 static int iterate_block_devices(void)
 {
 	DIR *dir;
 	struct dirent *d;
-	struct blkdev_cxt cxt = {};
+	struct lsblk_job *jobs = NULL;
+	size_t i, njobs = 0, nalloc = 0;
 
 	if (!(dir = opendir(_PATH_SYS_BLOCK)))
 		return EXIT_FAILURE;
 
 	while ((d = xreaddir(dir))) {
-		if (set_cxt(&cxt, NULL, NULL, d->d_name))
-			goto next;
-
-		if (is_maj_excluded(cxt.maj) || !is_maj_included(cxt.maj))
-			goto next;
-
-		/* Skip devices in the middle of dependency tree. */
-		if ((lsblk->inverse ? cxt.nholders : cxt.nslaves) > 0)
-			goto next;
-
-		process_blkdev(&cxt, NULL, 1, NULL);
-	next:
-		reset_blkdev_cxt(&cxt);
+		if (njobs == nalloc) {
+			nalloc = nalloc ? nalloc * 2 : 64;
+			jobs = xrealloc(jobs, nalloc * sizeof(struct lsblk_job));
+		}
+		jobs[njobs].name = xstrdup(d->d_name);
+		jobs[njobs].rows = NULL;
+		jobs[njobs].tail = &jobs[njobs].rows;
+		jobs[njobs].done = 0;
+		njobs++;
 	}
-
 	closedir(dir);
 
+	/* the output is in the readdir() order */
+	process_jobs(jobs, njobs);
+
+	for (i = 0; i < njobs; i++)
+		free(jobs[i].name);
+	free(jobs);
+
 	return EXIT_SUCCESS;
 }
 
@@ -1341,6 +1831,7 @@ static char *devno_to_sysfs_name(dev_t devno, char *devname, char *buf, size_t b
 
 static int process_one_device(char *devname)
 {
+	struct lsblk_job job = { .name = NULL };
 	struct blkdev_cxt parent = {}, cxt = {};
 	struct stat st;
 	char buf[PATH_MAX + 1], *name, *diskname = NULL;
@@ -1348,6 +1839,8 @@ static int process_one_device(char *devname)
 	int real_part = 0;
 	int status = EXIT_FAILURE;
 
+	job.tail = &job.rows;
+
 	if (stat(devname, &st) || !S_ISBLK(st.st_mode)) {
 		warnx(_("%s: not a block device"), devname);
 		return EXIT_FAILURE;
@@ -1376,7 +1869,7 @@ static int process_one_device(char *devname)
 		 */
 		if (set_cxt(&cxt, NULL, NULL, name))
 			goto leave;
-		process_blkdev(&cxt, NULL, !lsblk->inverse, NULL);
+		process_blkdev(&job, &cxt, NULL, !lsblk->inverse, NULL);
 	} else {
 		/*
 		 * Partition, read sysfs name of the device.
@@ -1387,13 +1880,14 @@ static int process_one_device(char *devname)
 			goto leave;
 
 		if (lsblk->inverse)
-			process_blkdev(&parent, &cxt, 1, cxt.name);
+			process_blkdev(&job, &parent, &cxt, 1, cxt.name);
 		else
-			process_blkdev(&cxt, &parent, 1, NULL);
+			process_blkdev(&job, &cxt, &parent, 1, NULL);
 	}
 
 	status = EXIT_SUCCESS;
 leave:
+	add_job_lines(&job);
 	free(name);
 	reset_blkdev_cxt(&cxt);
 
@@ -1456,25 +1950,6 @@ static void parse_includes(const char *str0)
 	}
 }
 
-/*
- * see set_sortdata_u64() and columns initialization in main()
- */
-static int cmp_u64_cells(struct libscols_cell *a,
-			 struct libscols_cell *b,
-			 __attribute__((__unused__)) void *data)
-{
-	uint64_t *adata = (uint64_t *) scols_cell_get_userdata(a),
-		 *bdata = (uint64_t *) scols_cell_get_userdata(b);
-
-	if (adata == NULL && bdata == NULL)
-		return 0;
-	if (adata == NULL)
-		return -1;
-	if (bdata == NULL)
-		return 1;
-	return *adata == *bdata ? 0 : *adata >= *bdata ? 1 : -1;
-}
-
 static void __attribute__((__noreturn__)) help(FILE *out)
 {
 	size_t i;
@@ -1501,7 +1976,7 @@ static void __attribute__((__noreturn__)) help(FILE *out)
 	fputs(_(" -s, --inverse        inverse dependencies\n"), out);
 	fputs(_(" -S, --scsi           output info about SCSI devices\n"), out);
 	fputs(_(" -t, --topology       output info about topology\n"), out);
-	fputs(_(" -x, --sort <column>  sort output by <column>\n"), out);
+	fputs(_(" -x, --sort <list>    sort output by the list of columns\n"), out);
 	fputs(USAGE_SEPARATOR, out);
 	fputs(USAGE_HELP, out);
 	fputs(USAGE_VERSION, out);
@@ -1525,7 +2000,7 @@ static void check_sysdevblock(void)
 
 int main(int argc, char *argv[])
 {
-	struct lsblk _ls = { .sort_id = -1 };
+	struct lsblk _ls = { .nsort = 0 };
 	int scols_flags = LSBLK_TREE;
 	int i, c, status = EXIT_FAILURE;
 	char *outarg = NULL;
@@ -1679,9 +2154,12 @@ int main(int argc, char *argv[])
 			return EXIT_SUCCESS;
 		case 'x':
 			scols_flags &= ~LSBLK_TREE; /* disable the default */
-			lsblk->sort_id = column_name_to_id(optarg, strlen(optarg));
-			if (lsblk->sort_id >= 0)
+			c = string_to_idarray(optarg, lsblk->sort_ids,
+					ARRAY_SIZE(lsblk->sort_ids), column_name_to_id);
+			if (c > 0) {
+				lsblk->nsort = c;
 				break;
+			}
 			/* fallthrough */
 		default:
 			help(stderr);
@@ -1707,11 +2185,14 @@ int main(int argc, char *argv[])
 	if (nexcludes == 0 && nincludes == 0)
 		excludes[nexcludes++] = 1;	/* default: ignore RAM disks */
 
-	if (lsblk->sort_id >= 0 && column_id_to_number(lsblk->sort_id) < 0)
-		errx(EXIT_FAILURE, _("the sort column has to be among the output columns"));
+	for (i = 0; (size_t) i < lsblk->nsort; i++) {
+		if (column_id_to_number(lsblk->sort_ids[i]) < 0)
+			errx(EXIT_FAILURE, _("the sort column has to be among the output columns"));
+	}
 
 	mnt_init_debug(0);
 	scols_init_debug(0);
+	blkid_init_debug(0);
 
 	/*
 	 * initialize output columns
@@ -1736,33 +2217,39 @@ int main(int argc, char *argv[])
 			warn(_("failed to initialize output column"));
 			goto leave;
 		}
-		if (!lsblk->sort_col && lsblk->sort_id == id) {
-			lsblk->sort_col = cl;
-			scols_column_set_cmpfunc(cl,
-				ci->sort_type == SORT_STRING ?
-				scols_cmpstr_cells : cmp_u64_cells, NULL);
+		for (c = 0; (size_t) c < lsblk->nsort; c++) {
+			if (lsblk->sort_ids[c] != id || lsblk->sort_cols[c])
+				continue;
+			lsblk->sort_cols[c] = cl;
+			/* numeric columns use cell sort keys */
+			if (ci->sort_type == SORT_STRING)
+				scols_column_set_cmpfunc(cl, scols_cmpstr_cells, NULL);
 		}
 	}
 
+	if (column_id_to_number(COL_TARGET) >= 0 ||
+	    column_id_to_number(COL_TARGETS) >= 0)
+		init_mountpoints();
+
+	/* the parsable list output does not need all lines in memory */
+	scols_table_enable_stream(lsblk->table,
+			(scols_flags & (LSBLK_RAW | LSBLK_EXPORT)) && !lsblk->nsort);
+	scols_table_enable_arena(lsblk->table, 1);
+
 	if (optind == argc)
 		status = iterate_block_devices();
 	else while (optind < argc)
 		status = process_one_device(argv[optind++]);
 
-	if (lsblk->sort_col)
-		scols_sort_table(lsblk->table, lsblk->sort_col);
+	if (lsblk->nsort)
+		scols_sort_table_by(lsblk->table, lsblk->sort_cols, NULL, lsblk->nsort);
 
 	scols_print_table(lsblk->table);
 
 leave:
-	if (lsblk->sort_col)
-		unref_sortdata(lsblk->table);
-
 	scols_unref_table(lsblk->table);
 
-	mnt_unref_table(mtab);
-	mnt_unref_table(swaps);
-	mnt_unref_cache(mntcache);
+	free_mountpoints();
 #ifdef HAVE_LIBUDEV
 	udev_unref(udev);
 #endif
@@ -463,6 +463,7 @@ static int show_locks(struct list_head *locks)
 	}
 	scols_table_enable_raw(table, raw);
 	scols_table_enable_noheadings(table, no_headings);
+	scols_table_enable_stream(table, raw);
 
 	for (i = 0; i < ncolumns; i++) {
 		struct colinfo *col = get_column_info(i);
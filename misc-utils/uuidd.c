@@ -23,6 +23,12 @@
 #include <fcntl.h>
 #include <signal.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
 #ifdef HAVE_GETOPT_H
 #include <getopt.h>
 #else
@@ -36,6 +42,7 @@ extern int optind;
 #include "all-io.h"
 #include "c.h"
 #include "closestream.h"
+#include "list.h"
 #include "strutils.h"
 #include "optutils.h"
 
@@ -57,13 +64,36 @@ extern int optind;
 /* length of binary representation of UUID */
 #define UUID_LEN	(sizeof(uuid_t))
 
+/* the longest request is op and number of UUIDs */
+#define UUIDD_REQ_LEN	(1 + sizeof(int))
+
+/* don't read more requests from client if so many bytes are not sent yet */
+#define UUIDD_OUTBUF_MAX	(64 * 1024)
+
+/* size of the reply buffer, limits number of UUIDs in bulk random reply */
+#define UUIDD_REPLY_LEN		1024
+
+#define UUIDD_MAX_WORKERS	64
+
+/* how often the main thread refills the shared ring (milliseconds) */
+#define UUIDD_RING_INTERVAL	100
+
+/* milliseconds without accept() if there is no free file descriptor and
+ * no connection to close */
+#define UUIDD_ACCEPT_BACKOFF	100
+
+/* connections without any request are closed after this time (seconds) */
+#define UUIDD_CONN_IDLE		5
+
 /* server loop control structure */
 struct uuidd_cxt_t {
 	uint32_t	timeout;
+	uint32_t	nworkers;
 	unsigned int	debug: 1,
 			quiet: 1,
 			no_fork: 1,
-			no_sock: 1;
+			no_sock: 1,
+			ring: 1;
 };
 
 static void __attribute__ ((__noreturn__)) usage(FILE * out)
@@ -83,6 +113,8 @@ static void __attribute__ ((__noreturn__)) usage(FILE * out)
 		" -P, --no-pid            do not create pid file\n"
 		" -F, --no-fork           do not daemonize using double-fork\n"
 		" -S, --socket-activation do not create listening socket\n"
+		" -W, --workers <num>     number of worker threads\n"
+		" -R, --shared-ring       share pre-reserved time UUIDs with clients\n"
 		" -d, --debug             run in debugging mode\n"
 		" -q, --quiet             turn on quiet mode\n"
 		" -V, --version           output version information and exit\n"
@@ -105,8 +137,13 @@ static void create_daemon(void)
 
 static const char *cleanup_pidfile, *cleanup_socket;
 
+static struct uuidd_ring *shared_ring;
+static int shared_ring_fd = -1;
+
 static void terminate_intr(int signo CODE_ATTR((unused)))
 {
+	if (shared_ring)
+		shared_ring->magic = 0;		/* clients will ask for new ring */
 	if (cleanup_pidfile)
 		unlink(cleanup_pidfile);
 	if (cleanup_socket)
@@ -291,16 +328,680 @@ static int create_socket(const char *socket_path, int will_fork, int quiet)
 	return s;
 }
 
+/*
+ * Client connection. The client may send more requests without waiting for
+ * the replies, the replies are collected in @outbuf and written together.
+ */
+struct uuidd_conn {
+	int		fd;
+	uint32_t	events;		/* registered epoll events */
+
+	char		inbuf[UUIDD_REQ_LEN * 64];
+	size_t		inlen;
+
+	char		*outbuf;
+	size_t		outlen;		/* bytes in outbuf */
+	size_t		outpos;		/* already written bytes */
+	size_t		outsz;		/* allocated size */
+
+	size_t		ring_pos;	/* send shared ring fd with this byte */
+
+	time_t		last_active;	/* the last event on the connection */
+	uint64_t	active_seq;	/* orders connections by the last event */
+	struct list_head conns;		/* uuidd_worker->conns */
+
+	unsigned int	eof : 1,	/* client closed its side */
+			pass_ring : 1,	/* ring_pos is valid */
+			shut : 1;	/* shut down to release the descriptor */
+};
+
+/* epoll loop, the main thread or a worker thread */
+struct uuidd_worker {
+	int			efd;
+	const struct uuidd_cxt_t *cxt;
+	struct list_head	conns;		/* the least recently active first */
+#ifdef HAVE_LIBPTHREAD
+	pthread_t		thread;
+	pthread_mutex_t		conns_lock;	/* the main thread adds connections */
+#endif
+};
+
+#ifdef HAVE_LIBPTHREAD
+# define lock_conns(_w)		pthread_mutex_lock(&(_w)->conns_lock)
+# define unlock_conns(_w)	pthread_mutex_unlock(&(_w)->conns_lock)
+#else
+# define lock_conns(_w)
+# define unlock_conns(_w)
+#endif
+
+/*
+ * The listening socket is removed from the main thread epoll if accept()
+ * fails with EMFILE or ENFILE, and it's added back when a connection is
+ * closed.
+ */
+static int listen_fd = -1;
+static int listen_efd = -1;
+static int accept_stopped;
+
+static uint64_t conn_seq;
+
+#ifdef HAVE_LIBPTHREAD
+/* time UUIDs have to be generated by one thread at once */
+static pthread_mutex_t time_lock = PTHREAD_MUTEX_INITIALIZER;
+# define lock_time(_c)		do { if ((_c)->nworkers) pthread_mutex_lock(&time_lock); } while (0)
+# define unlock_time(_c)	do { if ((_c)->nworkers) pthread_mutex_unlock(&time_lock); } while (0)
+#else
+# define lock_time(_c)
+# define unlock_time(_c)
+#endif
+
+/*
+ * Generates reply for the request @op to @reply_buf (UUIDD_REPLY_LEN bytes).
+ *
+ * Returns length of the reply or -1 for invalid operation.
+ */
+static int32_t handle_request(const struct uuidd_cxt_t *uuidd_cxt,
+			      char op, int num, char *reply_buf)
+{
+	int32_t		reply_len = 0;
+	uuid_t		uu;
+	char		str[UUID_STR_LEN], *cp;
+	int		i;
+
+	switch (op) {
+	case UUIDD_OP_GETPID:
+		sprintf(reply_buf, "%d", getpid());
+		reply_len = strlen(reply_buf) + 1;
+		break;
+	case UUIDD_OP_GET_MAXOP:
+		sprintf(reply_buf, "%d", UUIDD_MAX_OP);
+		reply_len = strlen(reply_buf) + 1;
+		break;
+	case UUIDD_OP_TIME_UUID:
+		num = 1;
+		lock_time(uuidd_cxt);
+		__uuid_generate_time(uu, &num);
+		unlock_time(uuidd_cxt);
+		if (uuidd_cxt->debug) {
+			uuid_unparse(uu, str);
+			fprintf(stderr, _("Generated time UUID: %s\n"), str);
+		}
+		memcpy(reply_buf, uu, sizeof(uu));
+		reply_len = sizeof(uu);
+		break;
+	case UUIDD_OP_RANDOM_UUID:
+		num = 1;
+		__uuid_generate_random(uu, &num);
+		if (uuidd_cxt->debug) {
+			uuid_unparse(uu, str);
+			fprintf(stderr, _("Generated random UUID: %s\n"), str);
+		}
+		memcpy(reply_buf, uu, sizeof(uu));
+		reply_len = sizeof(uu);
+		break;
+	case UUIDD_OP_BULK_TIME_UUID:
+		lock_time(uuidd_cxt);
+		__uuid_generate_time(uu, &num);
+		unlock_time(uuidd_cxt);
+		if (uuidd_cxt->debug) {
+			uuid_unparse(uu, str);
+			fprintf(stderr, P_("Generated time UUID %s "
+					   "and %d following\n",
+					   "Generated time UUID %s "
+					   "and %d following\n", num - 1),
+			       str, num - 1);
+		}
+		memcpy(reply_buf, uu, sizeof(uu));
+		reply_len = sizeof(uu);
+		memcpy(reply_buf + reply_len, &num, sizeof(num));
+		reply_len += sizeof(num);
+		break;
+	case UUIDD_OP_BULK_RANDOM_UUID:
+		if (num < 0)
+			num = 1;
+		if (num > 1000)
+			num = 1000;
+		if (num * UUID_LEN > UUIDD_REPLY_LEN - sizeof(num))
+			num = (UUIDD_REPLY_LEN - sizeof(num)) / UUID_LEN;
+		__uuid_generate_random((unsigned char *) reply_buf +
+				      sizeof(num), &num);
+		if (uuidd_cxt->debug) {
+			fprintf(stderr, P_("Generated %d UUID:\n",
+					   "Generated %d UUIDs:\n", num), num);
+			for (i = 0, cp = reply_buf + sizeof(num);
+			     i < num;
+			     i++, cp += UUID_LEN) {
+				uuid_unparse((unsigned char *)cp, str);
+				fprintf(stderr, "\t%s\n", str);
+			}
+		}
+		reply_len = (num * UUID_LEN) + sizeof(num);
+		memcpy(reply_buf, &num, sizeof(num));
+		break;
+	case UUIDD_OP_GET_RING:
+		/* the file descriptor is sent by conn_flush() */
+		if (shared_ring) {
+			uint32_t magic = UUIDD_RING_MAGIC,
+				 size = sizeof(struct uuidd_ring);
+
+			memcpy(reply_buf, &magic, sizeof(magic));
+			memcpy(reply_buf + sizeof(magic), &size, sizeof(size));
+			reply_len = sizeof(magic) + sizeof(size);
+		}
+		break;
+	default:
+		if (uuidd_cxt->debug)
+			fprintf(stderr, _("Invalid operation %d\n"), op);
+		return -1;
+	}
+
+	return reply_len;
+}
+
+static int conn_append_reply(struct uuidd_conn *cn, const char *reply,
+			     int32_t reply_len)
+{
+	size_t sz = sizeof(reply_len) + reply_len;
+
+	if (cn->outpos && cn->outpos == cn->outlen)
+		cn->outpos = cn->outlen = 0;
+
+	if (cn->outlen + sz > cn->outsz) {
+		size_t newsz = cn->outsz ? cn->outsz : 4096;
+		char *p;
+
+		while (newsz < cn->outlen + sz)
+			newsz *= 2;
+		p = realloc(cn->outbuf, newsz);
+		if (!p)
+			return -ENOMEM;
+		cn->outbuf = p;
+		cn->outsz = newsz;
+	}
+	memcpy(cn->outbuf + cn->outlen, &reply_len, sizeof(reply_len));
+	memcpy(cn->outbuf + cn->outlen + sizeof(reply_len), reply, reply_len);
+	cn->outlen += sz;
+	return 0;
+}
+
+/*
+ * Processes all complete requests from the input buffer.
+ *
+ * Returns 0 on success, -1 if the connection has to be closed.
+ */
+static int conn_process_requests(const struct uuidd_cxt_t *uuidd_cxt,
+				 struct uuidd_conn *cn)
+{
+	char		reply_buf[UUIDD_REPLY_LEN];
+	size_t		pos = 0;
+
+	while (pos < cn->inlen && cn->outlen - cn->outpos < UUIDD_OUTBUF_MAX) {
+		char op = cn->inbuf[pos];
+		int num = 0;
+		int32_t reply_len;
+
+		if ((op == UUIDD_OP_BULK_TIME_UUID) ||
+		    (op == UUIDD_OP_BULK_RANDOM_UUID)) {
+			if (cn->inlen - pos < UUIDD_REQ_LEN)
+				break;		/* incomplete request */
+			memcpy(&num, cn->inbuf + pos + 1, sizeof(num));
+			pos += UUIDD_REQ_LEN;
+			if (uuidd_cxt->debug)
+				fprintf(stderr, _("operation %d, incoming num = %d\n"),
+				       op, num);
+		} else {
+			pos++;
+			if (uuidd_cxt->debug)
+				fprintf(stderr, _("operation %d\n"), op);
+		}
+
+		if (op == UUIDD_OP_GET_RING && cn->pass_ring)
+			reply_len = 0;	/* only one file descriptor in flight */
+		else
+			reply_len = handle_request(uuidd_cxt, op, num, reply_buf);
+		if (reply_len < 0)
+			return -1;
+		if (op == UUIDD_OP_GET_RING && reply_len > 0) {
+			if (cn->outpos == cn->outlen)
+				cn->outpos = cn->outlen = 0;
+			cn->ring_pos = cn->outlen;
+			cn->pass_ring = 1;
+		}
+		if (conn_append_reply(cn, reply_buf, reply_len) != 0)
+			return -1;
+	}
+
+	if (pos) {
+		cn->inlen -= pos;
+		memmove(cn->inbuf, cn->inbuf + pos, cn->inlen);
+	}
+	return 0;
+}
+
+/* sends @buf with the shared ring file descriptor */
+static ssize_t send_ring_fd(int sock, const char *buf, size_t len)
+{
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+	union {
+		struct cmsghdr	cmsg;
+		char		buf[CMSG_SPACE(sizeof(int))];
+	} ctl;
+
+	memset(&msg, 0, sizeof(msg));
+	memset(&ctl, 0, sizeof(ctl));
+	iov.iov_base = (char *) buf;
+	iov.iov_len = len;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = ctl.buf;
+	msg.msg_controllen = sizeof(ctl.buf);
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &shared_ring_fd, sizeof(int));
+
+	return sendmsg(sock, &msg, MSG_NOSIGNAL);
+}
+
+/*
+ * Returns 0 on success, -1 if the connection has to be closed.
+ */
+static int conn_flush(struct uuidd_conn *cn)
+{
+	while (cn->outpos < cn->outlen) {
+		size_t len = cn->outlen - cn->outpos;
+		ssize_t ret;
+
+		if (cn->pass_ring && cn->ring_pos == cn->outpos) {
+			ret = send_ring_fd(cn->fd, cn->outbuf + cn->outpos, len);
+			if (ret > 0)
+				cn->pass_ring = 0;
+		} else {
+			/* stop before the reply with the file descriptor */
+			if (cn->pass_ring && cn->ring_pos > cn->outpos)
+				len = min(len, cn->ring_pos - cn->outpos);
+			ret = write(cn->fd, cn->outbuf + cn->outpos, len);
+		}
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			return -1;
+		}
+		cn->outpos += ret;
+	}
+	return 0;
+}
+
+static int conn_read(struct uuidd_conn *cn)
+{
+	while (!cn->eof && cn->inlen < sizeof(cn->inbuf)) {
+		ssize_t ret = read(cn->fd, cn->inbuf + cn->inlen,
+				   sizeof(cn->inbuf) - cn->inlen);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			warn(_("read failed"));
+			return -1;
+		}
+		if (ret == 0)
+			cn->eof = 1;
+		cn->inlen += ret;
+	}
+	return 0;
+}
+
+static void refill_ring(const struct uuidd_cxt_t *uuidd_cxt);
+
+static void resume_accept(void)
+{
+	struct epoll_event ev = { .events = EPOLLIN };
+
+	ev.data.ptr = NULL;
+	if (__sync_bool_compare_and_swap(&accept_stopped, 1, 0) &&
+	    epoll_ctl(listen_efd, EPOLL_CTL_ADD, listen_fd, &ev) != 0)
+		err(EXIT_FAILURE, "epoll_ctl");
+}
+
+static void conn_close(struct uuidd_worker *wk, struct uuidd_conn *cn)
+{
+	lock_conns(wk);
+	list_del(&cn->conns);
+	unlock_conns(wk);
+
+	epoll_ctl(wk->efd, EPOLL_CTL_DEL, cn->fd, NULL);
+	close(cn->fd);
+	free(cn->outbuf);
+	free(cn);
+
+	resume_accept();
+}
+
+/* moves the connection to the end of the list of connections */
+static void conn_touch(struct uuidd_worker *wk, struct uuidd_conn *cn)
+{
+	lock_conns(wk);
+	cn->last_active = time(NULL);
+	cn->active_seq = __sync_add_and_fetch(&conn_seq, 1);
+	list_del(&cn->conns);
+	list_add_tail(&cn->conns, &wk->conns);
+	unlock_conns(wk);
+}
+
+/* closes the connections of the worker without any event for a while */
+static void close_idle_connections(struct uuidd_worker *wk)
+{
+	time_t now = time(NULL);
+
+	while (1) {
+		struct uuidd_conn *cn;
+
+		lock_conns(wk);
+		cn = list_first_entry(&wk->conns, struct uuidd_conn, conns);
+		if (cn && now - cn->last_active < UUIDD_CONN_IDLE)
+			cn = NULL;
+		unlock_conns(wk);
+
+		if (!cn)
+			break;
+		if (wk->cxt->debug)
+			fprintf(stderr, _("closing idle connection\n"));
+		conn_close(wk, cn);
+	}
+}
+
+/*
+ * Shuts down the least recently active connection of all the workers, the
+ * descriptor is closed by the worker.
+ */
+static void shutdown_oldest_connection(struct uuidd_worker *wks, size_t nwks)
+{
+	struct uuidd_worker *oldest = NULL;
+	uint64_t oldest_seq = 0;
+	struct list_head *p;
+	size_t i;
+
+	for (i = 0; i < nwks; i++) {
+		lock_conns(&wks[i]);
+		list_for_each(p, &wks[i].conns) {
+			struct uuidd_conn *cn = list_entry(p, struct uuidd_conn, conns);
+
+			if (cn->shut)
+				continue;
+			if (!oldest || cn->active_seq < oldest_seq) {
+				oldest = &wks[i];
+				oldest_seq = cn->active_seq;
+			}
+			break;
+		}
+		unlock_conns(&wks[i]);
+	}
+	if (!oldest)
+		return;
+
+	lock_conns(oldest);
+	list_for_each(p, &oldest->conns) {
+		struct uuidd_conn *cn = list_entry(p, struct uuidd_conn, conns);
+
+		if (cn->shut)
+			continue;
+		shutdown(cn->fd, SHUT_RDWR);
+		cn->shut = 1;
+		break;
+	}
+	unlock_conns(oldest);
+}
+
+/*
+ * Reads and processes the client requests and sends the replies, the
+ * connection is kept open until the client closes it.
+ */
+static void conn_handle(struct uuidd_worker *wk, struct uuidd_conn *cn,
+			uint32_t events)
+{
+	struct epoll_event ev = { .events = 0 };
+	size_t pending;
+
+	if (events & EPOLLERR)
+		goto close;
+
+	conn_touch(wk, cn);
+
+	if ((events & (EPOLLIN | EPOLLHUP)) && conn_read(cn) != 0)
+		goto close;
+
+	do {
+		if (conn_process_requests(wk->cxt, cn) != 0 ||
+		    conn_flush(cn) != 0)
+			goto close;
+		pending = cn->outlen - cn->outpos;
+		/* read more requests if the input buffer has been full */
+	} while (pending < UUIDD_OUTBUF_MAX && cn->inlen == sizeof(cn->inbuf)
+		 && conn_read(cn) == 0);
+
+	if (cn->eof && !pending) {
+		if (cn->inlen && wk->cxt->debug)
+			fprintf(stderr, _("error reading from client, len = %d\n"),
+					(int) cn->inlen);
+		goto close;
+	}
+
+	if (!cn->eof && pending < UUIDD_OUTBUF_MAX)
+		ev.events |= EPOLLIN;
+	if (pending)
+		ev.events |= EPOLLOUT;
+
+	if (ev.events != cn->events) {
+		ev.data.ptr = cn;
+		if (epoll_ctl(wk->efd, EPOLL_CTL_MOD, cn->fd, &ev) != 0)
+			goto close;
+		cn->events = ev.events;
+	}
+	/* the client has probably found the ring empty */
+	if (shared_ring)
+		refill_ring(wk->cxt);
+	return;
+close:
+	conn_close(wk, cn);
+}
+
+static void add_connection(struct uuidd_worker *wk, int ns)
+{
+	struct epoll_event ev = { .events = EPOLLIN };
+	struct uuidd_conn *cn;
+
+	cn = calloc(1, sizeof(*cn));
+	if (!cn) {
+		close(ns);
+		return;
+	}
+	cn->fd = ns;
+	cn->events = ev.events;
+	cn->last_active = time(NULL);
+	cn->active_seq = __sync_add_and_fetch(&conn_seq, 1);
+	ev.data.ptr = cn;
+
+	lock_conns(wk);
+	list_add_tail(&cn->conns, &wk->conns);
+	unlock_conns(wk);
+
+	if (epoll_ctl(wk->efd, EPOLL_CTL_ADD, ns, &ev) != 0) {
+		warn(_("cannot add client to epoll"));
+		lock_conns(wk);
+		list_del(&cn->conns);
+		unlock_conns(wk);
+		close(ns);
+		free(cn);
+	}
+}
+
+static void init_worker(struct uuidd_worker *wk, const struct uuidd_cxt_t *cxt)
+{
+	wk->cxt = cxt;
+	INIT_LIST_HEAD(&wk->conns);
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_init(&wk->conns_lock, NULL);
+#endif
+	wk->efd = epoll_create1(EPOLL_CLOEXEC);
+	if (wk->efd < 0)
+		err(EXIT_FAILURE, "epoll_create");
+}
+
+/*
+ * Waits for events and handles the clients; the listening socket is in the
+ * main thread epoll only, its epoll_event has NULL data pointer.
+ */
+static int worker_wait(struct uuidd_worker *wk, struct epoll_event *evs,
+		       int maxevs, int timeout)
+{
+	int n = epoll_wait(wk->efd, evs, maxevs, timeout);
+
+	if (n < 0) {
+		if (errno == EINTR)
+			return 0;
+		err(EXIT_FAILURE, "epoll_wait");
+	}
+	if (n > 0 && wk->cxt->timeout != 0)
+		alarm(wk->cxt->timeout);
+	return n;
+}
+
+/*
+ * Creates the shared ring, it's memfd (or unlinked file on old kernels)
+ * and the file descriptor is sent to the clients.
+ */
+static void create_ring(void)
+{
+	size_t i;
+
+#ifdef SYS_memfd_create
+	shared_ring_fd = syscall(SYS_memfd_create, "uuidd-ring", 0x0001U /* MFD_CLOEXEC */);
+#endif
+	if (shared_ring_fd < 0) {
+		char path[] = UUIDD_DIR "/ring.XXXXXX";
+
+		shared_ring_fd = mkstemp(path);
+		if (shared_ring_fd >= 0)
+			unlink(path);
+	}
+	if (shared_ring_fd < 0)
+		err(EXIT_FAILURE, _("cannot create shared ring"));
+	if (ftruncate(shared_ring_fd, sizeof(struct uuidd_ring)) != 0)
+		err(EXIT_FAILURE, _("cannot resize shared ring"));
+
+	shared_ring = mmap(NULL, sizeof(struct uuidd_ring), PROT_READ | PROT_WRITE,
+			   MAP_SHARED, shared_ring_fd, 0);
+	if (shared_ring == MAP_FAILED)
+		err(EXIT_FAILURE, _("cannot map shared ring"));
+
+	for (i = 0; i < UUIDD_RING_SLOTS; i++)
+		shared_ring->slots[i].seq = UUIDD_RING_WRITING;
+	shared_ring->nslots = UUIDD_RING_SLOTS;
+	shared_ring->magic = UUIDD_RING_MAGIC;
+}
+
+/* moves time-based @uu by @n clock ticks forward */
+static void uuid_time_add(uuid_t uu, uint64_t n)
+{
+	uint64_t t = ((uint64_t) (uu[6] & 0x0F) << 56) | ((uint64_t) uu[7] << 48) |
+		     ((uint64_t) uu[4] << 40) | ((uint64_t) uu[5] << 32) |
+		     ((uint64_t) uu[0] << 24) | ((uint64_t) uu[1] << 16) |
+		     ((uint64_t) uu[2] << 8) | uu[3];
+	t += n;
+	uu[0] = t >> 24;
+	uu[1] = t >> 16;
+	uu[2] = t >> 8;
+	uu[3] = t;
+	uu[4] = t >> 40;
+	uu[5] = t >> 32;
+	uu[6] = (uu[6] & 0xF0) | ((t >> 56) & 0x0F);
+	uu[7] = t >> 48;
+}
+
+/*
+ * Reserves new ranges for the slots claimed by the clients. All the ranges
+ * are reserved by one __uuid_generate_time() call, so the clock state file
+ * is updated only once. The ring is writable for all clients, so don't
+ * trust the head, only the daemon writes the tail (with the time lock).
+ */
+static void refill_ring(const struct uuidd_cxt_t *uuidd_cxt)
+{
+	uint64_t head, tail;
+	int64_t now;
+	size_t i, count;
+	uuid_t uu;
+	int num;
+
+	head = __atomic_load_n(&shared_ring->head, __ATOMIC_ACQUIRE);
+	if (head + UUIDD_RING_SLOTS <= __atomic_load_n(&shared_ring->tail,
+						       __ATOMIC_RELAXED))
+		return;				/* full */
+
+	lock_time(uuidd_cxt);
+	tail = shared_ring->tail;
+	if (head + UUIDD_RING_SLOTS <= tail) {
+		unlock_time(uuidd_cxt);		/* refilled by another thread */
+		return;
+	}
+	count = min((uint64_t) UUIDD_RING_SLOTS, head + UUIDD_RING_SLOTS - tail);
+	num = count * UUIDD_RING_RANGE;
+	now = time(NULL);
+	__uuid_generate_time(uu, &num);
+
+	for (i = 0; i < count; i++) {
+		struct uuidd_ring_slot *sl = &shared_ring->slots[tail % UUIDD_RING_SLOTS];
+
+		__atomic_store_n(&sl->seq, UUIDD_RING_WRITING, __ATOMIC_RELAXED);
+		__sync_synchronize();
+		memcpy(sl->uuid, uu, sizeof(uu));
+		sl->num = UUIDD_RING_RANGE;
+		sl->stamp = now;
+		__atomic_store_n(&sl->seq, tail, __ATOMIC_RELEASE);
+
+		tail++;
+		__atomic_store_n(&shared_ring->tail, tail, __ATOMIC_RELEASE);
+		uuid_time_add(uu, UUIDD_RING_RANGE);
+	}
+	unlock_time(uuidd_cxt);
+
+	if (uuidd_cxt->debug)
+		fprintf(stderr, _("Shared ring: published %zu ranges\n"), count);
+}
+
+#ifdef HAVE_LIBPTHREAD
+static void *worker_thread(void *data)
+{
+	struct uuidd_worker *wk = data;
+	struct epoll_event evs[64];
+
+	while (1) {
+		int i, n = worker_wait(wk, evs, ARRAY_SIZE(evs),
+				       UUIDD_CONN_IDLE * 1000);
+
+		for (i = 0; i < n; i++)
+			conn_handle(wk, evs[i].data.ptr, evs[i].events);
+		close_idle_connections(wk);
+	}
+	return NULL;
+}
+#endif
+
 static void server_loop(const char *socket_path, const char *pidfile_path,
 			const struct uuidd_cxt_t *uuidd_cxt)
 {
-	struct sockaddr_un	from_addr;
-	socklen_t		fromlen;
-	int32_t			reply_len = 0;
-	uuid_t			uu;
-	char			reply_buf[1024], *cp;
-	char			op, str[UUID_STR_LEN];
-	int			i, ns, len, num;
+	struct uuidd_worker	main_wk = { .efd = -1 },
+				*workers = NULL;
+	struct epoll_event	evs[64], ev = { .events = EPOLLIN };
+	char			reply_buf[1024];
+	size_t			next_worker = 0;
+	int			accept_failed = 0;	/* EMFILE reported */
 	int			s = 0;
 	int			fd_pidfile = -1;
 	int			ret;
@@ -364,112 +1065,97 @@ static void server_loop(const char *socket_path, const char *pidfile_path,
 	}
 #endif
 
-	while (1) {
-		fromlen = sizeof(from_addr);
-		if (uuidd_cxt->timeout != 0)
-			alarm(uuidd_cxt->timeout);
-		ns = accept(s, (struct sockaddr *) &from_addr, &fromlen);
-		alarm(0);
-		if (ns < 0) {
-			if ((errno == EAGAIN) || (errno == EINTR))
-				continue;
-			else
-				err(EXIT_FAILURE, "accept");
+	fcntl(s, F_SETFL, fcntl(s, F_GETFL) | O_NONBLOCK);
+
+	init_worker(&main_wk, uuidd_cxt);
+	ev.data.ptr = NULL;
+	if (epoll_ctl(main_wk.efd, EPOLL_CTL_ADD, s, &ev) != 0)
+		err(EXIT_FAILURE, "epoll_ctl");
+	listen_fd = s;
+	listen_efd = main_wk.efd;
+
+#ifdef HAVE_LIBPTHREAD
+	if (uuidd_cxt->nworkers) {
+		uint32_t i;
+
+		workers = calloc(uuidd_cxt->nworkers, sizeof(*workers));
+		if (!workers)
+			err(EXIT_FAILURE, _("cannot allocate workers"));
+		for (i = 0; i < uuidd_cxt->nworkers; i++) {
+			init_worker(&workers[i], uuidd_cxt);
+			errno = pthread_create(&workers[i].thread, NULL,
+					       worker_thread, &workers[i]);
+			if (errno)
+				err(EXIT_FAILURE, _("cannot create worker thread"));
 		}
-		len = read(ns, &op, 1);
-		if (len != 1) {
-			if (len < 0)
-				warn(_("read failed"));
-			else
-				warnx(_("error reading from client, len = %d"),
-						len);
-			goto shutdown_socket;
-		}
-		if ((op == UUIDD_OP_BULK_TIME_UUID) ||
-		    (op == UUIDD_OP_BULK_RANDOM_UUID)) {
-			if (read_all(ns, (char *) &num, sizeof(num)) != 4)
-				goto shutdown_socket;
-			if (uuidd_cxt->debug)
-				fprintf(stderr, _("operation %d, incoming num = %d\n"),
-				       op, num);
-		} else if (uuidd_cxt->debug)
-			fprintf(stderr, _("operation %d\n"), op);
+	}
+#endif
+	if (uuidd_cxt->ring)
+		create_ring();
+	if (uuidd_cxt->timeout != 0)
+		alarm(uuidd_cxt->timeout);
 
-		switch (op) {
-		case UUIDD_OP_GETPID:
-			sprintf(reply_buf, "%d", getpid());
-			reply_len = strlen(reply_buf) + 1;
-			break;
-		case UUIDD_OP_GET_MAXOP:
-			sprintf(reply_buf, "%d", UUIDD_MAX_OP);
-			reply_len = strlen(reply_buf) + 1;
-			break;
-		case UUIDD_OP_TIME_UUID:
-			num = 1;
-			__uuid_generate_time(uu, &num);
-			if (uuidd_cxt->debug) {
-				uuid_unparse(uu, str);
-				fprintf(stderr, _("Generated time UUID: %s\n"), str);
-			}
-			memcpy(reply_buf, uu, sizeof(uu));
-			reply_len = sizeof(uu);
-			break;
-		case UUIDD_OP_RANDOM_UUID:
-			num = 1;
-			__uuid_generate_random(uu, &num);
-			if (uuidd_cxt->debug) {
-				uuid_unparse(uu, str);
-				fprintf(stderr, _("Generated random UUID: %s\n"), str);
-			}
-			memcpy(reply_buf, uu, sizeof(uu));
-			reply_len = sizeof(uu);
-			break;
-		case UUIDD_OP_BULK_TIME_UUID:
-			__uuid_generate_time(uu, &num);
-			if (uuidd_cxt->debug) {
-				uuid_unparse(uu, str);
-				fprintf(stderr, P_("Generated time UUID %s "
-						   "and %d following\n",
-						   "Generated time UUID %s "
-						   "and %d following\n", num - 1),
-				       str, num - 1);
+	while (1) {
+		int n, timeout;
+
+		if (shared_ring)
+			refill_ring(uuidd_cxt);
+
+		timeout = shared_ring ? UUIDD_RING_INTERVAL : UUIDD_CONN_IDLE * 1000;
+		if (__atomic_load_n(&accept_stopped, __ATOMIC_RELAXED) &&
+		    timeout > UUIDD_ACCEPT_BACKOFF)
+			timeout = UUIDD_ACCEPT_BACKOFF;
+
+		n = worker_wait(&main_wk, evs, ARRAY_SIZE(evs), timeout);
+
+		/* no connection has been closed, try it again */
+		if (n == 0)
+			resume_accept();
+
+		for (ret = 0; ret < n; ret++) {
+			if (evs[ret].data.ptr) {
+				conn_handle(&main_wk, evs[ret].data.ptr,
+					    evs[ret].events);
+				continue;
 			}
-			memcpy(reply_buf, uu, sizeof(uu));
-			reply_len = sizeof(uu);
-			memcpy(reply_buf + reply_len, &num, sizeof(num));
-			reply_len += sizeof(num);
-			break;
-		case UUIDD_OP_BULK_RANDOM_UUID:
-			if (num < 0)
-				num = 1;
-			if (num > 1000)
-				num = 1000;
-			if (num * UUID_LEN > (int) (sizeof(reply_buf) - sizeof(num)))
-				num = (sizeof(reply_buf) - sizeof(num)) / UUID_LEN;
-			__uuid_generate_random((unsigned char *) reply_buf +
-					      sizeof(num), &num);
-			if (uuidd_cxt->debug) {
-				fprintf(stderr, P_("Generated %d UUID:\n",
-						   "Generated %d UUIDs:\n", num), num);
-				for (i = 0, cp = reply_buf + sizeof(num);
-				     i < num;
-				     i++, cp += UUID_LEN) {
-					uuid_unparse((unsigned char *)cp, str);
-					fprintf(stderr, "\t%s\n", str);
+			/* new clients, round-robin to the workers */
+			while (1) {
+				int ns = accept4(s, NULL, NULL,
+						 SOCK_NONBLOCK | SOCK_CLOEXEC);
+				if (ns < 0) {
+					if (errno == EAGAIN || errno == EWOULDBLOCK)
+						break;
+					if (errno == EINTR || errno == ECONNABORTED)
+						continue;
+					if (errno == EMFILE || errno == ENFILE) {
+						/* the listening socket would be
+						 * reported again and again, remove
+						 * it from epoll until the oldest
+						 * connection is closed */
+						if (!accept_failed)
+							warn("accept");
+						accept_failed = 1;	/* only once */
+						epoll_ctl(main_wk.efd, EPOLL_CTL_DEL,
+							  s, NULL);
+						__atomic_store_n(&accept_stopped, 1,
+								 __ATOMIC_RELAXED);
+						if (workers)
+							shutdown_oldest_connection(workers,
+								uuidd_cxt->nworkers);
+						else
+							shutdown_oldest_connection(&main_wk, 1);
+						break;
+					}
+					err(EXIT_FAILURE, "accept");
 				}
+				if (workers) {
+					add_connection(&workers[next_worker], ns);
+					next_worker = (next_worker + 1) % uuidd_cxt->nworkers;
+				} else
+					add_connection(&main_wk, ns);
 			}
-			reply_len = (num * UUID_LEN) + sizeof(num);
-			memcpy(reply_buf, &num, sizeof(num));
-			break;
-		default:
-			if (uuidd_cxt->debug)
-				fprintf(stderr, _("Invalid operation %d\n"), op);
-			goto shutdown_socket;
 		}
-		write_all(ns, (char *) &reply_len, sizeof(reply_len));
-		write_all(ns, reply_buf, reply_len);
-	shutdown_socket:
-		close(ns);
+		close_idle_connections(&main_wk);
 	}
 }
 
@@ -505,6 +1191,8 @@ int main(int argc, char **argv)
 		{"no-pid", no_argument, NULL, 'P'},
 		{"no-fork", no_argument, NULL, 'F'},
 		{"socket-activation", no_argument, NULL, 'S'},
+		{"workers", required_argument, NULL, 'W'},
+		{"shared-ring", no_argument, NULL, 'R'},
 		{"debug", no_argument, NULL, 'd'},
 		{"quiet", no_argument, NULL, 'q'},
 		{"version", no_argument, NULL, 'V'},
@@ -525,7 +1213,7 @@ int main(int argc, char **argv)
 	atexit(close_stdout);
 
 	while ((c =
-		getopt_long(argc, argv, "p:s:T:krtn:PFSdqVh", longopts,
+		getopt_long(argc, argv, "p:s:T:krtn:PFSW:RdqVh", longopts,
 			    NULL)) != -1) {
 		err_exclusive_options(c, longopts, excl, excl_st);
 		switch (c) {
@@ -564,6 +1252,9 @@ int main(int argc, char **argv)
 		case 'r':
 			do_type = UUIDD_OP_RANDOM_UUID;
 			break;
+		case 'R':
+			uuidd_cxt.ring = 1;
+			break;
 		case 's':
 			socket_path = optarg;
 			s_flag = 1;
@@ -575,6 +1266,19 @@ int main(int argc, char **argv)
 			uuidd_cxt.timeout = strtou32_or_err(optarg,
 						_("failed to parse --timeout"));
 			break;
+		case 'W':
+			uuidd_cxt.nworkers = strtou32_or_err(optarg,
+						_("failed to parse --workers"));
+#ifdef HAVE_LIBPTHREAD
+			if (uuidd_cxt.nworkers > UUIDD_MAX_WORKERS)
+				errx(EXIT_FAILURE, _("too many workers (max %d)"),
+						UUIDD_MAX_WORKERS);
+#else
+			if (uuidd_cxt.nworkers)
+				errx(EXIT_FAILURE, _("uuidd has been built without "
+						     "support for worker threads"));
+#endif
+			break;
 		case 'V':
 			printf(UTIL_LINUX_VERSION);
 			return EXIT_SUCCESS;
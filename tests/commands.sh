@@ -4,10 +4,18 @@ TS_TESTUSER=${TS_TESTUSER:-"nobody"}
 # helpers
 TS_HELPER_BYTESWAP="$top_builddir/test_byteswap"
 TS_HELPER_CPUSET="$top_builddir/test_cpuset"
+TS_HELPER_CRC32="$top_builddir/test_crc32"
+TS_HELPER_CRC64="$top_builddir/test_crc64"
 TS_HELPER_ISLOCAL="$top_builddir/test_islocal"
 TS_HELPER_ISMOUNTED="$top_builddir/test_ismounted"
+TS_HELPER_LIBBLKID_SAVE="$top_builddir/test_blkid_save"
+TS_HELPER_LIBBLKID_TAG="$top_builddir/test_blkid_tag"
+TS_HELPER_LIBSMARTCOLS="$top_builddir/test_smartcols"
+TS_HELPER_LIBSMARTCOLS_ARENA="$top_builddir/test_smartcols_arena"
+TS_HELPER_LIBSMARTCOLS_SORT="$top_builddir/test_smartcols_sort"
 TS_HELPER_LIBMOUNT_CONTEXT="$top_builddir/test_mount_context"
 TS_HELPER_LIBMOUNT_LOCK="$top_builddir/test_mount_lock"
+TS_HELPER_LIBMOUNT_MONITOR="$top_builddir/test_mount_monitor"
 TS_HELPER_LIBMOUNT_OPTSTR="$top_builddir/test_mount_optstr"
 TS_HELPER_LIBMOUNT_TABDIFF="$top_builddir/test_mount_tab_diff"
 TS_HELPER_LIBMOUNT_TAB="$top_builddir/test_mount_tab"
@@ -17,7 +25,9 @@ TS_HELPER_LIBMOUNT_DEBUG="$top_builddir/test_mount_debug"
 TS_HELPER_PYLIBMOUNT_CONTEXT="$top_srcdir/libmount/python/test_mount_context.py"
 TS_HELPER_PYLIBMOUNT_TAB="$top_srcdir/libmount/python/test_mount_tab.py"
 TS_HELPER_PYLIBMOUNT_UPDATE="$top_srcdir/libmount/python/test_mount_tab_update.py"
+TS_HELPER_LIBUUID_DAEMON="$top_builddir/test_uuid_daemon"
 TS_HELPER_LOGINDEFS="$top_builddir/test_logindefs"
+TS_HELPER_MBSALIGN="$top_builddir/test_mbsalign"
 TS_HELPER_MD5="$top_builddir/test_md5"
 TS_HELPER_MORE=${TS_HELPER_MORE-"$top_builddir/test_more"}
 TS_HELPER_PARTITIONS="$top_builddir/sample-partitions"
@@ -25,6 +35,7 @@ TS_HELPER_PATHS="$top_builddir/test_pathnames"
 TS_HELPER_SIGRECEIVE="$top_builddir/test_sigreceive"
 TS_HELPER_STRUTILS="$top_builddir/test_strutils"
 TS_HELPER_SYSINFO="$top_builddir/test_sysinfo"
+TS_HELPER_UUIDD_LOAD="$top_builddir/test_uuidd_load"
 
 # paths to commands
 TS_CMD_ADDPART=${TS_CMD_ADDPART:-"$top_builddir/addpart"}
@@ -76,5 +87,6 @@ TS_CMD_UL=${TS_CMD_UL-"$top_builddir/ul"}
 TS_CMD_UMOUNT=${TS_CMD_UMOUNT:-"$top_builddir/umount"}
 TS_CMD_UTMPDUMP=${TS_CMD_UTMPDUMP-"$top_builddir/utmpdump"}
 TS_CMD_UUIDGEN=${TS_CMD_UUIDGEN-"$top_builddir/uuidgen"}
+TS_CMD_UUIDD=${TS_CMD_UUIDD-"$top_builddir/uuidd"}
 TS_CMD_WHEREIS=${TS_CMD_WHEREIS-"$top_builddir/whereis"}
 TS_CMD_WIPEFS=${TS_CMD_WIPEFS-"$top_builddir/wipefs"}
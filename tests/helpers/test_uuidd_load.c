@@ -0,0 +1,397 @@
+/*
+ * test_uuidd_load - uuidd load generator
+ *
+ * Sends requests to uuidd from more client threads and reports number of
+ * requests per second and the request latency.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it would be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include <err.h>
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "c.h"
+#include "all-io.h"
+#include "strutils.h"
+#include "uuid.h"
+#include "uuidd.h"
+
+#define MAX_PIPELINE	64
+
+/* not uuidd operation, claim time ranges from the shared ring */
+#define OP_RING		-1
+
+struct client {
+	pthread_t	thread;
+	size_t		nerrors;
+	size_t		nring;		/* ranges claimed from the ring */
+	uint64_t	*latency;	/* nanoseconds per request */
+	uuid_t		*uuids;		/* returned time UUIDs */
+};
+
+static const char *socket_path = UUIDD_SOCKET_PATH;
+static size_t nrequests = 10000;
+static size_t pipeline = 1;
+static int reconnect;
+static int op = UUIDD_OP_TIME_UUID;
+static struct uuidd_ring *ring;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int connect_daemon(void)
+{
+	struct sockaddr_un addr;
+	int s;
+
+	s = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (s < 0)
+		return -1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+
+	if (connect(s, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+		close(s);
+		return -1;
+	}
+	return s;
+}
+
+/* asks the daemon for the shared ring and maps it */
+static struct uuidd_ring *map_ring(void)
+{
+	char op_ring = UUIDD_OP_GET_RING, reply[8];
+	union {
+		struct cmsghdr	cmsg;
+		char		buf[CMSG_SPACE(sizeof(int))];
+	} ctl;
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+	int32_t reply_len = 0;
+	int s, fd = -1;
+	void *r;
+
+	s = connect_daemon();
+	if (s < 0)
+		err(EXIT_FAILURE, "cannot connect to %s", socket_path);
+	if (write_all(s, &op_ring, 1) != 0)
+		err(EXIT_FAILURE, "write failed");
+
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = &reply_len;
+	iov.iov_len = sizeof(reply_len);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = ctl.buf;
+	msg.msg_controllen = sizeof(ctl.buf);
+	if (recvmsg(s, &msg, 0) != sizeof(reply_len))
+		err(EXIT_FAILURE, "recvmsg failed");
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_type == SCM_RIGHTS)
+			memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+	}
+	if (reply_len != sizeof(reply) || fd < 0)
+		errx(EXIT_FAILURE, "the shared ring is not enabled");
+	if (read_all(s, reply, sizeof(reply)) != sizeof(reply))
+		err(EXIT_FAILURE, "read failed");
+	close(s);
+
+	r = mmap(NULL, sizeof(struct uuidd_ring), PROT_READ | PROT_WRITE,
+		 MAP_SHARED, fd, 0);
+	if (r == MAP_FAILED)
+		err(EXIT_FAILURE, "cannot map the shared ring");
+	close(fd);
+	return r;
+}
+
+/* sends @n requests at once and reads the replies */
+static int do_requests(int s, size_t n, struct client *cl, size_t idx)
+{
+	char req[MAX_PIPELINE * (1 + sizeof(int))], reply[1024];
+	size_t i, len = 0;
+	uint64_t start;
+
+	for (i = 0; i < n; i++) {
+		if (op == OP_RING) {
+			int num;
+
+			start = now_ns();
+			if (uuidd_ring_claim(ring, cl->uuids[idx + i], &num,
+					     time(NULL)) == 0) {
+				cl->latency[idx + i] = now_ns() - start;
+				cl->nring++;
+				continue;
+			}
+			/* the ring is empty, fallback to bulk request */
+			req[len++] = UUIDD_OP_BULK_TIME_UUID;
+			num = UUIDD_RING_RANGE;
+			memcpy(req + len, &num, sizeof(num));
+			len += sizeof(num);
+			continue;
+		}
+		req[len++] = op;
+		if (op == UUIDD_OP_BULK_TIME_UUID) {
+			int num = 10;
+
+			memcpy(req + len, &num, sizeof(num));
+			len += sizeof(num);
+		}
+	}
+
+	if (!len)
+		return 0;
+	start = now_ns();
+	if (write_all(s, req, len) != 0)
+		return -1;
+
+	for (i = 0; i < n; i++) {
+		int32_t reply_len;
+
+		if (op == OP_RING && !uuid_is_null(cl->uuids[idx + i]))
+			continue;	/* claimed from the ring */
+
+		if (read_all(s, (char *) &reply_len, sizeof(reply_len))
+				!= sizeof(reply_len))
+			return -1;
+		if (reply_len < (int32_t) sizeof(uuid_t) ||
+		    (size_t) reply_len > sizeof(reply))
+			return -1;
+		if (read_all(s, reply, reply_len) != reply_len)
+			return -1;
+
+		cl->latency[idx + i] = now_ns() - start;
+		memcpy(cl->uuids[idx + i], reply, sizeof(uuid_t));
+	}
+	return 0;
+}
+
+static void *client_thread(void *data)
+{
+	struct client *cl = data;
+	size_t i = 0;
+	int s = -1;
+
+	while (i < nrequests) {
+		size_t n = min(pipeline, nrequests - i);
+
+		if (s < 0 && (s = connect_daemon()) < 0) {
+			cl->nerrors++;
+			break;
+		}
+		if (do_requests(s, n, cl, i) != 0) {
+			cl->nerrors += n;
+			close(s);
+			s = -1;
+		}
+		i += n;
+		if (reconnect && s >= 0) {
+			close(s);
+			s = -1;
+		}
+	}
+	if (s >= 0)
+		close(s);
+	return NULL;
+}
+
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+	return x == y ? 0 : x > y ? 1 : -1;
+}
+
+static uint64_t uuid_get_time(const unsigned char *uu)
+{
+	return ((uint64_t) (uu[6] & 0x0F) << 56) | ((uint64_t) uu[7] << 48) |
+	       ((uint64_t) uu[4] << 40) | ((uint64_t) uu[5] << 32) |
+	       ((uint64_t) uu[0] << 24) | ((uint64_t) uu[1] << 16) |
+	       ((uint64_t) uu[2] << 8) | uu[3];
+}
+
+/* sorts by clock sequence and node, and then by time */
+static int cmp_uuid(const void *a, const void *b)
+{
+	const unsigned char *x = a, *y = b;
+	int rc = memcmp(x + 8, y + 8, 8);
+
+	if (rc == 0)
+		rc = cmp_u64((uint64_t []) { uuid_get_time(x) },
+			     (uint64_t []) { uuid_get_time(y) });
+	return rc;
+}
+
+/* number of UUIDs represented by one reply */
+static uint64_t range_size(void)
+{
+	if (op == OP_RING)
+		return UUIDD_RING_RANGE;	/* fallback uses the same size */
+	if (op == UUIDD_OP_BULK_TIME_UUID)
+		return 10;
+	return 1;
+}
+
+static void __attribute__((__noreturn__)) usage(FILE *out)
+{
+	fprintf(out, "Usage: %s [options]\n\n", program_invocation_short_name);
+	fputs(" -c, --clients <num>    number of client threads (default 4)\n"
+	      " -n, --requests <num>   requests per client (default 10000)\n"
+	      " -p, --pipeline <num>   send more requests without waiting for reply\n"
+	      " -r, --reconnect        new connection for each request\n"
+	      " -o, --op <op>          time, random, bulk-time or ring\n"
+	      " -s, --socket <path>    uuidd socket\n"
+	      " -q, --quiet            don't print timing (for regression tests)\n", out);
+	exit(out == stderr ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+int main(int argc, char *argv[])
+{
+	struct client *cls;
+	size_t nclients = 4, i, total, nerrors = 0, dups = 0, nring = 0;
+	uint64_t *lat, start, elapsed;
+	uuid_t *uuids;
+	int c, quiet = 0;
+
+	static const struct option longopts[] = {
+		{ "clients",	1, 0, 'c' },
+		{ "requests",	1, 0, 'n' },
+		{ "pipeline",	1, 0, 'p' },
+		{ "reconnect",	0, 0, 'r' },
+		{ "op",		1, 0, 'o' },
+		{ "socket",	1, 0, 's' },
+		{ "quiet",	0, 0, 'q' },
+		{ "help",	0, 0, 'h' },
+		{ NULL, 0, 0, 0 },
+	};
+
+	while ((c = getopt_long(argc, argv, "c:n:p:ro:s:qh", longopts, NULL)) != -1) {
+		switch (c) {
+		case 'c':
+			nclients = strtou32_or_err(optarg, "failed to parse --clients");
+			break;
+		case 'n':
+			nrequests = strtou32_or_err(optarg, "failed to parse --requests");
+			break;
+		case 'p':
+			pipeline = strtou32_or_err(optarg, "failed to parse --pipeline");
+			if (!pipeline || pipeline > MAX_PIPELINE)
+				errx(EXIT_FAILURE, "pipeline out of range (max %d)",
+						MAX_PIPELINE);
+			break;
+		case 'r':
+			reconnect = 1;
+			break;
+		case 'o':
+			if (strcmp(optarg, "time") == 0)
+				op = UUIDD_OP_TIME_UUID;
+			else if (strcmp(optarg, "random") == 0)
+				op = UUIDD_OP_RANDOM_UUID;
+			else if (strcmp(optarg, "bulk-time") == 0)
+				op = UUIDD_OP_BULK_TIME_UUID;
+			else if (strcmp(optarg, "ring") == 0)
+				op = OP_RING;
+			else
+				errx(EXIT_FAILURE, "unsupported operation '%s'", optarg);
+			break;
+		case 's':
+			socket_path = optarg;
+			break;
+		case 'q':
+			quiet = 1;
+			break;
+		case 'h':
+			usage(stdout);
+		default:
+			usage(stderr);
+		}
+	}
+	if (!nclients || !nrequests)
+		errx(EXIT_FAILURE, "no requests");
+
+	if (op == OP_RING)
+		ring = map_ring();
+
+	total = nclients * nrequests;
+	cls = calloc(nclients, sizeof(*cls));
+	lat = calloc(total, sizeof(*lat));
+	uuids = calloc(total, sizeof(uuid_t));
+	if (!cls || !lat || !uuids)
+		err(EXIT_FAILURE, "cannot allocate memory");
+
+	start = now_ns();
+	for (i = 0; i < nclients; i++) {
+		cls[i].latency = lat + i * nrequests;
+		cls[i].uuids = uuids + i * nrequests;
+		errno = pthread_create(&cls[i].thread, NULL, client_thread, &cls[i]);
+		if (errno)
+			err(EXIT_FAILURE, "cannot create thread");
+	}
+	for (i = 0; i < nclients; i++) {
+		pthread_join(cls[i].thread, NULL);
+		nerrors += cls[i].nerrors;
+		nring += cls[i].nring;
+	}
+	elapsed = now_ns() - start;
+
+	/*
+	 * The UUIDs (or the time ranges) have to be unique, unused (failed)
+	 * slots are zeroed.
+	 */
+	qsort(uuids, total, sizeof(uuid_t), cmp_uuid);
+	for (i = 1; i < total; i++) {
+		if (uuid_is_null(uuids[i]) || uuid_is_null(uuids[i - 1]))
+			continue;
+		if (memcmp(uuids[i - 1], uuids[i], sizeof(uuid_t)) == 0)
+			dups++;
+		else if (op != UUIDD_OP_RANDOM_UUID &&
+			 memcmp(uuids[i - 1] + 8, uuids[i] + 8, 8) == 0 &&
+			 uuid_get_time(uuids[i]) - uuid_get_time(uuids[i - 1])
+					< range_size())
+			dups++;		/* overlapping ranges */
+	}
+
+	printf("requests:   %zu\n", total);
+	printf("errors:     %zu\n", nerrors);
+	printf("duplicates: %zu\n", dups);
+
+	if (!quiet) {
+		qsort(lat, total, sizeof(*lat), cmp_u64);
+		printf("time:       %.3f s\n", elapsed / 1e9);
+		printf("requests/s: %.0f\n", total / (elapsed / 1e9));
+		printf("p50:        %.1f us\n", lat[total / 2] / 1e3);
+		printf("p99:        %.1f us\n", lat[total * 99 / 100] / 1e3);
+		if (op == OP_RING)
+			printf("from ring:  %zu\n", nring);
+	}
+
+	free(cls);
+	free(lat);
+	free(uuids);
+	return nerrors || dups ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -45,9 +45,13 @@
 #include "strutils.h"
 #include "c.h"
 #include "closestream.h"
+#include "all-io.h"
 
 #define DEFAULT_LINES  10
 
+/* size of blocks to read the file backwards and to follow it */
+#define TAILF_BUFSZ	(64 * 1024)
+
 static void
 tailf(const char *filename, int lines)
 {
@@ -85,6 +89,69 @@ tailf(const char *filename, int lines)
 	fclose(str);
 }
 
+/*
+ * Returns offset of the first of the last @lines lines of the file. The file
+ * is read backwards from @size in TAILF_BUFSZ blocks, so only the tail of the
+ * file is read and the memory usage does not depend on the length of lines.
+ */
+static off_t
+tail_start(int fd, const char *filename, off_t size, long lines, char *buf)
+{
+	off_t pos = size;
+	int last = 1;
+
+	if (!lines)
+		return size;
+
+	while (pos > 0) {
+		size_t sz = pos < TAILF_BUFSZ ? (size_t) pos : TAILF_BUFSZ;
+		char *end, *p;
+
+		pos -= sz;
+		if (lseek(fd, pos, SEEK_SET) == (off_t) -1 ||
+		    read_all(fd, buf, sz) != (ssize_t) sz)
+			err(EXIT_FAILURE, _("read failed: %s"), filename);
+
+		end = buf + sz;
+
+		/* newline at the end of file does not start a new line */
+		if (last && end[-1] == '\n')
+			end--;
+		last = 0;
+
+		while ((p = memrchr(buf, '\n', end - buf))) {
+			if (--lines == 0)
+				return pos + (p - buf) + 1;
+			end = p;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Prints the last @lines lines of a regular file of @size bytes. Unlike tailf()
+ * it does not read the whole file.
+ */
+static void
+tailf_reverse(int fd, const char *filename, long lines, off_t size, char *buf)
+{
+	off_t pos = tail_start(fd, filename, size, lines, buf);
+
+	if (lseek(fd, pos, SEEK_SET) == (off_t) -1)
+		err(EXIT_FAILURE, _("seek failed: %s"), filename);
+
+	while (pos < size) {
+		size_t sz = size - pos < TAILF_BUFSZ ? (size_t) (size - pos) : TAILF_BUFSZ;
+		ssize_t rc = read_all(fd, buf, sz);
+
+		if (rc <= 0)
+			break;		/* truncated */
+		if (write_all(STDOUT_FILENO, buf, rc))
+			err(EXIT_FAILURE, _("write failed"));
+		pos += rc;
+	}
+}
+
 static void
 roll_file(const char *filename, off_t *size)
 {
@@ -140,22 +207,49 @@ watch_file(const char *filename, off_t *size)
 
 #ifdef HAVE_INOTIFY_INIT
 
-#define EVENTS		(IN_MODIFY|IN_DELETE_SELF|IN_MOVE_SELF|IN_UNMOUNT)
-#define NEVENTS		4
+#define EVENTS		(IN_MODIFY|IN_ATTRIB|IN_DELETE_SELF|IN_MOVE_SELF|IN_UNMOUNT)
+#define NEVENTS		64
+
+/*
+ * Prints data appended to the already opened file since the last call. The
+ * file offset is expected at @size.
+ */
+static void
+roll_fd(int fd, const char *filename, off_t *size, char *buf)
+{
+	struct stat st;
+	ssize_t rc;
+	int nread = 0;
+
+	while ((rc = read(fd, buf, TAILF_BUFSZ)) > 0) {
+		if (write_all(STDOUT_FILENO, buf, rc))
+			warn(_("incomplete write to \"%s\""), filename);
+		*size += rc;
+		nread = 1;
+	}
+
+	/* If we read nothing, check for truncated file and continue at the
+	 * new end of the file.
+	 */
+	if (!nread && fstat(fd, &st) == 0 && st.st_size < *size) {
+		*size = st.st_size;
+		lseek(fd, *size, SEEK_SET);
+	}
+}
 
 static int
-watch_file_inotify(const char *filename, off_t *size)
+watch_file_inotify(int fd, const char *filename, off_t *size, char *buf)
 {
-	char buf[ NEVENTS * sizeof(struct inotify_event) ];
-	int fd, ffd, e;
+	char evbuf[ NEVENTS * sizeof(struct inotify_event) ];
+	int ifd, wd, e;
 	ssize_t len;
 
-	fd = inotify_init();
-	if (fd == -1)
+	ifd = inotify_init();
+	if (ifd == -1)
 		return 0;
 
-	ffd = inotify_add_watch(fd, filename, EVENTS);
-	if (ffd == -1) {
+	wd = inotify_add_watch(ifd, filename, EVENTS);
+	if (wd == -1) {
 		if (errno == ENOSPC)
 			errx(EXIT_FAILURE, _("%s: cannot add inotify watch "
 				"(limit of inotify watches was reached)."),
@@ -164,28 +258,45 @@ watch_file_inotify(const char *filename, off_t *size)
 		err(EXIT_FAILURE, _("%s: cannot add inotify watch."), filename);
 	}
 
-	while (ffd >= 0) {
-		len = read(fd, buf, sizeof(buf));
+	if (lseek(fd, *size, SEEK_SET) == (off_t) -1)
+		err(EXIT_FAILURE, _("seek failed: %s"), filename);
+
+	while (wd >= 0) {
+		int modified = 0, stop = 0;
+
+		len = read(ifd, evbuf, sizeof(evbuf));
 		if (len < 0 && (errno == EINTR || errno == EAGAIN))
 			continue;
 		if (len < 0)
 			err(EXIT_FAILURE,
 				_("%s: cannot read inotify events"), filename);
 
+		/* all events from one read() are handled by one roll_fd() */
 		for (e = 0; e < len; ) {
-			struct inotify_event *ev = (struct inotify_event *) &buf[e];
+			struct inotify_event *ev = (struct inotify_event *) &evbuf[e];
 
 			if (ev->mask & IN_MODIFY)
-				roll_file(filename, size);
-			else {
-				close(ffd);
-				ffd = -1;
-				break;
-			}
+				modified = 1;
+			else if (ev->mask & IN_ATTRIB) {
+				/* the file is kept open, so IN_DELETE_SELF
+				 * does not come when the file is removed */
+				struct stat st;
+
+				if (fstat(fd, &st) == 0 && st.st_nlink == 0)
+					stop = 1;
+			} else
+				stop = 1;
 			e += sizeof(struct inotify_event) + ev->len;
 		}
+
+		if (modified)
+			roll_fd(fd, filename, size, buf);
+		if (stop) {
+			inotify_rm_watch(ifd, wd);
+			wd = -1;
+		}
 	}
-	close(fd);
+	close(ifd);
 	return 1;
 }
 
@@ -233,9 +344,10 @@ int main(int argc, char **argv)
 {
 	const char *filename;
 	long lines;
-	int ch;
+	int ch, fd;
 	struct stat st;
 	off_t size = 0;
+	char *buf;
 
 	static const struct option longopts[] = {
 		{ "lines",   required_argument, 0, 'n' },
@@ -278,14 +390,27 @@ int main(int argc, char **argv)
 	if (stat(filename, &st) != 0)
 		err(EXIT_FAILURE, _("stat failed %s"), filename);
 
-	size = st.st_size;;
-	tailf(filename, lines);
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		err(EXIT_FAILURE, _("cannot open %s"), filename);
+
+	buf = xmalloc(TAILF_BUFSZ);
+	size = st.st_size;
+
+	/* files like /proc/<pid>/... do not report size */
+	if (S_ISREG(st.st_mode) && size > 0)
+		tailf_reverse(fd, filename, lines, size, buf);
+	else
+		tailf(filename, lines);
 
 #ifdef HAVE_INOTIFY_INIT
-	if (!watch_file_inotify(filename, &size))
+	if (!watch_file_inotify(fd, filename, &size, buf))
 #endif
 		watch_file(filename, &size);
 
+	close(fd);
+	free(buf);
+
 	return EXIT_SUCCESS;
 }
 